@@ -13,6 +13,8 @@
 #include <sys/types.h>
 #include <sys/stat.h>
 #include <unistd.h>
+#include <signal.h>
+#include <poll.h>
 
 #include "cgi.h"
 
@@ -27,7 +29,21 @@ struct ARGUMENT args[] =
 {
 	{ "exposureTime", INT_ARG, &cgi.args.nExposureTime, &cgi.args.bExposureTime_supplied },
 	{ "Threshold", INT_ARG, &cgi.args.nThreshold, &cgi.args.bThreshold_supplied },
-	{ "ImageType", INT_ARG, &cgi.args.nImageType, &cgi.args.bImageType_supplied }
+	{ "ImageType", INT_ARG, &cgi.args.nImageType, &cgi.args.bImageType_supplied },
+	{ "ImageFormat", INT_ARG, &cgi.args.nImageFormat, &cgi.args.bImageFormat_supplied },
+	{ "JpegQuality", INT_ARG, &cgi.args.nJpegQuality, &cgi.args.bJpegQuality_supplied },
+	{ "StateOnly", BOOL_ARG, &cgi.args.bStateOnly, NULL },
+	{ "WaitForChange", BOOL_ARG, &cgi.args.bWaitForChange, NULL },
+	{ "WaitStepcounter", INT_ARG, &cgi.args.waitVersion.nStepCounter, NULL },
+	{ "WaitThreshold", INT_ARG, &cgi.args.waitVersion.nThreshold, NULL },
+	{ "WaitExposureTime", INT_ARG, &cgi.args.waitVersion.nExposureTime, NULL },
+	{ "WaitImageType", INT_ARG, &cgi.args.waitVersion.nImageType, NULL },
+	{ "WaitTimeout", INT_ARG, &cgi.args.waitVersion.timeout, &cgi.args.bWaitTimeout_supplied },
+	{ "RoiX", INT_ARG, &cgi.args.nRoiX, &cgi.args.bImgRequest_supplied },
+	{ "RoiY", INT_ARG, &cgi.args.nRoiY, &cgi.args.bImgRequest_supplied },
+	{ "RoiWidth", INT_ARG, &cgi.args.nRoiWidth, &cgi.args.bImgRequest_supplied },
+	{ "RoiHeight", INT_ARG, &cgi.args.nRoiHeight, &cgi.args.bImgRequest_supplied },
+	{ "Decimation", INT_ARG, &cgi.args.nDecimation, &cgi.args.bImgRequest_supplied }
 };
 
 /*! @brief Strips whiltespace from the beginning and the end of a string and returns the new beginning of the string. Be advised, that the original string gets mangled! */
@@ -63,7 +79,8 @@ static OSC_ERR CGIParseArguments()
 	/* Intialize all arguments as 'not supplied' */
 	for (int i = 0; i < sizeof args / sizeof (struct ARGUMENT); i += 1)
 	{
-		*args[i].pbSupplied = false;
+		if (args[i].pbSupplied != NULL)
+			*args[i].pbSupplied = false;
 	}
 
 	while (fgets (buffer, sizeof buffer, stdin)) {
@@ -126,6 +143,208 @@ static OSC_ERR CGIParseArguments()
 	return SUCCESS;
 }
 
+/*********************************************************************//*!
+ * @brief Convert a JPEG quality in percent to the quality factor of the
+ * encoder.
+ *
+ * Uses the same scaling as the IJG library: 50 percent corresponds to
+ * the standard tables from Annex K, which is a quality factor of 1024.
+ *
+ * @param quality Quality in percent (1 to 100).
+ * @return The quality factor to pass to the JPEG encoder.
+ *//*********************************************************************/
+static uint32 JpegQualityFactor(int quality)
+{
+	int scale;
+
+	if (quality < 1)
+		quality = 1;
+	else if (quality > 100)
+		quality = 100;
+
+	if (quality < 50)
+		scale = 5000 / quality;
+	else
+		scale = 200 - 2 * quality;
+
+	return (uint32)(scale * 1024 / 100);
+}
+
+/*********************************************************************//*!
+ * @brief Encode a greyscale image as JPEG into the JPEG buffer.
+ *
+ * @param pImg The greyscale image.
+ * @param width Width of the image.
+ * @param height Height of the image.
+ * @param quality JPEG quality in percent.
+ * @param pLen The length of the encoded image in cgi.jpgBuf is returned
+ * over this pointer.
+ * @return SUCCESS or an appropriate error code otherwise
+ *//*********************************************************************/
+static OSC_ERR EncodeJpeg(uint8 *pImg, uint16 width, uint16 height, int quality, uint32 *pLen)
+{
+	struct OSC_PICTURE pic;
+
+	pic.width = width;
+	pic.height = height;
+	pic.type = OSC_PICTURE_GREYSCALE;
+	pic.data = (void*)pImg;
+
+	return OscJpgEncoderEncodeToBuffer(cgi.hJpegEncoder, &pic, cgi.jpgBuf, JPG_BUF_LEN, JpegQualityFactor(quality), pLen);
+}
+
+/*********************************************************************//*!
+ * @brief JPEG sink writing the data to a file.
+ *
+ * @param pContext The file.
+ * @param pData The data to write.
+ * @param len Length of the data.
+ * @return SUCCESS or an appropriate error code otherwise
+ *//*********************************************************************/
+static OSC_ERR WriteJpegData(void *pContext, const uint8 *pData, uint32 len)
+{
+	if (fwrite(pData, 1, len, (FILE *)pContext) != len)
+		return -EDEVICE;
+	return SUCCESS;
+}
+
+/*********************************************************************//*!
+ * @brief Encode a greyscale image as JPEG and write it to a file.
+ *
+ * The data is written while encoding, without going through the JPEG
+ * buffer.
+ *
+ * @param pImg The greyscale image.
+ * @param width Width of the image.
+ * @param height Height of the image.
+ * @param quality JPEG quality in percent.
+ * @param strFileName The file name of the JPEG file to write.
+ * @return SUCCESS or an appropriate error code otherwise
+ *//*********************************************************************/
+static OSC_ERR WriteJpeg(uint8 *pImg, uint16 width, uint16 height, int quality, const char *strFileName)
+{
+	struct OSC_PICTURE pic;
+	FILE *pFile;
+	OSC_ERR err;
+
+	pic.width = width;
+	pic.height = height;
+	pic.type = OSC_PICTURE_GREYSCALE;
+	pic.data = (void*)pImg;
+
+	pFile = fopen(strFileName, "wb");
+	if (pFile == NULL)
+	{
+		OscLog(ERROR, "%s: Unable to open %s for writing!\n", __func__, strFileName);
+		return -EUNABLE_TO_OPEN_FILE;
+	}
+
+	err = OscJpgEncoderEncodeToSink(cgi.hJpegEncoder, &pic, JpegQualityFactor(quality), WriteJpegData, pFile);
+	if (err != SUCCESS)
+	{
+		OscLog(ERROR, "%s: Unable to write %s! (%d)\n", __func__, strFileName, err);
+		fclose(pFile);
+		return err;
+	}
+
+	fclose(pFile);
+	return SUCCESS;
+}
+
+/*********************************************************************//*!
+ * @brief Fill in the image request from the RoiX, RoiY, RoiWidth,
+ * RoiHeight and Decimation arguments.
+ *
+ * Missing arguments default to the whole image without downscaling.
+ *
+ * @return SUCCESS or -EINVALID_PARAMETER if the area does not lie
+ * within the image or the decimation is not supported.
+ *//*********************************************************************/
+static OSC_ERR MakeImgRequest()
+{
+	struct ARGUMENT_DATA *pArgs = &cgi.args;
+	struct IMG_REQUEST *pImgReq = &cgi.imgRequest;
+	const int width = OSC_CAM_MAX_IMAGE_WIDTH/2, height = OSC_CAM_MAX_IMAGE_HEIGHT/2;
+
+	if (pArgs->nRoiWidth == 0)
+		pArgs->nRoiWidth = width - pArgs->nRoiX;
+	if (pArgs->nRoiHeight == 0)
+		pArgs->nRoiHeight = height - pArgs->nRoiY;
+	if (pArgs->nDecimation == 0)
+		pArgs->nDecimation = 1;
+
+	if (pArgs->nRoiX < 0 || pArgs->nRoiY < 0 || pArgs->nRoiWidth <= 0 || pArgs->nRoiHeight <= 0 ||
+			pArgs->nRoiX + pArgs->nRoiWidth > width || pArgs->nRoiY + pArgs->nRoiHeight > height ||
+			pArgs->nDecimation > MAX_IMG_DECIMATION || (pArgs->nDecimation & (pArgs->nDecimation - 1)) != 0 ||
+			pArgs->nRoiWidth < pArgs->nDecimation || pArgs->nRoiHeight < pArgs->nDecimation)
+	{
+		OscLog(ERROR, "%s: Invalid image area %dx%d+%d+%d/%d!\n", __func__,
+				pArgs->nRoiWidth, pArgs->nRoiHeight, pArgs->nRoiX, pArgs->nRoiY, pArgs->nDecimation);
+		return -EINVALID_PARAMETER;
+	}
+
+	pImgReq->rect.xPos = pArgs->nRoiX;
+	pImgReq->rect.yPos = pArgs->nRoiY;
+	pImgReq->rect.width = pArgs->nRoiWidth;
+	pImgReq->rect.height = pArgs->nRoiHeight;
+	pImgReq->decimation = pArgs->nDecimation;
+	return SUCCESS;
+}
+
+/*********************************************************************//*!
+ * @brief Choose the file name of the live image from the requested image
+ * area and the image format of the application.
+ *
+ * The whole image keeps its plain name, a cropped or downscaled image
+ * gets a name of its own per area so concurrent viewers of different
+ * areas never read each other's file.
+ *//*********************************************************************/
+static void SetImgFileName()
+{
+	const struct IMG_REQUEST *pImgReq = &cgi.imgRequest;
+	const char *strExt = cgi.appState.enImageFormat == IMG_FORMAT_JPEG ? ".jpg" : ".bmp";
+
+	if (cgi.args.bImgRequest_supplied)
+	{
+		snprintf(cgi.strImgFile, sizeof(cgi.strImgFile), IMG_ROI_BASE_FN "%s",
+				pImgReq->rect.xPos, pImgReq->rect.yPos, pImgReq->rect.width, pImgReq->rect.height,
+				pImgReq->decimation, strExt);
+	}
+	else
+	{
+		snprintf(cgi.strImgFile, sizeof(cgi.strImgFile), IMG_BASE_FN "%s", strExt);
+	}
+}
+
+/*********************************************************************//*!
+ * @brief Get the application state once it differs from the version
+ * supplied by the client or the timeout expired.
+ *
+ * The application holds the WAIT_APP_STATE request back, so this
+ * call blocks for up to the timeout.
+ *
+ * @return SUCCESS or an appropriate error code otherwise
+ *//*********************************************************************/
+static OSC_ERR WaitAppState()
+{
+	OSC_ERR err;
+	struct APP_STATE_VERSION *pVer = &cgi.args.waitVersion;
+
+	if (!cgi.args.bWaitTimeout_supplied)
+	{
+		pVer->timeout = STATE_WAIT_TIMEOUT;
+	}
+
+	err = OscIpcSetParam(cgi.ipcChan, pVer, SET_STATE_VERSION, sizeof(struct APP_STATE_VERSION));
+	if (err != SUCCESS)
+	{
+		OscLog(ERROR, "CGI: Error setting state version! (%d)\n", err);
+		return err;
+	}
+
+	return OscIpcGetParam(cgi.ipcChan, &cgi.appState, WAIT_APP_STATE, sizeof(struct APPLICATION_STATE));
+}
+
 /*********************************************************************//*!
  * @brief Query the current state of the application and see what else
  * we need to get from it
@@ -139,9 +358,17 @@ static OSC_ERR QueryApp()
 {
 	OSC_ERR err;
 	struct OSC_PICTURE pic;
+	char strFileName[sizeof(IMG_DIR) + MAX_IMG_FN_LEN];
 
 	/* First, get the current state of the algorithm. */
-	err = OscIpcGetParam(cgi.ipcChan, &cgi.appState, GET_APP_STATE, sizeof(struct APPLICATION_STATE));
+	if (cgi.args.bWaitForChange)
+	{
+		err = WaitAppState();
+	}
+	else
+	{
+		err = OscIpcGetParam(cgi.ipcChan, &cgi.appState, GET_APP_STATE, sizeof(struct APPLICATION_STATE));
+	}
 	if (err != SUCCESS)
 	{
 		/* This request is defined in all states, and thus must succeed. */
@@ -149,16 +376,30 @@ static OSC_ERR QueryApp()
 		return err;
 	}
 
+	SetImgFileName();
+
 	switch(cgi.appState.enAppMode)
 	{
 	case APP_OFF:
 		/* Algorithm is off, nothing else to do. */
 		break;
 	case APP_CAPTURE_ON:
-		if (cgi.appState.bNewImageReady)
+		if (cgi.appState.bNewImageReady && !cgi.args.bStateOnly)
 		{
 			/* If there is a new image ready, request it from the application. */
-			err = OscIpcGetParam(cgi.ipcChan, cgi.imgBuf, GET_NEW_IMG, OSC_CAM_MAX_IMAGE_WIDTH/2*OSC_CAM_MAX_IMAGE_HEIGHT/2);
+			if (cgi.args.bImgRequest_supplied)
+			{
+				/* Only the requested area, cropped and downscaled by the application. */
+				err = OscIpcSetParam(cgi.ipcChan, &cgi.imgRequest, SET_IMG_REQUEST, sizeof(struct IMG_REQUEST));
+				if (err == SUCCESS)
+				{
+					err = OscIpcGetParam(cgi.ipcChan, cgi.imgBuf, GET_IMG_RECT, IMG_REQUEST_SIZE(&cgi.imgRequest));
+				}
+			}
+			else
+			{
+				err = OscIpcGetParam(cgi.ipcChan, cgi.imgBuf, GET_NEW_IMG, OSC_CAM_MAX_IMAGE_WIDTH/2*OSC_CAM_MAX_IMAGE_HEIGHT/2);
+			}
 			if (err != SUCCESS)
 			{
 				OscLog(DEBUG, "CGI: Getting new image failed! (%d)\n", err);
@@ -167,12 +408,18 @@ static OSC_ERR QueryApp()
 
 			/* Write the image to the RAM file system where it can be picked
 			 * up by the webserver on request from the browser. */
-			pic.width = OSC_CAM_MAX_IMAGE_WIDTH/2;
-			pic.height = OSC_CAM_MAX_IMAGE_HEIGHT/2;
+			sprintf(strFileName, "%s%s", IMG_DIR, cgi.strImgFile);
+			if (cgi.appState.enImageFormat == IMG_FORMAT_JPEG)
+			{
+				return WriteJpeg(cgi.imgBuf, IMG_REQUEST_WIDTH(&cgi.imgRequest), IMG_REQUEST_HEIGHT(&cgi.imgRequest), cgi.appState.nJpegQuality, strFileName);
+			}
+
+			pic.width = IMG_REQUEST_WIDTH(&cgi.imgRequest);
+			pic.height = IMG_REQUEST_HEIGHT(&cgi.imgRequest);
 			pic.type = OSC_PICTURE_GREYSCALE;
 			pic.data = (void*)cgi.imgBuf;
 
-			return OscBmpWrite(&pic, IMG_FN);
+			return OscBmpWrite(&pic, strFileName);
 		}
 		break;
 	default:
@@ -213,6 +460,26 @@ static OSC_ERR SetOptions()
 		}
 	}
 
+	if (pArgs->bImageFormat_supplied)
+	{
+		err = OscIpcSetParam(cgi.ipcChan, &pArgs->nImageFormat, SET_IMAGE_FORMAT, sizeof(pArgs->nImageFormat));
+		if (err != SUCCESS)
+		{
+			OscLog(DEBUG, "CGI: Error setting option! (%d)\n", err);
+			return err;
+		}
+	}
+
+	if (pArgs->bJpegQuality_supplied)
+	{
+		err = OscIpcSetParam(cgi.ipcChan, &pArgs->nJpegQuality, SET_JPEG_QUALITY, sizeof(pArgs->nJpegQuality));
+		if (err != SUCCESS)
+		{
+			OscLog(DEBUG, "CGI: Error setting option! (%d)\n", err);
+			return err;
+		}
+	}
+
 	if (pArgs->bExposureTime_supplied)
 	{
 		err = OscIpcSetParam(cgi.ipcChan, &pArgs->nExposureTime, SET_EXPOSURE_TIME, sizeof(pArgs->nExposureTime));
@@ -226,6 +493,171 @@ static OSC_ERR SetOptions()
 	return SUCCESS;
 }
 
+/*********************************************************************//*!
+ * @brief Wait for the next live image of the application.
+ *
+ * Long polls the application with WAIT_APP_STATE, so this blocks until
+ * the state changed or STREAM_WAIT_TIMEOUT expired, without any IPC
+ * traffic meanwhile.
+ *
+ * @param pLastStep Step counter of the last image sent. Updated when a
+ * new image has been fetched.
+ * @return SUCCESS if a new image is in cgi.imgBuf, -ENO_MSG_AVAIL if
+ * there is no new image yet or an appropriate error code otherwise.
+ *//*********************************************************************/
+static OSC_ERR WaitStreamImage(unsigned int *pLastStep)
+{
+	OSC_ERR err;
+	struct APP_STATE_VERSION ver;
+
+	ver.nStepCounter = *pLastStep;
+	ver.nThreshold = cgi.appState.nThreshold;
+	ver.nExposureTime = cgi.appState.nExposureTime;
+	ver.nImageType = cgi.appState.nImageType;
+	ver.timeout = STREAM_WAIT_TIMEOUT;
+
+	err = OscIpcSetParam(cgi.ipcChan, &ver, SET_STATE_VERSION, sizeof(struct APP_STATE_VERSION));
+	if (err != SUCCESS)
+		return err;
+
+	err = OscIpcGetParam(cgi.ipcChan, &cgi.appState, WAIT_APP_STATE, sizeof(struct APPLICATION_STATE));
+	if (err != SUCCESS)
+		return err;
+
+	if (cgi.appState.enAppMode != APP_CAPTURE_ON || cgi.appState.nStepCounter == *pLastStep)
+		return -ENO_MSG_AVAIL;
+
+	err = OscIpcGetParam(cgi.ipcChan, cgi.imgBuf, GET_NEW_IMG, OSC_CAM_MAX_IMAGE_WIDTH/2*OSC_CAM_MAX_IMAGE_HEIGHT/2);
+	if (err == SUCCESS)
+		*pLastStep = cgi.appState.nStepCounter;
+	else if (err == -ENEGATIVE_ACKNOWLEDGE)
+		err = -ENO_MSG_AVAIL; /* Application changed state, try again. */
+	return err;
+}
+
+/*********************************************************************//*!
+ * @brief Check whether the web server closed our end of the response
+ * because the client went away.
+ *
+ * @return TRUE if nobody reads the stream anymore.
+ *//*********************************************************************/
+static bool IsStreamClosed(void)
+{
+	struct pollfd pfd;
+
+	pfd.fd = fileno(stdout);
+	pfd.events = 0;
+	pfd.revents = 0;
+	return poll(&pfd, 1, 0) > 0 && (pfd.revents & (POLLERR | POLLHUP | POLLNVAL)) != 0;
+}
+
+/*********************************************************************//*!
+ * @brief Write an encoded image from cgi.jpgBuf as a part of the stream.
+ *
+ * @param len Length of the image.
+ * @return SUCCESS or -EDEVICE if the client closed the connection.
+ *//*********************************************************************/
+static OSC_ERR WriteStreamImage(uint32 len)
+{
+	printf("--" STREAM_BOUNDARY "\r\n");
+	printf("Content-Type: image/jpeg\r\n");
+	printf("Content-Length: %u\r\n\r\n", (unsigned int)len);
+	fwrite(cgi.jpgBuf, 1, len, stdout);
+	printf("\r\n");
+	if (fflush(stdout) != 0 || ferror(stdout))
+		return -EDEVICE;
+	return SUCCESS;
+}
+
+/*********************************************************************//*!
+ * @brief Push the live image to the client as a MJPEG stream.
+ *
+ * Keeps the HTTP connection open and sends every new image as a part of
+ * a multipart/x-mixed-replace response. Images are only fetched from the
+ * application once the previous one has been written to the client, so
+ * a slow client skips frames instead of stalling the application.
+ *
+ * A closed connection is noticed without new images too: the web server
+ * hanging up our output is checked after every wait and the last image
+ * is sent again every STREAM_KEEPALIVE_INTERVAL, which fails once the
+ * client is gone. Returns when the client disconnects or the
+ * application goes away.
+ *
+ * With a size limit, the JPEG quality is chosen per image to stay below
+ * it instead of using the quality set in the application.
+ *
+ * @param nMaxBytes Maximum size of an image or 0 for no limit.
+ * @return SUCCESS or an appropriate error code otherwise
+ *//*********************************************************************/
+static OSC_ERR StreamImages(uint32 nMaxBytes)
+{
+	OSC_ERR err;
+	unsigned int lastStep = 0;
+	uint32 len = 0;
+	time_t lastWrite = time(NULL);
+
+	/* A closed connection is detected by the failing write instead. */
+	signal(SIGPIPE, SIG_IGN);
+
+	err = OscJpgEncoderSetTargetSize(cgi.hJpegEncoder, nMaxBytes, TRUE);
+	if (err != SUCCESS)
+		return err;
+
+	/* The application serves other clients besides this one, so the
+	 * channel stays open for the whole stream. */
+	err = OscIpcRegisterChannel(&cgi.ipcChan, USER_INTERFACE_SOCKET_PATH, 0);
+	if (err != SUCCESS)
+		return err;
+
+	printf("Content-type: multipart/x-mixed-replace; boundary=" STREAM_BOUNDARY "\n");
+	printf("Cache-Control: no-cache\n\n");
+	fflush(stdout);
+
+	loop
+	{
+		if (IsStreamClosed())
+		{
+			err = SUCCESS;
+			break;
+		}
+
+		err = WaitStreamImage(&lastStep);
+		if (err == -ENO_MSG_AVAIL)
+		{
+			if (len == 0 || time(NULL) - lastWrite < STREAM_KEEPALIVE_INTERVAL)
+				continue;
+
+			/* Nothing new for a while, repeat the last image to find
+			 * out whether the client is still there. */
+		}
+		else if (err != SUCCESS)
+		{
+			OscLog(DEBUG, "CGI: Stream ended, application not reachable! (%d)\n", err);
+			break;
+		}
+		else
+		{
+			err = EncodeJpeg(cgi.imgBuf, OSC_CAM_MAX_IMAGE_WIDTH/2, OSC_CAM_MAX_IMAGE_HEIGHT/2, cgi.appState.nJpegQuality, &len);
+			if (err != SUCCESS)
+			{
+				OscLog(ERROR, "CGI: Unable to encode stream image! (%d)\n", err);
+				break;
+			}
+		}
+
+		if (WriteStreamImage(len) != SUCCESS)
+		{
+			/* The client closed the connection. */
+			err = SUCCESS;
+			break;
+		}
+		lastWrite = time(NULL);
+	}
+
+	OscIpcUnregisterChannel(cgi.ipcChan);
+	return err;
+}
+
 /*********************************************************************//*!
  * @brief Take all the gathered info and formulate a valid AJAX response
  * that can be parsed by the Javascript in the browser.
@@ -241,9 +673,12 @@ static void FormCGIResponse()
 	printf("exposureTime: %d\n", pAppState->nExposureTime);
 	printf("Threshold: %d\n", pAppState->nThreshold);
 	printf("Stepcounter: %d\n", pAppState->nStepCounter);
-	printf("width: %d\n", OSC_CAM_MAX_IMAGE_WIDTH/2);
-	printf("height: %d\n", OSC_CAM_MAX_IMAGE_HEIGHT/2);
+	printf("width: %d\n", IMG_REQUEST_WIDTH(&cgi.imgRequest));
+	printf("height: %d\n", IMG_REQUEST_HEIGHT(&cgi.imgRequest));
 	printf("ImageType: %u\n", pAppState->nImageType);
+	printf("ImageFormat: %u\n", pAppState->enImageFormat);
+	printf("JpegQuality: %d\n", pAppState->nJpegQuality);
+	printf("imgFile: %s\n", cgi.strImgFile);
 
 	fflush(stdout);
 }
@@ -251,6 +686,7 @@ static void FormCGIResponse()
 OscFunction(mainFunction)
 	OSC_ERR err;
 	struct stat socketStat;
+	char *strQuery;
 
 	/* Initialize */
 	memset(&cgi, 0, sizeof(struct CGI_TEMPLATE));
@@ -269,14 +705,29 @@ OscFunction(mainFunction)
 	/******* Create the framework **********/
 	OscCall(OscCreate,
 		&OscModule_log,
-		&OscModule_ipc);
+		&OscModule_ipc,
+		&OscModule_jpg);
+
+	OscCall(OscJpgCreateEncoder, &cgi.hJpegEncoder);
 
 	OscLogSetConsoleLogLevel(CRITICAL);
 	OscLogSetFileLogLevel(DEBUG);
 
+	/* A GET request with ?stream starts the MJPEG live stream,
+	 * ?stream=<n> limits its images to n kilobytes. */
+	strQuery = getenv("QUERY_STRING");
+	if (strQuery != NULL && (strcmp(strQuery, "stream") == 0 || strncmp(strQuery, "stream=", 7) == 0))
+	{
+		StreamImages(strQuery[6] == '=' ? 1024 * strtoul(strQuery + 7, NULL, 10) : 0);
+		OscJpgDestroyEncoder(cgi.hJpegEncoder);
+		OscDestroy();
+		return SUCCESS;
+	}
+
 	OscCall( OscIpcRegisterChannel, &cgi.ipcChan, USER_INTERFACE_SOCKET_PATH, 0);
 
 	OscCall( CGIParseArguments);
+	OscCall( MakeImgRequest);
 
 	/* The algorithm negative acknowledges if it cannot supply
 	 * the requested data, i.e. it changed state during the
@@ -294,6 +745,7 @@ OscFunction(mainFunction)
 	} while (err == -ENEGATIVE_ACKNOWLEDGE);
 	FormCGIResponse();
 
+	OscJpgDestroyEncoder(cgi.hJpegEncoder);
 	OscDestroy();
 
 OscFunctionCatch()
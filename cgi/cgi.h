@@ -21,8 +21,39 @@
  * argument. */
 #define MAX_ARG_NAME_LEN 32
 
-/*! @brief The file name of the live image. */
-#define IMG_FN "../image.bmp"
+/*! @brief The directory the live image is written to, seen from the CGI. */
+#define IMG_DIR "../"
+/*! @brief The file name of the live image without extension. */
+#define IMG_BASE_FN "image"
+/*! @brief The file name of a cropped or downscaled live image without
+ * extension, from the x, y, width, height and decimation of the area.
+ * Every area has a file of its own, so viewers of different areas do not
+ * overwrite each other's image. */
+#define IMG_ROI_BASE_FN IMG_BASE_FN "_%d_%d_%d_%d_%d"
+/*! @brief The maximum length of the file name of the live image. */
+#define MAX_IMG_FN_LEN 64
+
+/*! @brief Size of the buffer receiving the encoded JPEG live image.
+ * Six times the size of the uncompressed greyscale image. This is a
+ * budget and not the worst case: the encoder may use up to 420 bytes per
+ * 8x8 block, about 6.6 bytes per pixel. EncodeJpeg encodes with the
+ * bounded OscJpgEncoderEncodeToBuffer, so an image that does not fit
+ * fails with -EBUFFER_TOO_SMALL instead of overflowing the buffer. */
+#define JPG_BUF_LEN (2*3*OSC_CAM_MAX_IMAGE_WIDTH/2*OSC_CAM_MAX_IMAGE_HEIGHT/2)
+
+/*! @brief Boundary separating the images of the MJPEG stream. */
+#define STREAM_BOUNDARY "leanXcamFrame"
+/*! @brief Time (ms) the application holds back a stream's request for a
+ * new image, after which the stream checks whether the client is still
+ * there. */
+#define STREAM_WAIT_TIMEOUT 1000
+/*! @brief Time (s) without a new image after which the stream sends the
+ * last one again, to notice a client that went away. */
+#define STREAM_KEEPALIVE_INTERVAL 2
+
+/*! @brief Default time (ms) to wait for a state change if the client
+ * does not supply WaitTimeout. */
+#define STATE_WAIT_TIMEOUT 1000
 
 /* @brief The different data types of the argument string. */
 enum EnArgumentType
@@ -66,6 +97,40 @@ struct ARGUMENT_DATA
 	/*! @brief Says whether the argument ImageType has been
 	 * supplied or not. */
 	bool bImageType_supplied;
+	/*! @brief File format of the live image (see enum EnImageFormat).*/
+	int nImageFormat;
+	/*! @brief Says whether the argument ImageFormat has been
+	 * supplied or not. */
+	bool bImageFormat_supplied;
+	/*! @brief JPEG quality in percent.*/
+	int nJpegQuality;
+	/*! @brief Says whether the argument JpegQuality has been
+	 * supplied or not. */
+	bool bJpegQuality_supplied;
+	/*! @brief Only query the state but do not fetch a new image, e.g.
+	 * because the image is streamed. */
+	bool bStateOnly;
+	/*! @brief Hold the response back until the application state differs
+	 * from waitVersion or the timeout expired (long poll). */
+	bool bWaitForChange;
+	/*! @brief The application state the client has last seen. */
+	struct APP_STATE_VERSION waitVersion;
+	/*! @brief Says whether the argument WaitTimeout has been
+	 * supplied or not. */
+	bool bWaitTimeout_supplied;
+	/*! @brief Left edge of the requested image area. */
+	int nRoiX;
+	/*! @brief Top edge of the requested image area. */
+	int nRoiY;
+	/*! @brief Width of the requested image area (0: up to the right edge). */
+	int nRoiWidth;
+	/*! @brief Height of the requested image area (0: up to the bottom edge). */
+	int nRoiHeight;
+	/*! @brief Downscaling factor of the requested image (0 or 1: none). */
+	int nDecimation;
+	/*! @brief Says whether any of the arguments RoiX, RoiY, RoiWidth,
+	 * RoiHeight or Decimation has been supplied. */
+	bool bImgRequest_supplied;
 };
 
 /*! @brief Main object structure of the CGI. Contains all 'global'
@@ -82,9 +147,17 @@ struct CGI_TEMPLATE
 
 	/*! @brief The state queried from the application. */
 	struct APPLICATION_STATE appState;
+	/*! @brief The image area requested from the application. */
+	struct IMG_REQUEST imgRequest;
+	/*! @brief The file name of the live image in IMG_DIR, with extension. */
+	char strImgFile[MAX_IMG_FN_LEN];
 	/*! @brief The GET/POST arguments of the CGI. */
 	struct ARGUMENT_DATA    args;
 	/*! @brief Temporary data buffer for the images to be saved. */
 	uint8 imgBuf[3*OSC_CAM_MAX_IMAGE_WIDTH*OSC_CAM_MAX_IMAGE_HEIGHT];
+	/*! @brief The JPEG encoder. */
+	void *hJpegEncoder;
+	/*! @brief Output buffer of the JPEG encoder. */
+	uint8 jpgBuf[JPG_BUF_LEN];
 };
 #endif /*CGI_TEMPLATE_H_*/
@@ -343,6 +343,9 @@ var stateControl = {
 	}
 }
 
+// URL of the MJPEG live stream.
+var streamUrl = "/cgi-bin/cgi?stream";
+
 function updateCycle() {
 	function offline() {
 		stateControl.pullState("offline");
@@ -362,21 +365,60 @@ function updateCycle() {
 		});
 	}
 	
+	function showData(data) {
+		$.each(data, function (key, value) {
+			function id(value) {
+				return value;
+			};
+			
+			$("#" + key).text((outputValueHooks[key] || id)(value));
+		})
+	}
+	
+	// The state last received, used to long poll for changes while streaming.
+	var lastState = null;
+	
 	function online() {
+		var streaming = inputValues.LiveStream == "true";
+		var request = { };
+		
 		stateControl.pullState("online");
 		
-		exchangeState("GetImage", { }, function (data) {
-			asynLoadImage("image.bmp?" + data.imgTS, function () {
+		// While streaming, the image arrives over the MJPEG stream and the CGI only answers once the state changed.
+		if (streaming) {
+			request.StateOnly = "true";
+			
+			if (lastState) {
+				request.WaitForChange = "true";
+				request.WaitStepcounter = lastState.Stepcounter;
+				request.WaitThreshold = lastState.Threshold;
+				request.WaitExposureTime = lastState.exposureTime;
+				request.WaitImageType = lastState.ImageType;
+				request.WaitTimeout = 500;
+			}
+		}
+		
+		exchangeState("GetImage", request, function (data) {
+			lastState = data;
+			
+			if (streaming) {
+				if ($("#image").attr("src") != streamUrl) {
+					var img = $(new Image());
+					
+					img.attr("id", "image");
+					img.attr("src", streamUrl);
+					$("#image").replaceWith(img);
+				}
+				
+				showData(data);
+				
+				// Close the loop, the next request blocks until something changed.
+				online();
+			} else asynLoadImage((data.imgFile || "image.bmp") + "?" + data.imgTS, function () {
 				$(this).attr("id", "image");
 				$("#image").replaceWith(this);
 				
-				$.each(data, function (key, value) {
-					function id(value) {
-						return value;
-					};
-					
-					$("#" + key).text((outputValueHooks[key] || id)(value));
-				})
+				showData(data);
 				
 				// Close the loop.
 				online();
@@ -400,6 +442,16 @@ function updateCycle() {
 					Threshold: inputValues.Threshold
 				});
 			
+			if (data.ImageFormat != inputValues.ImageFormat)
+				exchangeState("SetOptions", {
+					ImageFormat: inputValues.ImageFormat
+				});
+			
+			if (data.JpegQuality != inputValues.JpegQuality)
+				exchangeState("SetOptions", {
+					JpegQuality: inputValues.JpegQuality
+				});
+			
 		}, function (request, status) {
 		//	console.log(status);
 			offline();
@@ -69,15 +69,13 @@ OSC_ERR AckIpcRequests()
 		bSuccess = TRUE;
 	}
 	
+	/* The request is released even if the ack fails, so we're ready for the next one either way. */
 	err = OscIpcAckRequest(pIpc->ipcChan, pReq, bSuccess);
-	if (err == SUCCESS)
-	{
-		/* Ack sent successfully. Now we're ready for the next request.*/
-		pIpc->enReqState = REQ_STATE_IDLE;
-	}
-	else if (err == -ETRY_AGAIN)
+	pIpc->enReqState = REQ_STATE_IDLE;
+	if (err == -ESOCKET)
 	{
-		/* Not really an error, just means we have to try again later, which will happen soon enough. */
+		/* The client hung up, which only concerns that client. */
+		OscLog(WARN, "%s: Client left before the acknowledge. (%d)\n", __func__, err);
 		err = SUCCESS;
 	}
 	return err;
@@ -100,3 +98,108 @@ void IpcSendImage_fr16(fract16 *f16Image, uint32 nPixels)
 		pDst++;
 	}
 }
+
+bool IsValidImgRequest(const struct IMG_REQUEST *pImgReq)
+{
+	const struct IMG_RECT *pRect = &pImgReq->rect;
+
+	if (pImgReq->decimation != 1 && pImgReq->decimation != 2 &&
+			pImgReq->decimation != 4 && pImgReq->decimation != MAX_IMG_DECIMATION)
+	{
+		return FALSE;
+	}
+	if (pRect->width < pImgReq->decimation || pRect->height < pImgReq->decimation)
+	{
+		return FALSE;
+	}
+	return (uint32)pRect->xPos + pRect->width <= OSC_CAM_MAX_IMAGE_WIDTH/2 &&
+			(uint32)pRect->yPos + pRect->height <= OSC_CAM_MAX_IMAGE_HEIGHT/2;
+}
+
+/*********************************************************************//*!
+ * @brief Make sure the pyramid of an image is built up to a level.
+ * 
+ * Each level averages 2x2 pixels of the previous one, see
+ * OscVisBuildPyramidLevel. Levels already built for the current frame
+ * are reused.
+ * 
+ * @param nImg Index of the temporary image.
+ * @param nLevels The number of levels needed.
+ *//*********************************************************************/
+static void BuildPyramid(int nImg, int nLevels)
+{
+	struct OSC_PICTURE picSrc, picDst;
+	int level;
+
+	picSrc.data = data.u8TempImage[nImg];
+	picSrc.width = OSC_CAM_MAX_IMAGE_WIDTH/2;
+	picSrc.height = OSC_CAM_MAX_IMAGE_HEIGHT/2;
+	picSrc.type = OSC_PICTURE_GREYSCALE;
+	picDst.data = data.u8Pyramid;
+
+	if (data.nPyramidImg != nImg || data.nPyramidStep != data.ipc.state.nStepCounter)
+	{
+		/* The pyramid is from another image or frame. */
+		data.nPyramidImg = nImg;
+		data.nPyramidStep = data.ipc.state.nStepCounter;
+		data.nPyramidLevels = 0;
+	}
+
+	for (level = 0; level < nLevels; level++)
+	{
+		if (level >= data.nPyramidLevels)
+		{
+			OscVisBuildPyramidLevel(&picSrc, &picDst);
+			data.nPyramidLevels = level + 1;
+		}
+		else
+		{
+			/* Only the size is needed to find the next level. */
+			picDst.width = picSrc.width / 2;
+			picDst.height = picSrc.height / 2;
+			picDst.type = OSC_PICTURE_GREYSCALE;
+		}
+
+		picSrc = picDst;
+		picDst.data = (uint8*)picSrc.data + picSrc.width * picSrc.height;
+	}
+}
+
+void IpcSendImageRect(int nImg)
+{
+	const struct IMG_REQUEST *pImgReq = &data.ipc.aryImgRequests[data.ipc.req.conn];
+	uint16 width = OSC_CAM_MAX_IMAGE_WIDTH/2;
+	const uint8 *pLevel = data.u8TempImage[nImg];
+	uint8 *pDst = (uint8*)data.ipc.req.pAddr;
+	int level = 0, r;
+	uint16 xPos, yPos, outWidth, outHeight;
+
+	/* The decimation is a power of two and selects the pyramid level. */
+	while ((1 << level) < pImgReq->decimation)
+	{
+		level++;
+	}
+
+	if (level > 0)
+	{
+		BuildPyramid(nImg, level);
+		pLevel = data.u8Pyramid;
+		for (r = 1; r < level; r++)
+		{
+			pLevel += (width >> r) * ((OSC_CAM_MAX_IMAGE_HEIGHT/2) >> r);
+		}
+		width >>= level;
+	}
+
+	xPos = pImgReq->rect.xPos >> level;
+	yPos = pImgReq->rect.yPos >> level;
+	outWidth = IMG_REQUEST_WIDTH(pImgReq);
+	outHeight = IMG_REQUEST_HEIGHT(pImgReq);
+
+	/* Copy the requested rows to the address supplied in the request. */
+	for (r = 0; r < outHeight; r++)
+	{
+		memcpy(pDst, pLevel + (yPos + r) * width + xPos, outWidth);
+		pDst += outWidth;
+	}
+}
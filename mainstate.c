@@ -20,7 +20,8 @@ const Msg mainStateMsg[] = {
 	{ FRAMEPAR_EVT },
 	{ IPC_GET_APP_STATE_EVT },
 	{ IPC_GET_NEW_IMG_EVT },
-	{ IPC_SET_IMAGE_TYPE_EVT }
+	{ IPC_SET_IMAGE_TYPE_EVT },
+	{ IPC_GET_IMG_RECT_EVT }
 };
 
 /*********************************************************************//*!
@@ -35,6 +36,58 @@ void ThrowEvent(struct MainState *pHsm, unsigned int evt)
 	HsmOnEvent((Hsm*)pHsm, pMsg);
 }
 
+/*********************************************************************//*!
+ * @brief Completes the held back WAIT_APP_STATE requests once the
+ * application state differs from the version supplied by their client
+ * or the timeout expired. Requests of clients that hung up are dropped.
+ *//*********************************************************************/
+static void CheckStateWaits(void)
+{
+	struct IPC_DATA *pIpc = &data.ipc;
+	struct STATE_WAIT *pWait;
+	struct APP_STATE_VERSION *pVer;
+	uint32 waited;
+	OSC_ERR err;
+	int i;
+
+	for (i = 0; i < OSC_IPC_MAX_CONNECTIONS; i++)
+	{
+		pWait = &pIpc->aryStateWaits[i];
+		pVer = &pWait->version;
+		if (!pWait->bPending)
+		{
+			continue;
+		}
+
+		if (OscIpcCheckHeldRequest(pIpc->ipcChan, &pWait->req) != SUCCESS)
+		{
+			/* Nobody left to answer, e.g. the browser was closed. */
+			OscIpcDropRequest(pIpc->ipcChan, &pWait->req);
+			pWait->bPending = FALSE;
+			continue;
+		}
+
+		waited = (uint32)OscSupCycToMilliSecs64(OscSupCycGet64() - pWait->start);
+		if (pVer->nStepCounter == pIpc->state.nStepCounter &&
+				pVer->nThreshold == pIpc->state.nThreshold &&
+				pVer->nExposureTime == pIpc->state.nExposureTime &&
+				pVer->nImageType == pIpc->state.nImageType &&
+				waited < pVer->timeout)
+		{
+			/* Nothing changed yet, keep the client waiting. */
+			continue;
+		}
+
+		memcpy(pWait->req.pAddr, &pIpc->state, sizeof(struct APPLICATION_STATE));
+		err = OscIpcAckRequest(pIpc->ipcChan, &pWait->req, TRUE);
+		if (err != SUCCESS)
+		{
+			OscLog(WARN, "%s: Client left before the state wait ended. (%d)\n", __func__, err);
+		}
+		pWait->bPending = FALSE;
+	}
+}
+
 /*********************************************************************//*!
  * @brief Checks for IPC events, schedules their handling and
  * acknowledges any executed ones.
@@ -62,6 +115,12 @@ static OSC_ERR HandleIpcRequests(MainState *pMainState)
 			break;
 		case GET_NEW_IMG:
 			/* Request for the live image. */
+			if(pReq->paramSize < sizeof(data.u8TempImage[GRAYSCALE]))
+			{
+				OscLog(ERROR, "%s: image buffer of %u bytes too small!\n", __func__, pReq->paramSize);
+				pIpc->enReqState = REQ_STATE_NACK_PENDING;
+				break;
+			}
 			ThrowEvent(pMainState, IPC_GET_NEW_IMG_EVT);
 			break;
 		case SET_IMAGE_TYPE:
@@ -74,6 +133,10 @@ static OSC_ERR HandleIpcRequests(MainState *pMainState)
 			}
 			else
 			{
+				/* The last image may not have been stored for the new
+				 * type (see ProcessFrame()), so wait for the next frame. */
+				if (data.ipc.state.nImageType != ImgTyp)
+					data.ipc.state.bNewImageReady = FALSE;
 				data.ipc.state.nImageType = ImgTyp;
 				ThrowEvent(pMainState, IPC_SET_IMAGE_TYPE_EVT);
 			}
@@ -97,6 +160,107 @@ static OSC_ERR HandleIpcRequests(MainState *pMainState)
 			}
 			data.ipc.enReqState = REQ_STATE_ACK_PENDING;//we return immediately
 			break;
+		case SET_IMAGE_FORMAT:
+		{
+			/* Set the file format the CGI serves the live image in. */
+			unsigned int ImgFmt = *((unsigned int*)pReq->pAddr);
+			if(ImgFmt != IMG_FORMAT_BMP && ImgFmt != IMG_FORMAT_JPEG)
+			{
+				OscLog(ERROR, "%s: obtained unknown image format: %u! Will leave unchanged\n", __func__, ImgFmt);
+				data.ipc.enReqState = REQ_STATE_NACK_PENDING;
+			}
+			else
+			{
+				data.ipc.state.enImageFormat = ImgFmt;
+				data.ipc.enReqState = REQ_STATE_ACK_PENDING;//we return immediately
+			}
+			break;
+		}
+		case SET_JPEG_QUALITY:
+		{
+			/* The quality is only stored here, the encoding is done by the CGI. */
+			int Quality = *((int*)pReq->pAddr);
+			if(Quality < 1 || Quality > 100)
+			{
+				OscLog(ERROR, "%s: obtained invalid JPEG quality: %d! Will leave unchanged\n", __func__, Quality);
+				data.ipc.enReqState = REQ_STATE_NACK_PENDING;
+			}
+			else
+			{
+				data.ipc.state.nJpegQuality = Quality;
+				data.ipc.enReqState = REQ_STATE_ACK_PENDING;//we return immediately
+			}
+			break;
+		}
+		case SET_STATE_VERSION:
+		{
+			/* Remember what the client has seen for the following WAIT_APP_STATE. */
+			struct STATE_WAIT *pWait = &pIpc->aryStateWaits[pReq->conn];
+			memcpy(&pWait->version, pReq->pAddr, sizeof(struct APP_STATE_VERSION));
+			if(pWait->version.timeout > MAX_STATE_WAIT_TIMEOUT)
+			{
+				pWait->version.timeout = MAX_STATE_WAIT_TIMEOUT;
+			}
+			pWait->bVersionSet = TRUE;
+			pIpc->enReqState = REQ_STATE_ACK_PENDING;//we return immediately
+			break;
+		}
+		case WAIT_APP_STATE:
+		{
+			/* Long poll for the application state. Held back until CheckStateWaits answers it,
+			 * other clients are served meanwhile. */
+			struct STATE_WAIT *pWait = &pIpc->aryStateWaits[pReq->conn];
+			if(!pWait->bVersionSet)
+			{
+				OscLog(ERROR, "%s: state wait without a version set!\n", __func__);
+				pIpc->enReqState = REQ_STATE_NACK_PENDING;
+				break;
+			}
+			if(OscIpcHoldRequest(pIpc->ipcChan, pReq) != SUCCESS)
+			{
+				pIpc->enReqState = REQ_STATE_NACK_PENDING;
+				break;
+			}
+			pWait->bVersionSet = FALSE;
+			pWait->req = *pReq;
+			pWait->start = OscSupCycGet64();
+			pWait->bPending = TRUE;
+			/* Nothing to acknowledge for now. */
+			pIpc->enReqState = REQ_STATE_IDLE;
+			break;
+		}
+		case SET_IMG_REQUEST:
+		{
+			/* Select the image area and decimation for GET_IMG_RECT. */
+			struct IMG_REQUEST *pImgReq = (struct IMG_REQUEST*)pReq->pAddr;
+			if(pReq->paramSize < sizeof(struct IMG_REQUEST))
+			{
+				pIpc->enReqState = REQ_STATE_NACK_PENDING;
+			}
+			else if(!IsValidImgRequest(pImgReq))
+			{
+				OscLog(ERROR, "%s: obtained invalid image request %ux%u+%u+%u/%u! Will leave unchanged\n", __func__,
+						pImgReq->rect.width, pImgReq->rect.height, pImgReq->rect.xPos, pImgReq->rect.yPos, pImgReq->decimation);
+				pIpc->enReqState = REQ_STATE_NACK_PENDING;
+			}
+			else
+			{
+				/* Kept per client, another one may change its request in between. */
+				pIpc->aryImgRequests[pReq->conn] = *pImgReq;
+				pIpc->enReqState = REQ_STATE_ACK_PENDING;//we return immediately
+			}
+			break;
+		}
+		case GET_IMG_RECT:
+			/* Request for a part of the live image. */
+			if(pReq->paramSize < IMG_REQUEST_SIZE(&pIpc->aryImgRequests[pReq->conn]))
+			{
+				OscLog(ERROR, "%s: image buffer of %u bytes too small for the image request!\n", __func__, pReq->paramSize);
+				pIpc->enReqState = REQ_STATE_NACK_PENDING;
+				break;
+			}
+			ThrowEvent(pMainState, IPC_GET_IMG_RECT_EVT);
+			break;
 		default:
 			OscLog(ERROR, "%s: Unkown IPC parameter ID (%d)!\n", __func__, paramId);
 			data.ipc.enReqState = REQ_STATE_NACK_PENDING;
@@ -114,6 +278,9 @@ static OSC_ERR HandleIpcRequests(MainState *pMainState)
 		return err;
 	}
 
+	/* Release the waiting clients if the state changed meanwhile. */
+	CheckStateWaits();
+
 	/* Try to acknowledge the new or any old unacknowledged
 	 * requests. It may take several tries to succeed.*/
 	err = AckIpcRequests();
@@ -127,6 +294,7 @@ static OSC_ERR HandleIpcRequests(MainState *pMainState)
 Msg const *MainState_top(MainState *me, Msg *msg)
 {
 	struct APPLICATION_STATE *pState;
+	int i;
 	switch (msg->evt)
 	{
 	case START_EVT:
@@ -138,6 +306,17 @@ Msg const *MainState_top(MainState *me, Msg *msg)
 		data.ipc.state.nExposureTime = 25;
 		data.ipc.state.nStepCounter = 0;
 		data.ipc.state.nThreshold = 30;
+		data.ipc.state.enImageFormat = IMG_FORMAT_JPEG;
+		data.ipc.state.nJpegQuality = 75;
+		/* Without a request the whole image is returned. */
+		for(i = 0; i < OSC_IPC_MAX_CONNECTIONS; i++)
+		{
+			data.ipc.aryImgRequests[i].rect.xPos = 0;
+			data.ipc.aryImgRequests[i].rect.yPos = 0;
+			data.ipc.aryImgRequests[i].rect.width = OSC_CAM_MAX_IMAGE_WIDTH/2;
+			data.ipc.aryImgRequests[i].rect.height = OSC_CAM_MAX_IMAGE_HEIGHT/2;
+			data.ipc.aryImgRequests[i].decimation = 1;
+		}
 		return 0;
 	case IPC_GET_APP_STATE_EVT:
 		/* Fill in the response and schedule an acknowledge for the request. */
@@ -160,11 +339,8 @@ Msg const *MainState_top(MainState *me, Msg *msg)
 	{
 		/* we have a new image increase counter: here and only here! */
 		data.ipc.state.nStepCounter++;
-		/* debayer the image first -> to half size*/
-		OscVisDebayerGreyscaleHalfSize( data.pCurRawImg, OSC_CAM_MAX_IMAGE_WIDTH, OSC_CAM_MAX_IMAGE_HEIGHT, ROW_BGBG, data.u8TempImage[GRAYSCALE]);
-		/* Process the image. */
-		/* the parameter is not really required */
-		ProcessFrame(data.u8TempImage[GRAYSCALE]);
+		/* Process the image, it is debayered to half size on the way. */
+		ProcessFrame(data.pCurRawImg);
 
 		return 0;
 	}
@@ -186,6 +362,7 @@ Msg const *MainState_top(MainState *me, Msg *msg)
 		return 0;
 	}
 	case IPC_GET_NEW_IMG_EVT:
+	case IPC_GET_IMG_RECT_EVT:
 		/* If the IPC event is not handled in the actual substate, a negative acknowledge is returned by default. */
 		data.ipc.enReqState = REQ_STATE_NACK_PENDING;
 	return 0;
@@ -208,6 +385,16 @@ Msg const *MainState_ShowGray(MainState *me, Msg *msg)
 		data.ipc.enReqState = REQ_STATE_ACK_PENDING;
 		return 0;
 	}
+	case IPC_GET_IMG_RECT_EVT:
+	{
+		/* Write out the requested part of the image. */
+		IpcSendImageRect(GRAYSCALE);
+
+		data.ipc.state.bNewImageReady = FALSE;
+
+		data.ipc.enReqState = REQ_STATE_ACK_PENDING;
+		return 0;
+	}
 
 	}
 	return msg;
@@ -228,6 +415,16 @@ Msg const *MainState_ShowThreshold(MainState *me, Msg *msg)
 		data.ipc.enReqState = REQ_STATE_ACK_PENDING;
 		return 0;
 	}
+	case IPC_GET_IMG_RECT_EVT:
+	{
+		/* Write out the requested part of the image. */
+		IpcSendImageRect(BACKGROUND);
+
+		data.ipc.state.bNewImageReady = FALSE;
+
+		data.ipc.enReqState = REQ_STATE_ACK_PENDING;
+		return 0;
+	}
 
 	}
 	return msg;
@@ -248,6 +445,16 @@ Msg const *MainState_ShowBackground(MainState *me, Msg *msg)
 		data.ipc.enReqState = REQ_STATE_ACK_PENDING;
 		return 0;
 	}
+	case IPC_GET_IMG_RECT_EVT:
+	{
+		/* Write out the requested part of the image. */
+		IpcSendImageRect(DILATION);
+
+		data.ipc.state.bNewImageReady = FALSE;
+
+		data.ipc.enReqState = REQ_STATE_ACK_PENDING;
+		return 0;
+	}
 
 	}
 	return msg;
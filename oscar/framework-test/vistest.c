@@ -0,0 +1,702 @@
+/*	Oscar, a hardware abstraction framework for the LeanXcam and IndXcam.
+	Copyright (C) 2008 Supercomputing Systems AG
+
+	This library is free software; you can redistribute it and/or modify it
+	under the terms of the GNU Lesser General Public License as published by
+	the Free Software Foundation; either version 2.1 of the License, or (at
+	your option) any later version.
+
+	This library is distributed in the hope that it will be useful, but
+	WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser
+	General Public License for more details.
+
+	You should have received a copy of the GNU Lesser General Public License
+	along with this library; if not, write to the Free Software Foundation,
+	Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+/* Checks of the image processing and JPEG functions of the current
+	framework. Unlike test.c, which still uses the old LCV interface, this
+	builds against ../library with 'make vis_host' and must be run from
+	this directory, where it finds the test pictures. Returns non-zero
+	if a check fails. */
+
+#include "oscar.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define QUALITY_FACTOR 256
+
+/* Names of the bayer orders for the log, indexed by enum EnBayerOrder. */
+static const char *aryBayerOrderNames[] = { "BGBG", "RGRG", "GBGB", "GRGR" };
+
+/* Reference checksums of the OscVisDebayer output for test_grey_in.bmp
+	taken as raw image, and for test_rgb_in.bmp cropped to an even width
+	and sampled in the respective bayer order, indexed by enum EnBayerOrder. */
+static const uint32 aryDebayerGreyRef[] = { 0x3cf68962, 0x15935ec3, 0x19a97680, 0xda4037b5 };
+static const uint32 aryDebayerRgbRef[] = { 0x69490e18, 0xc8e9d023, 0xb353cb43, 0xf2cee3f0 };
+
+/* Reference checksums of the last two rows of the OscVisDebayer output
+	for test_grey_in.bmp, indexed by enum EnBayerOrder. Their green was
+	corrected after release v2.1-p2, they are checked separately to pin
+	that change. */
+static const uint32 aryDebayerLastRowsRef[] = { 0x4aa45e48, 0x72bb0ef2, 0xe9fff80d, 0x0da2f44e };
+
+/* FNV-1a hash of a buffer, used to compare pictures with a reference. */
+static uint32 checksum(const uint8 *pData, uint32 len)
+{
+	uint32 hash = 2166136261u;
+	uint32 i;
+
+	for (i = 0; i < len; i++)
+		hash = (hash ^ pData[i]) * 16777619u;
+	return hash;
+}
+
+/* Sample a BGR picture like a sensor with the given bayer filter would. */
+static void makeRaw(const struct OSC_PICTURE *pPic, enum EnBayerOrder enOrder, uint8 *pRaw)
+{
+	/* The color of the first two pixels of the first two rows, 0 being blue,
+		1 green and 2 red. */
+	static const uint8 aryColors[][2][2] = {
+		{ { 0, 1 }, { 1, 2 } },	/* ROW_BGBG */
+		{ { 2, 1 }, { 1, 0 } },	/* ROW_RGRG */
+		{ { 1, 0 }, { 2, 1 } },	/* ROW_GBGB */
+		{ { 1, 2 }, { 0, 1 } }	/* ROW_GRGR */
+	};
+	const uint8 *pBgr = pPic->data;
+	int x, y;
+
+	for (y = 0; y < pPic->height; y++)
+		for (x = 0; x < pPic->width; x++)
+			pRaw[y * pPic->width + x] = pBgr[(y * pPic->width + x) * 3 + aryColors[enOrder][y % 2][x % 2]];
+}
+
+/* Read the RGB test picture, cropped to an even width. */
+static OSC_ERR readRgbPicture(struct OSC_PICTURE *pPic)
+{
+	OSC_ERR err;
+	uint8 *pData;
+	int y, width;
+
+	memset(pPic, 0, sizeof(struct OSC_PICTURE));
+	err = OscBmpRead(pPic, "test_rgb_in.bmp");
+	if (err != SUCCESS)
+		return err;
+
+	width = pPic->width & ~1;
+	pData = pPic->data;
+	for (y = 0; y < pPic->height; y++)
+		memmove(&pData[y * width * 3], &pData[y * pPic->width * 3], width * 3);
+	pPic->width = width;
+	return SUCCESS;
+}
+
+int testDebayer()
+{
+	struct OSC_PICTURE grey, rgb;
+	uint8 *pRaw, *pOut;
+	enum EnBayerOrder enOrder;
+	uint32 hash, sumError;
+	int i, ret = 0;
+
+	memset(&grey, 0, sizeof(struct OSC_PICTURE));
+	if (OscBmpRead(&grey, "test_grey_in.bmp") != SUCCESS || readRgbPicture(&rgb) != SUCCESS)
+	{
+		OscLog(ERROR, "%s: Unable to read the test pictures!\n", __func__);
+		return -1;
+	}
+
+	pRaw = malloc(rgb.width * rgb.height);
+	pOut = malloc(grey.width * grey.height * 3 + rgb.width * rgb.height * 3);
+
+	for (enOrder = ROW_BGBG; enOrder <= ROW_GRGR; enOrder++)
+	{
+		OscVisDebayer(grey.data, grey.width, grey.height, enOrder, pOut);
+		hash = checksum(pOut, grey.width * grey.height * 3);
+		if (hash != aryDebayerGreyRef[enOrder])
+		{
+			OscLog(ERROR, "%s: Grey picture in %s order differs from the reference (0x%08x)!\n",
+					__func__, aryBayerOrderNames[enOrder], hash);
+			ret = -1;
+		}
+
+		makeRaw(&rgb, enOrder, pRaw);
+		OscVisDebayer(pRaw, rgb.width, rgb.height, enOrder, pOut);
+		hash = checksum(pOut, rgb.width * rgb.height * 3);
+		if (hash != aryDebayerRgbRef[enOrder])
+		{
+			OscLog(ERROR, "%s: RGB picture in %s order differs from the reference (0x%08x)!\n",
+					__func__, aryBayerOrderNames[enOrder], hash);
+			ret = -1;
+		}
+
+		/* Independent of the reference, the colors must come out about the
+			same as they went in. */
+		sumError = 0;
+		for (i = 0; i < rgb.width * rgb.height * 3; i++)
+			sumError += abs(pOut[i] - ((uint8*)rgb.data)[i]);
+		if (sumError / (rgb.width * rgb.height * 3) > 8)
+		{
+			OscLog(ERROR, "%s: RGB picture in %s order has a mean error of %u!\n",
+					__func__, aryBayerOrderNames[enOrder], sumError / (rgb.width * rgb.height * 3));
+			ret = -1;
+		}
+	}
+
+	free(pRaw);
+	free(pOut);
+	free(grey.data);
+	free(rgb.data);
+	OscLog(INFO, "%s: %s\n", __func__, ret ? "FAILED" : "ok");
+	return ret;
+}
+
+int testDebayerBorder()
+{
+	/* Sizes of the uniform pictures, the last being too narrow for more
+		than the border. */
+	const uint16 arySizes[][2] = { { 16, 8 }, { 752, 6 }, { 6, 4 } };
+	const uint8 aryColor[3] = { 40, 120, 200 };	/* B, G, R */
+	struct OSC_PICTURE grey, uniform;
+	enum EnBayerOrder enOrder;
+	uint8 *pRaw, *pOut;
+	uint32 hash;
+	int s, i, ret = 0;
+
+	memset(&grey, 0, sizeof(struct OSC_PICTURE));
+	if (OscBmpRead(&grey, "test_grey_in.bmp") != SUCCESS)
+	{
+		OscLog(ERROR, "%s: Unable to read the test picture!\n", __func__);
+		return -1;
+	}
+	pRaw = malloc(grey.width * grey.height);
+	pOut = malloc(grey.width * grey.height * 3);
+
+	for (enOrder = ROW_BGBG; enOrder <= ROW_GRGR; enOrder++)
+	{
+		OscVisDebayer(grey.data, grey.width, grey.height, enOrder, pOut);
+		hash = checksum(&pOut[(grey.height - 2) * grey.width * 3], 2 * grey.width * 3);
+		if (hash != aryDebayerLastRowsRef[enOrder])
+		{
+			OscLog(ERROR, "%s: Last rows in %s order differ from the reference (0x%08x)!\n",
+					__func__, aryBayerOrderNames[enOrder], hash);
+			ret = -1;
+		}
+
+		/* A picture of a single color must give its green everywhere,
+			including the pixels at the border. Red and blue are not checked:
+			in the first and last row of BGBG and GRGR pictures, they are
+			still taken from the wrong color. */
+		for (s = 0; s < sizeof(arySizes) / sizeof(arySizes[0]); s++)
+		{
+			uniform.width = arySizes[s][0];
+			uniform.height = arySizes[s][1];
+			uniform.type = OSC_PICTURE_BGR_24;
+			uniform.data = pOut;
+			for (i = 0; i < uniform.width * uniform.height; i++)
+				memcpy(&pOut[i * 3], aryColor, 3);
+
+			makeRaw(&uniform, enOrder, pRaw);
+			memset(pOut, 0, uniform.width * uniform.height * 3);
+			OscVisDebayer(pRaw, uniform.width, uniform.height, enOrder, pOut);
+			for (i = 0; i < uniform.width * uniform.height; i++)
+			{
+				if (pOut[i * 3 + 1] != aryColor[1])
+				{
+					OscLog(ERROR, "%s: %dx%d picture in %s order has a wrong green at %d/%d!\n",
+							__func__, uniform.width, uniform.height, aryBayerOrderNames[enOrder],
+							i % uniform.width, i / uniform.width);
+					ret = -1;
+					break;
+				}
+			}
+		}
+	}
+
+	free(pRaw);
+	free(pOut);
+	free(grey.data);
+	OscLog(INFO, "%s: %s\n", __func__, ret ? "FAILED" : "ok");
+	return ret;
+}
+
+int testDebayerTiles()
+{
+	struct OSC_VIS_RECT aryRects[] = {
+		{ 0, 0, 32, 16 },		/* Top left corner */
+		{ 37, 101, 13, 7 },		/* Odd position and size */
+		{ 190, 260, 40, 40 },	/* Clipped at the bottom right corner */
+		{ 300, 300, 10, 10 }	/* Outside of the image */
+	};
+	const int nRects = sizeof(aryRects) / sizeof(struct OSC_VIS_RECT);
+	struct OSC_VIS_TILE aryTiles[sizeof(aryRects) / sizeof(struct OSC_VIS_RECT)];
+	const enum EnOscPictureType aryTypes[] = { OSC_PICTURE_GREYSCALE, OSC_PICTURE_BGR_24 };
+	struct OSC_PICTURE rgb, full, fullGrey;
+	uint8 *pRaw, *pAtlas, *pTile, *pFull;
+	const uint32 atlasSize = 64 * 1024;
+	OSC_ERR err;
+	int t, i, y, bpp, ret = 0;
+
+	if (readRgbPicture(&rgb) != SUCCESS)
+	{
+		OscLog(ERROR, "%s: Unable to read the test picture!\n", __func__);
+		return -1;
+	}
+
+	pRaw = malloc(rgb.width * rgb.height);
+	pAtlas = malloc(atlasSize);
+	full = rgb;
+	full.data = malloc(rgb.width * rgb.height * 3);
+	fullGrey = rgb;
+	fullGrey.type = OSC_PICTURE_GREYSCALE;
+	fullGrey.data = malloc(rgb.width * rgb.height);
+
+	makeRaw(&rgb, ROW_BGBG, pRaw);
+	OscVisDebayer(pRaw, rgb.width, rgb.height, ROW_BGBG, full.data);
+	OscVisBGR2Grey(&full, &fullGrey);
+
+	/* Every tile must be the same as the part of the whole picture. */
+	for (t = 0; t < sizeof(aryTypes) / sizeof(aryTypes[0]); t++)
+	{
+		bpp = aryTypes[t] == OSC_PICTURE_BGR_24 ? 3 : 1;
+		pFull = aryTypes[t] == OSC_PICTURE_BGR_24 ? full.data : fullGrey.data;
+
+		err = OscVisDebayerTiles(pRaw, rgb.width, rgb.height, ROW_BGBG, aryRects, nRects, aryTypes[t], pAtlas, atlasSize, aryTiles);
+		if (err != SUCCESS)
+		{
+			OscLog(ERROR, "%s: Debayering the tiles failed! (%d)\n", __func__, err);
+			ret = -1;
+			continue;
+		}
+
+		if (aryTiles[2].rect.width != 20 || aryTiles[2].rect.height != 14 ||
+				aryTiles[3].rect.width * aryTiles[3].rect.height != 0)
+		{
+			OscLog(ERROR, "%s: Rectangles not clipped to the image!\n", __func__);
+			ret = -1;
+		}
+
+		for (i = 0; i < nRects; i++)
+		{
+			pTile = pAtlas + aryTiles[i].offset;
+			for (y = 0; y < aryTiles[i].rect.height; y++)
+			{
+				if (memcmp(&pTile[y * aryTiles[i].rect.width * bpp],
+						&pFull[((aryTiles[i].rect.top + y) * rgb.width + aryTiles[i].rect.left) * bpp],
+						aryTiles[i].rect.width * bpp) != 0)
+				{
+					OscLog(ERROR, "%s: Tile %d (%d bytes per pixel) differs in row %d!\n", __func__, i, bpp, y);
+					ret = -1;
+					break;
+				}
+			}
+		}
+	}
+
+	err = OscVisDebayerTiles(pRaw, rgb.width, rgb.height, ROW_BGBG, aryRects, nRects, OSC_PICTURE_BGR_24, pAtlas, 32 * 16 * 3, aryTiles);
+	if (err != -EBUFFER_TOO_SMALL)
+	{
+		OscLog(ERROR, "%s: Tiles larger than the atlas accepted! (%d)\n", __func__, err);
+		ret = -1;
+	}
+
+	free(pRaw);
+	free(pAtlas);
+	free(full.data);
+	free(fullGrey.data);
+	free(rgb.data);
+	OscLog(INFO, "%s: %s\n", __func__, ret ? "FAILED" : "ok");
+	return ret;
+}
+
+int testYuv422()
+{
+	/* Widths with an even and an odd number of pixels after debayering. */
+	const uint16 arySizes[][2] = { { 64, 50 }, { 66, 50 }, { 130, 6 }, { 752, 8 } };
+	struct OSC_PICTURE rgb, raw, yuv, lum, u, v;
+	uint8 *pYuv, *pLum, *pU, *pV;
+	int s, x, y, w, ret = 0;
+
+	if (readRgbPicture(&rgb) != SUCCESS)
+	{
+		OscLog(ERROR, "%s: Unable to read the test picture!\n", __func__);
+		return -1;
+	}
+	raw.data = malloc(752 * 8);
+	yuv.data = malloc(752 * 8 + 16);
+	lum.data = malloc(752 * 8 / 4);
+	u.data = malloc(752 * 8 / 4);
+	v.data = malloc(752 * 8 / 4);
+
+	for (s = 0; s < sizeof(arySizes) / sizeof(arySizes[0]); s++)
+	{
+		/* Any content will do, take the raw image from the RGB picture. */
+		raw.width = arySizes[s][0];
+		raw.height = arySizes[s][1];
+		raw.type = OSC_PICTURE_GREYSCALE;
+		for (y = 0; y < raw.height; y++)
+			memcpy(&((uint8*)raw.data)[y * raw.width], &((uint8*)rgb.data)[y * rgb.width * 3], raw.width);
+
+		w = (raw.width / 2) & ~1;
+		memset(yuv.data, 0x55, 752 * 8 + 16);
+		OscVisFastDebayerYUV422(&raw, &yuv);
+		OscVisFastDebayerLumY(&raw, &lum);
+		OscVisFastDebayerChromU(&raw, &u);
+		OscVisFastDebayerChromV(&raw, &v);
+
+		if (yuv.width != w || yuv.height != raw.height / 2 || ((uint8*)yuv.data)[w * yuv.height * 2] != 0x55)
+		{
+			OscLog(ERROR, "%s: Wrong size for %dx%d! (%dx%d)\n", __func__, raw.width, raw.height, yuv.width, yuv.height);
+			ret = -1;
+			continue;
+		}
+
+		/* Every row has w pixels, U and V are those of the first pixel
+			of a macro pixel. */
+		for (y = 0; y < yuv.height; y++)
+		{
+			pYuv = &((uint8*)yuv.data)[y * w * 2];
+			pLum = &((uint8*)lum.data)[y * lum.width];
+			pU = &((uint8*)u.data)[y * u.width];
+			pV = &((uint8*)v.data)[y * v.width];
+			for (x = 0; x < w; x += 2)
+			{
+				if (pYuv[2 * x] != pU[x] || pYuv[2 * x + 1] != pLum[x] ||
+						pYuv[2 * x + 2] != pV[x] || pYuv[2 * x + 3] != pLum[x + 1])
+				{
+					OscLog(ERROR, "%s: %dx%d differs at %d/%d!\n", __func__, raw.width, raw.height, x, y);
+					ret = -1;
+					x = w;
+					y = yuv.height;
+				}
+			}
+		}
+	}
+
+	free(raw.data);
+	free(yuv.data);
+	free(lum.data);
+	free(u.data);
+	free(v.data);
+	free(rgb.data);
+	OscLog(INFO, "%s: %s\n", __func__, ret ? "FAILED" : "ok");
+	return ret;
+}
+
+int testMedian()
+{
+	const uint8 aryRadii[] = { 1, 2, 3, 8 };
+	struct OSC_PICTURE grey, out;
+	uint8 *pIn, *pOut, median;
+	uint16 aryHist[256];
+	int i, x, y, dx, dy, count, r;
+	int ret = 0;
+
+	memset(&grey, 0, sizeof(struct OSC_PICTURE));
+	if (OscBmpRead(&grey, "test_grey_in.bmp") != SUCCESS)
+	{
+		OscLog(ERROR, "%s: Unable to read the test picture!\n", __func__);
+		return -1;
+	}
+	out = grey;
+	out.data = malloc(grey.width * grey.height);
+	pIn = grey.data;
+	pOut = out.data;
+
+	/* Compare with the median of the sorted window and the copied border. */
+	for (i = 0; i < sizeof(aryRadii) && ret == 0; i++)
+	{
+		r = aryRadii[i];
+		OscVisMedianFilter(&grey, &out, r);
+
+		for (y = 0; y < grey.height && ret == 0; y++)
+		{
+			for (x = 0; x < grey.width; x++)
+			{
+				if (y < r || y >= grey.height - r || x < r || x >= grey.width - r)
+				{
+					median = pIn[y * grey.width + x];
+				}
+				else
+				{
+					memset(aryHist, 0, sizeof(aryHist));
+					for (dy = -r; dy <= r; dy++)
+						for (dx = -r; dx <= r; dx++)
+							aryHist[pIn[(y + dy) * grey.width + x + dx]]++;
+					count = 0;
+					for (median = 0; ; median++)
+					{
+						count += aryHist[median];
+						if (count > (2 * r + 1) * (2 * r + 1) / 2)
+							break;
+					}
+				}
+
+				if (pOut[y * grey.width + x] != median)
+				{
+					OscLog(ERROR, "%s: Radius %d differs at %d/%d (%d instead of %d)!\n",
+							__func__, r, x, y, pOut[y * grey.width + x], median);
+					ret = -1;
+					break;
+				}
+			}
+		}
+	}
+
+	free(grey.data);
+	free(out.data);
+	OscLog(INFO, "%s: %s\n", __func__, ret ? "FAILED" : "ok");
+	return ret;
+}
+
+int testPyramid()
+{
+	struct OSC_VIS_PYRAMID pyramid;
+	struct OSC_PICTURE grey, level;
+	const uint8 *pUp;
+	uint8 *pLevel, mean;
+	int l, x, y, w;
+	int ret = 0;
+
+	memset(&grey, 0, sizeof(struct OSC_PICTURE));
+	if (OscBmpRead(&grey, "test_grey_in.bmp") != SUCCESS)
+	{
+		OscLog(ERROR, "%s: Unable to read the test picture!\n", __func__);
+		return -1;
+	}
+	if (OscVisCreatePyramid(&pyramid, grey.width, grey.height) != SUCCESS)
+	{
+		OscLog(ERROR, "%s: Unable to create the pyramid!\n", __func__);
+		return -1;
+	}
+	pLevel = malloc(grey.width * grey.height / 4);
+
+	OscVisBuildPyramid(&pyramid, grey.data, ROW_BGBG);
+
+	/* Level 0 is the greyscale half size image. */
+	OscVisDebayerGreyscaleHalfSize(grey.data, grey.width, grey.height, ROW_BGBG, pLevel);
+	if (memcmp(pLevel, pyramid.levels[0].data, pyramid.levels[0].width * pyramid.levels[0].height) != 0)
+	{
+		OscLog(ERROR, "%s: Level 0 differs from OscVisDebayerGreyscaleHalfSize!\n", __func__);
+		ret = -1;
+	}
+
+	/* The next levels are the rounded means of 2x2 blocks of the level
+		above, also when calculated one at a time. */
+	for (l = 1; l < OSC_VIS_PYRAMID_LEVELS; l++)
+	{
+		pUp = pyramid.levels[l - 1].data;
+		w = pyramid.levels[l - 1].width;
+		if (pyramid.levels[l].width != w / 2 || pyramid.levels[l].height != pyramid.levels[l - 1].height / 2)
+		{
+			OscLog(ERROR, "%s: Level %d has the wrong size!\n", __func__, l);
+			ret = -1;
+			continue;
+		}
+
+		for (y = 0; y < pyramid.levels[l].height; y++)
+		{
+			for (x = 0; x < pyramid.levels[l].width; x++)
+			{
+				mean = (pUp[2 * y * w + 2 * x] + pUp[2 * y * w + 2 * x + 1] +
+						pUp[(2 * y + 1) * w + 2 * x] + pUp[(2 * y + 1) * w + 2 * x + 1] + 2) / 4;
+				if (((uint8*)pyramid.levels[l].data)[y * pyramid.levels[l].width + x] != mean)
+				{
+					OscLog(ERROR, "%s: Level %d differs at %d/%d!\n", __func__, l, x, y);
+					ret = -1;
+					x = pyramid.levels[l].width;
+					y = pyramid.levels[l].height;
+				}
+			}
+		}
+
+		level = pyramid.levels[l];
+		level.data = pLevel;
+		OscVisBuildPyramidLevel(&pyramid.levels[l - 1], &level);
+		if (memcmp(pLevel, pyramid.levels[l].data, level.width * level.height) != 0)
+		{
+			OscLog(ERROR, "%s: OscVisBuildPyramidLevel differs from level %d!\n", __func__, l);
+			ret = -1;
+		}
+	}
+
+	OscVisDestroyPyramid(&pyramid);
+	free(pLevel);
+	free(grey.data);
+	OscLog(INFO, "%s: %s\n", __func__, ret ? "FAILED" : "ok");
+	return ret;
+}
+
+/* State of a JPEG sink collecting the data in a buffer. */
+struct SINK_BUFFER {
+	uint8 *pData;
+	uint32 len;
+	uint32 capacity;
+};
+
+static OSC_ERR collectJpegData(void *pContext, const uint8 *pData, uint32 len)
+{
+	struct SINK_BUFFER *pSink = pContext;
+
+	if (pSink->len + len > pSink->capacity)
+		return -EBUFFER_TOO_SMALL;
+	memcpy(pSink->pData + pSink->len, pData, len);
+	pSink->len += len;
+	return SUCCESS;
+}
+
+static OSC_ERR failJpegData(void *pContext, const uint8 *pData, uint32 len)
+{
+	return -EDEVICE;
+}
+
+/* Count the restart markers of a JPEG file. Marker bytes in the entropy
+	coded data are stuffed, so every 0xff followed by 0xd0 to 0xd7 is one. */
+static int countRestartMarkers(const uint8 *pData, uint32 len)
+{
+	uint32 i;
+	int count = 0;
+
+	for (i = 0; i + 1 < len; i++)
+		if (pData[i] == 0xff && (pData[i + 1] & 0xf8) == 0xd0)
+			count++;
+	return count;
+}
+
+int testJpg()
+{
+	struct OSC_PICTURE rgb;
+	struct SINK_BUFFER sink;
+	void *hEncoder;
+	uint8 *pRef, *pOut, *pEnd;
+	uint32 refLen, len, capacity;
+	OSC_ERR err;
+	int nThreads, ret = 0;
+
+	if (readRgbPicture(&rgb) != SUCCESS)
+	{
+		OscLog(ERROR, "%s: Unable to read the test picture!\n", __func__);
+		return -1;
+	}
+	capacity = rgb.width * rgb.height * 3 + 4096;
+	pRef = malloc(capacity);
+	pOut = malloc(capacity);
+	sink.pData = pOut;
+	sink.capacity = capacity;
+
+	OscJpgCreateEncoder(&hEncoder);
+	OscJpgEncoderEncode(hEncoder, &rgb, pRef, QUALITY_FACTOR, &pEnd);
+	refLen = pEnd - pRef;
+
+	/* A buffer of the exact size takes the same data. */
+	err = OscJpgEncoderEncodeToBuffer(hEncoder, &rgb, pOut, refLen, QUALITY_FACTOR, &len);
+	if (err != SUCCESS || len != refLen || memcmp(pOut, pRef, refLen) != 0)
+	{
+		OscLog(ERROR, "%s: Encoding to a buffer differs! (%d)\n", __func__, err);
+		ret = -1;
+	}
+
+	/* A smaller one is not overrun and gives the size needed. */
+	memset(pOut, 0x55, capacity);
+	err = OscJpgEncoderEncodeToBuffer(hEncoder, &rgb, pOut, refLen / 2, QUALITY_FACTOR, &len);
+	if (err != -EBUFFER_TOO_SMALL || len != refLen || pOut[refLen / 2] != 0x55)
+	{
+		OscLog(ERROR, "%s: Encoding to a small buffer not refused! (%d)\n", __func__, err);
+		ret = -1;
+	}
+
+	sink.len = 0;
+	err = OscJpgEncoderEncodeToSink(hEncoder, &rgb, QUALITY_FACTOR, collectJpegData, &sink);
+	if (err != SUCCESS || sink.len != refLen || memcmp(pOut, pRef, refLen) != 0)
+	{
+		OscLog(ERROR, "%s: Encoding to a sink differs! (%d)\n", __func__, err);
+		ret = -1;
+	}
+
+	err = OscJpgEncoderEncodeToSink(hEncoder, &rgb, QUALITY_FACTOR, failJpegData, NULL);
+	if (err != -EDEVICE)
+	{
+		OscLog(ERROR, "%s: Error of the sink not returned! (%d)\n", __func__, err);
+		ret = -1;
+	}
+
+	/* Slices of one MCU row, one restart marker between each two, the
+		same data on any number of threads. */
+	OscJpgEncoderSetRestartInterval(hEncoder, 1);
+	OscJpgEncoderEncode(hEncoder, &rgb, pRef, QUALITY_FACTOR, &pEnd);
+	refLen = pEnd - pRef;
+	if (countRestartMarkers(pRef, refLen) != (rgb.height + 7) / 8 - 1 ||
+			pRef[refLen - 2] != 0xff || pRef[refLen - 1] != 0xd9)
+	{
+		OscLog(ERROR, "%s: Wrong restart markers!\n", __func__);
+		ret = -1;
+	}
+
+	for (nThreads = 2; nThreads <= 4; nThreads++)
+	{
+		OscJpgEncoderSetThreads(hEncoder, nThreads);
+		sink.len = 0;
+		err = OscJpgEncoderEncodeToSink(hEncoder, &rgb, QUALITY_FACTOR, collectJpegData, &sink);
+		if (err != SUCCESS || sink.len != refLen || memcmp(pOut, pRef, refLen) != 0)
+		{
+			OscLog(ERROR, "%s: Slices encoded on %d threads differ! (%d)\n", __func__, nThreads, err);
+			ret = -1;
+		}
+		err = OscJpgEncoderEncodeToBuffer(hEncoder, &rgb, pOut, capacity, QUALITY_FACTOR, &len);
+		if (err != SUCCESS || len != refLen || memcmp(pOut, pRef, refLen) != 0)
+		{
+			OscLog(ERROR, "%s: Slices encoded on %d threads to a buffer differ! (%d)\n", __func__, nThreads, err);
+			ret = -1;
+		}
+	}
+
+	OscJpgDestroyEncoder(hEncoder);
+	free(pRef);
+	free(pOut);
+	free(rgb.data);
+	OscLog(INFO, "%s: %s\n", __func__, ret ? "FAILED" : "ok");
+	return ret;
+}
+
+int main()
+{
+	OSC_ERR err;
+	int ret = 0;
+
+	err = OscCreate(&OscModule_log, &OscModule_bmp, &OscModule_vis, &OscModule_jpg);
+	if (err != SUCCESS)
+	{
+		printf("Unable to create framework.\n");
+		return -1;
+	}
+	OscLogSetConsoleLogLevel(INFO);
+	OscLogSetFileLogLevel(WARN);
+
+	if (testDebayer())
+		ret = -1;
+
+	if (testDebayerBorder())
+		ret = -1;
+
+	if (testDebayerTiles())
+		ret = -1;
+
+	if (testYuv422())
+		ret = -1;
+
+	if (testMedian())
+		ret = -1;
+
+	if (testPyramid())
+		ret = -1;
+
+	if (testJpg())
+		ret = -1;
+
+	OscDestroy();
+	return ret;
+}
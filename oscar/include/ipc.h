@@ -58,6 +58,10 @@ enum EnChannelFlags
 	F_IPC_NONBLOCKING = 0x2
 };
 
+/*! @brief The maximum number of clients a server channel is connected
+ * to at the same time. */
+#define OSC_IPC_MAX_CONNECTIONS 8
+
 /*! @brief Represents an IPC request. */
 struct OSC_IPC_REQUEST
 {
@@ -68,6 +72,28 @@ struct OSC_IPC_REQUEST
 	/*! @brief The source/destination address in the address space of
 	 *  the peer process. */
 	void *pAddr;
+	/*! @brief The size of the parameter as given by the client. No more
+	 * than this may be written to pAddr. */
+	uint32 paramSize;
+	/*! @brief The client connection the request was received on, below
+	 * OSC_IPC_MAX_CONNECTIONS. */
+	uint8 conn;
+};
+
+/*! @brief The outcome of an asynchronously submitted parameter request.
+ * @see OscIpcCompleteParam */
+struct OSC_IPC_COMPLETION
+{
+	/*! @brief Whether a parameter was read or written. */
+	enum EnRequestType enType;
+	/*! @brief The parameter ID the request was submitted with. */
+	uint32 paramID;
+	/*! @brief The data pointer the request was submitted with. For reads,
+	 * the received data has been stored there. */
+	void *pData;
+	/*! @brief SUCCESS or -ENEGATIVE_ACKNOWLEDGE if the server could not
+	 * execute the request. */
+	OSC_ERR result;
 };
 
 /*! The data type for an IPC channel Identifier */
@@ -115,16 +141,19 @@ OSC_ERR OscIpcUnregisterChannel(const OSC_IPC_CHAN_ID chanID);
 /*********************************************************************//*!
  * @brief Read the value of a parameter from the server over IPC.
  * 
- * Can only be called on a blocking channel. The server and client need
- * to agree on identifiers for the data fields (parameters) they want to
- * exchange. Then can issue read and write requests of these parameters,
- * which the server then executes. This is the function to issue a read
- * request to the server. It will block until the data of the requested
- * data is written to pData.
+ * The server and client need to agree on identifiers for the data
+ * fields (parameters) they want to exchange. Then can issue read and
+ * write requests of these parameters, which the server then executes.
+ * This is the function to issue a read request to the server. It will
+ * block until the data of the requested data is written to pData.
+ * 
+ * Waiting does not use any CPU time. This call must not be mixed with
+ * requests submitted asynchronously but not yet completed.
  * 
  * Only to be called by the client side of an IPC channel.
  * 
  * @see OscIpcSetParam
+ * @see OscIpcSubmitGetParam
  * @see OscIpcRegisterChannel
  * 
  * @param chanID Channel ID of the channel to be used.
@@ -140,18 +169,21 @@ OSC_ERR OscIpcGetParam(const OSC_IPC_CHAN_ID chanID,
 		const uint32 paramSize);
 
 /*********************************************************************//*!
- * @brief Read the value of a parameter from the server over IPC.
+ * @brief Write the value of a parameter to the server over IPC.
+ * 
+ * The server and client need to agree on identifiers for the data
+ * fields (parameters) they want to exchange. Then can issue read and
+ * write requests of these parameters, which the server then executes.
+ * This is the function to issue a write request to the server. It will
+ * block until the server acknowledged the request.
  * 
- * Can only be called on a blocking channel. The server and client need
- * to agree on identifiers for the data fields (parameters) they want to
- * exchange. Then can issue read and write requests of these parameters,
- * which the server then executes. This is the function to issue a write
- * request to the server. It will block until the data of the requested
- * data is written to pData.
+ * Waiting does not use any CPU time. This call must not be mixed with
+ * requests submitted asynchronously but not yet completed.
  * 
  * Only to be called by the client side of an IPC channel.
  * 
- * @see OscIpcSetParam
+ * @see OscIpcGetParam
+ * @see OscIpcSubmitSetParam
  * @see OscIpcRegisterChannel
  * 
  * @param chanID Channel ID of the channel to be used.
@@ -166,6 +198,93 @@ OSC_ERR OscIpcSetParam(const OSC_IPC_CHAN_ID chanID,
 		const uint32 paramID,
 		const uint32 paramSize);
 
+/*********************************************************************//*!
+ * @brief Submit a read request without waiting for its completion.
+ * 
+ * Up to MAX_NR_IPC_PENDING requests may be outstanding per channel.
+ * The server executes them in the order they were submitted and they
+ * are completed in the same order by OscIpcCompleteParam. pData must
+ * stay valid until then.
+ * 
+ * Only to be called by the client side of an IPC channel.
+ * 
+ * @see OscIpcCompleteParam
+ * @see OscIpcGetParam
+ * 
+ * @param chanID Channel ID of the channel to be used.
+ * @param pData Where to write the data read from the remote process.
+ * @param paramID An identifier for the data field to be read.
+ * @param paramSize The length of above data field.
+ * @return SUCCESS on success, -EDEVICE_BUSY if too many requests are
+ * outstanding or an appropriate error code otherwise.
+ *//*********************************************************************/
+OSC_ERR OscIpcSubmitGetParam(const OSC_IPC_CHAN_ID chanID,
+		void *pData,
+		const uint32 paramID,
+		const uint32 paramSize);
+
+/*********************************************************************//*!
+ * @brief Submit a write request without waiting for its completion.
+ * 
+ * Same as OscIpcSubmitGetParam but for writing a parameter. On the host
+ * the data is sent right away, on the target the server reads it
+ * directly from pData, which therefore must stay valid until the
+ * request is completed.
+ * 
+ * Only to be called by the client side of an IPC channel.
+ * 
+ * @see OscIpcCompleteParam
+ * @see OscIpcSetParam
+ * 
+ * @param chanID Channel ID of the channel to be used.
+ * @param pData Pointer to data to write to remote process.
+ * @param paramID An identifier for the data field to be written.
+ * @param paramSize The length of above data field.
+ * @return SUCCESS on success, -EDEVICE_BUSY if too many requests are
+ * outstanding or an appropriate error code otherwise.
+ *//*********************************************************************/
+OSC_ERR OscIpcSubmitSetParam(const OSC_IPC_CHAN_ID chanID,
+		void *pData,
+		const uint32 paramID,
+		const uint32 paramSize);
+
+/*********************************************************************//*!
+ * @brief Get the file descriptor to wait on for completions.
+ * 
+ * The descriptor becomes readable (POLLIN) as soon as the oldest
+ * outstanding request can be completed by OscIpcCompleteParam. It may
+ * be added to the poll() or select() set of the caller's main loop.
+ * 
+ * @param chanID Channel ID of the channel to be used.
+ * @param pFd Where to store the file descriptor.
+ * @return SUCCESS on success or an appropriate error code otherwise.
+ *//*********************************************************************/
+OSC_ERR OscIpcGetPollFd(const OSC_IPC_CHAN_ID chanID, int *pFd);
+
+/*********************************************************************//*!
+ * @brief Complete the oldest outstanding asynchronous request.
+ * 
+ * Waits for the server to acknowledge the oldest request submitted with
+ * OscIpcSubmitGetParam or OscIpcSubmitSetParam. The wait uses poll()
+ * and does not use any CPU time.
+ * 
+ * @see OscIpcSubmitGetParam
+ * @see OscIpcSubmitSetParam
+ * @see OscIpcGetPollFd
+ * 
+ * @param chanID Channel ID of the channel to be used.
+ * @param pCompletion Where to store the outcome of the request.
+ * @param timeout Time to wait in milliseconds. 0 returns immediately,
+ * a negative value waits without timeout.
+ * @return SUCCESS if a request was completed (its own result is in
+ * pCompletion), -ENO_MSG_AVAIL if none is ready and timeout is 0,
+ * -ETIMEOUT if the timeout expired or an appropriate error code
+ * otherwise.
+ *//*********************************************************************/
+OSC_ERR OscIpcCompleteParam(const OSC_IPC_CHAN_ID chanID,
+		struct OSC_IPC_COMPLETION *pCompletion,
+		const int32 timeout);
+
 /*********************************************************************//*!
  * @brief Get a new IPC request to handle.
  * 
@@ -174,6 +293,10 @@ OSC_ERR OscIpcSetParam(const OSC_IPC_CHAN_ID chanID,
  * All requests received in this way must be acknowledged by calling
  * OscIpcAckRequest.
  * 
+ * Requests of up to OSC_IPC_MAX_CONNECTIONS clients are returned in
+ * turn. A client sends its next request only after the previous one was
+ * acknowledged, so each connection has at most one request outstanding.
+ * 
  * Only to be called by the server side of an IPC channel.
  * 
  * @see OscIpcAckRequest
@@ -190,7 +313,9 @@ OSC_ERR OscIpcGetRequest(const OSC_IPC_CHAN_ID chanID,
  * @brief Acknowledge the execution of an IPC request.
  * 
  * Acknowledge a request previously received by OscIpcGetRequest
- * depending on the success of the execution.
+ * depending on the success of the execution. The request is released
+ * even if the acknowledge could not be sent, in which case the client
+ * has hung up and its connection is closed.
  * 
  * Only to be called by the server side of an IPC channel.
  * 
@@ -200,10 +325,62 @@ OSC_ERR OscIpcGetRequest(const OSC_IPC_CHAN_ID chanID,
  * @param chanID Channel ID of the channel to be used.
  * @param pRequest The request to be acknowledged.
  * @param bSucceeded True if the request was executed successfully.
- * @return SUCCESS on success or an appropriate error code otherwise.
+ * @return SUCCESS on success, -ESOCKET if the client is gone or an
+ * appropriate error code otherwise.
  *//*********************************************************************/
 OSC_ERR OscIpcAckRequest(const OSC_IPC_CHAN_ID chanID,
 		const struct OSC_IPC_REQUEST *pRequest,
 		const bool bSucceeded);
 
+/*********************************************************************//*!
+ * @brief Hold back a request to acknowledge it later.
+ * 
+ * The other clients keep being served by OscIpcGetRequest meanwhile.
+ * A held request must eventually be passed to OscIpcAckRequest or, if
+ * its client hung up, to OscIpcDropRequest.
+ * 
+ * Only to be called by the server side of an IPC channel.
+ * 
+ * @see OscIpcCheckHeldRequest
+ * 
+ * @param chanID Channel ID of the channel to be used.
+ * @param pRequest The request received by OscIpcGetRequest.
+ * @return SUCCESS on success or an appropriate error code otherwise.
+ *//*********************************************************************/
+OSC_ERR OscIpcHoldRequest(const OSC_IPC_CHAN_ID chanID,
+		const struct OSC_IPC_REQUEST *pRequest);
+
+/*********************************************************************//*!
+ * @brief Check whether the client of a held request is still there.
+ * 
+ * Does not block.
+ * 
+ * @see OscIpcHoldRequest
+ * 
+ * @param chanID Channel ID of the channel to be used.
+ * @param pRequest The held request.
+ * @return SUCCESS if the client is still waiting, -ESOCKET if it hung
+ * up or an appropriate error code otherwise.
+ *//*********************************************************************/
+OSC_ERR OscIpcCheckHeldRequest(const OSC_IPC_CHAN_ID chanID,
+		const struct OSC_IPC_REQUEST *pRequest);
+
+/*********************************************************************//*!
+ * @brief Discard a request without acknowledging it.
+ * 
+ * Releases the request and closes the connection to its client, which
+ * would otherwise wait for the acknowledge forever. Meant for held
+ * requests whose client hung up.
+ * 
+ * Only to be called by the server side of an IPC channel.
+ * 
+ * @see OscIpcCheckHeldRequest
+ * 
+ * @param chanID Channel ID of the channel to be used.
+ * @param pRequest The request to discard.
+ * @return SUCCESS on success or an appropriate error code otherwise.
+ *//*********************************************************************/
+OSC_ERR OscIpcDropRequest(const OSC_IPC_CHAN_ID chanID,
+		const struct OSC_IPC_REQUEST *pRequest);
+
 #endif /*IPC_PUB_H_*/
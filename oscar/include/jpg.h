@@ -27,11 +27,281 @@
 
 extern struct OscModule OscModule_jpg;
 
+/*! @brief Receives the encoded data of a JPEG image in chunks, in order.
+ * 
+ * @param pContext The context passed to the encoding function.
+ * @param pData The next chunk of the image.
+ * @param len Length of the chunk in bytes.
+ * @return SUCCESS to continue, anything else aborts the encoding and is
+ * returned by the encoding function.
+ */
+typedef OSC_ERR (*OSC_JPG_SINK)(void *pContext, const uint8 *pData, uint32 len);
+
+/*! @brief How an encoder chooses its Huffman tables. */
+enum EnOscJpgHuffmanMode {
+	/*! @brief The example tables of the JPEG standard. */
+	OSC_JPG_HUFFMAN_STANDARD,
+	/*! @brief Tables built for each image from the symbols counted in a
+	 * first pass over the image. */
+	OSC_JPG_HUFFMAN_OPTIMIZED,
+	/*! @brief Tables built from the symbols of the previous image, counted
+	 * while encoding it. */
+	OSC_JPG_HUFFMAN_PREVIOUS
+};
+
+/*! @brief Statistics of the last image encoded by an encoder. */
+struct OSC_JPG_ENCODER_STATS {
+	uint32 nBytes;          /*!< @brief Size of the JPEG data. */
+	uint32 qualityFactor;   /*!< @brief The quality factor used. */
+	uint16 nEncodings;      /*!< @brief 2 if the image was encoded again
+	                             to meet the target size. */
+};
+
 /*====================== API functions =================================*/
 
+/*********************************************************************//*!
+ * @brief Create a JPEG encoder.
+ * 
+ * An encoder holds all the state needed while encoding, so different
+ * encoders may be used concurrently, e.g. from different threads. A
+ * single encoder must only encode one image at a time.
+ * @see OscJpgEncoderEncode
+ * @see OscJpgDestroyEncoder
+ * 
+ * @param phEncoder The handle to the encoder is returned over this
+ * pointer.
+ * @return SUCCESS or an appropriate error code otherwise
+ *//*********************************************************************/
+OSC_ERR OscJpgCreateEncoder(void **phEncoder);
+
+/*********************************************************************//*!
+ * @brief Free an encoder created by OscJpgCreateEncoder.
+ * 
+ * @param hEncoder Handle to the encoder.
+ * @return SUCCESS or an appropriate error code otherwise
+ *//*********************************************************************/
+OSC_ERR OscJpgDestroyEncoder(void *hEncoder);
+
+/*********************************************************************//*!
+ * @brief Set the chroma subsampling used for colour images.
+ * 
+ * Applies to OSC_PICTURE_BGR_24 images and raw images encoded with
+ * OscJpgEncoderEncodeBayer. 4:2:0 halves the number of chrominance
+ * blocks compared to 4:2:2 and is what most decoders handle fastest. New
+ * encoders use 4:4:4.
+ * 
+ * @param hEncoder Handle to the encoder.
+ * @param sampling OSC_PICTURE_YUV_444, OSC_PICTURE_YUV_422 or
+ * OSC_PICTURE_YUV_420.
+ * @return SUCCESS or an appropriate error code otherwise
+ *//*********************************************************************/
+OSC_ERR OscJpgEncoderSetSampling(void *hEncoder, enum EnOscPictureType sampling);
+
+/*********************************************************************//*!
+ * @brief Set the restart interval of an encoder.
+ * 
+ * Splits the image into slices of the given number of MCU rows (8 or 16
+ * pixel rows, depending on the sampling) separated by restart markers.
+ * Slices can be encoded independently, see OscJpgEncoderSetThreads.
+ * 
+ * @param hEncoder Handle to the encoder.
+ * @param nMcuRows MCU rows per slice or 0 to encode the image as a
+ * single slice without restart markers, which is the default.
+ * @return SUCCESS or an appropriate error code otherwise
+ *//*********************************************************************/
+OSC_ERR OscJpgEncoderSetRestartInterval(void *hEncoder, uint16 nMcuRows);
+
+/*********************************************************************//*!
+ * @brief Replace the quantization tables of an encoder.
+ * 
+ * The tables are scaled by the quality factor like the default ones, a
+ * quality factor of 1024 uses them as they are. The scaled tables are
+ * kept by the encoder and only computed again when the quality factor
+ * changes.
+ * 
+ * @param hEncoder Handle to the encoder.
+ * @param pLuminance 64 quantization values from 1 to 255 for the
+ * luminance in row order, not zigzag, or NULL for the default table.
+ * @param pChrominance The same for the chrominance.
+ * @return SUCCESS or an appropriate error code otherwise
+ *//*********************************************************************/
+OSC_ERR OscJpgEncoderSetQuantTables(void *hEncoder, const uint8 *pLuminance, const uint8 *pChrominance);
+
+/*********************************************************************//*!
+ * @brief Set how an encoder chooses its Huffman tables.
+ * 
+ * Tables built for the image make the files smaller, by 5 to 30 percent
+ * and most at low qualities. OSC_JPG_HUFFMAN_OPTIMIZED takes about twice as
+ * long to encode, as the DCT is done twice. OSC_JPG_HUFFMAN_PREVIOUS
+ * encodes in a single pass with tables built from the previous image and
+ * gains nearly as much on a sequence of similar images. Its tables have
+ * codes for all symbols, so any image can be encoded with them. The
+ * first image is encoded with the standard tables.
+ * 
+ * @param hEncoder Handle to the encoder.
+ * @param enMode The mode, OSC_JPG_HUFFMAN_STANDARD by default.
+ * @return SUCCESS or an appropriate error code otherwise
+ *//*********************************************************************/
+OSC_ERR OscJpgEncoderSetHuffmanMode(void *hEncoder, enum EnOscJpgHuffmanMode enMode);
+
+/*********************************************************************//*!
+ * @brief Let an encoder choose the quality to keep the images below a
+ * size.
+ * 
+ * The quality factor passed to the encoding functions is only used for
+ * the first image. For every further image, the encoder derives the
+ * quality factor from the size and quality of the previous one, aiming
+ * a bit below the target. If the quality of the previous image is
+ * not representative, e.g. after a scene change, an image can exceed the
+ * target. With bReencode set, such an image is encoded once more with a
+ * corrected quality by the functions writing to a buffer. Images passed
+ * to a sink are never encoded twice.
+ * @see OscJpgEncoderGetStats
+ * 
+ * @param hEncoder Handle to the encoder.
+ * @param nTargetBytes Size per image in bytes, 0 to use the quality
+ * factors as passed, which is the default.
+ * @param bReencode Whether to encode images exceeding the size again.
+ * @return SUCCESS or an appropriate error code otherwise
+ *//*********************************************************************/
+OSC_ERR OscJpgEncoderSetTargetSize(void *hEncoder, uint32 nTargetBytes, bool bReencode);
+
+/*********************************************************************//*!
+ * @brief Get the size and the quality factor of the last image encoded.
+ * 
+ * @param hEncoder Handle to the encoder.
+ * @param pStats The statistics are returned over this pointer.
+ * @return SUCCESS or an appropriate error code otherwise
+ *//*********************************************************************/
+OSC_ERR OscJpgEncoderGetStats(void *hEncoder, struct OSC_JPG_ENCODER_STATS *pStats);
+
+/*********************************************************************//*!
+ * @brief Set the number of threads an encoder uses.
+ * 
+ * With a restart interval set, the slices of an image are encoded in
+ * parallel on this many threads, including the calling one, and
+ * concatenated afterwards. The threads are started on first use and
+ * stopped by OscJpgDestroyEncoder. Each slice is encoded into a buffer
+ * of its own, allocated for the worst case. On the target, the slices
+ * are always encoded on the calling thread.
+ * 
+ * @param hEncoder Handle to the encoder.
+ * @param nThreads Number of threads, 1 by default.
+ * @return SUCCESS or an appropriate error code otherwise
+ *//*********************************************************************/
+OSC_ERR OscJpgEncoderSetThreads(void *hEncoder, uint16 nThreads);
+
+/*********************************************************************//*!
+ * @brief Encode a bitmap image to a JPEG file using a given encoder.
+ * 
+ * OSC_PICTURE_BGR_24 images are converted block by block to the sampling
+ * set with OscJpgEncoderSetSampling and are left unchanged.
+ * OSC_PICTURE_YUV_444, OSC_PICTURE_YUV_422 and OSC_PICTURE_YUV_420
+ * images are encoded with their own sampling. YUV 4:2:2 is stored in
+ * UYVY order as returned by OscVisFastDebayerYUV422, YUV 4:2:0 as the
+ * four luminance samples of a 2x2 block followed by Cb and Cr. Both need
+ * an even width, 4:2:0 also an even height. OSC_PICTURE_GREYSCALE and
+ * OSC_PICTURE_YUV_400 images are encoded as a single luminance component.
+ * 
+ * @param hEncoder Handle to the encoder.
+ * @param pic Pointer to the image
+ * @param output_ptr Pointer to the memory where the JPEG output will be stored
+ * @param quality_factor 1024 means heavy compression
+ * @param pOutputEnd The pointer to the end of the data in the JPEG output
+ * buffer is returned over this pointer.
+ * @return SUCCESS or an appropriate error code otherwise
+ *//*********************************************************************/
+OSC_ERR OscJpgEncoderEncode(void *hEncoder, struct OSC_PICTURE *pic, uint8 *output_ptr, uint32 quality_factor, uint8 **pOutputEnd);
+
+/*********************************************************************//*!
+ * @brief Encode a raw image of a sensor with bayer filter to a JPEG file.
+ * 
+ * Every 2x2 cell of the raw image becomes one colour pixel as in
+ * OscVisFastDebayerBGR, with the two green samples averaged. The result
+ * is width/2 by height/2 pixels. The colour conversion is done block by
+ * block while encoding, so no intermediate colour image is needed. The
+ * sampling is set with OscJpgEncoderSetSampling.
+ * 
+ * @param hEncoder Handle to the encoder.
+ * @param pRaw Pointer to the raw image. Width and height must be even.
+ * @param enBayerOrderFirstRow The order of the bayer pattern colors in
+ * the first row of the image. Can be queried by OscCamGetBayerOrder().
+ * @param output_ptr Pointer to the memory where the JPEG output will be stored
+ * @param quality_factor 1024 means heavy compression
+ * @param pOutputEnd The pointer to the end of the data in the JPEG output
+ * buffer is returned over this pointer.
+ * @return SUCCESS or an appropriate error code otherwise
+ *//*********************************************************************/
+OSC_ERR OscJpgEncoderEncodeBayer(void *hEncoder, const struct OSC_PICTURE *pRaw, enum EnBayerOrder enBayerOrderFirstRow, uint8 *output_ptr, uint32 quality_factor, uint8 **pOutputEnd);
+
+/*********************************************************************//*!
+ * @brief Encode a bitmap image into a buffer of limited size.
+ * 
+ * Accepts the same images as OscJpgEncoderEncode. Nothing is written
+ * past the end of the buffer, if the image does not fit, the contents
+ * of the buffer are undefined and the size it would have taken is
+ * returned. If the encoder re-encodes images exceeding the target size,
+ * it does so for images exceeding the buffer as well.
+ * 
+ * @param hEncoder Handle to the encoder.
+ * @param pic Pointer to the image.
+ * @param pOutput The buffer for the JPEG data.
+ * @param capacity Size of the buffer in bytes.
+ * @param quality_factor 1024 means heavy compression
+ * @param pLength The length of the JPEG data is returned over this
+ * pointer, also if the buffer is too small.
+ * @return SUCCESS, -EBUFFER_TOO_SMALL if the image does not fit or an
+ * appropriate error code otherwise
+ *//*********************************************************************/
+OSC_ERR OscJpgEncoderEncodeToBuffer(void *hEncoder, const struct OSC_PICTURE *pic, uint8 *pOutput, uint32 capacity, uint32 quality_factor, uint32 *pLength);
+
+/*********************************************************************//*!
+ * @brief Encode a bitmap image and pass the data to a sink.
+ * 
+ * Accepts the same images as OscJpgEncoderEncode. The data is collected
+ * in a buffer of the encoder and passed on in chunks of a few kilobytes,
+ * so the image can be written to a file or socket without a buffer for
+ * the whole image. With threads and a restart interval set, the encoded
+ * slices are passed on as a whole.
+ * 
+ * @param hEncoder Handle to the encoder.
+ * @param pic Pointer to the image.
+ * @param quality_factor 1024 means heavy compression
+ * @param sink Function receiving the data.
+ * @param pSinkContext Passed to the sink.
+ * @return SUCCESS, the error returned by the sink or an appropriate error
+ * code otherwise
+ *//*********************************************************************/
+OSC_ERR OscJpgEncoderEncodeToSink(void *hEncoder, const struct OSC_PICTURE *pic, uint32 quality_factor, OSC_JPG_SINK sink, void *pSinkContext);
+
+/*********************************************************************//*!
+ * @brief Encode a raw image of a sensor with bayer filter and pass the
+ * data to a sink.
+ * 
+ * @see OscJpgEncoderEncodeBayer
+ * @see OscJpgEncoderEncodeToSink
+ * 
+ * @param hEncoder Handle to the encoder.
+ * @param pRaw Pointer to the raw image. Width and height must be even.
+ * @param enBayerOrderFirstRow The order of the bayer pattern colors in
+ * the first row of the image.
+ * @param quality_factor 1024 means heavy compression
+ * @param sink Function receiving the data.
+ * @param pSinkContext Passed to the sink.
+ * @return SUCCESS, the error returned by the sink or an appropriate error
+ * code otherwise
+ *//*********************************************************************/
+OSC_ERR OscJpgEncoderEncodeBayerToSink(void *hEncoder, const struct OSC_PICTURE *pRaw, enum EnBayerOrder enBayerOrderFirstRow, uint32 quality_factor, OSC_JPG_SINK sink, void *pSinkContext);
+
 /*********************************************************************//*!
  * @brief Encode a bitmap image to a JPEG file
  * 
+ * Uses an encoder shared by all callers of this function, so it must
+ * not be called concurrently. Use OscJpgEncoderEncode for that. Colour
+ * images are encoded with 4:4:4 sampling. The output buffer must be large
+ * enough for any image, use OscJpgEncoderEncodeToBuffer if its size is
+ * limited.
+ * 
  * @param pic Pointer to the image
  * @param output_ptr Pointer to the memory where the JPEG output will be stored
  * @param quality_factor 1024 means heavy compression
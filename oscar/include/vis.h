@@ -90,6 +90,45 @@ struct OSC_VIS_REGIONS {
 	struct OSC_VIS_REGIONS_OBJECT objects[MAX_NO_OF_OBJECTS];	/*!< @brief Array of the detected objects */
 };
 
+/*! @brief Structure representing a rectangle of pixels in an image. */
+struct OSC_VIS_RECT {
+	uint16 left;		/*!< @brief Column of the left-most pixel */
+	uint16 top;			/*!< @brief Row of the top-most pixel */
+	uint16 width;		/*!< @brief Width in pixels */
+	uint16 height;		/*!< @brief Height in pixels */
+};
+
+/*! @brief Structure describing one tile in an atlas of debayered rectangles. */
+struct OSC_VIS_TILE {
+	struct OSC_VIS_RECT rect;	/*!< @brief The rectangle of the raw image covered by the tile, clipped to the image */
+	uint32 offset;				/*!< @brief Offset of the first pixel of the tile in the atlas in bytes */
+};
+
+/*! @brief Number of levels of an image pyramid. */
+#define OSC_VIS_PYRAMID_LEVELS 3
+
+/*! @brief Structure holding the greyscale levels of an image pyramid. */
+struct OSC_VIS_PYRAMID {
+	uint8 *pBuffer;				/*!< @brief Buffer holding all levels, one after the other */
+	uint32 bufferSize;			/*!< @brief Size of the buffer in bytes */
+	uint16 width;				/*!< @brief Width of the raw image */
+	uint16 height;				/*!< @brief Height of the raw image */
+	struct OSC_PICTURE levels[OSC_VIS_PYRAMID_LEVELS]; /*!< @brief The levels at 1/2, 1/4 and 1/8 of the size of the raw image */
+};
+
+/* Datatypes needed by color.c */
+/*! @brief Structure describing where the colors of a pixel are, relative to its first byte. */
+struct OSC_VIS_COLOR_LAYOUT {
+	uint32 offsetB;				/*!< @brief Offset of blue */
+	uint32 offsetG1;			/*!< @brief Offset of the first green */
+	uint32 offsetG2;			/*!< @brief Offset of the second green, green is the rounded mean of both. Same as offsetG1 if there is only one. */
+	uint32 offsetR;				/*!< @brief Offset of red */
+	uint16 step;				/*!< @brief Bytes from one pixel to the next in a row */
+};
+
+/* The layout of OSC_PICTURE_BGR_24 pictures (defined in 'color.c') */
+extern const struct OSC_VIS_COLOR_LAYOUT OSC_VIS_BGR_LAYOUT;
+
 /* Datatypes needed by filters.c */
 /*! @brief Structure representing a filter kernel used in the generic 2D filter. */
 struct OSC_VIS_FILTER_KERNEL {	
@@ -102,9 +141,14 @@ struct OSC_VIS_FILTER_KERNEL {
 /* Realizations of several filter kernels used by the generic 2D filter (defined in 'filters.c') */
 extern struct OSC_VIS_FILTER_KERNEL GAUSS3X3;
 extern struct OSC_VIS_FILTER_KERNEL GAUSS5X5;
+/* Despite their names these are mean filters, OscVisMedianFilter
+ * calculates the median. */
 extern struct OSC_VIS_FILTER_KERNEL MEDIAN3X3;
 extern struct OSC_VIS_FILTER_KERNEL MEDIAN5X5;
 
+/*! @brief The largest radius of OscVisMedianFilter. */
+#define OSC_VIS_MAX_MEDIAN_RADIUS 127
+
 
 
 extern struct OscModule OscModule_vis;
@@ -134,6 +178,11 @@ extern struct OscModule OscModule_vis;
  * the same width and height as the input image. Color representation
  * is suboptimal at the border pixels.
  * 
+ * Up to release v2.1-p2, the green of the right-most pixel of the first
+ * row and of the last two rows was interpolated from the wrong raw
+ * pixels, and the last row's green was shifted by one pixel. Outputs of
+ * later versions differ from earlier ones in these rows.
+ * 
  * @param pRaw Pointer to the raw input picture of size width x height.
  * @param width Width of the input and output image.
  * @param height Height of the input and output image.
@@ -208,6 +257,118 @@ OSC_ERR OscVisDebayerHalfSize(uint8 const * const pRaw, uint16 const width, uint
  */
 OSC_ERR OscVisDebayerSpot(uint8 const * const pRaw, uint16 const width, uint16 const height, enum EnBayerOrder enBayerOrderFirstRow, uint16 const xPos, uint16 const yPos, uint16 const size, uint8 * color);
 
+/*********************************************************************//*!
+ * @brief Debayer only some rectangles of a raw image into a tile atlas.
+ * 
+ * Each rectangle is debayered like OscVisDebayer does with the whole
+ * image, using the surrounding raw pixels as context, and gives the same
+ * pixel values. The tiles are written to the atlas one after the other,
+ * each with rows of rect.width pixels and no padding. The tile
+ * descriptions tell where each ended up. Rectangles are clipped to the
+ * image, and a rectangle outside of it gives an empty tile.
+ * 
+ * This makes the cost proportional to the area of the rectangles, for
+ * example the bounding boxes of the objects found in the last frame.
+ * The bounding box of an OSC_VIS_REGIONS object is the rectangle
+ * { bboxLeft, bboxTop, bboxRight - bboxLeft + 1, bboxBottom - bboxTop }.
+ * 
+ * ! Only even widths are supported !
+ * 
+ * @param pRaw Pointer to the raw input picture of size width x height.
+ * @param width Width of the input image.
+ * @param height Height of the input image.
+ * @param enBayerOrderFirstRow The order of the bayer pattern colors
+ * in the first row of the image to be debayered. Can be queried by
+ * OscCamGetBayerOrder().
+ * @param pRects The rectangles to debayer.
+ * @param nRects Number of rectangles.
+ * @param enType OSC_PICTURE_BGR_24 for color tiles or
+ * OSC_PICTURE_GREYSCALE for grey tiles using the weights of
+ * OscVisBGR2Grey.
+ * @param pAtlas The output atlas.
+ * @param atlasSize Size of the atlas in bytes.
+ * @param pTiles Array of nRects tile descriptions to be filled out.
+ * @return SUCCESS, -EBUFFER_TOO_SMALL if the tiles do not fit into the
+ * atlas or an appropriate error code otherwise
+ *//*********************************************************************/
+OSC_ERR OscVisDebayerTiles(const uint8 *pRaw,
+		const uint16 width,
+		const uint16 height,
+		const enum EnBayerOrder enBayerOrderFirstRow,
+		const struct OSC_VIS_RECT *pRects,
+		const uint16 nRects,
+		const enum EnOscPictureType enType,
+		uint8 *pAtlas,
+		const uint32 atlasSize,
+		struct OSC_VIS_TILE *pTiles);
+
+/*********************************************************************//*!
+ * @brief Allocate an image pyramid for raw images of a given size.
+ * 
+ * The pyramid is meant to be created once and rebuilt for every frame
+ * with OscVisBuildPyramid. Level 0 has half, level 1 a quarter and
+ * level 2 an eighth of the width and height of the raw image, odd
+ * sizes being rounded down. All levels are OSC_PICTURE_GREYSCALE
+ * pictures without padding between the rows and can be passed on as
+ * they are, e.g. to OscBmpWrite or an IPC image request.
+ * @see OscVisBuildPyramid
+ * @see OscVisDestroyPyramid
+ * 
+ * ! Only even widths and heights of at least 16 are supported !
+ * 
+ * @param pPyramid The pyramid to fill out.
+ * @param width Width of the raw images.
+ * @param height Height of the raw images.
+ * @return SUCCESS or an appropriate error code otherwise
+ *//*********************************************************************/
+OSC_ERR OscVisCreatePyramid(struct OSC_VIS_PYRAMID *pPyramid,
+		const uint16 width,
+		const uint16 height);
+
+/*********************************************************************//*!
+ * @brief Free the buffer of a pyramid created by OscVisCreatePyramid.
+ * 
+ * @param pPyramid The pyramid.
+ * @return SUCCESS or an appropriate error code otherwise
+ *//*********************************************************************/
+OSC_ERR OscVisDestroyPyramid(struct OSC_VIS_PYRAMID *pPyramid);
+
+/*********************************************************************//*!
+ * @brief Build all levels of an image pyramid from a raw image.
+ * 
+ * Level 0 is the same as the output of OscVisDebayerGreyscaleHalfSize.
+ * Every pixel of the next levels is the rounded mean of a 2x2 block of
+ * the level above. The levels are built in a single pass over the raw
+ * image: a row of a level is calculated as soon as the two rows it is
+ * made of are done, while those are still in the cache.
+ * 
+ * @param pPyramid The pyramid, created for the size of the image.
+ * @param pRaw Pointer to the raw input picture.
+ * @param enBayerOrderFirstRow The order of the bayer pattern colors
+ * in the first row of the image to be debayered. Can be queried by
+ * OscCamGetBayerOrder().
+ * @return SUCCESS or an appropriate error code otherwise
+ *//*********************************************************************/
+OSC_ERR OscVisBuildPyramid(struct OSC_VIS_PYRAMID *pPyramid,
+		const uint8 *pRaw,
+		const enum EnBayerOrder enBayerOrderFirstRow);
+
+/*********************************************************************//*!
+ * @brief Calculate the next smaller pyramid level of a greyscale picture.
+ * 
+ * Every output pixel is the rounded mean of a 2x2 block of the input,
+ * just like the levels of OscVisBuildPyramid. Meant for pyramids of
+ * images that are already greyscale, or to build levels only when they
+ * are needed. A trailing odd row or column of the input is not used.
+ * 
+ * @param picIn Pointer to the input greyscale picture struct.
+ * @param picOut Pointer to the output picture struct with room for
+ * width/2 x height/2 pixels. Must not have the same data as the input.
+ * @return SUCCESS or an appropriate error code otherwise
+ *//*********************************************************************/
+OSC_ERR OscVisBuildPyramidLevel(const struct OSC_PICTURE *picIn,
+		struct OSC_PICTURE *picOut);
+
 
 /*********************************************************************//*!
  * @brief Convert a raw image captured by a camera sensor with bayer
@@ -346,8 +507,11 @@ OSC_ERR OscVisFastDebayerChromV(const struct OSC_PICTURE *pRaw, struct OSC_PICTU
  * The macro pixel is stored in UYVY order (equal to Y422 and UYNV and HDYC 
  * according to www.fourcc.org. The fourcc hexcode is 0x59565955
  * 
+ * A macro pixel holds two pixels, so if width/2 is odd, the last pixel
+ * of each row is left out and the output is one pixel narrower.
+ * 
  * @param pRaw Pointer to an OSC_PICTURE structure which contains the raw input picture of size width x height.
- * @param pOut Pointer to the result OSC_PICTURE structure of size (width/2) x (height/2).
+ * @param pOut Pointer to the result OSC_PICTURE structure of size ((width/2) & ~1) x (height/2).
  * @return SUCCESS or an appropriate error code.
  *//*********************************************************************/
 OSC_ERR OscVisFastDebayerYUV422(const struct OSC_PICTURE *pRaw, struct OSC_PICTURE *pOut);
@@ -383,6 +547,8 @@ OSC_ERR OscVisFastDebayerHSL_H(const struct OSC_PICTURE *pRaw, struct OSC_PICTUR
  * Only even width and height are supported. Image size is reduced by a factor of 4!
  * The image is returned in 8 Bit/Pixel Format.
  * 
+ * Pixels with a luminance of 0 get a saturation of 0.
+ * 
  * @param pRaw Pointer to an OSC_PICTURE structure which contains the raw input picture of size width x height.
  * @param pOut Pointer to the result OSC_PICTURE structure of size (width/2) x (height/2).
  * @return SUCCESS or an appropriate error code.
@@ -552,21 +718,153 @@ OSC_ERR OscVisGrey2BW(struct OSC_PICTURE *picIn, struct OSC_PICTURE *picOut, uin
  *//*********************************************************************/
 OSC_ERR OscVisBGR2BW(struct OSC_PICTURE *picIn, struct OSC_PICTURE *picOut, uint8 threshold, bool bDarkIsForeground);
 
+/*********************************************************************//*!
+ * @brief BGR to YCbCr Conversion
+ * 
+ * Converts a BGR color image to the YCbCr of JFIF in the layout the JPEG
+ * encoder reads for the type of the output picture: 
+ * OSC_PICTURE_YUV_444 stores Y, Cb and Cr of every pixel,
+ * OSC_PICTURE_YUV_422 stores Cb, Y, Cr and Y of every pair of pixels in
+ * a row and OSC_PICTURE_YUV_420 stores the four Y of a 2x2 block in row
+ * order followed by Cb and Cr. The chroma is the mean over the pixels
+ * sharing it. If width and height are multiples of 16, encoding the
+ * result gives the same JPEG as encoding the BGR image with the same
+ * sampling. Otherwise only the padding of the last MCUs differs.
+ * 
+ * ! The 4:2:2 and 4:2:0 formats need even widths, 4:2:0 also even heights !
+ * 
+ * @param picIn Pointer to the input color picture struct (type must be OSC_PICTURE_BGR_24).
+ * @param picOut Pointer to the output picture struct, with the type set
+ * to the format to convert to. Width and height are set.
+ * @return SUCCESS or an appropriate error code.
+ *//*********************************************************************/
+OSC_ERR OscVisBGR2YCbCr(const struct OSC_PICTURE *picIn, struct OSC_PICTURE *picOut);
+
+/*********************************************************************//*!
+ * @brief Get the layout of the 2x2 cells of a raw image.
+ * 
+ * Every cell is one pixel for the color conversion kernels. Its green
+ * is the mean of both green pixels of the cell.
+ * 
+ * @param width Width of the raw image.
+ * @param enBayerOrderFirstRow The order of the bayer pattern colors
+ * in the first row of the image. Can be queried by
+ * OscCamGetBayerOrder().
+ * @param pLayout The layout to fill out.
+ * @return SUCCESS or an appropriate error code.
+ *//*********************************************************************/
+OSC_ERR OscVisGetBayerColorLayout(const uint16 width,
+		const enum EnBayerOrder enBayerOrderFirstRow,
+		struct OSC_VIS_COLOR_LAYOUT *pLayout);
+
+/*********************************************************************//*!
+ * @brief Convert a row of pixels to luminance and color differences.
+ * 
+ * The luminance is (0.299 * R + 0.587 * G + 0.114 * B), as used by
+ * OscVisBGR2Grey and OscVisFastDebayerLumY, U is 0.492 * (B - Y) + 128
+ * and V is 0.877 * (R - Y) + 128 truncated to 8 bits, as used by
+ * OscVisFastDebayerChromU and OscVisFastDebayerChromV. Pixels with a
+ * step of 2 bytes, as in raw images, are converted with SIMD
+ * instructions where available.
+ * 
+ * @param pIn The first pixel.
+ * @param pLayout The layout of the pixels.
+ * @param nPixels Number of pixels.
+ * @param pY Output of the luminance or NULL.
+ * @param pU Output of U or NULL.
+ * @param pV Output of V or NULL.
+ *//*********************************************************************/
+void OscVisColorToYUV(const uint8 *pIn,
+		const struct OSC_VIS_COLOR_LAYOUT *pLayout,
+		const uint32 nPixels,
+		uint8 *pY,
+		uint8 *pU,
+		uint8 *pV);
+
+/*********************************************************************//*!
+ * @brief Convert a row of pixels to the YCbCr of JFIF.
+ * 
+ * Y is (77 * R + 150 * G + 29 * B) >> 8. Cb is (-43 * R - 85 * G + 128 *
+ * B) and Cr is (128 * R - 107 * G - 21 * B), both without the division
+ * by 256 and the offset of 128, so that they can be summed up for
+ * subsampling. Pixels with a step of 2 bytes, as in raw images, are
+ * converted with SIMD instructions where available.
+ * 
+ * @param pIn The first pixel.
+ * @param pLayout The layout of the pixels.
+ * @param nPixels Number of pixels.
+ * @param pY Output of the luma or NULL.
+ * @param pCb Output of the scaled Cb or NULL.
+ * @param pCr Output of the scaled Cr or NULL.
+ *//*********************************************************************/
+void OscVisColorToYCbCr(const uint8 *pIn,
+		const struct OSC_VIS_COLOR_LAYOUT *pLayout,
+		const uint32 nPixels,
+		uint8 *pY,
+		int16 *pCb,
+		int16 *pCr);
+
+/*********************************************************************//*!
+ * @brief Convert a row of pixels to hue, saturation and lightness.
+ * 
+ * The values are the ones of OscVisFastDebayerHSL_H,
+ * OscVisFastDebayerHSL_S and OscVisFastDebayerHSL_L. Pixels with a step
+ * of 2 bytes, as in raw images, are converted with SIMD instructions
+ * where available.
+ * 
+ * @param pIn The first pixel.
+ * @param pLayout The layout of the pixels.
+ * @param nPixels Number of pixels.
+ * @param pH Output of the hue or NULL.
+ * @param pS Output of the saturation or NULL.
+ * @param pL Output of the lightness or NULL.
+ *//*********************************************************************/
+void OscVisColorToHSL(const uint8 *pIn,
+		const struct OSC_VIS_COLOR_LAYOUT *pLayout,
+		const uint32 nPixels,
+		uint8 *pH,
+		uint8 *pS,
+		uint8 *pL);
+
 
 
 /*********************************************************************//*!
  * @brief Generic 2D Filter for Grayscale Images * 
  * 
  * A generic 2D filter for grayscale images only. A filter kernel must be provided with this function.
+ * Pixels closer to the border than the kernel reaches are not written.
+ * Kernels that are the product of a row and a column vector, like the
+ * Gauss kernels, are applied as two 1D filters, which is done with SIMD
+ * on the host. A power of two weight is divided by a shift.
  * 
  * @param picIn Pointer to the input grayscale picture struct (type must be OSC_PICTURE_GREYSCALE).
- * @param picOut Pointer to the output picture struct. 
- * @param pTemp Pointer to the temporary data buffer.
+ * @param picOut Pointer to the output picture struct. May have the same data as the input.
+ * @param pTemp Temporary buffer of kernelHeight * width bytes, only used
+ * when filtering in place. May be NULL otherwise.
  * @param pKernel Pointer to the filter kernel struct.
  * @return SUCCESS or an appropriate error code.
  *//*********************************************************************/
 OSC_ERR OscVisFilter2D(struct OSC_PICTURE *picIn, struct OSC_PICTURE *picOut, uint8 *pTemp, struct OSC_VIS_FILTER_KERNEL *pKernel);
 
+/*********************************************************************//*!
+ * @brief Median filter for greyscale images.
+ * 
+ * Every output pixel is the median of the (2 * radius + 1) x (2 * radius
+ * + 1) input pixels around it, which removes salt and pepper noise while
+ * keeping edges. Pixels closer to the border than radius are copied from
+ * the input. The 3x3 and 5x5 medians use sorting networks, larger ones
+ * a histogram method whose time per pixel does not depend on the radius.
+ * On the host the rows are split among threads.
+ * 
+ * @param picIn Pointer to the input grayscale picture struct.
+ * @param picOut Pointer to the output picture struct. Must not have the
+ * same data as the input.
+ * @param radius Pixels from the center to the border of the window, 1 to
+ * OSC_VIS_MAX_MEDIAN_RADIUS.
+ * @return SUCCESS or an appropriate error code.
+ *//*********************************************************************/
+OSC_ERR OscVisMedianFilter(struct OSC_PICTURE *picIn, struct OSC_PICTURE *picOut, const uint8 radius);
+
 
 /*********************************************************************//*!
  * @brief Debayer an image to BGR color format using bilinear debayering.
@@ -33,6 +33,7 @@
 #include <fcntl.h>
 #include <unistd.h>
 #include <errno.h>
+#include <poll.h>
 
 #include "oscar.h"
 
@@ -41,6 +42,9 @@
 /*! @brief The number of incoming connection requests that get queued
  * until calling accept()*/
 #define ACCEPT_WAIT_QUEUE_LEN 5
+/*! @brief The maximum number of asynchronous requests a client may
+ * have outstanding per channel. */
+#define MAX_NR_IPC_PENDING 8
 /*! @brief Path to the temporary sockets used by IPC clients. */
 #define SOCKET_PATH "/tmp/OscIpc"
 /*! @brief File permissions of the server socket file node. */
@@ -49,6 +53,19 @@
 		S_IXGRP | S_IRGRP | S_IWGRP |  \
 		S_IXOTH | S_IROTH | S_IWOTH)
 
+/*! @brief A request submitted by a client and not yet acknowledged. */
+struct OSC_IPC_PENDING
+{
+	/*! @brief Whether a parameter is read or written. */
+	enum EnRequestType enType;
+	/*! @brief The parameter ID of the request. */
+	uint32 paramID;
+	/*! @brief Destination (read) or source (write) of the data. */
+	void *pData;
+	/*! @brief The length of the data. */
+	uint32 paramSize;
+};
+
 /*! @brief Structure representing a full-duplex IPC channel. */
 struct OSC_IPC_CHANNEL
 {
@@ -58,9 +75,21 @@ struct OSC_IPC_CHANNEL
 	char    strSocketPath[256];
 	/*! @brief The flags used when opening that channel. */
 	uint32  flags;
-	/*! @brief Socket returned by accept() and used for communication
-	 * on the server side. */
-	int     acceptedSock;
+	/*! @brief Sockets returned by accept() and used for communication
+	 * on the server side, -1 for unused slots. */
+	int     aryConnSocks[OSC_IPC_MAX_CONNECTIONS];
+	/*! @brief Whether the server holds back the request last received
+	 * on a connection. No further requests are read from it meanwhile. */
+	bool    arybConnHeld[OSC_IPC_MAX_CONNECTIONS];
+	/*! @brief The connection the server is currently talking to. */
+	uint8   curConn;
+	/*! @brief Ring buffer of the outstanding client requests, in the
+	 * order they were submitted. */
+	struct OSC_IPC_PENDING aryPending[MAX_NR_IPC_PENDING];
+	/*! @brief Index of the oldest outstanding request. */
+	uint8   firstPending;
+	/*! @brief The number of outstanding requests. */
+	uint8   nPending;
 };
 
 /*! @brief The different commands used in IPC messages. */
@@ -90,6 +119,9 @@ struct OSC_IPC_MSG
 	 * Target: A pointer to above parameter.
 	 * Host: The size of the parameter. */
 	uint32 paramProp;
+	/*! @brief The size of the parameter on the client side. Only set in
+	 * requests. */
+	uint32 paramSize;
 };
 
 #if defined(OSC_HOST) || defined(OSC_SIM)
@@ -186,4 +218,112 @@ OSC_ERR OscIpcRecvMsg(const OSC_IPC_CHAN_ID chanID,
 OSC_ERR OscIpcSendMsg(const OSC_IPC_CHAN_ID chanID,
 		const struct OSC_IPC_MSG *pMsg);
 
+/*********************************************************************//*!
+ * @brief Wait until the socket of a channel is ready.
+ * 
+ * @param chanID Channel ID of the channel to wait on.
+ * @param events The poll() events to wait for (POLLIN or POLLOUT).
+ * @param timeout Time to wait in milliseconds. 0 returns immediately,
+ * a negative value waits without timeout.
+ * @return SUCCESS if ready, -ENO_MSG_AVAIL if not ready and timeout is
+ * 0, -ETIMEOUT if the timeout expired or -ESOCKET on error.
+ *//*********************************************************************/
+OSC_ERR OscIpcWaitSocket(const OSC_IPC_CHAN_ID chanID,
+		const short events,
+		const int32 timeout);
+
+/*********************************************************************//*!
+ * @brief Receive the next request message on the server side.
+ * 
+ * Accepts new clients and reads from the connections that do not have
+ * a request held back, in turn. The connection the message was read
+ * from becomes the current one, so its data can be received and the
+ * acknowledge sent with OscIpcRecv and OscIpcSend.
+ * 
+ * @param chanID Channel ID of the channel to receive from.
+ * @param pMsg Where to store the message.
+ * @param pConn Where to store the connection the message came from.
+ * @return SUCCESS, -ENO_MSG_AVAIL if no client sent anything or an
+ * appropriate error code otherwise.
+ *//*********************************************************************/
+OSC_ERR OscIpcRecvRequestMsg(const OSC_IPC_CHAN_ID chanID,
+		struct OSC_IPC_MSG *pMsg,
+		uint8 *pConn);
+
+/*********************************************************************//*!
+ * @brief Make a client connection of a server channel the current one.
+ * 
+ * Common validation of OscIpcAckRequest, OscIpcHoldRequest and
+ * OscIpcDropRequest.
+ * 
+ * @param chanID Channel ID of the channel to be used.
+ * @param pRequest The request whose connection is selected.
+ * @return SUCCESS, -EINVALID_PARAMETER or -ESOCKET if the connection
+ * has been closed meanwhile.
+ *//*********************************************************************/
+OSC_ERR OscIpcSelectConnection(const OSC_IPC_CHAN_ID chanID,
+		const struct OSC_IPC_REQUEST *pRequest);
+
+/*********************************************************************//*!
+ * @brief Close a client connection of a server channel.
+ * 
+ * @param chanID Channel ID of the channel.
+ * @param conn The connection to close.
+ *//*********************************************************************/
+void OscIpcCloseConnection(const OSC_IPC_CHAN_ID chanID, const uint8 conn);
+
+/*********************************************************************//*!
+ * @brief Receive a data packet of known length on the client side.
+ * 
+ * Works on blocking and non-blocking channels alike and sleeps in
+ * poll() until all the data has arrived.
+ * 
+ * @param chanID Channel ID of the channel to receive from.
+ * @param pData Where to store incoming data.
+ * @param dataLen The length of the expected data.
+ * @return SUCCESS on success or -ESOCKET if the connection broke.
+ *//*********************************************************************/
+OSC_ERR OscIpcRecvAll(const OSC_IPC_CHAN_ID chanID,
+		void *pData,
+		const uint32 dataLen);
+
+/*********************************************************************//*!
+ * @brief Append a submitted request to the outstanding ones of a
+ * channel.
+ * 
+ * @param chanID Channel ID of the channel the request was sent on.
+ * @param enType Read or write request.
+ * @param pData Data pointer of the request.
+ * @param paramID Parameter ID of the request.
+ * @param paramSize Data length of the request.
+ *//*********************************************************************/
+void OscIpcPushPending(const OSC_IPC_CHAN_ID chanID,
+		const enum EnRequestType enType,
+		void *pData,
+		const uint32 paramID,
+		const uint32 paramSize);
+
+/*********************************************************************//*!
+ * @brief Check an acknowledge message against the oldest outstanding
+ * request and remove that request.
+ * 
+ * @param chanID Channel ID of the channel the message was received on.
+ * @param pMsg The acknowledge message received.
+ * @param pCompletion Filled with the outcome of the request.
+ * @return SUCCESS or -EDEVICE if the message does not match.
+ *//*********************************************************************/
+OSC_ERR OscIpcPopPending(const OSC_IPC_CHAN_ID chanID,
+		const struct OSC_IPC_MSG *pMsg,
+		struct OSC_IPC_COMPLETION *pCompletion);
+
+/*********************************************************************//*!
+ * @brief Validate the arguments of a parameter request submission.
+ * 
+ * @param chanID Channel ID of the channel to be used.
+ * @param pData Data pointer of the request.
+ * @return SUCCESS, -EINVALID_PARAMETER or -EDEVICE_BUSY if too many
+ * requests are outstanding.
+ *//*********************************************************************/
+OSC_ERR OscIpcCheckSubmit(const OSC_IPC_CHAN_ID chanID, const void *pData);
+
 #endif /*IPC_PRIV_H_*/
@@ -25,7 +25,7 @@
 /*! The camera module singelton instance. Declared in ipc_shared.c*/
 extern struct OSC_IPC ipc;
 
-OSC_ERR OscIpcGetParam(const OSC_IPC_CHAN_ID chanID,
+OSC_ERR OscIpcSubmitGetParam(const OSC_IPC_CHAN_ID chanID,
 		void *pData,
 		const uint32 paramID,
 		const uint32 paramSize)
@@ -33,29 +33,19 @@ OSC_ERR OscIpcGetParam(const OSC_IPC_CHAN_ID chanID,
 	struct OSC_IPC_MSG      msg;
 	OSC_ERR                 err;
 
-	msg.enCmd = CMD_RD_PARAM;
-	msg.paramID = paramID;
-	msg.paramProp = (uint32)paramSize;
-
-	/* Input validation */
-	if(unlikely((chanID >= MAX_NR_IPC_CHANNELS) ||
-			(ipc.arybIpcChansBusy[chanID] == FALSE) ||
-			(pData == NULL)))
+	err = OscIpcCheckSubmit(chanID, pData);
+	if(err != SUCCESS)
 	{
-		OscLog(ERROR, "%s(%d, 0x%x, %u, %u): Invalid parameter!\n",
-				__func__, chanID, pData, paramID, paramSize);
-		return -EINVALID_PARAMETER;
+		return err;
 	}
 
-	/* This function only works in blocking mode. */
-	if(unlikely(ipc.aryIpcChans[chanID].flags & F_IPC_NONBLOCKING))
-	{
-		OscLog(ERROR, "%s: Only works in blocking mode!\n", __func__);
-		return -EBLOCKING_MODE_ONLY;
-	}
+	msg.enCmd = CMD_RD_PARAM;
+	msg.paramID = paramID;
+	msg.paramProp = (uint32)paramSize;
+	msg.paramSize = paramSize;
 
-	/* Send the message. The server will write the requested
-	 * data directly to the specified data pointer. */
+	/* Send the message. The server will send the requested data back
+	 * after its acknowledge. */
 	err = OscIpcSendMsg(chanID, &msg);
 	if(err != SUCCESS)
 	{
@@ -64,118 +54,100 @@ OSC_ERR OscIpcGetParam(const OSC_IPC_CHAN_ID chanID,
 				err);
 		return err;
 	}
-	
-	/* Wait for an acknowledge. As long as the server has not opened
-	 * the other side yet, we will receive -ENO_MSG_AVAIL. */
-	do
-	{
-		err = OscIpcRecvMsg(chanID, &msg);
-	} while(err == -ENO_MSG_AVAIL);
-	
+
+	OscIpcPushPending(chanID, REQ_TYPE_READ, pData, paramID, paramSize);
+	return SUCCESS;
+}
+
+OSC_ERR OscIpcSubmitSetParam(const OSC_IPC_CHAN_ID chanID,
+		void *pData,
+		const uint32 paramID,
+		const uint32 paramSize)
+{
+	struct OSC_IPC_MSG      msg;
+	OSC_ERR                 err;
+
+	err = OscIpcCheckSubmit(chanID, pData);
 	if(err != SUCCESS)
 	{
-		OscLog(ERROR, "%s: Error receiving message! (%d)\n",
-				__func__,
-				err);
 		return err;
 	}
-	
-	if(unlikely(msg.enCmd != CMD_RD_PARAM_ACK &&
-			msg.enCmd != CMD_RD_PARAM_NACK))
-	{
-		/* We got the wrong message. */
 
-		OscLog(ERROR, "%s: Received wrong message!\n", __func__);
-		return -EDEVICE;
-	}
+	msg.enCmd = CMD_WR_PARAM;
+	msg.paramID = paramID;
+	msg.paramProp = paramSize;
+	msg.paramSize = paramSize;
 
-	/* Wait for the actual data. As long as the server has not opened
-	 * the other side yet, we will receive -ENO_MSG_AVAIL. */
-	do
-	{
-		err = OscIpcRecv(chanID, pData, paramSize);
-	} while(err == -ENO_MSG_AVAIL);
-	
+	/* Send the message followed by the data to be written. */
+	err = OscIpcSendMsg(chanID, &msg);
 	if(err != SUCCESS)
 	{
-		OscLog(ERROR, "%s: Error receiving data! (%d)\n",
-				__func__,
-				err);
 		return err;
 	}
-	
-	
-	if(likely(msg.enCmd == CMD_RD_PARAM_ACK))
-	{
-		return SUCCESS;
-	}
-	else
+
+	err = OscIpcSend(chanID, pData, paramSize);
+	if(err != SUCCESS)
 	{
-		/* NACK */
-		return -ENEGATIVE_ACKNOWLEDGE;
+		return err;
 	}
-	
+
+	OscIpcPushPending(chanID, REQ_TYPE_WRITE, pData, paramID, paramSize);
+	return SUCCESS;
 }
 
-OSC_ERR OscIpcSetParam(const OSC_IPC_CHAN_ID chanID,
-		void *pData,
-		const uint32 paramID,
-		const uint32 paramSize)
+OSC_ERR OscIpcCompleteParam(const OSC_IPC_CHAN_ID chanID,
+		struct OSC_IPC_COMPLETION *pCompletion,
+		const int32 timeout)
 {
 	struct OSC_IPC_MSG      msg;
+	struct OSC_IPC_PENDING  *pPend;
 	OSC_ERR                 err;
 
-	msg.enCmd = CMD_WR_PARAM;
-	msg.paramID = paramID;
-	msg.paramProp = paramSize;
-
 	/* Input validation */
 	if(unlikely((chanID >= MAX_NR_IPC_CHANNELS) ||
 			(ipc.arybIpcChansBusy[chanID] == FALSE) ||
-			(pData == NULL)))
+			(ipc.aryIpcChans[chanID].nPending == 0) ||
+			(pCompletion == NULL)))
 	{
-		OscLog(ERROR, "%s(%d, 0x%x, %u, %u): Invalid parameter!\n",
-				__func__, chanID, pData, paramID, paramSize);
+		OscLog(ERROR, "%s(%d, 0x%x, %d): Invalid parameter!\n",
+				__func__, chanID, pCompletion, timeout);
 		return -EINVALID_PARAMETER;
 	}
 
-	/* This function only works in blocking mode. */
-	if(unlikely(ipc.aryIpcChans[chanID].flags & F_IPC_NONBLOCKING))
-	{
-		OscLog(ERROR, "%s: Only works in blocking mode!\n", __func__);
-		return -EBLOCKING_MODE_ONLY;
-	}
-
-	/* Send the message. The server will write the requested
-	 * data directly to the specified data pointer. */
-	err = OscIpcSendMsg(chanID, &msg);
+	/* Sleep until the acknowledge starts to arrive. */
+	err = OscIpcWaitSocket(chanID, POLLIN, timeout);
 	if(err != SUCCESS)
 	{
 		return err;
 	}
 
-	err = OscIpcSend(chanID, pData, paramSize);
+	/* The server sends the acknowledge and any data in one go, so the
+	 * rest follows shortly. */
+	err = OscIpcRecvAll(chanID, &msg, sizeof(msg));
 	if(err != SUCCESS)
 	{
+		OscLog(ERROR, "%s: Error receiving message! (%d)\n",
+				__func__,
+				err);
 		return err;
 	}
 
-	/* Wait for an acknowledge. As long as the server has not opened
-	 * the other side yet, we will receive -ENO_MSG_AVAIL. */
-	do
-	{
-		err = OscIpcRecvMsg(chanID, &msg);
-	} while(err == -ENO_MSG_AVAIL);
-
-	if(likely(msg.enCmd == CMD_WR_PARAM_ACK))
+	pPend = &ipc.aryIpcChans[chanID].aryPending[ipc.aryIpcChans[chanID].firstPending];
+	if(pPend->enType == REQ_TYPE_READ &&
+			(msg.enCmd == CMD_RD_PARAM_ACK || msg.enCmd == CMD_RD_PARAM_NACK))
 	{
-		return SUCCESS;
-	}
-	else
-	{
-		/* NACK */
-		return -ENEGATIVE_ACKNOWLEDGE;
+		/* The data follows the acknowledge, in case of a NACK too. */
+		err = OscIpcRecvAll(chanID, pPend->pData, pPend->paramSize);
+		if(err != SUCCESS)
+		{
+			OscLog(ERROR, "%s: Error receiving data! (%d)\n",
+					__func__,
+					err);
+			return err;
+		}
 	}
+
+	return OscIpcPopPending(chanID, &msg, pCompletion);
 }
 
 OSC_ERR OscIpcGetRequest(const OSC_IPC_CHAN_ID chanID,
@@ -195,7 +167,7 @@ OSC_ERR OscIpcGetRequest(const OSC_IPC_CHAN_ID chanID,
 		return -EINVALID_PARAMETER;
 	}
 	
-	err = OscIpcRecvMsg(chanID, &msg);
+	err = OscIpcRecvRequestMsg(chanID, &msg, &pRequest->conn);
 	if(err != SUCCESS)
 	{
 		/* Probably -ENO_MSG_AVAILABLE but may also be a
@@ -215,6 +187,7 @@ OSC_ERR OscIpcGetRequest(const OSC_IPC_CHAN_ID chanID,
 	 * OscIpcAckRequest. */
 	pTempMem->memLen = msg.paramProp;
 	pRequest->pAddr = &pTempMem->data;
+	pRequest->paramSize = msg.paramSize;
 
 	switch(msg.enCmd)
 	{
@@ -240,40 +213,38 @@ OSC_ERR OscIpcGetRequest(const OSC_IPC_CHAN_ID chanID,
 	{
 		usleep(1); /* yield */
 		err = OscIpcRecv(chanID, pRequest->pAddr, pTempMem->memLen);
-	} while(err == -ENO_MSG_AVAIL);
+	} while(err == -ENO_MSG_AVAIL &&
+			ipc.aryIpcChans[chanID].aryConnSocks[pRequest->conn] >= 0);
 
 	if(err != SUCCESS)
 	{
+		/* The client broke off in the middle of its request, there is
+		 * nothing to answer. */
+		err = -ENO_MSG_AVAIL;
 		goto exit_fail;
 	}
 
 	return SUCCESS;
 
 	exit_fail:
+	/* The stream from this client can not be trusted any more. */
+	OscIpcCloseConnection(chanID, pRequest->conn);
 	free(pTempMem);
 	return err;
 }
 
-OSC_ERR OscIpcAckRequest(const OSC_IPC_CHAN_ID chanID,
-		const struct OSC_IPC_REQUEST *pRequest,
-		const bool bSucceeded)
+/*********************************************************************//*!
+ * @brief Recover the memory area allocated by OscIpcGetRequest.
+ * 
+ * @param pRequest The request.
+ * @return The memory area holding the request data.
+ *//*********************************************************************/
+static struct OSC_IPC_PARAM_MEMORY * OscIpcGetParamMemory(
+		const struct OSC_IPC_REQUEST *pRequest)
 {
-	struct OSC_IPC_MSG              msg;
-	struct OSC_IPC_PARAM_MEMORY     *pMem;
-	uint8                           *pTemp;
-	OSC_ERR                         err;
+	struct OSC_IPC_PARAM_MEMORY *pMem;
+	uint8 *pTemp;
 
-	/* Input validation */
-	if(unlikely((chanID >= MAX_NR_IPC_CHANNELS) ||
-			(ipc.arybIpcChansBusy[chanID] == FALSE) ||
-			(pRequest == NULL)))
-	{
-		OscLog(ERROR, "%s(%d, 0x%x, %d): Invalid parameter!\n",
-				__func__, chanID, pRequest, bSucceeded);
-		return -EINVALID_PARAMETER;
-	}
-		
-	err = SUCCESS;
 	/* Recover the struct OSC_IPC_PARAM_MEMORY pointer from the pointer
 	 * to its member data. We need this to know the length of the
 	 * parameter memory area to be able to send it. */
@@ -283,9 +254,35 @@ OSC_ERR OscIpcAckRequest(const OSC_IPC_CHAN_ID chanID,
 	 * This looks ugly but is save to do since the value of sizeof
 	 * is determined at compile time. */
 	pTemp -= sizeof(pMem->memLen);
-	pMem = (struct OSC_IPC_PARAM_MEMORY*)pTemp;
+	return (struct OSC_IPC_PARAM_MEMORY*)pTemp;
+}
+
+OSC_ERR OscIpcAckRequest(const OSC_IPC_CHAN_ID chanID,
+		const struct OSC_IPC_REQUEST *pRequest,
+		const bool bSucceeded)
+{
+	struct OSC_IPC_MSG              msg;
+	struct OSC_IPC_PARAM_MEMORY     *pMem;
+	OSC_ERR                         err;
+
+	/* Input validation */
+	err = OscIpcSelectConnection(chanID, pRequest);
+	if(err == -EINVALID_PARAMETER)
+	{
+		return err;
+	}
+	
+	/* A held request is answered now. */
+	ipc.aryIpcChans[chanID].arybConnHeld[pRequest->conn] = FALSE;
+	pMem = OscIpcGetParamMemory(pRequest);
+	if(err != SUCCESS)
+	{
+		/* The client is already gone. */
+		goto exit;
+	}
 
 	msg.paramProp = 0;
+	msg.paramSize = 0;
 	msg.paramID = pRequest->paramID;
 	if(likely(bSucceeded == TRUE))
 	{
@@ -316,17 +313,11 @@ OSC_ERR OscIpcAckRequest(const OSC_IPC_CHAN_ID chanID,
 		}
 	}
 
-	/* Send the acknowledge. This call may return -ETRY_AGAIN, if
-	 * the client on the other side of the FIFO did not open the
-	 * FIFO for reading yet. We pass it on and leave it to the caller
-	 * to try it again later. */
+	/* Send the acknowledge. If that fails the client is gone and the
+	 * request is released all the same. */
 	err = OscIpcSendMsg(chanID, &msg);
 	if(err != SUCCESS)
 	{
-		if(err != -ETRY_AGAIN)
-		{
-			OscLog(ERROR, "%s: Failed to send acknowledge!\n", __func__);
-		}
 		goto exit;
 	}
 
@@ -345,3 +336,19 @@ exit:
 	free(pMem);
 	return err;
 }
+
+OSC_ERR OscIpcDropRequest(const OSC_IPC_CHAN_ID chanID,
+		const struct OSC_IPC_REQUEST *pRequest)
+{
+	OSC_ERR err;
+
+	err = OscIpcSelectConnection(chanID, pRequest);
+	if(err == -EINVALID_PARAMETER)
+	{
+		return err;
+	}
+
+	free(OscIpcGetParamMemory(pRequest));
+	OscIpcCloseConnection(chanID, pRequest->conn);
+	return SUCCESS;
+}
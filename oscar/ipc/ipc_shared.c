@@ -82,7 +82,7 @@ OSC_ERR OscIpcRegisterChannel(
 {
 	unsigned int        sock;
 	struct sockaddr_un  addr;
-	int                 len, ret, chan;
+	int                 len, ret, chan, i;
 
 	if(unlikely((pIpcChan == NULL) ||
 			(strSocketPath == NULL) || (strSocketPath[0] == '\0')))
@@ -133,6 +133,14 @@ OSC_ERR OscIpcRegisterChannel(
 	}
 	
 	ipc.aryIpcChans[chan].flags = flags;
+	ipc.aryIpcChans[chan].firstPending = 0;
+	ipc.aryIpcChans[chan].nPending = 0;
+	for(i = 0; i < OSC_IPC_MAX_CONNECTIONS; i++)
+	{
+		ipc.aryIpcChans[chan].aryConnSocks[i] = -1;
+		ipc.aryIpcChans[chan].arybConnHeld[i] = FALSE;
+	}
+	ipc.aryIpcChans[chan].curConn = 0;
 	strcpy(ipc.aryIpcChans[chan].strSocketPath, strSocketPath);
 	
 	if(flags & F_IPC_SERVER)
@@ -221,6 +229,7 @@ OSC_ERR OscIpcRegisterChannel(
 OSC_ERR OscIpcUnregisterChannel(OSC_IPC_CHAN_ID chanID)
 {
 	struct OSC_IPC_CHANNEL  *pChan;
+	uint8                   i;
 	
 	pChan = &ipc.aryIpcChans[chanID];
 	
@@ -238,6 +247,10 @@ OSC_ERR OscIpcUnregisterChannel(OSC_IPC_CHAN_ID chanID)
 	/* Delete the file node associated with this channel's socket. */
 	if(pChan->flags & F_IPC_SERVER)
 	{
+		for(i = 0; i < OSC_IPC_MAX_CONNECTIONS; i++)
+		{
+			OscIpcCloseConnection(chanID, i);
+		}
 		unlink(ipc.aryIpcChans[chanID].strSocketPath);
 	}
 	ipc.arybIpcChansBusy[chanID] = FALSE;
@@ -250,64 +263,246 @@ inline OSC_ERR OscIpcRecvMsg(const OSC_IPC_CHAN_ID chanID,
 	return OscIpcRecv(chanID, pMsg, sizeof(struct OSC_IPC_MSG));
 }
 
+/*********************************************************************//*!
+ * @brief Get the socket a channel currently talks over.
+ * 
+ * @param pChan The channel.
+ * @return The current client connection of a server, the socket of a
+ * client.
+ *//*********************************************************************/
+static inline int OscIpcGetSocket(const struct OSC_IPC_CHANNEL *pChan)
+{
+	if(pChan->flags & F_IPC_SERVER)
+	{
+		return pChan->aryConnSocks[pChan->curConn];
+	}
+	return pChan->sock;
+}
+
+void OscIpcCloseConnection(const OSC_IPC_CHAN_ID chanID, const uint8 conn)
+{
+	struct OSC_IPC_CHANNEL  *pChan = &ipc.aryIpcChans[chanID];
+
+	if(pChan->aryConnSocks[conn] >= 0)
+	{
+		close(pChan->aryConnSocks[conn]);
+	}
+	pChan->aryConnSocks[conn] = -1;
+	pChan->arybConnHeld[conn] = FALSE;
+}
+
+/*********************************************************************//*!
+ * @brief Accept pending clients into the free connection slots of a
+ * server channel.
+ * 
+ * A blocking server only waits for a client if it has none, and then
+ * talks to that one alone, just like before there were several.
+ * 
+ * @param chanID Channel ID of the server channel.
+ * @return SUCCESS or -ESOCKET on error.
+ *//*********************************************************************/
+static OSC_ERR OscIpcAcceptConnections(const OSC_IPC_CHAN_ID chanID)
+{
+	struct OSC_IPC_CHANNEL  *pChan = &ipc.aryIpcChans[chanID];
+	struct sockaddr_un      remoteAddr;
+	socklen_t               remoteAddrLen;
+	int                     sock, ret;
+	uint8                   i, nOpen = 0;
+
+	for(i = 0; i < OSC_IPC_MAX_CONNECTIONS; i++)
+	{
+		if(pChan->aryConnSocks[i] >= 0)
+		{
+			nOpen++;
+		}
+	}
+
+	for(i = 0; i < OSC_IPC_MAX_CONNECTIONS; i++)
+	{
+		if(pChan->aryConnSocks[i] >= 0)
+		{
+			continue;
+		}
+		if(!(pChan->flags & F_IPC_NONBLOCKING) && nOpen != 0)
+		{
+			break;
+		}
+
+		remoteAddrLen = sizeof(remoteAddr);
+		sock = accept(pChan->sock,
+				(struct sockaddr*)&remoteAddr,
+				&remoteAddrLen);
+		if(sock < 0)
+		{
+			if(likely((errno == EAGAIN) || (errno == EWOULDBLOCK)))
+			{
+				/* No connection request pending.*/
+				break;
+			}
+			OscLog(ERROR, "%s: Accepting connection failed! (%s)\n",
+					__func__, strerror(errno));
+			return -ESOCKET;
+		}
+
+		if(pChan->flags & F_IPC_NONBLOCKING)
+		{
+			/* Make the file descriptor non-blocking so receive and
+			 * send commands do not block. */
+			ret = fcntl(sock, F_SETFL, O_NONBLOCK);
+			if(ret < 0)
+			{
+				OscLog(ERROR,
+						"%s: Unable to make socket non-blocking! (%s)\n",
+						__func__,
+						strerror(errno));
+				close(sock);
+				return -ESOCKET;
+			}
+		}
+		pChan->aryConnSocks[i] = sock;
+		pChan->arybConnHeld[i] = FALSE;
+		nOpen++;
+	}
+	return SUCCESS;
+}
+
+OSC_ERR OscIpcRecvRequestMsg(const OSC_IPC_CHAN_ID chanID,
+		struct OSC_IPC_MSG *pMsg,
+		uint8 *pConn)
+{
+	struct OSC_IPC_CHANNEL  *pChan = &ipc.aryIpcChans[chanID];
+	OSC_ERR                 err;
+	uint8                   i, conn;
+
+	err = OscIpcAcceptConnections(chanID);
+	if(err != SUCCESS)
+	{
+		return err;
+	}
+
+	/* Start after the connection served last, so a busy client does
+	 * not starve the others. */
+	for(i = 1; i <= OSC_IPC_MAX_CONNECTIONS; i++)
+	{
+		conn = (pChan->curConn + i) % OSC_IPC_MAX_CONNECTIONS;
+		if(pChan->aryConnSocks[conn] < 0 || pChan->arybConnHeld[conn])
+		{
+			continue;
+		}
+
+		pChan->curConn = conn;
+		err = OscIpcRecvMsg(chanID, pMsg);
+		if(err == SUCCESS)
+		{
+			*pConn = conn;
+			return SUCCESS;
+		}
+		if(err != -ENO_MSG_AVAIL)
+		{
+			/* Only this client is affected, drop it and go on. */
+			OscIpcCloseConnection(chanID, conn);
+		}
+	}
+	return -ENO_MSG_AVAIL;
+}
+
+OSC_ERR OscIpcSelectConnection(const OSC_IPC_CHAN_ID chanID,
+		const struct OSC_IPC_REQUEST *pRequest)
+{
+	struct OSC_IPC_CHANNEL  *pChan = &ipc.aryIpcChans[chanID];
+
+	if(unlikely((chanID >= MAX_NR_IPC_CHANNELS) ||
+			(ipc.arybIpcChansBusy[chanID] == FALSE) ||
+			!(pChan->flags & F_IPC_SERVER) ||
+			(pRequest == NULL) ||
+			(pRequest->conn >= OSC_IPC_MAX_CONNECTIONS)))
+	{
+		OscLog(ERROR, "%s(%d, 0x%x): Invalid parameter!\n",
+				__func__, chanID, pRequest);
+		return -EINVALID_PARAMETER;
+	}
+
+	pChan->curConn = pRequest->conn;
+	if(pChan->aryConnSocks[pRequest->conn] < 0)
+	{
+		return -ESOCKET;
+	}
+	return SUCCESS;
+}
+
+OSC_ERR OscIpcHoldRequest(const OSC_IPC_CHAN_ID chanID,
+		const struct OSC_IPC_REQUEST *pRequest)
+{
+	OSC_ERR err;
+
+	err = OscIpcSelectConnection(chanID, pRequest);
+	if(err != SUCCESS)
+	{
+		return err;
+	}
+
+	ipc.aryIpcChans[chanID].arybConnHeld[pRequest->conn] = TRUE;
+	return SUCCESS;
+}
+
+OSC_ERR OscIpcCheckHeldRequest(const OSC_IPC_CHAN_ID chanID,
+		const struct OSC_IPC_REQUEST *pRequest)
+{
+	struct pollfd   pfd;
+	char            c;
+	int             ret;
+	OSC_ERR         err;
+
+	err = OscIpcSelectConnection(chanID, pRequest);
+	if(err != SUCCESS)
+	{
+		return err;
+	}
+
+	pfd.fd = ipc.aryIpcChans[chanID].aryConnSocks[pRequest->conn];
+	pfd.events = POLLIN;
+	pfd.revents = 0;
+	do
+	{
+		ret = poll(&pfd, 1, 0);
+	} while(ret < 0 && errno == EINTR);
+
+	if(unlikely(ret < 0))
+	{
+		OscLog(ERROR, "%s: Polling socket failed! (%s)\n",
+				__func__, strerror(errno));
+		return -ESOCKET;
+	}
+	if(pfd.revents & (POLLERR | POLLHUP | POLLNVAL))
+	{
+		return -ESOCKET;
+	}
+	if(pfd.revents & POLLIN)
+	{
+		/* The client does not send anything while waiting, so the
+		 * socket only gets readable on EOF. */
+		ret = recv(pfd.fd, &c, 1, MSG_PEEK | MSG_DONTWAIT);
+		if(ret == 0 || (ret < 0 && errno != EAGAIN && errno != EWOULDBLOCK))
+		{
+			return -ESOCKET;
+		}
+	}
+	return SUCCESS;
+}
+
 OSC_ERR OscIpcRecv(const OSC_IPC_CHAN_ID chanID,
 		void *pData,
 		const uint32 dataLen)
 {
 	int                     ret;
 	struct OSC_IPC_CHANNEL  *pChan;
-	struct sockaddr_un      remoteAddr;
-	socklen_t               remoteAddrLen;
 	int                     sock;
 	
 	/* No input validation since this is only called by module-internal
 	 * functions. */
 	
 	pChan = &ipc.aryIpcChans[chanID];
-	
-	if(pChan->flags & F_IPC_SERVER)
-	{
-		if(pChan->acceptedSock <= 0)
-		{
-			/* No connected accepted yet. */
-			remoteAddrLen = sizeof(remoteAddr);
-			pChan->acceptedSock = accept(pChan->sock,
-											(struct sockaddr*)&remoteAddr,
-											&remoteAddrLen);
-			if(pChan->acceptedSock < 0)
-			{
-				if(likely((errno == EAGAIN) || (errno == EWOULDBLOCK)))
-				{
-					/* No connection request pending.*/
-					return -ENO_MSG_AVAIL;
-				} else {
-					OscLog(ERROR, "%s: Accepting connection failed! (%s)\n",
-							__func__, strerror(errno));
-					return -ESOCKET;
-				}
-			}
-			
-			if(pChan->flags & F_IPC_NONBLOCKING)
-			{
-				/* Make the file descriptor non-blocking so receive and
-				 * send commands do not block. */
-				ret = fcntl(pChan->acceptedSock,
-						F_SETFL,
-						O_NONBLOCK);
-				if(ret < 0)
-				{
-					OscLog(ERROR,
-							"%s: Unable to make socket non-blocking! (%s)\n",
-							__func__,
-							strerror(errno));
-					return -ESOCKET;
-				}
-			}
-		}
-		sock = pChan->acceptedSock;
-	} else {
-		sock = pChan->sock;
-	}
+	sock = OscIpcGetSocket(pChan);
 	
 	if(pChan->flags & F_IPC_NONBLOCKING)
 	{
@@ -326,10 +521,9 @@ OSC_ERR OscIpcRecv(const OSC_IPC_CHAN_ID chanID,
 				/* No messages waiting */
 				return -ENO_MSG_AVAIL;
 			} else if(errno == 0 && ret == 0) { /* EOF */
-				/* Remote end of socket shut down. Mark it as invalid, so
-				 * the next call will try to accept a new connection. */
-				close(pChan->acceptedSock);
-				pChan->acceptedSock = -1;
+				/* Remote end of socket shut down. Free the slot for
+				 * a new connection. */
+				OscIpcCloseConnection(chanID, pChan->curConn);
 				return -ENO_MSG_AVAIL;
 			} else {
 				OscLog(ERROR, "%s: Reading pending messages failed! (%s)\n",
@@ -352,10 +546,9 @@ OSC_ERR OscIpcRecv(const OSC_IPC_CHAN_ID chanID,
 			/* No messages waiting */
 			return -ENO_MSG_AVAIL;
 		} else if(errno == 0 && ret == 0) { /* EOF */
-			/* Remote end of socket shut down. Mark it as invalid, so
-			 * the next call will try to accept a new connection. */
-			close(pChan->acceptedSock);
-			pChan->acceptedSock = -1;
+			/* Remote end of socket shut down. Free the slot for a new
+			 * connection. */
+			OscIpcCloseConnection(chanID, pChan->curConn);
 			return -ENO_MSG_AVAIL;
 		} else {
 			OscLog(ERROR, "%s: Reading pending messages failed! (%s)\n",
@@ -381,23 +574,20 @@ OSC_ERR OscIpcSend(const OSC_IPC_CHAN_ID chanID,
 	int                     sock;
 	
 	pChan = &ipc.aryIpcChans[chanID];
-	
-	if(pChan->flags & F_IPC_SERVER)
-	{
-		sock = pChan->acceptedSock;
-	} else {
-		sock = pChan->sock;
-	}
+	sock = OscIpcGetSocket(pChan);
 	/* No input validation since this is only called by module-internal
 	 * functions. */
 	while ( dataLen != 0 )
 	{
-		ret = send(sock, pData, dataLen, 0);
+		/* A peer that hung up must not kill us with SIGPIPE. */
+		ret = send(sock, pData, dataLen, MSG_NOSIGNAL);
 		if (unlikely(ret == -1))
 		{
 			if ( errno == EAGAIN )
 			{
-				usleep(5000);
+				/* Sleep until the peer has read enough to make room. */
+				if (OscIpcWaitSocket(chanID, POLLOUT, -1) != SUCCESS)
+					break;
 			} else
 				break;
 		}
@@ -410,12 +600,241 @@ OSC_ERR OscIpcSend(const OSC_IPC_CHAN_ID chanID,
 	
 	if(unlikely(ret == -1))
 	{
+		if((pChan->flags & F_IPC_SERVER) &&
+				(errno == EPIPE || errno == ECONNRESET))
+		{
+			/* The client hung up, free its slot. */
+			OscLog(WARN, "%s: Client hung up before the answer.\n", __func__);
+			OscIpcCloseConnection(chanID, pChan->curConn);
+		} else {
+			OscLog(ERROR, "%s: Sending to remote process failed! (%s)\n",
+					__func__, strerror(errno));
+		}
+		return -ESOCKET;
+	}
+	
+	return SUCCESS;
+}
+
+
+OSC_ERR OscIpcWaitSocket(const OSC_IPC_CHAN_ID chanID,
+		const short events,
+		const int32 timeout)
+{
+	struct OSC_IPC_CHANNEL  *pChan;
+	struct pollfd           pfd;
+	int                     ret;
+
+	pChan = &ipc.aryIpcChans[chanID];
+
+	pfd.fd = OscIpcGetSocket(pChan);
+	pfd.events = events;
+	pfd.revents = 0;
+
+	do
+	{
+		ret = poll(&pfd, 1, timeout);
+	} while(ret < 0 && errno == EINTR);
 
-		OscLog(ERROR, "%s: Sending to remote process failed! (%s)\n",
+	if(unlikely(ret < 0))
+	{
+		OscLog(ERROR, "%s: Waiting on socket failed! (%s)\n",
 				__func__, strerror(errno));
 		return -ESOCKET;
 	}
-	
+	if(ret == 0)
+	{
+		return timeout == 0 ? -ENO_MSG_AVAIL : -ETIMEOUT;
+	}
+	/* Errors and hang-ups are reported by the following read or write. */
+	return SUCCESS;
+}
+
+OSC_ERR OscIpcRecvAll(const OSC_IPC_CHAN_ID chanID,
+		void *pData,
+		const uint32 dataLen)
+{
+	int         sock = ipc.aryIpcChans[chanID].sock;
+	uint8       *pDst = (uint8*)pData;
+	uint32      remaining = dataLen;
+	int         ret;
+	OSC_ERR     err;
+
+	while(remaining != 0)
+	{
+		ret = recv(sock, pDst, remaining, MSG_DONTWAIT);
+		if(ret > 0)
+		{
+			pDst += ret;
+			remaining -= ret;
+		}
+		else if(ret < 0 && (errno == EAGAIN || errno == EWOULDBLOCK ||
+				errno == EINTR))
+		{
+			err = OscIpcWaitSocket(chanID, POLLIN, -1);
+			if(err != SUCCESS)
+			{
+				return err;
+			}
+		}
+		else
+		{
+			OscLog(ERROR, "%s: Connection to server lost! (%s)\n",
+					__func__, ret == 0 ? "EOF" : strerror(errno));
+			return -ESOCKET;
+		}
+	}
+	return SUCCESS;
+}
+
+OSC_ERR OscIpcCheckSubmit(const OSC_IPC_CHAN_ID chanID, const void *pData)
+{
+	if(unlikely((chanID >= MAX_NR_IPC_CHANNELS) ||
+			(ipc.arybIpcChansBusy[chanID] == FALSE) ||
+			(ipc.aryIpcChans[chanID].flags & F_IPC_SERVER) ||
+			(pData == NULL)))
+	{
+		OscLog(ERROR, "%s(%d, 0x%x): Invalid parameter!\n",
+				__func__, chanID, pData);
+		return -EINVALID_PARAMETER;
+	}
+
+	if(unlikely(ipc.aryIpcChans[chanID].nPending == MAX_NR_IPC_PENDING))
+	{
+		OscLog(ERROR, "%s: Too many outstanding requests!\n", __func__);
+		return -EDEVICE_BUSY;
+	}
+	return SUCCESS;
+}
+
+void OscIpcPushPending(const OSC_IPC_CHAN_ID chanID,
+		const enum EnRequestType enType,
+		void *pData,
+		const uint32 paramID,
+		const uint32 paramSize)
+{
+	struct OSC_IPC_CHANNEL  *pChan = &ipc.aryIpcChans[chanID];
+	struct OSC_IPC_PENDING  *pPend;
+
+	pPend = &pChan->aryPending[(pChan->firstPending + pChan->nPending) %
+			MAX_NR_IPC_PENDING];
+	pPend->enType = enType;
+	pPend->paramID = paramID;
+	pPend->pData = pData;
+	pPend->paramSize = paramSize;
+	pChan->nPending++;
+}
+
+OSC_ERR OscIpcPopPending(const OSC_IPC_CHAN_ID chanID,
+		const struct OSC_IPC_MSG *pMsg,
+		struct OSC_IPC_COMPLETION *pCompletion)
+{
+	struct OSC_IPC_CHANNEL  *pChan = &ipc.aryIpcChans[chanID];
+	struct OSC_IPC_PENDING  *pPend = &pChan->aryPending[pChan->firstPending];
+	bool                    bRead = (pPend->enType == REQ_TYPE_READ);
+
+	if(unlikely(pMsg->paramID != pPend->paramID ||
+			(bRead && pMsg->enCmd != CMD_RD_PARAM_ACK &&
+					pMsg->enCmd != CMD_RD_PARAM_NACK) ||
+			(!bRead && pMsg->enCmd != CMD_WR_PARAM_ACK &&
+					pMsg->enCmd != CMD_WR_PARAM_NACK)))
+	{
+		OscLog(ERROR, "%s: Ack did not match to request issued!\n",
+				__func__);
+		return -EDEVICE;
+	}
+
+	pCompletion->enType = pPend->enType;
+	pCompletion->paramID = pPend->paramID;
+	pCompletion->pData = pPend->pData;
+	if(likely(pMsg->enCmd == CMD_RD_PARAM_ACK ||
+			pMsg->enCmd == CMD_WR_PARAM_ACK))
+	{
+		pCompletion->result = SUCCESS;
+	} else {
+		pCompletion->result = -ENEGATIVE_ACKNOWLEDGE;
+	}
+
+	pChan->firstPending = (pChan->firstPending + 1) % MAX_NR_IPC_PENDING;
+	pChan->nPending--;
+	return SUCCESS;
+}
+
+OSC_ERR OscIpcGetPollFd(const OSC_IPC_CHAN_ID chanID, int *pFd)
+{
+	if(unlikely((chanID >= MAX_NR_IPC_CHANNELS) ||
+			(ipc.arybIpcChansBusy[chanID] == FALSE) ||
+			(pFd == NULL)))
+	{
+		OscLog(ERROR, "%s(%d, 0x%x): Invalid parameter!\n",
+				__func__, chanID, pFd);
+		return -EINVALID_PARAMETER;
+	}
+
+	*pFd = OscIpcGetSocket(&ipc.aryIpcChans[chanID]);
 	return SUCCESS;
 }
 
+/*********************************************************************//*!
+ * @brief Submit a request and sleep until it is completed.
+ * 
+ * Common part of OscIpcGetParam and OscIpcSetParam.
+ * 
+ * @param chanID Channel ID of the channel to be used.
+ * @param pData Data pointer of the request.
+ * @param paramID Parameter ID of the request.
+ * @param paramSize Data length of the request.
+ * @param enType Read or write request.
+ * @return SUCCESS, -ENEGATIVE_ACKNOWLEDGE or an appropriate error code.
+ *//*********************************************************************/
+static OSC_ERR OscIpcSyncParam(const OSC_IPC_CHAN_ID chanID,
+		void *pData,
+		const uint32 paramID,
+		const uint32 paramSize,
+		const enum EnRequestType enType)
+{
+	struct OSC_IPC_COMPLETION   completion;
+	OSC_ERR                     err;
+
+	if(unlikely(chanID < MAX_NR_IPC_CHANNELS &&
+			ipc.aryIpcChans[chanID].nPending != 0))
+	{
+		OscLog(ERROR, "%s: Asynchronous requests still outstanding!\n",
+				__func__);
+		return -EDEVICE_BUSY;
+	}
+
+	if(enType == REQ_TYPE_READ)
+	{
+		err = OscIpcSubmitGetParam(chanID, pData, paramID, paramSize);
+	} else {
+		err = OscIpcSubmitSetParam(chanID, pData, paramID, paramSize);
+	}
+	if(err != SUCCESS)
+	{
+		return err;
+	}
+
+	err = OscIpcCompleteParam(chanID, &completion, -1);
+	if(err != SUCCESS)
+	{
+		return err;
+	}
+	return completion.result;
+}
+
+OSC_ERR OscIpcGetParam(const OSC_IPC_CHAN_ID chanID,
+		void *pData,
+		const uint32 paramID,
+		const uint32 paramSize)
+{
+	return OscIpcSyncParam(chanID, pData, paramID, paramSize, REQ_TYPE_READ);
+}
+
+OSC_ERR OscIpcSetParam(const OSC_IPC_CHAN_ID chanID,
+		void *pData,
+		const uint32 paramID,
+		const uint32 paramSize)
+{
+	return OscIpcSyncParam(chanID, pData, paramID, paramSize, REQ_TYPE_WRITE);
+}
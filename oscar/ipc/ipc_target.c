@@ -25,168 +25,104 @@
 /*! The camera module singelton instance. Declared in ipc_shared.c*/
 extern struct OSC_IPC ipc;
 
-OSC_ERR OscIpcGetParam(const OSC_IPC_CHAN_ID chanID,
+/*********************************************************************//*!
+ * @brief Send a request message carrying the address of the data.
+ * 
+ * Common part of OscIpcSubmitGetParam and OscIpcSubmitSetParam. The
+ * server reads or writes the data directly at that address.
+ * 
+ * @param chanID Channel ID of the channel to be used.
+ * @param pData Data pointer of the request.
+ * @param paramID Parameter ID of the request.
+ * @param paramSize Data length of the request.
+ * @param enType Read or write request.
+ * @return SUCCESS on success or an appropriate error code otherwise.
+ *//*********************************************************************/
+static OSC_ERR OscIpcSubmitParam(const OSC_IPC_CHAN_ID chanID,
 		void *pData,
 		const uint32 paramID,
-		const uint32 paramSize)
+		const uint32 paramSize,
+		const enum EnRequestType enType)
 {
 	struct OSC_IPC_MSG      msg;
 	OSC_ERR                 err;
 
-	msg.enCmd = CMD_RD_PARAM;
-	msg.paramID = paramID;
-	msg.paramProp = (uint32)pData;
-
-	/* Input validation */
-	if(unlikely((chanID >= MAX_NR_IPC_CHANNELS) ||
-			(ipc.arybIpcChansBusy[chanID] == FALSE)||
-			(pData == NULL)))
+	err = OscIpcCheckSubmit(chanID, pData);
+	if(err != SUCCESS)
 	{
-		OscLog(ERROR, "%s(%d, 0x%x, %u, %u): Invalid parameter!\n",
-				__func__, pData, paramID, paramSize);
-		return -EINVALID_PARAMETER;
+		return err;
 	}
 
-	/* This function only works in blocking mode. */
-	if(unlikely(ipc.aryIpcChans[chanID].flags & F_IPC_NONBLOCKING))
-	{
-		OscLog(ERROR, "%s: Only works in non-blocking mode!\n", __func__);
-		return -EBLOCKING_MODE_ONLY;
-	}
+	msg.enCmd = (enType == REQ_TYPE_READ) ? CMD_RD_PARAM : CMD_WR_PARAM;
+	msg.paramID = paramID;
+	msg.paramProp = (uint32)pData;
+	msg.paramSize = paramSize;
 
-	/* Send the message. The server will write the requested
-	 * data directly to the specified data pointer. */
 	err = OscIpcSendMsg(chanID, &msg);
 	if(err != SUCCESS)
 	{
-		return err;
-	}
-	
-	/* Wait for an acknowledge. As long as the server has not opened
-	 * the other side yet, we will receive -ENO_MSG_AVAIL. */
-	do
-	{
-		err = OscIpcRecvMsg(chanID, &msg);
-	} while(err == -ENO_MSG_AVAIL);
-	
-	if(err != SUCCESS)
-	{
+		OscLog(ERROR, "%s: Error sending request! (%d)\n",
+				__func__, err);
 		return err;
 	}
 
-	if(likely(msg.enCmd == CMD_RD_PARAM_ACK))
-	{
-		if(likely(msg.paramID == paramID))
-		{
-			return SUCCESS;
-		} else {
-			OscLog(ERROR, "%s: Ack did not match to request issued!\n");
-			return -EDEVICE;
-		}
-	}
-	else if(likely(msg.enCmd == CMD_RD_PARAM_NACK))
-	{
-		if(likely(msg.paramID == paramID))
-		{
-			return -ENEGATIVE_ACKNOWLEDGE;
-		} else {
-			OscLog(ERROR, "%s: Ack did not match to request issued!\n");
-			return -EDEVICE;
-		}
-	}
-	else
-	{
-		/* We got the wrong message, this must not happen. */
-		OscLog(ERROR, "%s: Received no ack!\n", __func__);
-		return -EDEVICE;
-	}
+	OscIpcPushPending(chanID, enType, pData, paramID, paramSize);
+	return SUCCESS;
 }
 
-OSC_ERR OscIpcSetParam(const OSC_IPC_CHAN_ID chanID,
+OSC_ERR OscIpcSubmitGetParam(const OSC_IPC_CHAN_ID chanID,
 		void *pData,
 		const uint32 paramID,
 		const uint32 paramSize)
+{
+	return OscIpcSubmitParam(chanID, pData, paramID, paramSize, REQ_TYPE_READ);
+}
+
+OSC_ERR OscIpcSubmitSetParam(const OSC_IPC_CHAN_ID chanID,
+		void *pData,
+		const uint32 paramID,
+		const uint32 paramSize)
+{
+	return OscIpcSubmitParam(chanID, pData, paramID, paramSize, REQ_TYPE_WRITE);
+}
+
+OSC_ERR OscIpcCompleteParam(const OSC_IPC_CHAN_ID chanID,
+		struct OSC_IPC_COMPLETION *pCompletion,
+		const int32 timeout)
 {
 	struct OSC_IPC_MSG      msg;
 	OSC_ERR                 err;
 
-	msg.enCmd = CMD_WR_PARAM;
-	msg.paramID = paramID;
-	msg.paramProp = (uint32)pData;
-
 	/* Input validation */
 	if(unlikely((chanID >= MAX_NR_IPC_CHANNELS) ||
 			(ipc.arybIpcChansBusy[chanID] == FALSE) ||
-			(pData == NULL)))
+			(ipc.aryIpcChans[chanID].nPending == 0) ||
+			(pCompletion == NULL)))
 	{
-		OscLog(ERROR, "%s(%d, 0x%x, %u, %u): Invalid parameter!\n",
-				__func__, pData, paramID, paramSize);
+		OscLog(ERROR, "%s(%d, 0x%x, %d): Invalid parameter!\n",
+				__func__, chanID, pCompletion, timeout);
 		return -EINVALID_PARAMETER;
 	}
 
-	/* This function only works in blocking mode. */
-	if(unlikely(ipc.aryIpcChans[chanID].flags & F_IPC_NONBLOCKING))
-	{
-		OscLog(ERROR, "%s: Only works in non-blocking mode!\n",
-				__func__);
-		return -EBLOCKING_MODE_ONLY;
-	}
-	
-	/* Send the message. The server will write the requested
-	 * data directly to the specified data pointer. */
-	err = OscIpcSendMsg(chanID, &msg);
+	/* Sleep until the acknowledge arrives. The server has already
+	 * read or written the data by then. */
+	err = OscIpcWaitSocket(chanID, POLLIN, timeout);
 	if(err != SUCCESS)
 	{
-		OscLog(ERROR, "%s: Error sending request! (%d)\n",
-				__func__, err);
 		return err;
 	}
 
-	/* Wait for an acknowledge. As long as the server has not opened
-	 * the other side yet, we will receive -ENO_MSG_AVAIL. */
-	do
-	{
-		err = OscIpcRecvMsg(chanID, &msg);
-	} while(err == -ENO_MSG_AVAIL);
-	
+	err = OscIpcRecvAll(chanID, &msg, sizeof(msg));
 	if(err != SUCCESS)
 	{
 		OscLog(ERROR, "%s: Error receiving acknowledge! (%d)\n",
 				__func__, err);
 		return err;
 	}
-	
-	if(likely(msg.enCmd == CMD_WR_PARAM_ACK))
-	{
-		if(likely(msg.paramID == paramID))
-		{
-			return SUCCESS;
-		} else {
-			OscLog(ERROR, "%s: Ack did not match to request issued!\n");
-			return -EDEVICE;
-		}
-	}
-	else if(likely(msg.enCmd == CMD_WR_PARAM_NACK))
-	{
-		if(likely(msg.paramID == paramID))
-		{
-			return -ENEGATIVE_ACKNOWLEDGE;
-		} else {
-			OscLog(ERROR, "%s: Ack did not match to request issued!\n");
-			return -EDEVICE;
-		}
-	}
-	else
-	{
-		/* We got the wrong message, this must not happen. */
-		OscLog(ERROR, "%s: Received no ack!\n", __func__);
-		return -EDEVICE;
-	}
 
-	return SUCCESS;
+	return OscIpcPopPending(chanID, &msg, pCompletion);
 }
 
-
 OSC_ERR OscIpcGetRequest(const OSC_IPC_CHAN_ID chanID,
 		struct OSC_IPC_REQUEST *pRequest)
 {
@@ -203,7 +139,7 @@ OSC_ERR OscIpcGetRequest(const OSC_IPC_CHAN_ID chanID,
 		return -EINVALID_PARAMETER;
 	}
 		
-	err = OscIpcRecvMsg(chanID, &msg);
+	err = OscIpcRecvRequestMsg(chanID, &msg, &pRequest->conn);
 	if(err != SUCCESS)
 	{
 		/* Probably -ENO_MSG_AVAILABLE but may also be a
@@ -220,10 +156,13 @@ OSC_ERR OscIpcGetRequest(const OSC_IPC_CHAN_ID chanID,
 		pRequest->enType = REQ_TYPE_WRITE;
 		break;
 	default:
-		/* Must not happen. */
+		/* Must not happen. The stream from this client can not be
+		 * trusted any more. */
+		OscIpcCloseConnection(chanID, pRequest->conn);
 		return -EDEVICE;
 	}
 	pRequest->pAddr = (void*)msg.paramProp;
+	pRequest->paramSize = msg.paramSize;
 	pRequest->paramID = msg.paramID;
 
 	return SUCCESS;
@@ -237,17 +176,21 @@ OSC_ERR OscIpcAckRequest(const OSC_IPC_CHAN_ID chanID,
 	OSC_ERR err;
 
 	/* Input validation */
-	if(unlikely((chanID >= MAX_NR_IPC_CHANNELS) ||
-			(ipc.arybIpcChansBusy[chanID] == FALSE) ||
-			(pRequest == NULL)))
+	err = OscIpcSelectConnection(chanID, pRequest);
+	/* A held request is answered now. */
+	if(err != -EINVALID_PARAMETER)
 	{
-		OscLog(ERROR, "%s(%d, 0x%x, %d): Invalid parameter!\n",
-				__func__, chanID, pRequest, bSucceeded);
-		return -EINVALID_PARAMETER;
+		ipc.aryIpcChans[chanID].arybConnHeld[pRequest->conn] = FALSE;
+	}
+	if(err != SUCCESS)
+	{
+		/* Invalid or the client is already gone. */
+		return err;
 	}
 		
 	/* Fill out the acknowledge message structure */
 	msg.paramProp = (uint32)pRequest->pAddr;
+	msg.paramSize = 0;
 	msg.paramID = pRequest->paramID;
 	if(likely(bSucceeded == TRUE))
 	{
@@ -276,20 +219,23 @@ OSC_ERR OscIpcAckRequest(const OSC_IPC_CHAN_ID chanID,
 		}
 	}
 
-	/* Send the acknowledge. This call may return -ETRY_AGAIN, if
-	 * the client on the other side of the FIFO did not open the
-	 * FIFO for reading yet. We pass it on and leave it to the caller
-	 * to try it again later. */
-	err = OscIpcSendMsg(chanID, &msg);
-	if(err != SUCCESS)
+	/* Send the acknowledge. If that fails the client is gone and the
+	 * request is released all the same. */
+	return OscIpcSendMsg(chanID, &msg);
+}
+
+OSC_ERR OscIpcDropRequest(const OSC_IPC_CHAN_ID chanID,
+		const struct OSC_IPC_REQUEST *pRequest)
+{
+	OSC_ERR err;
+
+	err = OscIpcSelectConnection(chanID, pRequest);
+	if(err == -EINVALID_PARAMETER)
 	{
-		if(err != -ETRY_AGAIN)
-		{
-			OscLog(ERROR, "%s: Failed to send acknowledge! (%d)\n",
-					__func__, err);
-		}
 		return err;
 	}
 
+	/* The data lives in the client, nothing to release here. */
+	OscIpcCloseConnection(chanID, pRequest->conn);
 	return SUCCESS;
 }
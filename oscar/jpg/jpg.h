@@ -33,6 +33,48 @@
 
 #define		BLOCK_SIZE				64
 
+/*! @brief Maximum number of threads an encoder encodes slices on. */
+#define		MAX_JPEG_THREADS		16
+
+/*! @brief Upper bound for the encoded size of one block: 11+11 bits for
+ * the DC, 63 times 16+10 bits and an end of block code for the AC
+ * coefficients, doubled for the stuffed zero bytes. */
+#define		MAX_BLOCK_BYTES			420
+
+/*! @brief Fill level at which the data is passed to the sink and the
+ * room left above it for one MCU, a restart marker and the end of the
+ * image. */
+#define		JPEG_CHUNK_SIZE			4096
+#define		JPEG_CHUNK_MARGIN		(6 * MAX_BLOCK_BYTES + 32)
+
+/*! @brief Number of DC and AC symbols of the Huffman tables. The AC
+ * symbols are indexed by run length * 10 + size, with the end of block at
+ * 0 and the run of 16 zeros at 161. */
+#define		DC_SYMBOLS				12
+#define		AC_SYMBOLS				162
+
+typedef struct IMGDATA {
+	int16	Y1 [BLOCK_SIZE];
+	int16	Y2 [BLOCK_SIZE];
+	int16	Y3 [BLOCK_SIZE];
+	int16	Y4 [BLOCK_SIZE];
+	int16	CB [BLOCK_SIZE];
+	int16	CR [BLOCK_SIZE];
+/*	int16	Temp [BLOCK_SIZE];*/
+} IMGDATA;
+
+/*! @brief Divisors of the quantization, with the scale factors of the
+ * DCT folded in. Stored in the transposed order of the DCT output. A
+ * coefficient x is quantized to
+ * sign(x) * ((((|x| + corr) * recip) >> 16) * scale) >> 16. */
+typedef struct DCT_DIVISORS {
+	uint16	recip [BLOCK_SIZE];
+	uint16	corr [BLOCK_SIZE];
+	uint16	scale [BLOCK_SIZE];
+} DCT_DIVISORS;
+
+/*! @brief Encoder context. Holds all the state of one encoder, so several
+ * encoders can run at the same time. */
 typedef struct JPEG_ENCODER_STRUCTURE
 {
 	uint16	mcu_width;
@@ -57,47 +99,150 @@ typedef struct JPEG_ENCODER_STRUCTURE
 
 	int16 debug_pass;
 
+	/*! @brief Quantization tables in row order before scaling by the
+	 * quality factor. */
+	uint8	Lbase [BLOCK_SIZE];
+	uint8	Cbase [BLOCK_SIZE];
+	/*! @brief The quality factor Lqt, Cqt and the divisors were computed
+	 * for, if tables_valid is set. */
+	uint32	tables_quality;
+	bool	tables_valid;
+
+	/*! @brief Quantization tables in zigzag order as written to the DQT marker. */
+	uint8	Lqt [BLOCK_SIZE];
+	uint8	Cqt [BLOCK_SIZE];
+	/*! @brief Divisors for the quantization tables. */
+	DCT_DIVISORS	Ldiv;
+	DCT_DIVISORS	Cdiv;
+
+	/*! @brief Huffman codes and their lengths, [0] for the luminance and
+	 * [1] for the chrominance. */
+	uint16	dc_code [2][DC_SYMBOLS];
+	uint16	dc_size [2][DC_SYMBOLS];
+	uint16	ac_code [2][AC_SYMBOLS];
+	uint16	ac_size [2][AC_SYMBOLS];
+	/*! @brief Set if the Huffman tables are not the standard ones. The
+	 * contents of their DHT marker then are the number of codes per length
+	 * and the symbols, in the order luminance DC, chrominance DC, luminance
+	 * AC, chrominance AC. */
+	bool	huffman_custom;
+	uint8	dht_bits [4][16];
+	uint8	dht_values [4][AC_SYMBOLS];
+	uint16	dht_count [4];
+
+	/*! @brief How the Huffman tables are chosen. */
+	enum EnOscJpgHuffmanMode huffman_mode;
+	/*! @brief Count the symbols while encoding. */
+	bool	count_symbols;
+	/*! @brief Set once the counts hold the symbols of a whole image. */
+	bool	have_symbol_counts;
+	uint32	dc_count [2][DC_SYMBOLS];
+	uint32	ac_count [2][AC_SYMBOLS];
+
+	/*! @brief Bits not yet written to the output. */
+	uint32	lcode;
+	/*! @brief Number of valid bits in lcode. */
+	uint16	bitindex;
+
+	/*! @brief The blocks of the MCU being encoded. */
+	IMGDATA	image;
+	/*! @brief The quantized coefficients of the block being encoded. */
+	uint16	Temp [BLOCK_SIZE];
+
+	/*! @brief Reads one MCU of the input format into image. */
+	void (*read_format) (IMGDATA *img, struct JPEG_ENCODER_STRUCTURE *jpeg_encoder_structure, uint8 *input_ptr);
+	/*! @brief Codes one quantized block, huffman or gather_symbols. */
+	uint8* (*code_block) (struct JPEG_ENCODER_STRUCTURE *jpeg_encoder_structure, uint16 component, uint8 *output_ptr, uint16 *Temp);
+
+	/*! @brief Chroma sampling used for colour sources (YUV 4:4:4, 4:2:2
+	 * or 4:2:0). */
+	uint32	sampling;
+	/*! @brief Colour source read by read_color_format or NULL if the
+	 * input is already in the sampling format of the JPEG. */
+	uint8	*src;
+	/*! @brief Size of the colour source in output pixels. */
+	uint16	src_width;
+	uint16	src_height;
+	/*! @brief Bytes between two output rows of the colour source. */
+	uint32	src_ystep;
+	/*! @brief Where the colours of an output pixel are. */
+	struct OSC_VIS_COLOR_LAYOUT src_layout;
+	/*! @brief Position of the MCU being read in output pixels. */
+	uint16	mcu_x;
+	uint16	mcu_y;
+
+	/*! @brief The input data for the read functions of the YUV formats
+	 * and its size per MCU row. */
+	uint8	*input;
+	uint32	input_row_size;
+
+	/*! @brief MCU rows per restart interval as configured, 0 for none. */
+	uint16	restart_rows;
+	/*! @brief MCU rows per slice, the number of slices and the restart
+	 * interval in MCUs of the image being encoded. */
+	uint16	slice_rows;
+	uint16	slices;
+	uint16	restart_interval;
+
+	/*! @brief Number of threads to encode the slices on. */
+	uint16	threads;
+	/*! @brief The threads and buffers for the slices, host only. */
+	struct JPEG_SLICE_POOL *pool;
+
+	/*! @brief Receives the encoded data, NULL to write it to the output
+	 * buffer directly. */
+	OSC_JPG_SINK sink;
+	void	*sink_context;
+	/*! @brief Buffer for the data passed to the sink. */
+	uint8	*chunk;
+	/*! @brief Number of bytes passed to the sink. */
+	uint32	sink_bytes;
+	/*! @brief The reason the encoding was aborted. */
+	OSC_ERR	error;
+
+	/*! @brief Size per image the rate control aims for, 0 if off. */
+	uint32	target_bytes;
+	/*! @brief Encode an image a second time if it exceeds the target. */
+	bool	reencode;
+	/*! @brief Size of the markers of the last image, EOI included. */
+	uint16	marker_bytes;
+	/*! @brief Size and quality of the last image, which the rate control
+	 * bases the quality of the next one on. */
+	struct OSC_JPG_ENCODER_STATS stats;
 } JPEG_ENCODER_STRUCTURE;
 
-extern uint8	Lqt [BLOCK_SIZE];
-extern uint8	Cqt [BLOCK_SIZE];
-extern uint16	ILqt [BLOCK_SIZE];
-extern uint16	ICqt [BLOCK_SIZE];
-
-typedef struct IMGDATA {
-	int16	Y1 [BLOCK_SIZE];
-	int16	Y2 [BLOCK_SIZE];
-	int16	Y3 [BLOCK_SIZE];
-	int16	Y4 [BLOCK_SIZE];
-	int16	CB [BLOCK_SIZE];
-	int16	CR [BLOCK_SIZE];
-/*	int16	Temp [BLOCK_SIZE];*/
-} IMGDATA;
-
-extern uint32 lcode;
-extern uint16 bitindex;
+/*! @brief Zigzag position of the coefficients in row order. */
+extern uint8 zigzag_table [];
 
 /*======================= Private methods ==============================*/
 void initialization (JPEG_ENCODER_STRUCTURE *, uint32, uint32, uint32);
-
-uint16 DSP_Division (uint32, uint32);
-void initialize_quantization_tables (uint32);
-
-uint8* write_markers (uint8 *, uint32, uint32, uint32);
-
+void set_quantization_base (JPEG_ENCODER_STRUCTURE *, const uint8 *, const uint8 *);
+void initialize_quantization_tables (JPEG_ENCODER_STRUCTURE *, uint32);
+uint8* write_markers (JPEG_ENCODER_STRUCTURE *, uint8 *, uint32, uint32, uint32);
 void read_400_format (IMGDATA *img, JPEG_ENCODER_STRUCTURE *, uint8 *);
 void read_420_format (IMGDATA *img, JPEG_ENCODER_STRUCTURE *, uint8 *);
 void read_422_format (IMGDATA *img, JPEG_ENCODER_STRUCTURE *, uint8 *);
 void read_444_format (IMGDATA *img, JPEG_ENCODER_STRUCTURE *, uint8 *);
-void BGR_2_444 (uint8 *, uint8 *, uint32, uint32);
-
+void read_color_format (IMGDATA *img, JPEG_ENCODER_STRUCTURE *, uint8 *);
 uint8* encodeMCU (JPEG_ENCODER_STRUCTURE *, uint32, uint8 *);
-
-void levelshift (int16 *);
-void DCT (int16 *);
-void quantization (int16 *, uint16 *, uint16 *);
+void DCT_quantization (int16 *, const DCT_DIVISORS *, uint16 *);
 uint8* huffman (JPEG_ENCODER_STRUCTURE *, uint16, uint8 *, uint16 *);
-
-uint8* close_bitstream (uint8 *);
+uint8* gather_symbols (JPEG_ENCODER_STRUCTURE *, uint16, uint8 *, uint16 *);
+void set_standard_huffman_tables (JPEG_ENCODER_STRUCTURE *);
+void build_huffman_tables (JPEG_ENCODER_STRUCTURE *, bool);
+void clear_symbol_counts (JPEG_ENCODER_STRUCTURE *);
+void add_symbol_counts (JPEG_ENCODER_STRUCTURE *, const JPEG_ENCODER_STRUCTURE *);
+uint8* flush_bitstream (JPEG_ENCODER_STRUCTURE *, uint8 *);
+uint8* close_bitstream (JPEG_ENCODER_STRUCTURE *, uint8 *);
+uint8* encode_slice (JPEG_ENCODER_STRUCTURE *, uint32, uint16, uint8 *);
+uint8* encode_slices_sequential (JPEG_ENCODER_STRUCTURE *, uint32, uint8 *);
+uint8* write_restart_marker (uint8 *, uint16);
+uint8* encode_slices (JPEG_ENCODER_STRUCTURE *, uint32, uint8 *);
+uint8* flush_chunk (JPEG_ENCODER_STRUCTURE *, uint8 *);
+uint8* write_slice_data (JPEG_ENCODER_STRUCTURE *, uint8 *, const uint8 *, uint32);
+void destroy_slice_pool (JPEG_ENCODER_STRUCTURE *);
+uint32 rate_control_quality (JPEG_ENCODER_STRUCTURE *, uint32);
+bool rate_control_retry (JPEG_ENCODER_STRUCTURE *, uint32, uint32, uint32 *);
+void rate_control_update (JPEG_ENCODER_STRUCTURE *, uint32, uint32, uint16);
 #
 #endif /*JPG_PRIV_H_*/
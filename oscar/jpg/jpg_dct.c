@@ -17,104 +17,235 @@
 	Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
 */
 
-#include "jpg.h"
+/*
+ * Forward DCT after Arai, Agui and Nakajima (AAN) followed by the
+ * quantization. The AAN DCT needs 5 multiplications per 8 samples, but
+ * its outputs are scaled by a different factor for each coefficient.
+ * These factors are folded into the quantization divisors, see
+ * initialize_quantization_tables.
+ *
+ * All arithmetic is done on 16 bit values. A multiplication by a
+ * constant c < 1 is (2 * x * (c << 15)) >> 16, which is what the SSE2
+ * pmulhw instruction computes on 8 values at once. The scalar version
+ * does exactly the same and gives bit identical results, so the host
+ * produces the same JPEG files as the target.
+ *
+ * The column transform is done first, followed by the row transform. In
+ * the SSE2 version, which transposes once in between, the coefficients
+ * come out transposed (horizontal frequency first).
+ */
 
-/* Level shifting to get 8 bit SIGNED values for the data  */
-void levelshift (int16* const data)
-{
-	int16 i;
+#include "jpg.h"
 
-	for (i=63; i>=0; i--)
-		data [i] -= 128;
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+/* The constants of the AAN DCT in Q.15. */
+#define FIX_0_382683433		12540
+#define FIX_0_541196100		17734
+#define FIX_0_707106781		23170
+#define FIX_0_306562965		10045	/* 1.306562965 - 1 */
+
+#ifdef __SSE2__
+
+/* Multiplication by a Q.15 constant. */
+#define MULTIPLY(x, c)	_mm_mulhi_epi16 (_mm_slli_epi16 ((x), 1), (c))
+
+/* One pass of the AAN DCT, on 8 vectors of 8 samples each. */
+#define AAN_PASS(d) \
+{ \
+	__m128i tmp0, tmp1, tmp2, tmp3, tmp4, tmp5, tmp6, tmp7; \
+	__m128i tmp10, tmp11, tmp12, tmp13, z1, z2, z3, z4, z5, z11, z13; \
+\
+	tmp0 = _mm_add_epi16 (d [0], d [7]); \
+	tmp7 = _mm_sub_epi16 (d [0], d [7]); \
+	tmp1 = _mm_add_epi16 (d [1], d [6]); \
+	tmp6 = _mm_sub_epi16 (d [1], d [6]); \
+	tmp2 = _mm_add_epi16 (d [2], d [5]); \
+	tmp5 = _mm_sub_epi16 (d [2], d [5]); \
+	tmp3 = _mm_add_epi16 (d [3], d [4]); \
+	tmp4 = _mm_sub_epi16 (d [3], d [4]); \
+\
+	/* Even part */ \
+	tmp10 = _mm_add_epi16 (tmp0, tmp3); \
+	tmp13 = _mm_sub_epi16 (tmp0, tmp3); \
+	tmp11 = _mm_add_epi16 (tmp1, tmp2); \
+	tmp12 = _mm_sub_epi16 (tmp1, tmp2); \
+\
+	d [0] = _mm_add_epi16 (tmp10, tmp11); \
+	d [4] = _mm_sub_epi16 (tmp10, tmp11); \
+\
+	z1 = MULTIPLY (_mm_add_epi16 (tmp12, tmp13), c0707); \
+	d [2] = _mm_add_epi16 (tmp13, z1); \
+	d [6] = _mm_sub_epi16 (tmp13, z1); \
+\
+	/* Odd part */ \
+	tmp10 = _mm_add_epi16 (tmp4, tmp5); \
+	tmp11 = _mm_add_epi16 (tmp5, tmp6); \
+	tmp12 = _mm_add_epi16 (tmp6, tmp7); \
+\
+	z5 = MULTIPLY (_mm_sub_epi16 (tmp10, tmp12), c0382); \
+	z2 = _mm_add_epi16 (MULTIPLY (tmp10, c0541), z5); \
+	z4 = _mm_add_epi16 (_mm_add_epi16 (MULTIPLY (tmp12, c0306), tmp12), z5); \
+	z3 = MULTIPLY (tmp11, c0707); \
+\
+	z11 = _mm_add_epi16 (tmp7, z3); \
+	z13 = _mm_sub_epi16 (tmp7, z3); \
+\
+	d [5] = _mm_add_epi16 (z13, z2); \
+	d [3] = _mm_sub_epi16 (z13, z2); \
+	d [1] = _mm_add_epi16 (z11, z4); \
+	d [7] = _mm_sub_epi16 (z11, z4); \
 }
 
-/* DCT for One block(8x8) */
-void DCT (int16 *data)
+void DCT_quantization (int16 *data, const DCT_DIVISORS *divisors, uint16 *Temp)
 {
-	uint16 i;
-	int32 x0, x1, x2, x3, x4, x5, x6, x7, x8;
-
-/*	All values are shifted left by 10
-	and rounded off to nearest integer */
-
-	static const uint16 c1=1420;	/* cos PI/16 * root(2)	*/
-	static const uint16 c2=1338;	/* cos PI/8 * root(2)	*/
-	static const uint16 c3=1204;	/* cos 3PI/16 * root(2)	*/
-	static const uint16 c5=805;		/* cos 5PI/16 * root(2)	*/
-	static const uint16 c6=554;		/* cos 3PI/8 * root(2)	*/
-	static const uint16 c7=283;		/* cos 7PI/16 * root(2)	*/
-
-	static const uint16 s1=3;
-	static const uint16 s2=10;
-	static const uint16 s3=13;
+	const __m128i c0382 = _mm_set1_epi16 (FIX_0_382683433);
+	const __m128i c0541 = _mm_set1_epi16 (FIX_0_541196100);
+	const __m128i c0707 = _mm_set1_epi16 (FIX_0_707106781);
+	const __m128i c0306 = _mm_set1_epi16 (FIX_0_306562965);
+	const __m128i c128 = _mm_set1_epi16 (128);
+	__m128i d [8], t [8];
+	int16 coeff [BLOCK_SIZE];
+	int16 i;
 
-	for (i=8; i>0; i--)
+	/* Load the rows and level shift them. */
+	for (i=0; i<8; i++)
+		d [i] = _mm_sub_epi16 (_mm_loadu_si128 ((__m128i *) (data + 8*i)), c128);
+
+	/* Columns */
+	AAN_PASS (d);
+
+	/* Transpose, so the rows are in the lanes. */
+	t [0] = _mm_unpacklo_epi16 (d [0], d [1]);
+	t [1] = _mm_unpackhi_epi16 (d [0], d [1]);
+	t [2] = _mm_unpacklo_epi16 (d [2], d [3]);
+	t [3] = _mm_unpackhi_epi16 (d [2], d [3]);
+	t [4] = _mm_unpacklo_epi16 (d [4], d [5]);
+	t [5] = _mm_unpackhi_epi16 (d [4], d [5]);
+	t [6] = _mm_unpacklo_epi16 (d [6], d [7]);
+	t [7] = _mm_unpackhi_epi16 (d [6], d [7]);
+
+	d [0] = _mm_unpacklo_epi32 (t [0], t [2]);
+	d [1] = _mm_unpackhi_epi32 (t [0], t [2]);
+	d [2] = _mm_unpacklo_epi32 (t [1], t [3]);
+	d [3] = _mm_unpackhi_epi32 (t [1], t [3]);
+	d [4] = _mm_unpacklo_epi32 (t [4], t [6]);
+	d [5] = _mm_unpackhi_epi32 (t [4], t [6]);
+	d [6] = _mm_unpacklo_epi32 (t [5], t [7]);
+	d [7] = _mm_unpackhi_epi32 (t [5], t [7]);
+
+	t [0] = _mm_unpacklo_epi64 (d [0], d [4]);
+	t [1] = _mm_unpackhi_epi64 (d [0], d [4]);
+	t [2] = _mm_unpacklo_epi64 (d [1], d [5]);
+	t [3] = _mm_unpackhi_epi64 (d [1], d [5]);
+	t [4] = _mm_unpacklo_epi64 (d [2], d [6]);
+	t [5] = _mm_unpackhi_epi64 (d [2], d [6]);
+	t [6] = _mm_unpacklo_epi64 (d [3], d [7]);
+	t [7] = _mm_unpackhi_epi64 (d [3], d [7]);
+
+	/* Rows */
+	AAN_PASS (t);
+
+	/* Quantize: sign (((|x| + corr) * recip) >> 16) * scale) >> 16) */
+	for (i=0; i<8; i++)
 	{
-		x8 = data [0] + data [7];
-		x0 = data [0] - data [7];
-
-		x7 = data [1] + data [6];
-		x1 = data [1] - data [6];
-
-		x6 = data [2] + data [5];
-		x2 = data [2] - data [5];
-
-		x5 = data [3] + data [4];
-		x3 = data [3] - data [4];
-
-		x4 = x8 + x5;
-		x8 -= x5;
-
-		x5 = x7 + x6;
-		x7 -= x6;
-
-		data [0] = (int16) (x4 + x5);
-		data [4] = (int16) (x4 - x5);
-
-		data [2] = (int16) ((x8*c2 + x7*c6) >> s2);
-		data [6] = (int16) ((x8*c6 - x7*c2) >> s2);
-
-		data [7] = (int16) ((x0*c7 - x1*c5 + x2*c3 - x3*c1) >> s2);
-		data [5] = (int16) ((x0*c5 - x1*c1 + x2*c7 + x3*c3) >> s2);
-		data [3] = (int16) ((x0*c3 - x1*c7 - x2*c1 - x3*c5) >> s2);
-		data [1] = (int16) ((x0*c1 + x1*c3 + x2*c5 + x3*c7) >> s2);
-
-		data += 8;
+		__m128i sign, value;
+
+		sign = _mm_srai_epi16 (t [i], 15);
+		value = _mm_sub_epi16 (_mm_xor_si128 (t [i], sign), sign);
+		value = _mm_add_epi16 (value, _mm_loadu_si128 ((__m128i *) (divisors->corr + 8*i)));
+		value = _mm_mulhi_epu16 (value, _mm_loadu_si128 ((__m128i *) (divisors->recip + 8*i)));
+		value = _mm_mulhi_epu16 (value, _mm_loadu_si128 ((__m128i *) (divisors->scale + 8*i)));
+		value = _mm_sub_epi16 (_mm_xor_si128 (value, sign), sign);
+		_mm_storeu_si128 ((__m128i *) (coeff + 8*i), value);
 	}
 
-	data -= 64;
-
-	for (i=8; i>0; i--)
-	{
-		x8 = data [0] + data [56];
-		x0 = data [0] - data [56];
+	for (i=0; i<64; i++)
+		Temp [zigzag_table [((i & 7) << 3) | (i >> 3)]] = (uint16) coeff [i];
+}
 
-		x7 = data [8] + data [48];
-		x1 = data [8] - data [48];
+#else /* __SSE2__ */
 
-		x6 = data [16] + data [40];
-		x2 = data [16] - data [40];
+/* Multiplication by a Q.15 constant, like pmulhw on a doubled value. */
+#define MULTIPLY(x, c)	((int16) ((((int32) (int16) ((x) << 1)) * (c)) >> 16))
 
-		x5 = data [24] + data [32];
-		x3 = data [24] - data [32];
+/* One pass of the AAN DCT over 8 samples, step elements apart. */
+static inline void AAN_pass (int16 *d, int16 step)
+{
+	int16 tmp0, tmp1, tmp2, tmp3, tmp4, tmp5, tmp6, tmp7;
+	int16 tmp10, tmp11, tmp12, tmp13, z1, z2, z3, z4, z5, z11, z13;
+
+	tmp0 = d [0] + d [7*step];
+	tmp7 = d [0] - d [7*step];
+	tmp1 = d [step] + d [6*step];
+	tmp6 = d [step] - d [6*step];
+	tmp2 = d [2*step] + d [5*step];
+	tmp5 = d [2*step] - d [5*step];
+	tmp3 = d [3*step] + d [4*step];
+	tmp4 = d [3*step] - d [4*step];
+
+	/* Even part */
+	tmp10 = tmp0 + tmp3;
+	tmp13 = tmp0 - tmp3;
+	tmp11 = tmp1 + tmp2;
+	tmp12 = tmp1 - tmp2;
+
+	d [0] = tmp10 + tmp11;
+	d [4*step] = tmp10 - tmp11;
+
+	z1 = MULTIPLY (tmp12 + tmp13, FIX_0_707106781);
+	d [2*step] = tmp13 + z1;
+	d [6*step] = tmp13 - z1;
+
+	/* Odd part */
+	tmp10 = tmp4 + tmp5;
+	tmp11 = tmp5 + tmp6;
+	tmp12 = tmp6 + tmp7;
+
+	z5 = MULTIPLY (tmp10 - tmp12, FIX_0_382683433);
+	z2 = MULTIPLY (tmp10, FIX_0_541196100) + z5;
+	z4 = MULTIPLY (tmp12, FIX_0_306562965) + tmp12 + z5;
+	z3 = MULTIPLY (tmp11, FIX_0_707106781);
+
+	z11 = tmp7 + z3;
+	z13 = tmp7 - z3;
+
+	d [5*step] = z13 + z2;
+	d [3*step] = z13 - z2;
+	d [step] = z11 + z4;
+	d [7*step] = z11 - z4;
+}
 
-		x4 = x8 + x5;
-		x8 -= x5;
+void DCT_quantization (int16 *data, const DCT_DIVISORS *divisors, uint16 *Temp)
+{
+	int16 i, t, coeff;
+	uint32 value;
 
-		x5 = x7 + x6;
-		x7 -= x6;
+	for (i=0; i<64; i++)
+		data [i] -= 128;
 
-		data [0] = (int16) ((x4 + x5) >> s1);
-		data [32] = (int16) ((x4 - x5) >> s1);
+	/* Columns */
+	for (i=0; i<8; i++)
+		AAN_pass (data + i, 8);
 
-		data [16] = (int16) ((x8*c2 + x7*c6) >> s3);
-		data [48] = (int16) ((x8*c6 - x7*c2) >> s3);
+	/* Rows */
+	for (i=0; i<8; i++)
+		AAN_pass (data + 8*i, 1);
 
-		data [56] = (int16) ((x0*c7 - x1*c5 + x2*c3 - x3*c1) >> s3);
-		data [40] = (int16) ((x0*c5 - x1*c1 + x2*c7 + x3*c3) >> s3);
-		data [24] = (int16) ((x0*c3 - x1*c7 - x2*c1 - x3*c5) >> s3);
-		data [8] = (int16) ((x0*c1 + x1*c3 + x2*c5 + x3*c7) >> s3);
+	/* Quantize: sign (((|x| + corr) * recip) >> 16) * scale) >> 16).
+	 * The divisors are stored transposed. */
+	for (i=0; i<64; i++)
+	{
+		t = (int16) (((i & 7) << 3) | (i >> 3));
+		coeff = data [i];
+		value = (uint16) ((coeff < 0 ? -coeff : coeff) + divisors->corr [t]);
+		value = (value * divisors->recip [t]) >> 16;
+		value = (value * divisors->scale [t]) >> 16;
 
-		data++;
+		Temp [zigzag_table [i]] = (uint16) (coeff < 0 ? -(int16) value : (int16) value);
 	}
 }
+
+#endif /* __SSE2__ */
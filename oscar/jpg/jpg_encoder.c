@@ -26,18 +26,8 @@
 
 #include "jpg.h"
 
-uint8	Lqt [BLOCK_SIZE];
-uint8	Cqt [BLOCK_SIZE];
-uint16	ILqt [BLOCK_SIZE];
-uint16	ICqt [BLOCK_SIZE];
-
-struct IMGDATA *Image=NULL; /* Singleton */
-JPEG_ENCODER_STRUCTURE *JpegStruct = NULL /* Singleton */;
-uint32 lcode = 0;
-uint16 bitindex = 0; 
-uint16  Temp [BLOCK_SIZE];
-
-void (*read_format) (IMGDATA *img, JPEG_ENCODER_STRUCTURE *jpeg_encoder_structure, uint8 *input_ptr);
+/*! @brief The encoder used by OscJpgEncode. Created on first use. */
+static JPEG_ENCODER_STRUCTURE *DefaultEncoder = NULL;
 
 void initialization (JPEG_ENCODER_STRUCTURE *jpeg, uint32 image_format, uint32 image_width, uint32 image_height)
 {
@@ -46,27 +36,31 @@ void initialization (JPEG_ENCODER_STRUCTURE *jpeg, uint32 image_format, uint32 i
 	/* RB there was a bug in the original code that bitindex and lcode were not initialized at
 	 * the second time
  	 */
-	bitindex = 0; 
-	lcode=0;
+	jpeg->bitindex = 0; 
+	jpeg->lcode=0;
 
 	jpeg->debug_pass = 0; 
 
 	switch (image_format) 
 	{
 	case OSC_PICTURE_YUV_444:
-		read_format = read_444_format;
+		jpeg->read_format = read_444_format;
 		break;
 	case OSC_PICTURE_YUV_422:
-		read_format = read_422_format;
+		jpeg->read_format = read_422_format;
 		break;
 	case OSC_PICTURE_YUV_420:
-		read_format = read_420_format;
+		jpeg->read_format = read_420_format;
 		break;
 	case OSC_PICTURE_YUV_400:
-		read_format = read_400_format;
+		jpeg->read_format = read_400_format;
 		break;
 	}
 
+	/* Colour sources are converted MCU by MCU. */
+	if (jpeg->src != NULL)
+		jpeg->read_format = read_color_format;
+
 	bytes_per_pixel = OSC_PICTURE_TYPE_COLOR_DEPTH(image_format)/8;
 
 	if (image_format == OSC_PICTURE_YUV_400|| 
@@ -115,57 +109,195 @@ void initialization (JPEG_ENCODER_STRUCTURE *jpeg, uint32 image_format, uint32 i
 	jpeg->ldc3 = 0;
 }
 
-uint8* OscJpgEncode(struct OSC_PICTURE *pic, uint8 *output_ptr, uint32 quality_factor)
+OSC_ERR OscJpgCreateEncoder(void **phEncoder)
 {
-	uint16 i, j;
-	uint8 *input_ptr = (uint8 *)pic->data;
+	JPEG_ENCODER_STRUCTURE *jpeg;
 
-	JPEG_ENCODER_STRUCTURE *jpeg_encoder_structure;
+	if (unlikely(phEncoder == NULL))
+	{
+		OscLog(ERROR, "%s(0x%x): Invalid parameter!\n", __func__, phEncoder);
+		return -EINVALID_PARAMETER;
+	}
 
-	if (Image==NULL) {
-		Image = malloc(sizeof(struct IMGDATA));	
-		if (Image == NULL)
-			OscFatalErr("Could not allocate memory\n");
+	jpeg = malloc(sizeof(JPEG_ENCODER_STRUCTURE));
+	if (jpeg == NULL)
+	{
+		OscLog(ERROR, "%s: Could not allocate memory!\n", __func__);
+		return -EOUT_OF_MEMORY;
 	}
+	memset(jpeg, 0, sizeof(JPEG_ENCODER_STRUCTURE));
+	jpeg->sampling = OSC_PICTURE_YUV_444;
+	jpeg->threads = 1;
+	set_quantization_base (jpeg, NULL, NULL);
+	set_standard_huffman_tables (jpeg);
+	jpeg->code_block = huffman;
+
+	*phEncoder = jpeg;
+	return SUCCESS;
+}
 
-	if (JpegStruct==NULL) {
-		JpegStruct= malloc(sizeof(JPEG_ENCODER_STRUCTURE));	
-		if (JpegStruct == NULL)
-			OscFatalErr("Could not allocate memory\n");
+OSC_ERR OscJpgDestroyEncoder(void *hEncoder)
+{
+	if (unlikely(hEncoder == NULL))
+	{
+		OscLog(ERROR, "%s(0x%x): Invalid parameter!\n", __func__, hEncoder);
+		return -EINVALID_PARAMETER;
 	}
 
-	jpeg_encoder_structure = JpegStruct;
-	
-	if (pic->type == OSC_PICTURE_BGR_24)
+	if (hEncoder == DefaultEncoder)
+		DefaultEncoder = NULL;
+	destroy_slice_pool (hEncoder);
+	free(((JPEG_ENCODER_STRUCTURE *)hEncoder)->chunk);
+	free(hEncoder);
+	return SUCCESS;
+}
+
+OSC_ERR OscJpgEncoderSetSampling(void *hEncoder, enum EnOscPictureType sampling)
+{
+	JPEG_ENCODER_STRUCTURE *jpeg = hEncoder;
+
+	if (unlikely(hEncoder == NULL || (sampling != OSC_PICTURE_YUV_444 &&
+			sampling != OSC_PICTURE_YUV_422 && sampling != OSC_PICTURE_YUV_420)))
 	{
-		pic->type = OSC_PICTURE_YUV_444;
-		BGR_2_444 (input_ptr, output_ptr, pic->width, pic->height);
-		memcpy(input_ptr, output_ptr, pic->width*pic->height*3);
+		OscLog(ERROR, "%s(0x%x, %d): Invalid parameter!\n", __func__, hEncoder, sampling);
+		return -EINVALID_PARAMETER;
 	}
 
-	if (pic->type != OSC_PICTURE_YUV_444)
+	jpeg->sampling = sampling;
+	return SUCCESS;
+}
+
+OSC_ERR OscJpgEncoderSetRestartInterval(void *hEncoder, uint16 nMcuRows)
+{
+	JPEG_ENCODER_STRUCTURE *jpeg = hEncoder;
+
+	if (unlikely(hEncoder == NULL))
 	{
-		/* unsupported or untested image format */
-		OscFatalErr("Unsupported Image Format in OscJpgEncode\n");
-	} 
+		OscLog(ERROR, "%s(0x%x, %u): Invalid parameter!\n", __func__, hEncoder, nMcuRows);
+		return -EINVALID_PARAMETER;
+	}
 
-	/* Initialization of JPEG control structure */
-	initialization (jpeg_encoder_structure, pic->type, pic->width, pic->height);
-	
-	/* Quantization Table Initialization */
-	initialize_quantization_tables (quality_factor);
+	jpeg->restart_rows = nMcuRows;
+	return SUCCESS;
+}
 
-	/* Writing Marker Data */
+OSC_ERR OscJpgEncoderSetQuantTables(void *hEncoder, const uint8 *pLuminance, const uint8 *pChrominance)
+{
+	uint16 i;
+
+	if (unlikely(hEncoder == NULL))
+	{
+		OscLog(ERROR, "%s(0x%x, 0x%x, 0x%x): Invalid parameter!\n", __func__, hEncoder, pLuminance, pChrominance);
+		return -EINVALID_PARAMETER;
+	}
+
+	/* A quantization value of 0 is not allowed in the DQT marker. */
+	for (i=0; i<BLOCK_SIZE; i++)
+	{
+		if ((pLuminance != NULL && pLuminance [i] == 0) ||
+				(pChrominance != NULL && pChrominance [i] == 0))
+		{
+			OscLog(ERROR, "%s: Quantization value 0 at %u!\n", __func__, i);
+			return -EINVALID_PARAMETER;
+		}
+	}
+
+	set_quantization_base (hEncoder, pLuminance, pChrominance);
+	return SUCCESS;
+}
+
+OSC_ERR OscJpgEncoderSetHuffmanMode(void *hEncoder, enum EnOscJpgHuffmanMode enMode)
+{
+	JPEG_ENCODER_STRUCTURE *jpeg = hEncoder;
+
+	if (unlikely(hEncoder == NULL || (enMode != OSC_JPG_HUFFMAN_STANDARD &&
+			enMode != OSC_JPG_HUFFMAN_OPTIMIZED && enMode != OSC_JPG_HUFFMAN_PREVIOUS)))
+	{
+		OscLog(ERROR, "%s(0x%x, %d): Invalid parameter!\n", __func__, hEncoder, enMode);
+		return -EINVALID_PARAMETER;
+	}
+
+	jpeg->huffman_mode = enMode;
+	/* A new sequence starts with the standard tables. */
+	set_standard_huffman_tables (jpeg);
+	jpeg->have_symbol_counts = FALSE;
+	return SUCCESS;
+}
+
+OSC_ERR OscJpgEncoderSetTargetSize(void *hEncoder, uint32 nTargetBytes, bool bReencode)
+{
+	JPEG_ENCODER_STRUCTURE *jpeg = hEncoder;
+
+	if (unlikely(hEncoder == NULL))
+	{
+		OscLog(ERROR, "%s(0x%x, %u, %d): Invalid parameter!\n", __func__, hEncoder, nTargetBytes, bReencode);
+		return -EINVALID_PARAMETER;
+	}
+
+	jpeg->target_bytes = nTargetBytes;
+	jpeg->reencode = bReencode;
+	return SUCCESS;
+}
+
+OSC_ERR OscJpgEncoderGetStats(void *hEncoder, struct OSC_JPG_ENCODER_STATS *pStats)
+{
+	JPEG_ENCODER_STRUCTURE *jpeg = hEncoder;
+
+	if (unlikely(hEncoder == NULL || pStats == NULL))
+	{
+		OscLog(ERROR, "%s(0x%x, 0x%x): Invalid parameter!\n", __func__, hEncoder, pStats);
+		return -EINVALID_PARAMETER;
+	}
+
+	*pStats = jpeg->stats;
+	return SUCCESS;
+}
 
-	output_ptr = write_markers (output_ptr, pic->type, pic->width, pic->height);
+OSC_ERR OscJpgEncoderSetThreads(void *hEncoder, uint16 nThreads)
+{
+	JPEG_ENCODER_STRUCTURE *jpeg = hEncoder;
 
-	for (i=1; i<=jpeg_encoder_structure->vertical_mcus; i++)
+	if (unlikely(hEncoder == NULL || nThreads < 1 || nThreads > MAX_JPEG_THREADS))
+	{
+		OscLog(ERROR, "%s(0x%x, %u): Invalid parameter!\n", __func__, hEncoder, nThreads);
+		return -EINVALID_PARAMETER;
+	}
+
+	if (nThreads != jpeg->threads)
+		destroy_slice_pool (jpeg);
+	jpeg->threads = nThreads;
+	return SUCCESS;
+}
+
+uint8* encode_slice (JPEG_ENCODER_STRUCTURE *jpeg_encoder_structure, uint32 image_format, uint16 slice, uint8 *output_ptr)
+{
+	uint16 i, j, first_row, last_row;
+	uint8 *input_ptr;
+
+	first_row = (uint16) (slice * jpeg_encoder_structure->slice_rows);
+	last_row = (uint16) (first_row + jpeg_encoder_structure->slice_rows);
+	if (last_row > jpeg_encoder_structure->vertical_mcus)
+		last_row = jpeg_encoder_structure->vertical_mcus;
+
+	/* Every slice starts with fresh DC predictors and an empty bit
+	 * buffer, so the slices can be encoded independently. */
+	jpeg_encoder_structure->ldc1 = 0;
+	jpeg_encoder_structure->ldc2 = 0;
+	jpeg_encoder_structure->ldc3 = 0;
+	jpeg_encoder_structure->lcode = 0;
+	jpeg_encoder_structure->bitindex = 0;
+
+	input_ptr = jpeg_encoder_structure->input + first_row * jpeg_encoder_structure->input_row_size;
+
+	jpeg_encoder_structure->mcu_y = (uint16) (first_row * jpeg_encoder_structure->mcu_height);
+	for (i=first_row+1; i<=last_row; i++)
 	{
 		if (i < jpeg_encoder_structure->vertical_mcus)
 			jpeg_encoder_structure->rows = jpeg_encoder_structure->mcu_height;
 		else
 			jpeg_encoder_structure->rows = jpeg_encoder_structure->rows_in_bottom_mcus;
 
+		jpeg_encoder_structure->mcu_x = 0;
 		for (j=1; j<=jpeg_encoder_structure->horizontal_mcus; j++)
 		{
 			if (j < jpeg_encoder_structure->horizontal_mcus)
@@ -179,62 +311,600 @@ uint8* OscJpgEncode(struct OSC_PICTURE *pic, uint8 *output_ptr, uint32 quality_f
 				jpeg_encoder_structure->incr = jpeg_encoder_structure->length_minus_width;
 			}
 
-			read_format (Image, jpeg_encoder_structure, input_ptr);
+			jpeg_encoder_structure->read_format (&jpeg_encoder_structure->image, jpeg_encoder_structure, input_ptr);
+
 			/* Encode the data in MCU */
-			output_ptr = encodeMCU (jpeg_encoder_structure, pic->type, output_ptr);
+			output_ptr = encodeMCU (jpeg_encoder_structure, image_format, output_ptr);
+			if (jpeg_encoder_structure->sink != NULL &&
+					output_ptr >= jpeg_encoder_structure->chunk + JPEG_CHUNK_SIZE)
+			{
+				output_ptr = flush_chunk (jpeg_encoder_structure, output_ptr);
+				if (output_ptr == NULL)
+					return NULL;
+			}
 
 			input_ptr += jpeg_encoder_structure->mcu_width_size;
+			jpeg_encoder_structure->mcu_x += jpeg_encoder_structure->mcu_width;
 		}
 
 		input_ptr += jpeg_encoder_structure->offset;
+		jpeg_encoder_structure->mcu_y += jpeg_encoder_structure->mcu_height;
 	}
 
-	/* Close Routine */
-	close_bitstream (output_ptr);
+	return flush_bitstream (jpeg_encoder_structure, output_ptr);
+}
+
+uint8* write_restart_marker (uint8 *output_ptr, uint16 slice)
+{
+	*output_ptr++ = 0xFF;
+	*output_ptr++ = (uint8) (0xD0 + (slice & 7));
 	return output_ptr;
 }
 
+uint8* encode_slices_sequential (JPEG_ENCODER_STRUCTURE *jpeg_encoder_structure, uint32 image_format, uint8 *output_ptr)
+{
+	uint16 slice;
+
+	for (slice=0; slice<jpeg_encoder_structure->slices; slice++)
+	{
+		/* RST0 follows the first slice. */
+		if (slice > 0 && jpeg_encoder_structure->code_block != gather_symbols)
+			output_ptr = write_restart_marker (output_ptr, (uint16) (slice - 1));
+		output_ptr = encode_slice (jpeg_encoder_structure, image_format, slice, output_ptr);
+		if (output_ptr == NULL)
+			return NULL;
+	}
+
+	return output_ptr;
+}
+
+uint8* flush_chunk (JPEG_ENCODER_STRUCTURE *jpeg_encoder_structure, uint8 *output_ptr)
+{
+	uint32 len = output_ptr - jpeg_encoder_structure->chunk;
+	OSC_ERR err;
+
+	if (len == 0)
+		return output_ptr;
+
+	err = jpeg_encoder_structure->sink (jpeg_encoder_structure->sink_context, jpeg_encoder_structure->chunk, len);
+	if (err != SUCCESS)
+	{
+		jpeg_encoder_structure->error = err;
+		return NULL;
+	}
+	jpeg_encoder_structure->sink_bytes += len;
+	return jpeg_encoder_structure->chunk;
+}
+
+uint8* write_slice_data (JPEG_ENCODER_STRUCTURE *jpeg_encoder_structure, uint8 *output_ptr, const uint8 *data, uint32 len)
+{
+	OSC_ERR err;
+
+	if (jpeg_encoder_structure->sink == NULL)
+	{
+		memcpy (output_ptr, data, len);
+		return output_ptr + len;
+	}
+
+	/* Pass the slice on as it is instead of copying it into the chunk. */
+	output_ptr = flush_chunk (jpeg_encoder_structure, output_ptr);
+	if (output_ptr == NULL || len == 0)
+		return output_ptr;
+
+	err = jpeg_encoder_structure->sink (jpeg_encoder_structure->sink_context, data, len);
+	if (err != SUCCESS)
+	{
+		jpeg_encoder_structure->error = err;
+		return NULL;
+	}
+	jpeg_encoder_structure->sink_bytes += len;
+	return output_ptr;
+}
+
+/*********************************************************************//*!
+ * @brief Choose the Huffman tables of an image according to the mode of
+ * the encoder.
+ * 
+ * In the optimized mode the image is run through the DCT once to count
+ * its symbols, nothing is written. In the previous mode the tables are
+ * built from the counts of the last image and counting is turned on for
+ * this one.
+ * 
+ * @param jpeg_encoder_structure The encoder, set up for the image.
+ * @param image_format Sampling format of the JPEG.
+ * @param output_ptr Pointer to the JPEG output buffer.
+ *//*********************************************************************/
+static void choose_huffman_tables (JPEG_ENCODER_STRUCTURE *jpeg_encoder_structure, uint32 image_format, uint8 *output_ptr)
+{
+	jpeg_encoder_structure->count_symbols = FALSE;
+
+	switch (jpeg_encoder_structure->huffman_mode)
+	{
+	case OSC_JPG_HUFFMAN_OPTIMIZED:
+		clear_symbol_counts (jpeg_encoder_structure);
+		jpeg_encoder_structure->count_symbols = TRUE;
+		jpeg_encoder_structure->code_block = gather_symbols;
+		encode_slices (jpeg_encoder_structure, image_format, output_ptr);
+		jpeg_encoder_structure->code_block = huffman;
+		jpeg_encoder_structure->count_symbols = FALSE;
+		build_huffman_tables (jpeg_encoder_structure, FALSE);
+		break;
+	case OSC_JPG_HUFFMAN_PREVIOUS:
+		/* Every symbol needs a code, the image may differ from the last. */
+		if (jpeg_encoder_structure->have_symbol_counts)
+			build_huffman_tables (jpeg_encoder_structure, TRUE);
+		clear_symbol_counts (jpeg_encoder_structure);
+		jpeg_encoder_structure->count_symbols = TRUE;
+		break;
+	default:
+		break;
+	}
+}
+
+/*********************************************************************//*!
+ * @brief Encode an image whose input format and the read function have
+ * been set up.
+ * 
+ * @param jpeg_encoder_structure The encoder.
+ * @param image_format Sampling format of the JPEG.
+ * @param input_ptr The input data for the read functions of the YUV
+ * formats.
+ * @param image_width Width of the JPEG.
+ * @param image_height Height of the JPEG.
+ * @param output_ptr Pointer to the JPEG output buffer, the chunk if a
+ * sink is set.
+ * @param quality_factor 1024 means heavy compression
+ * @return Pointer to the end of the data in the JPEG output buffer or
+ * NULL if the encoding was aborted, with the reason in the error member.
+ *//*********************************************************************/
+static uint8* encode_image (JPEG_ENCODER_STRUCTURE *jpeg_encoder_structure, uint32 image_format, uint8 *input_ptr, uint32 image_width, uint32 image_height, uint8 *output_ptr, uint32 quality_factor)
+{
+	uint16 max_rows;
+	uint8 *marker_end;
+
+	jpeg_encoder_structure->error = SUCCESS;
+
+	/* Initialization of JPEG control structure */
+	initialization (jpeg_encoder_structure, image_format, image_width, image_height);
+
+	/* Quantization Table Initialization */
+	initialize_quantization_tables (jpeg_encoder_structure, quality_factor);
+
+	jpeg_encoder_structure->input = input_ptr;
+	jpeg_encoder_structure->input_row_size = (uint32) jpeg_encoder_structure->horizontal_mcus *
+			jpeg_encoder_structure->mcu_width_size + jpeg_encoder_structure->offset;
+
+	/* Split the image into slices of restart_rows MCU rows. The restart
+	 * interval in the DRI marker counts MCUs and is limited to 16 bit. */
+	jpeg_encoder_structure->slice_rows = jpeg_encoder_structure->vertical_mcus;
+	jpeg_encoder_structure->restart_interval = 0;
+	if (jpeg_encoder_structure->restart_rows != 0 &&
+			jpeg_encoder_structure->restart_rows < jpeg_encoder_structure->vertical_mcus)
+	{
+		max_rows = (uint16) (0xffff / jpeg_encoder_structure->horizontal_mcus);
+		jpeg_encoder_structure->slice_rows = jpeg_encoder_structure->restart_rows;
+		if (jpeg_encoder_structure->slice_rows > max_rows)
+			jpeg_encoder_structure->slice_rows = max_rows;
+		jpeg_encoder_structure->restart_interval = (uint16) (jpeg_encoder_structure->slice_rows *
+				jpeg_encoder_structure->horizontal_mcus);
+	}
+	jpeg_encoder_structure->slices = (uint16) ((jpeg_encoder_structure->vertical_mcus +
+			jpeg_encoder_structure->slice_rows - 1) / jpeg_encoder_structure->slice_rows);
+
+	choose_huffman_tables (jpeg_encoder_structure, image_format, output_ptr);
+
+	/* Writing Marker Data */
+	marker_end = write_markers (jpeg_encoder_structure, output_ptr, image_format, image_width, image_height);
+	jpeg_encoder_structure->marker_bytes = (uint16) (marker_end - output_ptr + 2);
+	output_ptr = marker_end;
+
+	output_ptr = encode_slices (jpeg_encoder_structure, image_format, output_ptr);
+	jpeg_encoder_structure->have_symbol_counts = jpeg_encoder_structure->count_symbols;
+	if (output_ptr == NULL)
+		return NULL;
+
+	/* Close Routine */
+	return close_bitstream (jpeg_encoder_structure, output_ptr);
+}
+
+/*********************************************************************//*!
+ * @brief Set up the encoder to read a bitmap image.
+ * 
+ * @param jpeg_encoder_structure The encoder.
+ * @param pic The image.
+ * @param pImageFormat The sampling format of the JPEG is returned over
+ * this pointer.
+ * @return SUCCESS or an appropriate error code otherwise
+ *//*********************************************************************/
+static OSC_ERR setup_picture (JPEG_ENCODER_STRUCTURE *jpeg_encoder_structure, const struct OSC_PICTURE *pic, uint32 *pImageFormat)
+{
+	jpeg_encoder_structure->src = NULL;
+
+	switch (pic->type)
+	{
+	case OSC_PICTURE_BGR_24:
+		/* Converted to the sampling format of the encoder while reading. */
+		*pImageFormat = jpeg_encoder_structure->sampling;
+		jpeg_encoder_structure->src = (uint8 *)pic->data;
+		jpeg_encoder_structure->src_width = pic->width;
+		jpeg_encoder_structure->src_height = pic->height;
+		jpeg_encoder_structure->src_ystep = (uint32)pic->width * 3;
+		jpeg_encoder_structure->src_layout = OSC_VIS_BGR_LAYOUT;
+		break;
+	case OSC_PICTURE_YUV_444:
+		*pImageFormat = OSC_PICTURE_YUV_444;
+		break;
+	case OSC_PICTURE_YUV_422:
+	case OSC_PICTURE_YUV_420:
+		/* The read functions only handle whole macro pixels. */
+		if ((pic->width & 1) || (pic->type == OSC_PICTURE_YUV_420 && (pic->height & 1)))
+		{
+			OscLog(ERROR, "%s: Odd image size %dx%d for subsampled format!\n",
+					__func__, pic->width, pic->height);
+			return -EINVALID_PARAMETER;
+		}
+		*pImageFormat = pic->type;
+		break;
+	case OSC_PICTURE_GREYSCALE:
+	case OSC_PICTURE_YUV_400:
+		/* Greyscale images are encoded as a single luminance component. */
+		*pImageFormat = OSC_PICTURE_YUV_400;
+		break;
+	default:
+		/* unsupported or untested image format */
+		OscLog(ERROR, "%s: Unsupported image format %d!\n", __func__, pic->type);
+		return -EINVALID_PARAMETER;
+	} 
+
+	return SUCCESS;
+}
+
+/*********************************************************************//*!
+ * @brief Set up the encoder to read a raw bayer image at half size.
+ * 
+ * @param jpeg_encoder_structure The encoder.
+ * @param pRaw The raw image with even width and height.
+ * @param enBayerOrderFirstRow The order of the colors in the first row.
+ * @return SUCCESS or an appropriate error code otherwise
+ *//*********************************************************************/
+static OSC_ERR setup_bayer (JPEG_ENCODER_STRUCTURE *jpeg_encoder_structure, const struct OSC_PICTURE *pRaw, enum EnBayerOrder enBayerOrderFirstRow)
+{
+	OSC_ERR err;
+
+	/* Every 2x2 cell of the raw image becomes one pixel. */
+	err = OscVisGetBayerColorLayout(pRaw->width, enBayerOrderFirstRow,
+			&jpeg_encoder_structure->src_layout);
+	if (err != SUCCESS)
+		return err;
+
+	jpeg_encoder_structure->src = (uint8 *)pRaw->data;
+	jpeg_encoder_structure->src_width = pRaw->width / 2;
+	jpeg_encoder_structure->src_height = pRaw->height / 2;
+	jpeg_encoder_structure->src_ystep = (uint32)pRaw->width * 2;
+
+	return SUCCESS;
+}
+
+/*********************************************************************//*!
+ * @brief Encode an image that has been set up into the chunk of the
+ * encoder and pass the data to a sink.
+ * 
+ * @param jpeg_encoder_structure The encoder.
+ * @param image_format Sampling format of the JPEG.
+ * @param input_ptr The input data for the read functions of the YUV
+ * formats.
+ * @param image_width Width of the JPEG.
+ * @param image_height Height of the JPEG.
+ * @param quality_factor 1024 means heavy compression
+ * @param sink Function receiving the data.
+ * @param pSinkContext Passed to the sink.
+ * @return SUCCESS or an appropriate error code otherwise
+ *//*********************************************************************/
+static OSC_ERR encode_to_sink (JPEG_ENCODER_STRUCTURE *jpeg_encoder_structure, uint32 image_format, uint8 *input_ptr, uint32 image_width, uint32 image_height, uint32 quality_factor, OSC_JPG_SINK sink, void *pSinkContext)
+{
+	uint8 *output_ptr;
+
+	if (jpeg_encoder_structure->chunk == NULL)
+	{
+		jpeg_encoder_structure->chunk = malloc(JPEG_CHUNK_SIZE + JPEG_CHUNK_MARGIN);
+		if (jpeg_encoder_structure->chunk == NULL)
+		{
+			OscLog(ERROR, "%s: Could not allocate memory!\n", __func__);
+			return -EOUT_OF_MEMORY;
+		}
+	}
+
+	jpeg_encoder_structure->sink = sink;
+	jpeg_encoder_structure->sink_context = pSinkContext;
+	jpeg_encoder_structure->sink_bytes = 0;
+
+	/* The markers fit into the chunk and every MCU is followed by a check
+	 * of the fill level. */
+	output_ptr = encode_image (jpeg_encoder_structure, image_format, input_ptr, image_width, image_height,
+			jpeg_encoder_structure->chunk, quality_factor);
+	if (output_ptr != NULL)
+		output_ptr = flush_chunk (jpeg_encoder_structure, output_ptr);
+
+	jpeg_encoder_structure->sink = NULL;
+	if (output_ptr == NULL)
+		return jpeg_encoder_structure->error;
+	return SUCCESS;
+}
+
+/*********************************************************************//*!
+ * @brief Encode an image that has been set up into a buffer with the
+ * quality chosen by the rate control.
+ * 
+ * @param jpeg_encoder_structure The encoder.
+ * @param image_format Sampling format of the JPEG.
+ * @param input_ptr The input data for the read functions of the YUV
+ * formats.
+ * @param image_width Width of the JPEG.
+ * @param image_height Height of the JPEG.
+ * @param output_ptr Pointer to the JPEG output buffer.
+ * @param quality_factor Quality factor if the rate control is off.
+ * @return Pointer to the end of the data in the JPEG output buffer or
+ * NULL if the encoding was aborted, with the reason in the error member.
+ *//*********************************************************************/
+static uint8* encode_image_rate_controlled (JPEG_ENCODER_STRUCTURE *jpeg_encoder_structure, uint32 image_format, uint8 *input_ptr, uint32 image_width, uint32 image_height, uint8 *output_ptr, uint32 quality_factor)
+{
+	uint8 *output_end;
+	uint16 encodings = 1;
+
+	quality_factor = rate_control_quality (jpeg_encoder_structure, quality_factor);
+	output_end = encode_image (jpeg_encoder_structure, image_format, input_ptr, image_width, image_height, output_ptr, quality_factor);
+	if (output_end == NULL)
+		return NULL;
+
+	if (rate_control_retry (jpeg_encoder_structure, output_end - output_ptr, jpeg_encoder_structure->target_bytes, &quality_factor))
+	{
+		encodings++;
+		output_end = encode_image (jpeg_encoder_structure, image_format, input_ptr, image_width, image_height, output_ptr, quality_factor);
+		if (output_end == NULL)
+			return NULL;
+	}
+
+	rate_control_update (jpeg_encoder_structure, output_end - output_ptr, quality_factor, encodings);
+	return output_end;
+}
+
+/*! @brief The context of buffer_sink. */
+struct JPEG_BUFFER {
+	uint8 *pData;
+	uint32 capacity;
+	uint32 length;
+};
+
+/*********************************************************************//*!
+ * @brief Sink appending the data to a buffer of limited size.
+ * 
+ * Once the data does not fit anymore, it is only counted, so the size of
+ * the image is known to the caller and the rate control.
+ * 
+ * @param pContext The buffer, a struct JPEG_BUFFER.
+ * @param pData The data.
+ * @param len Length of the data.
+ * @return SUCCESS
+ *//*********************************************************************/
+static OSC_ERR buffer_sink (void *pContext, const uint8 *pData, uint32 len)
+{
+	struct JPEG_BUFFER *pBuffer = pContext;
+
+	if (pBuffer->length <= pBuffer->capacity && len <= pBuffer->capacity - pBuffer->length)
+		memcpy(pBuffer->pData + pBuffer->length, pData, len);
+	pBuffer->length += len;
+	return SUCCESS;
+}
+
+OSC_ERR OscJpgEncoderEncode(void *hEncoder, struct OSC_PICTURE *pic, uint8 *output_ptr, uint32 quality_factor, uint8 **pOutputEnd)
+{
+	uint32 image_format;
+	OSC_ERR err;
+	JPEG_ENCODER_STRUCTURE *jpeg_encoder_structure = hEncoder;
+
+	if (unlikely(hEncoder == NULL || pic == NULL || pic->data == NULL ||
+			output_ptr == NULL || pOutputEnd == NULL))
+	{
+		OscLog(ERROR, "%s(0x%x, 0x%x, 0x%x, %u, 0x%x): Invalid parameter!\n",
+				__func__, hEncoder, pic, output_ptr, quality_factor, pOutputEnd);
+		return -EINVALID_PARAMETER;
+	}
+
+	err = setup_picture (jpeg_encoder_structure, pic, &image_format);
+	if (err != SUCCESS)
+		return err;
+
+	output_ptr = encode_image_rate_controlled (jpeg_encoder_structure, image_format, (uint8 *)pic->data, pic->width, pic->height, output_ptr, quality_factor);
+	if (output_ptr == NULL)
+		return jpeg_encoder_structure->error;
+
+	*pOutputEnd = output_ptr;
+	return SUCCESS;
+}
+
+OSC_ERR OscJpgEncoderEncodeBayer(void *hEncoder, const struct OSC_PICTURE *pRaw, enum EnBayerOrder enBayerOrderFirstRow, uint8 *output_ptr, uint32 quality_factor, uint8 **pOutputEnd)
+{
+	JPEG_ENCODER_STRUCTURE *jpeg_encoder_structure = hEncoder;
+	OSC_ERR err;
+
+	if (unlikely(hEncoder == NULL || pRaw == NULL || pRaw->data == NULL ||
+			output_ptr == NULL || pOutputEnd == NULL ||
+			pRaw->width < 2 || pRaw->height < 2 ||
+			(pRaw->width & 1) || (pRaw->height & 1)))
+	{
+		OscLog(ERROR, "%s(0x%x, 0x%x, %d, 0x%x, %u, 0x%x): Invalid parameter!\n",
+				__func__, hEncoder, pRaw, enBayerOrderFirstRow, output_ptr, quality_factor, pOutputEnd);
+		return -EINVALID_PARAMETER;
+	}
+
+	err = setup_bayer (jpeg_encoder_structure, pRaw, enBayerOrderFirstRow);
+	if (err != SUCCESS)
+		return err;
+
+	output_ptr = encode_image_rate_controlled (jpeg_encoder_structure, jpeg_encoder_structure->sampling, (uint8 *)pRaw->data,
+			jpeg_encoder_structure->src_width, jpeg_encoder_structure->src_height,
+			output_ptr, quality_factor);
+	if (output_ptr == NULL)
+		return jpeg_encoder_structure->error;
+
+	*pOutputEnd = output_ptr;
+	return SUCCESS;
+}
+
+OSC_ERR OscJpgEncoderEncodeToBuffer(void *hEncoder, const struct OSC_PICTURE *pic, uint8 *pOutput, uint32 capacity, uint32 quality_factor, uint32 *pLength)
+{
+	struct JPEG_BUFFER buffer;
+	uint32 image_format, limit;
+	uint16 encodings;
+	OSC_ERR err;
+	JPEG_ENCODER_STRUCTURE *jpeg_encoder_structure = hEncoder;
+
+	if (unlikely(hEncoder == NULL || pic == NULL || pic->data == NULL ||
+			pOutput == NULL || pLength == NULL))
+	{
+		OscLog(ERROR, "%s(0x%x, 0x%x, 0x%x, %u, %u, 0x%x): Invalid parameter!\n",
+				__func__, hEncoder, pic, pOutput, capacity, quality_factor, pLength);
+		return -EINVALID_PARAMETER;
+	}
+
+	err = setup_picture (jpeg_encoder_structure, pic, &image_format);
+	if (err != SUCCESS)
+		return err;
+
+	limit = capacity;
+	if (jpeg_encoder_structure->target_bytes != 0 && jpeg_encoder_structure->target_bytes < limit)
+		limit = jpeg_encoder_structure->target_bytes;
+
+	quality_factor = rate_control_quality (jpeg_encoder_structure, quality_factor);
+	for (encodings = 1; ; encodings++)
+	{
+		buffer.pData = pOutput;
+		buffer.capacity = capacity;
+		buffer.length = 0;
+
+		err = encode_to_sink (jpeg_encoder_structure, image_format, (uint8 *)pic->data, pic->width, pic->height,
+				quality_factor, buffer_sink, &buffer);
+		if (err != SUCCESS)
+			return err;
+
+		if (encodings > 1 || !rate_control_retry (jpeg_encoder_structure, buffer.length, limit, &quality_factor))
+			break;
+	}
+
+	rate_control_update (jpeg_encoder_structure, buffer.length, quality_factor, encodings);
+	*pLength = buffer.length;
+	if (buffer.length > capacity)
+		return -EBUFFER_TOO_SMALL;
+	return SUCCESS;
+}
+
+OSC_ERR OscJpgEncoderEncodeToSink(void *hEncoder, const struct OSC_PICTURE *pic, uint32 quality_factor, OSC_JPG_SINK sink, void *pSinkContext)
+{
+	uint32 image_format;
+	OSC_ERR err;
+	JPEG_ENCODER_STRUCTURE *jpeg_encoder_structure = hEncoder;
+
+	if (unlikely(hEncoder == NULL || pic == NULL || pic->data == NULL || sink == NULL))
+	{
+		OscLog(ERROR, "%s(0x%x, 0x%x, %u, 0x%x, 0x%x): Invalid parameter!\n",
+				__func__, hEncoder, pic, quality_factor, sink, pSinkContext);
+		return -EINVALID_PARAMETER;
+	}
+
+	err = setup_picture (jpeg_encoder_structure, pic, &image_format);
+	if (err != SUCCESS)
+		return err;
+
+	quality_factor = rate_control_quality (jpeg_encoder_structure, quality_factor);
+	err = encode_to_sink (jpeg_encoder_structure, image_format, (uint8 *)pic->data, pic->width, pic->height,
+			quality_factor, sink, pSinkContext);
+	if (err != SUCCESS)
+		return err;
+
+	rate_control_update (jpeg_encoder_structure, jpeg_encoder_structure->sink_bytes, quality_factor, 1);
+	return SUCCESS;
+}
+
+OSC_ERR OscJpgEncoderEncodeBayerToSink(void *hEncoder, const struct OSC_PICTURE *pRaw, enum EnBayerOrder enBayerOrderFirstRow, uint32 quality_factor, OSC_JPG_SINK sink, void *pSinkContext)
+{
+	JPEG_ENCODER_STRUCTURE *jpeg_encoder_structure = hEncoder;
+	OSC_ERR err;
+
+	if (unlikely(hEncoder == NULL || pRaw == NULL || pRaw->data == NULL || sink == NULL ||
+			pRaw->width < 2 || pRaw->height < 2 ||
+			(pRaw->width & 1) || (pRaw->height & 1)))
+	{
+		OscLog(ERROR, "%s(0x%x, 0x%x, %d, %u, 0x%x, 0x%x): Invalid parameter!\n",
+				__func__, hEncoder, pRaw, enBayerOrderFirstRow, quality_factor, sink, pSinkContext);
+		return -EINVALID_PARAMETER;
+	}
+
+	err = setup_bayer (jpeg_encoder_structure, pRaw, enBayerOrderFirstRow);
+	if (err != SUCCESS)
+		return err;
+
+	quality_factor = rate_control_quality (jpeg_encoder_structure, quality_factor);
+	err = encode_to_sink (jpeg_encoder_structure, jpeg_encoder_structure->sampling, (uint8 *)pRaw->data,
+			jpeg_encoder_structure->src_width, jpeg_encoder_structure->src_height,
+			quality_factor, sink, pSinkContext);
+	if (err != SUCCESS)
+		return err;
+
+	rate_control_update (jpeg_encoder_structure, jpeg_encoder_structure->sink_bytes, quality_factor, 1);
+	return SUCCESS;
+}
+
+uint8* OscJpgEncode(struct OSC_PICTURE *pic, uint8 *output_ptr, uint32 quality_factor)
+{
+	uint8 *output_end;
+
+	if (DefaultEncoder == NULL)
+	{
+		if (OscJpgCreateEncoder((void **)&DefaultEncoder) != SUCCESS)
+			OscFatalErr("Could not allocate memory\n");
+	}
+
+	if (OscJpgEncoderEncode(DefaultEncoder, pic, output_ptr, quality_factor, &output_end) != SUCCESS)
+	{
+		/* unsupported or untested image format */
+		OscFatalErr("Unsupported Image Format in OscJpgEncode\n");
+	}
+	return output_end;
+}
+
 uint8* encodeMCU (JPEG_ENCODER_STRUCTURE *jpeg_encoder_structure, uint32 image_format, uint8 *output_ptr)
 {
-	levelshift (Image->Y1);
-	DCT ((int16 *)Image->Y1);
-	quantization (Image->Y1, ILqt, Temp);
+	IMGDATA *Image = &jpeg_encoder_structure->image;
+	uint16 *Temp = jpeg_encoder_structure->Temp;
+	const DCT_DIVISORS *Ldiv = &jpeg_encoder_structure->Ldiv;
+	const DCT_DIVISORS *Cdiv = &jpeg_encoder_structure->Cdiv;
 
-	output_ptr = huffman (jpeg_encoder_structure, 1, output_ptr, Temp);
+	DCT_quantization (Image->Y1, Ldiv, Temp);
+	output_ptr = jpeg_encoder_structure->code_block (jpeg_encoder_structure, 1, output_ptr, Temp);
 
 	if (image_format == OSC_PICTURE_YUV_420 || 
 	    image_format == OSC_PICTURE_YUV_422)
 	{
-		levelshift (Image->Y2);
-		DCT (Image->Y2);
-		quantization (Image->Y2, ILqt, Temp);
-		output_ptr = huffman (jpeg_encoder_structure, 1, output_ptr, Temp);
+		DCT_quantization (Image->Y2, Ldiv, Temp);
+		output_ptr = jpeg_encoder_structure->code_block (jpeg_encoder_structure, 1, output_ptr, Temp);
 
 		if (image_format == OSC_PICTURE_YUV_420)
 		{
-			levelshift (Image->Y3);
-			DCT (Image->Y3);
-			quantization (Image->Y3, ILqt, Temp);
-			output_ptr = huffman (jpeg_encoder_structure, 1, output_ptr, Temp);
-
-			levelshift (Image->Y4);
-			DCT (Image->Y4);
-			quantization (Image->Y4, ILqt, Temp);
-			output_ptr = huffman (jpeg_encoder_structure, 1, output_ptr, Temp);
+			DCT_quantization (Image->Y3, Ldiv, Temp);
+			output_ptr = jpeg_encoder_structure->code_block (jpeg_encoder_structure, 1, output_ptr, Temp);
+
+			DCT_quantization (Image->Y4, Ldiv, Temp);
+			output_ptr = jpeg_encoder_structure->code_block (jpeg_encoder_structure, 1, output_ptr, Temp);
 		}
 	}
 
 	if (image_format != OSC_PICTURE_YUV_400)
 	{
-		levelshift (Image->CB);
-		DCT (Image->CB);
-		quantization (Image->CB, ICqt, Temp);
-		output_ptr = huffman (jpeg_encoder_structure, 2, output_ptr, Temp);
+		DCT_quantization (Image->CB, Cdiv, Temp);
+		output_ptr = jpeg_encoder_structure->code_block (jpeg_encoder_structure, 2, output_ptr, Temp);
 
-		levelshift (Image->CR);
-		DCT (Image->CR);
-		quantization (Image->CR, ICqt, Temp);
-		output_ptr = huffman (jpeg_encoder_structure, 3, output_ptr, Temp);
+		DCT_quantization (Image->CR, Cdiv, Temp);
+		output_ptr = jpeg_encoder_structure->code_block (jpeg_encoder_structure, 3, output_ptr, Temp);
 	}
 
 	jpeg_encoder_structure->debug_pass++;
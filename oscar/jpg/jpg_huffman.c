@@ -20,75 +20,196 @@
 #include "jpg.h"
 #include "jpg_huffdata.h"
 
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+/* Non-zero if one of the bytes of the 32 bit word is 0xff. */
+#define HAS_FF_BYTE(word)	((~(word) - 0x01010101) & (word) & 0x80808080)
+
+/* Append the numbits low bits of data to the bit buffer. Whenever 32 bits
+ * are complete they are written out, a 0 byte following every 0xff byte.
+ * The buffer is 64 bit wide, so codes of up to 32 bits can be appended to
+ * the less than 32 bits left behind without splitting them. */
 #define PUTBITS	\
 {	\
-	bits_in_next_word = (int16) (bitindex + numbits - 32);	\
-	if (bits_in_next_word < 0)	\
+	lcode = (lcode << numbits) | data;	\
+	bitindex += numbits;	\
+	if (bitindex >= 32)	\
 	{	\
-		lcode = (lcode << numbits) | data;	\
-		bitindex += numbits;	\
-	}	\
-	else	\
-	{	\
-		lcode = (lcode << (32 - bitindex)) | (data >> bits_in_next_word);	\
-		if ((*output_ptr++ = (uint8)(lcode >> 24)) == 0xff)	\
-			*output_ptr++ = 0;	\
-		if ((*output_ptr++ = (uint8)(lcode >> 16)) == 0xff)	\
-			*output_ptr++ = 0;	\
-		if ((*output_ptr++ = (uint8)(lcode >> 8)) == 0xff)	\
-			*output_ptr++ = 0;	\
-		if ((*output_ptr++ = (uint8) lcode) == 0xff)	\
-			*output_ptr++ = 0;	\
-		lcode = data;	\
-		bitindex = bits_in_next_word;	\
+		bitindex -= 32;	\
+		word = (uint32) (lcode >> bitindex);	\
+		if (likely(!HAS_FF_BYTE(word)))	\
+		{	\
+			output_ptr [0] = (uint8) (word >> 24);	\
+			output_ptr [1] = (uint8) (word >> 16);	\
+			output_ptr [2] = (uint8) (word >> 8);	\
+			output_ptr [3] = (uint8) word;	\
+			output_ptr += 4;	\
+		}	\
+		else	\
+			output_ptr = put_stuffed_word (output_ptr, word);	\
 	}	\
 }
 
-uint8* huffman (JPEG_ENCODER_STRUCTURE *jpeg_encoder_structure, uint16 component, uint8 *output_ptr, uint16 *Temp)
+static inline uint8* put_stuffed_word (uint8 *output_ptr, uint32 word)
 {
+	int16 shift;
+
+	for (shift=24; shift>=0; shift-=8)
+	{
+		if ((*output_ptr++ = (uint8) (word >> shift)) == 0xff)
+			*output_ptr++ = 0;
+	}
+	return output_ptr;
+}
+
+/* Bit i is set if coefficient i of the block in zigzag order is not 0. */
+static inline uint64_t nonzero_mask (const uint16 *Temp)
+{
+#ifdef __SSE2__
+	const __m128i zero = _mm_setzero_si128 ();
+	uint64_t mask = 0;
 	uint16 i;
-	uint16 *DcCodeTable, *DcSizeTable, *AcCodeTable, *AcSizeTable;
 
-	int16 *Temp_Ptr, Coeff, LastDc;
-	uint16 AbsCoeff, HuffCode, HuffSize, RunLength=0, DataSize=0, index;
+	for (i=0; i<64; i+=16)
+	{
+		__m128i lo = _mm_cmpeq_epi16 (_mm_loadu_si128 ((const __m128i *) (Temp + i)), zero);
+		__m128i hi = _mm_cmpeq_epi16 (_mm_loadu_si128 ((const __m128i *) (Temp + i + 8)), zero);
 
-	int16 bits_in_next_word;
-	uint16 numbits;
-	uint32 data;
+		mask |= (uint64_t) (uint16) ~_mm_movemask_epi8 (_mm_packs_epi16 (lo, hi)) << i;
+	}
+	return mask;
+#else
+	uint32 lo = 0, hi = 0;
+	uint16 i;
 
-	Temp_Ptr = (int16 *)Temp;
-	Coeff = *Temp_Ptr++;
+	for (i=0; i<32; i++)
+	{
+		lo |= (uint32) (Temp [i] != 0) << i;
+		hi |= (uint32) (Temp [i + 32] != 0) << i;
+	}
+	return ((uint64_t) hi << 32) | lo;
+#endif
+}
+
+void set_standard_huffman_tables (JPEG_ENCODER_STRUCTURE *jpeg_encoder_structure)
+{
+	memcpy (jpeg_encoder_structure->dc_code [0], luminance_dc_code_table, sizeof (jpeg_encoder_structure->dc_code [0]));
+	memcpy (jpeg_encoder_structure->dc_size [0], luminance_dc_size_table, sizeof (jpeg_encoder_structure->dc_size [0]));
+	memcpy (jpeg_encoder_structure->ac_code [0], luminance_ac_code_table, sizeof (jpeg_encoder_structure->ac_code [0]));
+	memcpy (jpeg_encoder_structure->ac_size [0], luminance_ac_size_table, sizeof (jpeg_encoder_structure->ac_size [0]));
+	memcpy (jpeg_encoder_structure->dc_code [1], chrominance_dc_code_table, sizeof (jpeg_encoder_structure->dc_code [1]));
+	memcpy (jpeg_encoder_structure->dc_size [1], chrominance_dc_size_table, sizeof (jpeg_encoder_structure->dc_size [1]));
+	memcpy (jpeg_encoder_structure->ac_code [1], chrominance_ac_code_table, sizeof (jpeg_encoder_structure->ac_code [1]));
+	memcpy (jpeg_encoder_structure->ac_size [1], chrominance_ac_size_table, sizeof (jpeg_encoder_structure->ac_size [1]));
+	jpeg_encoder_structure->huffman_custom = FALSE;
+}
+
+/* Replace the DC predictor of a component by the DC coefficient of the
+ * block and return the difference to code. */
+static inline int16 dc_difference (JPEG_ENCODER_STRUCTURE *jpeg_encoder_structure, uint16 component, int16 Coeff)
+{
+	int16 LastDc;
 
 	if (component == 1)
 	{
-		DcCodeTable = luminance_dc_code_table;
-		DcSizeTable = luminance_dc_size_table;
-		AcCodeTable = luminance_ac_code_table;
-		AcSizeTable = luminance_ac_size_table;
-
 		LastDc = jpeg_encoder_structure->ldc1;
 		jpeg_encoder_structure->ldc1 = Coeff;
 	}
+	else if (component == 2)
+	{
+		LastDc = jpeg_encoder_structure->ldc2;
+		jpeg_encoder_structure->ldc2 = Coeff;
+	}
 	else
 	{
-		DcCodeTable = chrominance_dc_code_table;
-		DcSizeTable = chrominance_dc_size_table;
-		AcCodeTable = chrominance_ac_code_table;
-		AcSizeTable = chrominance_ac_size_table;
+		LastDc = jpeg_encoder_structure->ldc3;
+		jpeg_encoder_structure->ldc3 = Coeff;
+	}
+	return (int16) (Coeff - LastDc);
+}
+
+/* Counts the symbols huffman would code for the block, without output. */
+uint8* gather_symbols (JPEG_ENCODER_STRUCTURE *jpeg_encoder_structure, uint16 component, uint8 *output_ptr, uint16 *Temp)
+{
+	uint16 i, last, AbsCoeff, DataSize=0, RunLength;
+	uint32 *dc_count, *ac_count;
+	uint64_t nonzero;
+	int16 Coeff;
+
+	dc_count = jpeg_encoder_structure->dc_count [component != 1];
+	ac_count = jpeg_encoder_structure->ac_count [component != 1];
+
+	Coeff = dc_difference (jpeg_encoder_structure, component, (int16) Temp [0]);
+	AbsCoeff = (Coeff < 0) ? -Coeff : Coeff;
+	while (AbsCoeff != 0)
+	{
+		AbsCoeff >>= 1;
+		DataSize++;
+	}
+	dc_count [DataSize]++;
+
+	nonzero = nonzero_mask (Temp) & ~(uint64_t) 1;
+	last = 0;
+	while (nonzero != 0)
+	{
+		i = (uint16) __builtin_ctzll (nonzero);
+		nonzero &= nonzero - 1;
+		RunLength = (uint16) (i - last - 1);
+		last = i;
 
-		if (component == 2)
+		while (RunLength > 15)
 		{
-			LastDc = jpeg_encoder_structure->ldc2;
-			jpeg_encoder_structure->ldc2 = Coeff;
+			RunLength -= 16;
+			ac_count [161]++;
 		}
+
+		Coeff = (int16) Temp [i];
+		AbsCoeff = (Coeff < 0) ? -Coeff : Coeff;
+		if (AbsCoeff >> 8 == 0)
+			DataSize = bitsize [AbsCoeff];
 		else
-		{
-			LastDc = jpeg_encoder_structure->ldc3;
-			jpeg_encoder_structure->ldc3 = Coeff;
-		}
+			DataSize = bitsize [AbsCoeff >> 8] + 8;
+
+		ac_count [RunLength * 10 + DataSize]++;
 	}
 
-	Coeff -= LastDc;
+	if (last != 63)
+		ac_count [0]++;
+
+	return output_ptr;
+}
+
+uint8* huffman (JPEG_ENCODER_STRUCTURE *jpeg_encoder_structure, uint16 component, uint8 *output_ptr, uint16 *Temp)
+{
+	uint16 i, last, table;
+	uint16 *DcCodeTable, *DcSizeTable, *AcCodeTable, *AcSizeTable;
+	uint32 *dc_count = NULL, *ac_count = NULL;
+
+	int16 Coeff;
+	uint16 AbsCoeff, HuffCode, HuffSize, RunLength, DataSize=0, index;
+
+	uint16 numbits;
+	uint32 data, word;
+	uint64_t nonzero;
+
+	/* Work on local copies of the bit buffer, it is stored back at the end. */
+	uint64_t lcode = jpeg_encoder_structure->lcode;
+	uint16 bitindex = jpeg_encoder_structure->bitindex;
+
+	table = (component != 1);
+	DcCodeTable = jpeg_encoder_structure->dc_code [table];
+	DcSizeTable = jpeg_encoder_structure->dc_size [table];
+	AcCodeTable = jpeg_encoder_structure->ac_code [table];
+	AcSizeTable = jpeg_encoder_structure->ac_size [table];
+	if (jpeg_encoder_structure->count_symbols)
+	{
+		dc_count = jpeg_encoder_structure->dc_count [table];
+		ac_count = jpeg_encoder_structure->ac_count [table];
+	}
+
+	Coeff = dc_difference (jpeg_encoder_structure, component, (int16) Temp [0]);
 
 	AbsCoeff = (Coeff < 0) ? -Coeff-- : Coeff;
 
@@ -100,6 +221,8 @@ uint8* huffman (JPEG_ENCODER_STRUCTURE *jpeg_encoder_structure, uint16 component
 
 	HuffCode = DcCodeTable [DataSize];
 	HuffSize = DcSizeTable [DataSize];
+	if (dc_count != NULL)
+		dc_count [DataSize]++;
 
 	Coeff &= (1 << DataSize) - 1;
 	data = (HuffCode << DataSize) | Coeff;
@@ -107,58 +230,76 @@ uint8* huffman (JPEG_ENCODER_STRUCTURE *jpeg_encoder_structure, uint16 component
 
 	PUTBITS
 
-	for (i=63; i>0; i--)
+	/* Visit the non-zero AC coefficients only, the length of a run of
+	 * zeros is the distance to the previous one. */
+	nonzero = nonzero_mask (Temp) & ~(uint64_t) 1;
+	last = 0;
+	while (nonzero != 0)
 	{
-		if ((Coeff = *Temp_Ptr++) != 0)
+		i = (uint16) __builtin_ctzll (nonzero);
+		nonzero &= nonzero - 1;
+		RunLength = (uint16) (i - last - 1);
+		last = i;
+
+		while (RunLength > 15)
 		{
-			while (RunLength > 15)
-			{
-				RunLength -= 16;
-				data = AcCodeTable [161];
-				numbits = AcSizeTable [161];
-				PUTBITS
-			}
+			RunLength -= 16;
+			data = AcCodeTable [161];
+			numbits = AcSizeTable [161];
+			PUTBITS
+			if (ac_count != NULL)
+				ac_count [161]++;
+		}
 
-			AbsCoeff = (Coeff < 0) ? -Coeff-- : Coeff;
+		Coeff = (int16) Temp [i];
+		AbsCoeff = (Coeff < 0) ? -Coeff-- : Coeff;
 
-			if (AbsCoeff >> 8 == 0)
-				DataSize = bitsize [AbsCoeff];
-			else
-				DataSize = bitsize [AbsCoeff >> 8] + 8;
+		if (AbsCoeff >> 8 == 0)
+			DataSize = bitsize [AbsCoeff];
+		else
+			DataSize = bitsize [AbsCoeff >> 8] + 8;
 
-			index = RunLength * 10 + DataSize;
-			HuffCode = AcCodeTable [index];
-			HuffSize = AcSizeTable [index];
+		index = RunLength * 10 + DataSize;
+		HuffCode = AcCodeTable [index];
+		HuffSize = AcSizeTable [index];
+		if (ac_count != NULL)
+			ac_count [index]++;
 
-			Coeff &= (1 << DataSize) - 1;
-			data = (HuffCode << DataSize) | Coeff;
-			numbits = HuffSize + DataSize;
+		Coeff &= (1 << DataSize) - 1;
+		data = (HuffCode << DataSize) | Coeff;
+		numbits = HuffSize + DataSize;
 
-			PUTBITS
-			RunLength = 0;
-		}
-		else
-			RunLength++;
+		PUTBITS
 	}
 
-	if (RunLength != 0)
+	/* End of block unless the last coefficient is non-zero. */
+	if (last != 63)
 	{
 		data = AcCodeTable [0];
 		numbits = AcSizeTable [0];
 		PUTBITS
+		if (ac_count != NULL)
+			ac_count [0]++;
 	}
+
+	/* Less than 32 bits are left in the buffer. */
+	jpeg_encoder_structure->lcode = (uint32) lcode;
+	jpeg_encoder_structure->bitindex = bitindex;
 	return output_ptr;
 }
 
 /* For bit Stuffing and EOI marker */
-uint8* close_bitstream (uint8 *output_ptr)
+uint8* flush_bitstream (JPEG_ENCODER_STRUCTURE *jpeg_encoder_structure, uint8 *output_ptr)
 {
 	uint16 i, count;
 	uint8 *ptr;
+	uint32 lcode = jpeg_encoder_structure->lcode;
+	uint16 bitindex = jpeg_encoder_structure->bitindex;
 
 	if (bitindex > 0)
 	{
-		lcode <<= (32 - bitindex);
+		/* Pad the last byte with 1-bits. */
+		lcode = (lcode << (32 - bitindex)) | (0xffffffff >> bitindex);
 		count = (bitindex + 7) >> 3;
 
 		ptr = (uint8 *) &lcode + 3;
@@ -170,6 +311,15 @@ uint8* close_bitstream (uint8 *output_ptr)
 		}
 	}
 
+	jpeg_encoder_structure->lcode = 0;
+	jpeg_encoder_structure->bitindex = 0;
+	return output_ptr;
+}
+
+uint8* close_bitstream (JPEG_ENCODER_STRUCTURE *jpeg_encoder_structure, uint8 *output_ptr)
+{
+	output_ptr = flush_bitstream (jpeg_encoder_structure, output_ptr);
+
 	/* End of image marker */
 	*output_ptr++ = 0xFF;
 	*output_ptr++ = 0xD9;
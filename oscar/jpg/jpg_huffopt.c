@@ -0,0 +1,233 @@
+/*	JPEG encoder library
+	Original Implementation by Nitin Gupta
+	Adapted to leanXcam by Reto Baettig
+	
+	This library is free software; you can redistribute it and/or modify it
+	under the terms of the GNU Lesser General Public License as published by
+	the Free Software Foundation; either version 2.1 of the License, or (at
+	your option) any later version.
+	
+	This library is distributed in the hope that it will be useful, but
+	WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser
+	General Public License for more details.
+	
+	You should have received a copy of the GNU Lesser General Public License
+	along with this library; if not, write to the Free Software Foundation,
+	Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+
+/*! @file
+ * @brief Huffman tables built from the symbols counted in an image.
+ * 
+ * The code lengths are found and limited to 16 bits as described in
+ * Annex K.2 and K.3 of the JPEG standard, the codes are assigned as in
+ * Annex C.
+ */
+
+#include "jpg.h"
+
+/*! @brief The reserved symbol that keeps the all ones code unused. */
+#define RESERVED_SYMBOL		256
+
+/* JPEG symbol of an index into the AC tables. */
+static uint8 ac_symbol (uint16 index)
+{
+	if (index == 0)
+		return 0x00;
+	if (index == 161)
+		return 0xF0;
+	return (uint8) ((((index - 1) / 10) << 4) | ((index - 1) % 10 + 1));
+}
+
+/*********************************************************************//*!
+ * @brief Build the DHT contents of one table from symbol counts.
+ * 
+ * @param count Count of each symbol, 0 for unused ones. Changed.
+ * @param bits The number of codes per length 1 to 16 is returned here.
+ * @param values The symbols ordered by code length are returned here.
+ * @return The number of symbols.
+ *//*********************************************************************/
+static uint16 build_table (uint32 count [RESERVED_SYMBOL + 1], uint8 bits [16], uint8 *values)
+{
+	uint8 code_size [RESERVED_SYMBOL + 1];
+	int16 others [RESERVED_SYMBOL + 1];
+	uint16 length_count [33];
+	int16 i, j, c1, c2;
+	uint32 min1, min2;
+	uint16 n = 0;
+
+	memset (code_size, 0, sizeof (code_size));
+	memset (length_count, 0, sizeof (length_count));
+	for (i=0; i<=RESERVED_SYMBOL; i++)
+		others [i] = -1;
+	count [RESERVED_SYMBOL] = 1;
+
+	/* Merge the two least frequent trees until one is left, the code
+	 * size of every symbol in them grows by one. */
+	for (;;)
+	{
+		c1 = c2 = -1;
+		min1 = min2 = 0xffffffff;
+		for (i=0; i<=RESERVED_SYMBOL; i++)
+		{
+			if (count [i] == 0)
+				continue;
+			if (count [i] <= min1)
+			{
+				min2 = min1;
+				c2 = c1;
+				min1 = count [i];
+				c1 = i;
+			}
+			else if (count [i] <= min2)
+			{
+				min2 = count [i];
+				c2 = i;
+			}
+		}
+		if (c2 < 0)
+			break;
+
+		count [c1] += count [c2];
+		count [c2] = 0;
+
+		code_size [c1]++;
+		while (others [c1] >= 0)
+		{
+			c1 = others [c1];
+			code_size [c1]++;
+		}
+		others [c1] = c2;
+
+		code_size [c2]++;
+		while (others [c2] >= 0)
+		{
+			c2 = others [c2];
+			code_size [c2]++;
+		}
+	}
+
+	for (i=0; i<=RESERVED_SYMBOL; i++)
+		length_count [code_size [i]]++;
+
+	/* Limit the code length to 16 bits. Two codes of the longest length
+	 * are replaced by one a bit shorter and a shorter code is split. */
+	for (i=32; i>16; i--)
+	{
+		while (length_count [i] > 0)
+		{
+			j = (int16) (i - 2);
+			while (length_count [j] == 0)
+				j--;
+			length_count [i] -= 2;
+			length_count [i - 1]++;
+			length_count [j + 1] += 2;
+			length_count [j]--;
+		}
+	}
+
+	/* Drop the reserved symbol, it has one of the longest codes. */
+	i = 16;
+	while (length_count [i] == 0)
+		i--;
+	length_count [i]--;
+
+	for (i=1; i<=16; i++)
+		bits [i - 1] = (uint8) length_count [i];
+
+	/* Symbols of equal code size are kept in order, the reserved one
+	 * was last and is left out. */
+	for (i=1; i<=32; i++)
+	{
+		for (j=0; j<RESERVED_SYMBOL; j++)
+		{
+			if (code_size [j] == i)
+				values [n++] = (uint8) j;
+		}
+	}
+	return n;
+}
+
+/*********************************************************************//*!
+ * @brief Assign the codes of a table from its DHT contents.
+ * 
+ * @param bits Number of codes per length.
+ * @param values The symbols ordered by code length.
+ * @param code The code of each JPEG symbol is returned here.
+ * @param size The code length of each JPEG symbol is returned here.
+ *//*********************************************************************/
+static void assign_codes (const uint8 bits [16], const uint8 *values, uint16 code [256], uint8 size [256])
+{
+	uint16 length, i, k = 0, next = 0;
+
+	for (length=1; length<=16; length++)
+	{
+		for (i=0; i<bits [length - 1]; i++)
+		{
+			code [values [k]] = next++;
+			size [values [k]] = (uint8) length;
+			k++;
+		}
+		next <<= 1;
+	}
+}
+
+void build_huffman_tables (JPEG_ENCODER_STRUCTURE *jpeg, bool all_symbols)
+{
+	uint32 count [RESERVED_SYMBOL + 1];
+	uint16 code [256];
+	uint8 size [256];
+	uint16 table, i, dht;
+
+	for (table=0; table<2; table++)
+	{
+		/* DC */
+		dht = table;
+		memset (count, 0, sizeof (count));
+		for (i=0; i<DC_SYMBOLS; i++)
+			count [i] = (all_symbols && jpeg->dc_count [table][i] == 0) ? 1 : jpeg->dc_count [table][i];
+		jpeg->dht_count [dht] = build_table (count, jpeg->dht_bits [dht], jpeg->dht_values [dht]);
+		assign_codes (jpeg->dht_bits [dht], jpeg->dht_values [dht], code, size);
+		for (i=0; i<DC_SYMBOLS; i++)
+		{
+			jpeg->dc_code [table][i] = code [i];
+			jpeg->dc_size [table][i] = size [i];
+		}
+
+		/* AC */
+		dht = (uint16) (table + 2);
+		memset (count, 0, sizeof (count));
+		for (i=0; i<AC_SYMBOLS; i++)
+			count [ac_symbol (i)] = (all_symbols && jpeg->ac_count [table][i] == 0) ? 1 : jpeg->ac_count [table][i];
+		jpeg->dht_count [dht] = build_table (count, jpeg->dht_bits [dht], jpeg->dht_values [dht]);
+		assign_codes (jpeg->dht_bits [dht], jpeg->dht_values [dht], code, size);
+		for (i=0; i<AC_SYMBOLS; i++)
+		{
+			jpeg->ac_code [table][i] = code [ac_symbol (i)];
+			jpeg->ac_size [table][i] = size [ac_symbol (i)];
+		}
+	}
+
+	jpeg->huffman_custom = TRUE;
+}
+
+void clear_symbol_counts (JPEG_ENCODER_STRUCTURE *jpeg)
+{
+	memset (jpeg->dc_count, 0, sizeof (jpeg->dc_count));
+	memset (jpeg->ac_count, 0, sizeof (jpeg->ac_count));
+}
+
+void add_symbol_counts (JPEG_ENCODER_STRUCTURE *jpeg, const JPEG_ENCODER_STRUCTURE *from)
+{
+	uint16 table, i;
+
+	for (table=0; table<2; table++)
+	{
+		for (i=0; i<DC_SYMBOLS; i++)
+			jpeg->dc_count [table][i] += from->dc_count [table][i];
+		for (i=0; i<AC_SYMBOLS; i++)
+			jpeg->ac_count [table][i] += from->ac_count [table][i];
+	}
+}
@@ -22,7 +22,45 @@
 
 /* Header for JPEG Encoder */
 
-uint8* write_markers (uint8 *output_ptr, uint32 image_format, uint32 image_width, uint32 image_height)
+/* The bytes of the DHT marker, starting with the marker itself. The
+ * tables follow in the order luminance DC, chrominance DC, luminance AC,
+ * chrominance AC. */
+#define MARKER_BYTE(i) ((uint8) (markerdata [(i) >> 1] >> (((i) & 1) ? 0 : 8)))
+#define DHT_LUMINANCE_DC_START	4
+#define DHT_CHROMINANCE_DC_START	33
+#define DHT_LUMINANCE_AC_START	62
+#define DHT_CHROMINANCE_AC_START	241
+#define DHT_END	420
+
+/* Table class and destination of the custom tables in their order. */
+static const uint8 dht_table_ids [4] = {0x00, 0x01, 0x10, 0x11};
+
+static uint8* write_custom_dht (JPEG_ENCODER_STRUCTURE *jpeg, uint8 *output_ptr, uint32 image_format)
+{
+	uint16 i, header_length = 2;
+	uint16 step = (image_format == OSC_PICTURE_YUV_400) ? 2 : 1;
+
+	for (i=0; i<4; i+=step)
+		header_length = (uint16) (header_length + 17 + jpeg->dht_count [i]);
+
+	*output_ptr++ = 0xFF;
+	*output_ptr++ = 0xC4;
+	*output_ptr++ = (uint8) (header_length >> 8);
+	*output_ptr++ = (uint8) header_length;
+
+	/* A greyscale image only needs the luminance tables. */
+	for (i=0; i<4; i+=step)
+	{
+		*output_ptr++ = dht_table_ids [i];
+		memcpy (output_ptr, jpeg->dht_bits [i], 16);
+		output_ptr += 16;
+		memcpy (output_ptr, jpeg->dht_values [i], jpeg->dht_count [i]);
+		output_ptr += jpeg->dht_count [i];
+	}
+	return output_ptr;
+}
+
+uint8* write_markers (JPEG_ENCODER_STRUCTURE *jpeg, uint8 *output_ptr, uint32 image_format, uint32 image_width, uint32 image_height)
 {
 	uint16 i, header_length;
 	uint8 number_of_components;
@@ -35,29 +73,61 @@ uint8* write_markers (uint8 *output_ptr, uint32 image_format, uint32 image_width
 	*output_ptr++ = 0xFF;
 	*output_ptr++ = 0xDB;
 
-	/* Quantization table length */
-	*output_ptr++ = 0x00;
-	*output_ptr++ = 0x84;
+	/* Quantization table length, a greyscale image only needs Lqt */
+	header_length = (image_format == OSC_PICTURE_YUV_400) ? 0x43 : 0x84;
+	*output_ptr++ = (uint8) (header_length >> 8);
+	*output_ptr++ = (uint8) header_length;
 
 	/* Pq, Tq */
 	*output_ptr++ = 0x00;
 
 	/* Lqt table */
-	for (i=0; i<64; i++)
-		*output_ptr++ = Lqt [i];
+	memcpy (output_ptr, jpeg->Lqt, BLOCK_SIZE);
+	output_ptr += BLOCK_SIZE;
 
-	/* Pq, Tq */
-	*output_ptr++ = 0x01;
+	if (image_format != OSC_PICTURE_YUV_400)
+	{
+		/* Pq, Tq */
+		*output_ptr++ = 0x01;
 
-	/* Cqt table */
-	for (i=0; i<64; i++)
-		*output_ptr++ = Cqt [i];
+		/* Cqt table */
+		memcpy (output_ptr, jpeg->Cqt, BLOCK_SIZE);
+		output_ptr += BLOCK_SIZE;
+	}
 
 	/* huffman table(DHT) */
-	for (i=0; i<210; i++)
+	if (jpeg->huffman_custom)
+		output_ptr = write_custom_dht (jpeg, output_ptr, image_format);
+	else if (image_format == OSC_PICTURE_YUV_400)
 	{
-		*output_ptr++ = (uint8) (markerdata [i] >> 8);
-		*output_ptr++ = (uint8) markerdata [i];
+		/* Only the luminance tables. */
+		header_length = (uint16) (2 + (DHT_CHROMINANCE_DC_START - DHT_LUMINANCE_DC_START) +
+				(DHT_CHROMINANCE_AC_START - DHT_LUMINANCE_AC_START));
+		*output_ptr++ = 0xFF;
+		*output_ptr++ = 0xC4;
+		*output_ptr++ = (uint8) (header_length >> 8);
+		*output_ptr++ = (uint8) header_length;
+
+		for (i=DHT_LUMINANCE_DC_START; i<DHT_CHROMINANCE_DC_START; i++)
+			*output_ptr++ = MARKER_BYTE (i);
+		for (i=DHT_LUMINANCE_AC_START; i<DHT_CHROMINANCE_AC_START; i++)
+			*output_ptr++ = MARKER_BYTE (i);
+	}
+	else
+	{
+		for (i=0; i<DHT_END; i++)
+			*output_ptr++ = MARKER_BYTE (i);
+	}
+
+	/* Restart interval(DRI) */
+	if (jpeg->restart_interval != 0)
+	{
+		*output_ptr++ = 0xFF;
+		*output_ptr++ = 0xDD;
+		*output_ptr++ = 0x00;
+		*output_ptr++ = 0x04;
+		*output_ptr++ = (uint8) (jpeg->restart_interval >> 8);
+		*output_ptr++ = (uint8) jpeg->restart_interval;
 	}
 
 	if (image_format == OSC_PICTURE_YUV_400)
@@ -20,99 +20,97 @@
 #include "jpg.h"
 #include "jpg_quantdata.h"
 
-/*	This function implements 16 Step division for Q.15 format data */
-uint16 DSP_Division (uint32 numer, uint32 denom)
+/* Scale factors of the AAN DCT outputs in Q.14:
+ * 16384 * a[u] * a[v] with a[0] = 1 and a[k] = cos(k*PI/16) * root(2) */
+static const uint16 aanscales [] =
 {
-	uint16 i;
+	16384, 22725, 21407, 19266, 16384, 12873,  8867,  4520,
+	22725, 31521, 29692, 26722, 22725, 17855, 12299,  6270,
+	21407, 29692, 27969, 25172, 21407, 16819, 11585,  5906,
+	19266, 26722, 25172, 22654, 19266, 15137, 10426,  5315,
+	16384, 22725, 21407, 19266, 16384, 12873,  8867,  4520,
+	12873, 17855, 16819, 15137, 12873, 10114,  6967,  3552,
+	 8867, 12299, 11585, 10426,  8867,  6967,  4799,  2446,
+	 4520,  6270,  5906,  5315,  4520,  3552,  2446,  1247
+};
+
+/* The DCT outputs coefficient i scaled by 8 * aanscales [i] / 16384, so
+ * it is quantized with the divisor D = value * aanscales [i] / 2048. The
+ * division is a multiplication by recip / 2^(16 + b) with
+ * 2^b <= D < 2^(b+1), which keeps 16 significant bits in recip. D must
+ * be at least 2, see min_quant_value. */
+static void compute_divisor (DCT_DIVISORS *divisors, uint16 index, uint32 value, uint32 aanscale)
+{
+	uint32 numer = value * aanscale;
+	uint32 recip;
+	uint16 b = 0;
 
-	denom <<= 15;
+	while ((numer >> (b + 12)) != 0)
+		b++;
 
-	for (i=16; i>0; i--)
-	{
-		if (numer > denom)
-		{
-			numer -= denom;
-			numer <<= 1;
-			numer++;
-		}
-		else
-			numer <<= 1;
-	}
+	recip = (uint32) (((1ULL << (27 + b)) + (numer >> 1)) / numer);
+	if (recip > 0xffff)
+		recip = 0xffff;
+
+	divisors->recip [index] = (uint16) recip;
+	divisors->corr [index] = (uint16) ((numer + 0x800) >> 12);
+	divisors->scale [index] = (uint16) (1 << (16 - b));
+}
 
-	return (uint16) numer;
+/* Smallest quantization value for which the divisor of the coefficient is
+ * at least 2. Only reached at the highest qualities. */
+static uint32 min_quant_value (uint32 aanscale)
+{
+	return (4096 + aanscale - 1) / aanscale;
+}
+
+void set_quantization_base (JPEG_ENCODER_STRUCTURE *jpeg, const uint8 *luminance, const uint8 *chrominance)
+{
+	memcpy (jpeg->Lbase, luminance != NULL ? luminance : luminance_quant_table, BLOCK_SIZE);
+	memcpy (jpeg->Cbase, chrominance != NULL ? chrominance : chrominance_quant_table, BLOCK_SIZE);
+	jpeg->tables_valid = FALSE;
 }
 
-/* Multiply Quantization table with quality factor to get LQT and CQT */
-void initialize_quantization_tables (uint32 quality_factor)
+/* Multiply Quantization table with quality factor to get LQT and CQT. The
+ * tables are kept until the quality factor or the base tables change. */
+void initialize_quantization_tables (JPEG_ENCODER_STRUCTURE *jpeg, uint32 quality_factor)
 {
-	uint16 i, index;
+	uint16 i, index, transposed;
 	uint32 value;
 
-	uint8 luminance_quant_table [] =
-	{
-		16, 11, 10, 16,  24,  40,  51,  61,
-		12, 12, 14, 19,  26,  58,  60,  55,
-		14, 13, 16, 24,  40,  57,  69,  56,
-		14, 17, 22, 29,  51,  87,  80,  62,
-		18, 22, 37, 56,  68, 109, 103,  77,
-		24, 35, 55, 64,  81, 104, 113,  92,
-		49, 64, 78, 87, 103, 121, 120, 101,
-		72, 92, 95, 98, 112, 100, 103,  99
-	};
-
-	uint8 chrominance_quant_table [] =
-	{
-		17, 18, 24, 47, 99, 99, 99, 99,
-		18, 21, 26, 66, 99, 99, 99, 99,
-		24, 26, 56, 99, 99, 99, 99, 99,
-		47, 66, 99, 99, 99, 99, 99, 99,
-		99, 99, 99, 99, 99, 99, 99, 99,
-		99, 99, 99, 99, 99, 99, 99, 99,
-		99, 99, 99, 99, 99, 99, 99, 99,
-		99, 99, 99, 99, 99, 99, 99, 99
-	};
+	if (jpeg->tables_valid && jpeg->tables_quality == quality_factor)
+		return;
 
 	for (i=0; i<64; i++)
 	{
 		index = zigzag_table [i];
+		transposed = (uint16) (((i & 7) << 3) | (i >> 3));
 
 		/* luminance quantization table * quality factor */
-		value = luminance_quant_table [i] * quality_factor;
+		value = jpeg->Lbase [i] * quality_factor;
 		value = (value + 0x200) >> 10;
 
-		if (value == 0)
-			value = 1;
+		if (value < min_quant_value (aanscales [i]))
+			value = min_quant_value (aanscales [i]);
 		else if (value > 255)
 			value = 255;
 
-		Lqt [index] = (uint8) value;
-		ILqt [i] = DSP_Division (0x8000, value);
+		jpeg->Lqt [index] = (uint8) value;
+		compute_divisor (&jpeg->Ldiv, transposed, value, aanscales [i]);
 
 		/* chrominance quantization table * quality factor */
-		value = chrominance_quant_table [i] * quality_factor;
+		value = jpeg->Cbase [i] * quality_factor;
 		value = (value + 0x200) >> 10;
 
-		if (value == 0)
-			value = 1;
+		if (value < min_quant_value (aanscales [i]))
+			value = min_quant_value (aanscales [i]);
 		else if (value > 255)
 			value = 255;
 
-		Cqt [index] = (uint8) value;
-		ICqt [i] = DSP_Division (0x8000, value);
+		jpeg->Cqt [index] = (uint8) value;
+		compute_divisor (&jpeg->Cdiv, transposed, value, aanscales [i]);
 	}
-}
-
-/* multiply DCT Coefficients with Quantization table and store in ZigZag location */
-void quantization (int16* const data, uint16* const quant_table_ptr, uint16 *Temp)
-{
-	int16 i;
-	int32 value;
-
-	for (i=63; i>=0; i--)
-	{
-		value = data [i] * quant_table_ptr [i];
-		value = (value + 0x4000) >> 15;
 
-		Temp [zigzag_table [i]] = (uint16) value;
-	}
+	jpeg->tables_quality = quality_factor;
+	jpeg->tables_valid = TRUE;
 }
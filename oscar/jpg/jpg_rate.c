@@ -0,0 +1,108 @@
+/*	JPEG encoder library
+	Original Implementation by Nitin Gupta
+	Adapted to leanXcam by Reto Baettig
+	
+	This library is free software; you can redistribute it and/or modify it
+	under the terms of the GNU Lesser General Public License as published by
+	the Free Software Foundation; either version 2.1 of the License, or (at
+	your option) any later version.
+	
+	This library is distributed in the hope that it will be useful, but
+	WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser
+	General Public License for more details.
+	
+	You should have received a copy of the GNU Lesser General Public License
+	along with this library; if not, write to the Free Software Foundation,
+	Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+
+/*! @file
+ * @brief Rate control of the JPEG encoder.
+ * 
+ * The size of the entropy coded data falls roughly with the quality
+ * factor to the power of 0.6 to 0.75 over the useful range, depending on
+ * the image, so the quality factor for a given size is found by scaling
+ * the one of the previous image by the ratio of the sizes to the power
+ * of 3/2. This errs on the small side. The markers do not depend
+ * on the quality and are left out. Done in integer arithmetic, the target
+ * has no FPU.
+ */
+
+#include "jpg.h"
+
+/*! @brief Limits of the quality factor chosen by the rate control. Below
+ * and above nearly all quantization values are saturated. */
+#define RATE_MIN_QUALITY	8
+#define RATE_MAX_QUALITY	32768
+
+/* Largest r with r^2 <= value, for values below 2^40. */
+static uint32 square_root (uint64_t value)
+{
+	uint32 root = 0;
+	int16 bit;
+
+	for (bit=19; bit>=0; bit--)
+	{
+		uint64_t t = root | (1UL << bit);
+
+		if (t * t <= value)
+			root = (uint32) t;
+	}
+	return root;
+}
+
+/* The quality factor with which an image that took bytes at
+ * quality_factor would take aim bytes, both including the markers. */
+static uint32 predict_quality (JPEG_ENCODER_STRUCTURE *jpeg, uint32 quality_factor, uint32 bytes, uint32 aim)
+{
+	uint64_t ratio, quality;
+
+	bytes = (bytes > jpeg->marker_bytes) ? bytes - jpeg->marker_bytes : 1;
+	aim = (aim > jpeg->marker_bytes) ? aim - jpeg->marker_bytes : 1;
+
+	/* Q.16, limited to a factor of 16 per step. */
+	ratio = ((uint64_t) bytes << 16) / aim;
+	if (ratio < (1 << 12))
+		ratio = 1 << 12;
+	else if (ratio > (1 << 20))
+		ratio = 1 << 20;
+
+	/* ratio^(3/2) = ratio * square_root (ratio), still in Q.16. */
+	ratio = (ratio * square_root (ratio << 16)) >> 16;
+
+	quality = ((uint64_t) quality_factor * ratio + (1 << 15)) >> 16;
+	if (quality < RATE_MIN_QUALITY)
+		quality = RATE_MIN_QUALITY;
+	else if (quality > RATE_MAX_QUALITY)
+		quality = RATE_MAX_QUALITY;
+	return (uint32) quality;
+}
+
+uint32 rate_control_quality (JPEG_ENCODER_STRUCTURE *jpeg, uint32 quality_factor)
+{
+	if (jpeg->target_bytes == 0 || jpeg->stats.nBytes == 0)
+		return quality_factor;
+
+	/* Leave some room for the next image to be more complex. */
+	return predict_quality (jpeg, jpeg->stats.qualityFactor, jpeg->stats.nBytes,
+			jpeg->target_bytes - (jpeg->target_bytes >> 4));
+}
+
+bool rate_control_retry (JPEG_ENCODER_STRUCTURE *jpeg, uint32 bytes, uint32 limit, uint32 *quality_factor)
+{
+	if (jpeg->target_bytes == 0 || !jpeg->reencode || bytes <= limit)
+		return FALSE;
+
+	/* The second try has to fit, aim lower. */
+	*quality_factor = predict_quality (jpeg, *quality_factor, bytes, limit - (limit >> 3));
+	return TRUE;
+}
+
+void rate_control_update (JPEG_ENCODER_STRUCTURE *jpeg, uint32 bytes, uint32 quality_factor, uint16 encodings)
+{
+	jpeg->stats.nBytes = bytes;
+	jpeg->stats.qualityFactor = quality_factor;
+	jpeg->stats.nEncodings = encodings;
+}
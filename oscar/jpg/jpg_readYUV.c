@@ -48,6 +48,8 @@ void read_400_format (struct IMGDATA *img, JPEG_ENCODER_STRUCTURE *jpeg_encoder_
 	}
 }
 
+/* Each 2x2 block of pixels is stored as the four luminance samples in
+ * row order followed by Cb and Cr. */
 void read_420_format (struct IMGDATA *img, JPEG_ENCODER_STRUCTURE *jpeg_encoder_structure, uint8 *input_ptr)
 {
 	int32 i, j;
@@ -290,6 +292,8 @@ void read_420_format (struct IMGDATA *img, JPEG_ENCODER_STRUCTURE *jpeg_encoder_
 	}
 }
 
+/* The macro pixels are stored in UYVY order, as written by
+ * OscVisFastDebayerYUV422. */
 void read_422_format (struct IMGDATA *img, JPEG_ENCODER_STRUCTURE *jpeg_encoder_structure, uint8 *input_ptr)
 {
 	int32 i, j;
@@ -319,26 +323,26 @@ void read_422_format (struct IMGDATA *img, JPEG_ENCODER_STRUCTURE *jpeg_encoder_
 	{
 		for (j=Y1_cols>>1; j>0; j--)
 		{
-			*Y1_Ptr = *input_ptr;
-			Y1_Ptr++; input_ptr++;
 			*CB_Ptr = *input_ptr;
 			CB_Ptr++; input_ptr++;
 			*Y1_Ptr = *input_ptr;
 			Y1_Ptr++; input_ptr++;
 			*CR_Ptr = *input_ptr;
 			CR_Ptr++; input_ptr++;
+			*Y1_Ptr = *input_ptr;
+			Y1_Ptr++; input_ptr++;
 		}
 
 		for (j=Y2_cols>>1; j>0; j--)
 		{
-			*Y2_Ptr = *input_ptr;
-			Y2_Ptr++; input_ptr++;
 			*CB_Ptr = *input_ptr;
 			CB_Ptr++; input_ptr++;
 			*Y2_Ptr = *input_ptr;
 			Y2_Ptr++; input_ptr++;
 			*CR_Ptr = *input_ptr;
 			CR_Ptr++; input_ptr++;
+			*Y2_Ptr = *input_ptr;
+			Y2_Ptr++; input_ptr++;
 		}
 
 		if (cols <= 8)
@@ -439,41 +443,68 @@ void read_444_format (struct IMGDATA *img, JPEG_ENCODER_STRUCTURE *jpeg_encoder_
 	}
 }
 
-void BGR_2_444 (uint8 *input_ptr, uint8 *output_ptr, uint32 image_width, uint32 image_height)
+void read_color_format (struct IMGDATA *img, JPEG_ENCODER_STRUCTURE *jpeg_encoder_structure, uint8 *input_ptr)
 {
-	uint32 i, size;
-	uint8 R, G, B;
-	int32 Y, Cb, Cr;
+	int32 i, j;
+	int32 Cb_Sum [BLOCK_SIZE], Cr_Sum [BLOCK_SIZE];
+	uint8 Y_Row [16];
+	int16 Cb_Row [16], Cr_Row [16];
+	int16 *Y_Block [4];
+	int16 *Y_Ptr;
+	uint8 *row_ptr;
+	uint16 h_shift, v_shift, c_shift, y, cols, x;
+
+	uint16 mcu_width = jpeg_encoder_structure->mcu_width;
+	uint16 mcu_height = jpeg_encoder_structure->mcu_height;
+	const struct OSC_VIS_COLOR_LAYOUT *layout = &jpeg_encoder_structure->src_layout;
+
+	/* The MCU covers 1, 2 or 4 luminance blocks and one chrominance block
+	 * per component, the chrominance is averaged over the pixels that
+	 * share a sample. */
+	h_shift = (mcu_width == 16);
+	v_shift = (mcu_height == 16);
+	c_shift = (uint16) (8 + h_shift + v_shift);
+
+	Y_Block [0] = img->Y1;
+	Y_Block [1] = img->Y2;
+	Y_Block [2] = img->Y3;
+	Y_Block [3] = img->Y4;
+
+	/* Pixels outside the image repeat the last row and column, like the
+	 * other read functions do. */
+	cols = (uint16) MIN(mcu_width, jpeg_encoder_structure->src_width - jpeg_encoder_structure->mcu_x);
+
+	memset (Cb_Sum, 0, sizeof(Cb_Sum));
+	memset (Cr_Sum, 0, sizeof(Cr_Sum));
+
+	for (i=0; i<mcu_height; i++)
+	{
+		int32 *Cb_Ptr = Cb_Sum + ((i >> v_shift) << 3);
+		int32 *Cr_Ptr = Cr_Sum + ((i >> v_shift) << 3);
+
+		y = (uint16) (jpeg_encoder_structure->mcu_y + i);
+		if (y >= jpeg_encoder_structure->src_height)
+			y = (uint16) (jpeg_encoder_structure->src_height - 1);
+		row_ptr = jpeg_encoder_structure->src + y * jpeg_encoder_structure->src_ystep +
+				jpeg_encoder_structure->mcu_x * layout->step;
+
+		OscVisColorToYCbCr (row_ptr, layout, cols, Y_Row, Cb_Row, Cr_Row);
+
+		for (j=0; j<mcu_width; j++)
+		{
+			x = (uint16) MIN(j, cols - 1);
+
+			Y_Ptr = Y_Block [((i >> 3) << 1) + (j >> 3)];
+			Y_Ptr [((i & 7) << 3) + (j & 7)] = Y_Row [x];
 
-	size = image_width * image_height;
+			Cb_Ptr [j >> h_shift] += Cb_Row [x];
+			Cr_Ptr [j >> h_shift] += Cr_Row [x];
+		}
+	}
 
-	for (i=size; i>0; i--)
+	for (i=0; i<BLOCK_SIZE; i++)
 	{
-		B = *input_ptr++;
-		G = *input_ptr++;
-		R = *input_ptr++;
-
-		Y = ((77 * R + 150 * G + 29 * B) >> 8);
-		Cb = ((-43 * R - 85 * G + 128 * B) >> 8) + 128;
-		Cr = ((128 * R - 107 * G - 21 * B) >> 8) + 128;
-
-		if (Y < 0)
-			Y = 0;
-		else if (Y > 255)
-			Y = 255;
-
-		if (Cb < 0)
-			Cb = 0;
-		else if (Cb > 255)
-			Cb = 255;
-
-		if (Cr < 0)
-			Cr = 0;
-		else if (Cr > 255)
-			Cr = 255;
-
-		*output_ptr++ = (uint8) Y;
-		*output_ptr++ = (uint8) Cb;
-		*output_ptr++ = (uint8) Cr;
+		img->CB [i] = (int16) ((Cb_Sum [i] >> c_shift) + 128);
+		img->CR [i] = (int16) ((Cr_Sum [i] >> c_shift) + 128);
 	}
 }
@@ -0,0 +1,326 @@
+/*	JPEG encoder library
+	Original Implementation by Nitin Gupta
+	Adapted to leanXcam by Reto Baettig
+	
+	This library is free software; you can redistribute it and/or modify it
+	under the terms of the GNU Lesser General Public License as published by
+	the Free Software Foundation; either version 2.1 of the License, or (at
+	your option) any later version.
+	
+	This library is distributed in the hope that it will be useful, but
+	WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser
+	General Public License for more details.
+	
+	You should have received a copy of the GNU Lesser General Public License
+	along with this library; if not, write to the Free Software Foundation,
+	Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+/*! @file
+ * @brief Encoding of the slices of a JPEG image on several threads.
+ * 
+ * The threads of the pool are started on the first image that is split
+ * into slices and wait for the next image afterwards. Every thread, and
+ * the caller, takes the next slice not yet taken and encodes it into a
+ * buffer of its own using a private copy of the encoder. The caller
+ * concatenates the slices once all are done.
+ */
+
+#include <pthread.h>
+
+#include "jpg.h"
+
+/*! @brief The encoded data of one slice. */
+struct JPEG_SLICE {
+	uint8 *buffer;          /*!< @brief Memory for the slice. */
+	uint32 size;            /*!< @brief Size of buffer. */
+	uint8 *end;             /*!< @brief End of the encoded data. */
+};
+
+/*! @brief Threads of an encoder and the image they are working on. */
+struct JPEG_SLICE_POOL {
+	pthread_t aryThreads[MAX_JPEG_THREADS];
+	uint16 nThreads;        /*!< @brief Number of started threads. */
+
+	pthread_mutex_t mutex;
+	/*! @brief Signalled when a new image is to be encoded or the threads
+	 * have to quit. */
+	pthread_cond_t condStart;
+	/*! @brief Signalled when the last slice is done. */
+	pthread_cond_t condDone;
+
+	uint32 image;           /*!< @brief Incremented for every image. */
+	bool bQuit;
+
+	/*! @brief The encoder with the image being encoded. */
+	JPEG_ENCODER_STRUCTURE *jpeg;
+	uint32 image_format;
+	uint16 nSlices;
+	uint16 nextSlice;       /*!< @brief The next slice not yet taken. */
+	uint16 nSlicesDone;
+
+	struct JPEG_SLICE *arySlices;
+	uint16 nSliceBuffers;   /*!< @brief Number of entries in arySlices. */
+};
+
+/*********************************************************************//*!
+ * @brief Encode slices of the current image until none is left.
+ * 
+ * @param pPool The pool.
+ *//*********************************************************************/
+static void EncodeSlices(struct JPEG_SLICE_POOL *pPool)
+{
+	JPEG_ENCODER_STRUCTURE jpeg;
+	struct JPEG_SLICE *pSlice;
+	uint16 slice;
+
+	pthread_mutex_lock(&pPool->mutex);
+	if (pPool->nextSlice < pPool->nSlices)
+	{
+		/* The encoder does not change until all slices are done. */
+		memcpy(&jpeg, pPool->jpeg, sizeof(jpeg));
+		/* The slices go to buffers of their own. */
+		jpeg.sink = NULL;
+		/* The symbols are counted per thread and added up at the end. */
+		if (jpeg.count_symbols)
+			clear_symbol_counts(&jpeg);
+	}
+
+	while (pPool->nextSlice < pPool->nSlices)
+	{
+		slice = pPool->nextSlice++;
+		pthread_mutex_unlock(&pPool->mutex);
+
+		pSlice = &pPool->arySlices[slice];
+		pSlice->end = encode_slice(&jpeg, pPool->image_format, slice, pSlice->buffer);
+
+		pthread_mutex_lock(&pPool->mutex);
+		if (jpeg.count_symbols && pPool->nextSlice == pPool->nSlices)
+		{
+			/* Counted before the last slice is reported done, the
+			 * caller uses the counts right after. */
+			add_symbol_counts(pPool->jpeg, &jpeg);
+		}
+		pPool->nSlicesDone++;
+		if (pPool->nSlicesDone == pPool->nSlices)
+			pthread_cond_signal(&pPool->condDone);
+	}
+	pthread_mutex_unlock(&pPool->mutex);
+}
+
+/*********************************************************************//*!
+ * @brief Main function of the threads of the pool.
+ * 
+ * @param pArg The pool.
+ * @return Always NULL.
+ *//*********************************************************************/
+static void * SliceThread(void *pArg)
+{
+	struct JPEG_SLICE_POOL *pPool = pArg;
+	/* The pool is new, no image has been handed out yet. */
+	uint32 image = 0;
+
+	pthread_mutex_lock(&pPool->mutex);
+	for (;;)
+	{
+		while (!pPool->bQuit && pPool->image == image)
+			pthread_cond_wait(&pPool->condStart, &pPool->mutex);
+		if (pPool->bQuit)
+			break;
+		image = pPool->image;
+		pthread_mutex_unlock(&pPool->mutex);
+
+		EncodeSlices(pPool);
+
+		pthread_mutex_lock(&pPool->mutex);
+	}
+	pthread_mutex_unlock(&pPool->mutex);
+	return NULL;
+}
+
+/*********************************************************************//*!
+ * @brief Create the pool of an encoder and start its threads.
+ * 
+ * @param jpeg The encoder.
+ * @return SUCCESS or an appropriate error code otherwise
+ *//*********************************************************************/
+static OSC_ERR CreateSlicePool(JPEG_ENCODER_STRUCTURE *jpeg)
+{
+	struct JPEG_SLICE_POOL *pPool;
+
+	pPool = malloc(sizeof(struct JPEG_SLICE_POOL));
+	if (pPool == NULL)
+		return -EOUT_OF_MEMORY;
+	memset(pPool, 0, sizeof(struct JPEG_SLICE_POOL));
+
+	pthread_mutex_init(&pPool->mutex, NULL);
+	pthread_cond_init(&pPool->condStart, NULL);
+	pthread_cond_init(&pPool->condDone, NULL);
+	jpeg->pool = pPool;
+
+	/* The caller encodes slices as well. */
+	while (pPool->nThreads < jpeg->threads - 1)
+	{
+		if (pthread_create(&pPool->aryThreads[pPool->nThreads], NULL, SliceThread, pPool) != 0)
+		{
+			OscLog(ERROR, "%s: Could not start thread!\n", __func__);
+			destroy_slice_pool(jpeg);
+			return -EDEVICE;
+		}
+		pPool->nThreads++;
+	}
+
+	return SUCCESS;
+}
+
+/*********************************************************************//*!
+ * @brief Make sure there is a buffer large enough for every slice of the
+ * current image.
+ * 
+ * @param jpeg The encoder.
+ * @param image_format Sampling format of the JPEG.
+ * @return SUCCESS or an appropriate error code otherwise
+ *//*********************************************************************/
+static OSC_ERR AllocSliceBuffers(JPEG_ENCODER_STRUCTURE *jpeg, uint32 image_format)
+{
+	struct JPEG_SLICE_POOL *pPool = jpeg->pool;
+	struct JPEG_SLICE *pSlices;
+	uint32 size, blocks;
+	uint16 slice;
+
+	if (pPool->nSliceBuffers < jpeg->slices)
+	{
+		pSlices = realloc(pPool->arySlices, jpeg->slices * sizeof(struct JPEG_SLICE));
+		if (pSlices == NULL)
+			return -EOUT_OF_MEMORY;
+		memset(pSlices + pPool->nSliceBuffers, 0,
+				(jpeg->slices - pPool->nSliceBuffers) * sizeof(struct JPEG_SLICE));
+		pPool->arySlices = pSlices;
+		pPool->nSliceBuffers = jpeg->slices;
+	}
+
+	switch (image_format)
+	{
+	case OSC_PICTURE_YUV_400:
+		blocks = 1;
+		break;
+	case OSC_PICTURE_YUV_422:
+		blocks = 4;
+		break;
+	case OSC_PICTURE_YUV_420:
+		blocks = 6;
+		break;
+	default:
+		blocks = 3;
+		break;
+	}
+
+	/* Room for the flushed bit buffer included. */
+	size = (uint32) jpeg->slice_rows * jpeg->horizontal_mcus * blocks * MAX_BLOCK_BYTES + 8;
+	for (slice = 0; slice < jpeg->slices; slice++)
+	{
+		struct JPEG_SLICE *pSlice = &pPool->arySlices[slice];
+
+		if (pSlice->size < size)
+		{
+			free(pSlice->buffer);
+			pSlice->buffer = malloc(size);
+			pSlice->size = (pSlice->buffer == NULL) ? 0 : size;
+			if (pSlice->buffer == NULL)
+				return -EOUT_OF_MEMORY;
+		}
+	}
+
+	return SUCCESS;
+}
+
+uint8* encode_slices (JPEG_ENCODER_STRUCTURE *jpeg_encoder_structure, uint32 image_format, uint8 *output_ptr)
+{
+	struct JPEG_SLICE_POOL *pPool;
+	uint32 len;
+	uint16 slice;
+
+	if (jpeg_encoder_structure->threads <= 1 || jpeg_encoder_structure->slices <= 1)
+		return encode_slices_sequential (jpeg_encoder_structure, image_format, output_ptr);
+
+	if (jpeg_encoder_structure->pool == NULL)
+	{
+		if (CreateSlicePool(jpeg_encoder_structure) != SUCCESS)
+		{
+			OscLog(WARN, "%s: Encoding without threads.\n", __func__);
+			return encode_slices_sequential (jpeg_encoder_structure, image_format, output_ptr);
+		}
+	}
+	pPool = jpeg_encoder_structure->pool;
+
+	if (AllocSliceBuffers(jpeg_encoder_structure, image_format) != SUCCESS)
+	{
+		OscLog(ERROR, "%s: Could not allocate memory!\n", __func__);
+		jpeg_encoder_structure->error = -EOUT_OF_MEMORY;
+		return NULL;
+	}
+
+	/* Hand the image to the threads and help encoding it. */
+	pthread_mutex_lock(&pPool->mutex);
+	pPool->jpeg = jpeg_encoder_structure;
+	pPool->image_format = image_format;
+	pPool->nSlices = jpeg_encoder_structure->slices;
+	pPool->nextSlice = 0;
+	pPool->nSlicesDone = 0;
+	pPool->image++;
+	pthread_cond_broadcast(&pPool->condStart);
+	pthread_mutex_unlock(&pPool->mutex);
+
+	EncodeSlices(pPool);
+
+	pthread_mutex_lock(&pPool->mutex);
+	while (pPool->nSlicesDone < pPool->nSlices)
+		pthread_cond_wait(&pPool->condDone, &pPool->mutex);
+	pthread_mutex_unlock(&pPool->mutex);
+
+	/* Nothing is written while counting the symbols. */
+	if (jpeg_encoder_structure->code_block == gather_symbols)
+		return output_ptr;
+
+	for (slice = 0; slice < jpeg_encoder_structure->slices; slice++)
+	{
+		/* RST0 follows the first slice. */
+		if (slice > 0)
+			output_ptr = write_restart_marker (output_ptr, (uint16) (slice - 1));
+
+		len = pPool->arySlices[slice].end - pPool->arySlices[slice].buffer;
+		output_ptr = write_slice_data (jpeg_encoder_structure, output_ptr, pPool->arySlices[slice].buffer, len);
+		if (output_ptr == NULL)
+			return NULL;
+	}
+
+	return output_ptr;
+}
+
+void destroy_slice_pool (JPEG_ENCODER_STRUCTURE *jpeg_encoder_structure)
+{
+	struct JPEG_SLICE_POOL *pPool = jpeg_encoder_structure->pool;
+	uint16 i;
+
+	if (pPool == NULL)
+		return;
+
+	pthread_mutex_lock(&pPool->mutex);
+	pPool->bQuit = TRUE;
+	pthread_cond_broadcast(&pPool->condStart);
+	pthread_mutex_unlock(&pPool->mutex);
+
+	for (i = 0; i < pPool->nThreads; i++)
+		pthread_join(pPool->aryThreads[i], NULL);
+
+	for (i = 0; i < pPool->nSliceBuffers; i++)
+		free(pPool->arySlices[i].buffer);
+	free(pPool->arySlices);
+
+	pthread_cond_destroy(&pPool->condDone);
+	pthread_cond_destroy(&pPool->condStart);
+	pthread_mutex_destroy(&pPool->mutex);
+	free(pPool);
+	jpeg_encoder_structure->pool = NULL;
+}
@@ -0,0 +1,36 @@
+/*	JPEG encoder library
+	Original Implementation by Nitin Gupta
+	Adapted to leanXcam by Reto Baettig
+	
+	This library is free software; you can redistribute it and/or modify it
+	under the terms of the GNU Lesser General Public License as published by
+	the Free Software Foundation; either version 2.1 of the License, or (at
+	your option) any later version.
+	
+	This library is distributed in the hope that it will be useful, but
+	WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser
+	General Public License for more details.
+	
+	You should have received a copy of the GNU Lesser General Public License
+	along with this library; if not, write to the Free Software Foundation,
+	Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+/*! @file
+ * @brief Encoding of the slices of a JPEG image on the target.
+ * 
+ * The Blackfin has a single core, so the slices are always encoded one
+ * after the other and the number of threads is ignored.
+ */
+
+#include "jpg.h"
+
+uint8* encode_slices (JPEG_ENCODER_STRUCTURE *jpeg_encoder_structure, uint32 image_format, uint8 *output_ptr)
+{
+	return encode_slices_sequential (jpeg_encoder_structure, image_format, output_ptr);
+}
+
+void destroy_slice_pool (JPEG_ENCODER_STRUCTURE *jpeg_encoder_structure)
+{
+}
@@ -22,56 +22,7 @@
 #ifndef DEBAYER_BILINEAR_H_
 #define DEBAYER_BILINEAR_H_
 
-/*********************************************************************//*!
- * @brief Preprocess a row of the image by calculating all possible
- * interpolations in every pixel
- * 
- * For bilinear interpolation, there are 4 possible filters:
- * - Vertical average:     01 (02) 03  One row up
- *                         11 !12! 13  Current row
- *                         21 (22) 23  One row down
- * VertAvg[12] = (02 + 22)/2
- *
- * - Horizontal average:   01  02  03  One row up
- *                        (11)!12!(13) Current row
- *                         21  22  23  One row down
- * HorizAvg[12] = (11 + 13)/2
- *
- * - X average:           (01) 02 (03) One row up
- *                         11 !12! 13  Current row
- *                        (21) 22 (23) One row down
- * XAvg[12] = ((01 + 21)/2 + (03 + 23)/2)/2
- *
- * - + average:            01 (02) 03  One row up
- *                        (11)!12!(13) Current row
- *                         21 (22) 23  One row down
- * PlusAvg[12] = ((11 + 13)/2 + (02 + 22)/2)/2
- * 
- * The supplied temporary memory area is divided into 4 sections of size
- * <width> and the calculated filters are saved there per pixel in 
- * above error.
- * @see debayerBilinearPreprocRowFirstOrLast
- *
- * @param pTmp Pointer to temporary memory of size 4 * width
- * @param width Width of the row.
- * @param pOneRowUp Pointer to the source row one line above the currently
- *        preprocessed row
- * @param pCurRow Pointer to the currently preprocessed source row.
- * @param pOneRowDown Pointer to the source row one line below the currently
- *        preprocessed row
- *
- *//*********************************************************************/
-void debayerBilinearPreprocRow(uint8 *pTmp, 
-			       uint32 width, 
-			       const uint8* pOneRowUp,
-			       const uint8* pCurRow,
-			       const uint8* pOneRowDown);
-
-/*********************************************************************//*!
- * @brief Preprocess a border row of the image by calculating all possible
- * interpolations in every pixel
- * 
- * For bilinear interpolation, there are 4 possible filters:
+/* For bilinear interpolation, there are 4 possible filters:
  * - Vertical average:     01 (02) 03  One row up
  *                         11 !12! 13  Current row
  *                         21 (22) 23  One row down
@@ -92,26 +43,12 @@ void debayerBilinearPreprocRow(uint8 *pTmp,
  *                         21 (22) 23  One row down
  * PlusAvg[12] = ((11 + 13)/2 + (02 + 22)/2)/2
  *
- * The supplied temporary memory area is divided into 4 sections of size
- * <width> and the calculated filters are saved there per pixel in 
- * above error.
- * Since this version of the function is adapted to the border cases
- * (first or last row), the filters are truncated.
- * @see debayerBilinearPreprocRow
- *
- * @param pTmp Pointer to temporary memory of size 4 * width
- * @param width Width of the row.
- * @param pOneRowUpOrDown Pointer to the source row one line above or below 
- *        the currently preprocessed row, depending on whether this is
- *        called for the first or the last row of an image.
- * @param pCurRow Pointer to the currently preprocessed source row.
- *
- *//*********************************************************************/
-void debayerBilinearPreprocRowFirstOrLast(uint8 *pTmp, 
-					  uint32 width, 
-					  const uint8* pOneRowUpOrDown,
-					  const uint8* pCurRow);
-
+ * In the first and the last row, the missing neighbor row is replaced by
+ * the one on the other side and the + average is truncated to
+ * (2 * HorizAvg + VertAvg)/3.
+ * The target preprocesses every row into the 4 sections of the temporary
+ * memory, the host calculates the filters on the fly.
+ */
 
 /*********************************************************************//*!
  * @brief Debayer an image to BGR color format using bilinear debayering.
@@ -128,7 +65,7 @@ void debayerBilinearPreprocRowFirstOrLast(uint8 *pTmp,
  * zero.
  * @param height Height of the source image
  * @param pTmp Temporary memory for intermediate calculations
- * (size: width x 4)
+ * (size: width x 4), only used on the target.
  * @param enBayerOrder The order of the bayer pattern in the source image.
  * @return SUCCESS or an appropriate error code.
  *//*********************************************************************/
@@ -16,10 +16,112 @@
 	Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
 */
 
-/*! @file Bilinear debayering to BGR format on host. */
+/*! @file Bilinear debayering to BGR format on host.
+ *
+ * Each row is debayered in one pass directly from the source rows above,
+ * at and below it, without the preprocessing into temporary memory done
+ * on the target. The rows are split into bands done on several threads.
+ */
 /* Helper functions */
 #include "DebayerBilinear.h"
+#include "vis.h"
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+/*! @brief Vertical average at a pixel. */
+#define VERT_AVG(pix) BIASED_AVG(pOneRowUp[pix], pOneRowDown[pix])
+/*! @brief Horizontal average at a pixel. */
+#define HORIZ_AVG(pix) BIASED_AVG(pCurRow[(pix) - 1], pCurRow[(pix) + 1])
+/*! @brief X average at a pixel. */
+#define X_AVG(pix) BIASED_AVG(VERT_AVG((pix) - 1), VERT_AVG((pix) + 1))
+/*! @brief + average at a pixel, truncated in the first and the last
+ * row. */
+#define PLUS_AVG(pix) (bBorderRow ? (HORIZ_AVG(pix) * 2 + VERT_AVG(pix))/3 : \
+		       BIASED_AVG(HORIZ_AVG(pix), VERT_AVG(pix)))
+
+/*! @brief A band of rows of the image. */
+struct DEBAYER_BILINEAR_BAND {
+  uint8 *pDst;
+  const uint8 *pSrc;
+  uint32 width;
+  uint32 height;
+  uint32 firstRow;
+  uint32 endRow;
+  enum EnBayerOrder enBayerOrder;
+};
+
+#ifdef __SSE2__
+/*********************************************************************//*!
+ * @brief Store 16 pixels given as planes of blue, green and red as
+ *        packed BGR.
+ *
+ * Also overwrites the 2 bytes after the 48 bytes of the pixels.
+ * @param pDst Output (BGR format)
+ * @param blue The blue color of the pixels.
+ * @param green The green color of the pixels.
+ * @param red The red color of the pixels.
+ *
+ *//*********************************************************************/
+static inline void storeBgr16(uint8 *pDst, __m128i blue, __m128i green, __m128i red)
+{
+  const __m128i mask = _mm_set_epi32(0, -1, 0, -1);
+  __m128i bg[2], r[2], pix, packed;
+  int i;
 
+  bg[0] = _mm_unpacklo_epi8(blue, green);
+  bg[1] = _mm_unpackhi_epi8(blue, green);
+  r[0] = _mm_unpacklo_epi8(red, _mm_setzero_si128());
+  r[1] = _mm_unpackhi_epi8(red, _mm_setzero_si128());
+
+  for(i = 0; i < 4; i++)
+  {
+    // Four pixels in the low three bytes of 32 bits each, packed to 12
+    // bytes in two 64 bit stores.
+    pix = (i & 1) ? _mm_unpackhi_epi16(bg[i/2], r[i/2]) : _mm_unpacklo_epi16(bg[i/2], r[i/2]);
+    packed = _mm_or_si128(_mm_and_si128(pix, mask),
+			  _mm_slli_epi64(_mm_srli_epi64(pix, 32), 24));
+    _mm_storel_epi64((__m128i *)&pDst[12*i], packed);
+    _mm_storel_epi64((__m128i *)&pDst[12*i + 6], _mm_srli_si128(packed, 8));
+  }
+}
+
+/*********************************************************************//*!
+ * @brief Calculate the filters of 16 pixels of a row that is neither the
+ *        first nor the last.
+ *
+ * @param pOneRowUp Source row one line above, at the first pixel.
+ * @param pCurRow Current source row, at the first pixel.
+ * @param pOneRowDown Source row one line below, at the first pixel.
+ * @param pVertAvg Vertical average.
+ * @param pHorizAvg Horizontal average.
+ * @param pXAvg X average.
+ * @param pPlusAvg + average.
+ *
+ *//*********************************************************************/
+static inline void filters16(const uint8 *pOneRowUp,
+			     const uint8 *pCurRow,
+			     const uint8 *pOneRowDown,
+			     __m128i *pVertAvg,
+			     __m128i *pHorizAvg,
+			     __m128i *pXAvg,
+			     __m128i *pPlusAvg)
+{
+  // _mm_avg_epu8 rounds up like BIASED_AVG.
+  __m128i vertLeft = _mm_avg_epu8(_mm_loadu_si128((const __m128i *)&pOneRowUp[-1]),
+				  _mm_loadu_si128((const __m128i *)&pOneRowDown[-1]));
+  __m128i vertRight = _mm_avg_epu8(_mm_loadu_si128((const __m128i *)&pOneRowUp[1]),
+				   _mm_loadu_si128((const __m128i *)&pOneRowDown[1]));
+
+  *pVertAvg = _mm_avg_epu8(_mm_loadu_si128((const __m128i *)pOneRowUp),
+			   _mm_loadu_si128((const __m128i *)pOneRowDown));
+  *pHorizAvg = _mm_avg_epu8(_mm_loadu_si128((const __m128i *)&pCurRow[-1]),
+			    _mm_loadu_si128((const __m128i *)&pCurRow[1]));
+  *pXAvg = _mm_avg_epu8(vertLeft, vertRight);
+  *pPlusAvg = _mm_avg_epu8(*pHorizAvg, *pVertAvg);
+}
+#endif /* __SSE2__ */
 
 /*********************************************************************//*!
  * @brief Assemble a row from a BGBG bayer order source for the output 
@@ -28,78 +130,85 @@
  * Special treatment has to be applied to the border cases (left and right
  * border).
  * @param pDstRow Output row (BGR format)
- * @param pVertAvg Preprocessed vertical average
- * @param pHorizAvg Preprocessed horizontal average
- * @param pXAvg Preprocessed X average
- * @param pPlusAvg Preprocessed + average
- * @param pSrcRow Current source row in BGBG bayer order.
+ * @param pOneRowUp Source row one line above, or below in the first row.
+ * @param pCurRow Current source row in BGBG bayer order.
+ * @param pOneRowDown Source row one line below, or above in the last row.
+ * @param bBorderRow Whether this is the first or the last row.
  * @param width Width of the row.
  *
  *//*********************************************************************/
 static void bgbgToBgr(uint8 *pDstRow,
-		      const uint8 *pVertAvg,
-		      const uint8 *pHorizAvg,
-		      const uint8 *pXAvg,
-		      const uint8 *pPlusAvg,
-		      const uint8 *pSrcRow,
+		      const uint8 *pOneRowUp,
+		      const uint8 *pCurRow,
+		      const uint8 *pOneRowDown,
+		      bool bBorderRow,
 		      uint32 width)
 {
-  uint32 pix;
+  uint32 pix = 1;
 
   /******* First Blue pixel *******/
   // Blue color of first blue pixel
-  *pDstRow++ = *pSrcRow++;
+  *pDstRow++ = pCurRow[0];
 
   // Green color of first blue pixel
-  *pDstRow++ = ((2 * *pVertAvg++) + *pSrcRow)/3;
+  *pDstRow++ = ((2 * VERT_AVG(0)) + pCurRow[1])/3;
 
   // Red color of first blue pixel
-  *pDstRow++ = *pVertAvg;
+  *pDstRow++ = VERT_AVG(1);
+
+#ifdef __SSE2__
+  if(!bBorderRow)
+  {
+    // The even lanes are the green pixels.
+    const __m128i isGreen = _mm_set1_epi16(0x00ff);
+    __m128i vertAvg, horizAvg, xAvg, plusAvg, src;
 
-  pHorizAvg++;
-  pXAvg++;
-  pPlusAvg++;
+    for(; pix + 16 <= width - 1; pix += 16)
+    {
+      filters16(&pOneRowUp[pix], &pCurRow[pix], &pOneRowDown[pix],
+		&vertAvg, &horizAvg, &xAvg, &plusAvg);
+      src = _mm_loadu_si128((const __m128i *)&pCurRow[pix]);
+      storeBgr16(pDstRow,
+		 VisSelect(isGreen, horizAvg, src),
+		 VisSelect(isGreen, src, plusAvg),
+		 VisSelect(isGreen, vertAvg, xAvg));
+      pDstRow += 16 * 3;
+    }
+  }
+#endif /* __SSE2__ */
 
-  for(pix = 0; pix < width - 2; )
+  for(; pix < width - 1; pix += 2)
   {
     /********** Green pixel ***********/
     // Blue color of green pixel
-    *pDstRow++ = *pHorizAvg++;
+    *pDstRow++ = HORIZ_AVG(pix);
 
     // Green color of green pixel
-    *pDstRow++ = *pSrcRow++;
+    *pDstRow++ = pCurRow[pix];
 
     // Red color of green pixel
-    *pDstRow++ = *pVertAvg++;
-
-    pXAvg++;
-    pPlusAvg++;
-    pix++;
+    *pDstRow++ = VERT_AVG(pix);
 
     /********** Blue pixel ***********/
     // Blue color of blue pixel
-    *pDstRow++ = *pSrcRow++;
+    *pDstRow++ = pCurRow[pix + 1];
 
     // Green color of blue pixel
-    *pDstRow++ = *pPlusAvg++;
+    *pDstRow++ = PLUS_AVG(pix + 1);
 
     // Red color of blue pixel
-    *pDstRow++ = *pXAvg++;
-
-    pVertAvg++;
-    pHorizAvg++;
-    pix++;
+    *pDstRow++ = X_AVG(pix + 1);
   }
 
   /******* Last green pixel *********/  
   // Blue color of last green pixel
-  *pDstRow++ = pSrcRow[(ptrdiff_t)(-1)];
+  *pDstRow++ = pCurRow[pix - 1];
 
   // Green color of last green pixel
-  *pDstRow++ = *pSrcRow++;
+  *pDstRow++ = pCurRow[pix];
 
   // Red color of last green pixel
-  *pDstRow++ = *pVertAvg++;
+  *pDstRow++ = VERT_AVG(pix);
 }
 
 /*********************************************************************//*!
@@ -109,148 +218,160 @@ static void bgbgToBgr(uint8 *pDstRow,
  * Special treatment has to be applied to the border cases (left and right
  * border).
  * @param pDstRow Output row (BGR format)
- * @param pVertAvg Preprocessed vertical average
- * @param pHorizAvg Preprocessed horizontal average
- * @param pXAvg Preprocessed X average
- * @param pPlusAvg Preprocessed + average
- * @param pSrcRow Current source row in GRGR bayer order.
+ * @param pOneRowUp Source row one line above, or below in the first row.
+ * @param pCurRow Current source row in GRGR bayer order.
+ * @param pOneRowDown Source row one line below, or above in the last row.
+ * @param bBorderRow Whether this is the first or the last row.
  * @param width Width of the row.
  *
  *//*********************************************************************/
 static void grgrToBgr(uint8 *pDstRow,
-		      const uint8 *pVertAvg,
-		      const uint8 *pHorizAvg,
-		      const uint8 *pXAvg,
-		      const uint8 *pPlusAvg,
-		      const uint8 *pSrcRow,
+		      const uint8 *pOneRowUp,
+		      const uint8 *pCurRow,
+		      const uint8 *pOneRowDown,
+		      bool bBorderRow,
 		      uint32 width)
 {
-  uint32 pix;
+  uint32 pix = 1;
 
   /******* First Green pixel *******/
   // Blue color of first green pixel
-  *pDstRow++ = *pVertAvg++;
+  *pDstRow++ = VERT_AVG(0);
 
   // Green color of first green pixel
-  *pDstRow++ = *pSrcRow++;
+  *pDstRow++ = pCurRow[0];
 
   // Red color of first green pixel
-  *pDstRow++ = *pSrcRow;
+  *pDstRow++ = pCurRow[1];
+
+#ifdef __SSE2__
+  if(!bBorderRow)
+  {
+    // The even lanes are the red pixels.
+    const __m128i isRed = _mm_set1_epi16(0x00ff);
+    __m128i vertAvg, horizAvg, xAvg, plusAvg, src;
 
-  pHorizAvg++;
-  pXAvg++;
-  pPlusAvg++;
+    for(; pix + 16 <= width - 1; pix += 16)
+    {
+      filters16(&pOneRowUp[pix], &pCurRow[pix], &pOneRowDown[pix],
+		&vertAvg, &horizAvg, &xAvg, &plusAvg);
+      src = _mm_loadu_si128((const __m128i *)&pCurRow[pix]);
+      storeBgr16(pDstRow,
+		 VisSelect(isRed, xAvg, vertAvg),
+		 VisSelect(isRed, plusAvg, src),
+		 VisSelect(isRed, src, horizAvg));
+      pDstRow += 16 * 3;
+    }
+  }
+#endif /* __SSE2__ */
 
-  for(pix = 0; pix < width - 2; )
+  for(; pix < width - 1; pix += 2)
   {
     /********** Red pixel ***********/
     // Blue color of red pixel
-    *pDstRow++ = *pXAvg++;
+    *pDstRow++ = X_AVG(pix);
 
     // Green color of red pixel
-    *pDstRow++ = *pPlusAvg++;
+    *pDstRow++ = PLUS_AVG(pix);
 
     // Red color of red pixel
-    *pDstRow++ = *pSrcRow++;
-
-    pVertAvg++;
-    pHorizAvg++;
-    pix++;
+    *pDstRow++ = pCurRow[pix];
 
     /********** Green pixel ***********/
     // Blue color of green pixel
-    *pDstRow++ = *pVertAvg++;
+    *pDstRow++ = VERT_AVG(pix + 1);
 
     // Green color of green pixel
-    *pDstRow++ = *pSrcRow++;
+    *pDstRow++ = pCurRow[pix + 1];
 
     // Red color of green pixel
-    *pDstRow++ = *pHorizAvg++;
-
-    pXAvg++;
-    pPlusAvg++;
-    pix++;
+    *pDstRow++ = HORIZ_AVG(pix + 1);
   }
 
   /******* Last red pixel *********/  
   // Blue color of last red pixel
-  *pDstRow++ = pVertAvg[(ptrdiff_t)(-1)];
+  *pDstRow++ = VERT_AVG(pix - 1);
 
   // Green color of last red pixel
-  *pDstRow++ = ((*pVertAvg * 2) + pSrcRow[(ptrdiff_t)(-1)])/3;
+  *pDstRow++ = ((VERT_AVG(pix) * 2) + pCurRow[pix - 1])/3;
 
   // Red color of last red pixel
-  *pDstRow++ = *pSrcRow++;
+  *pDstRow++ = pCurRow[pix];
 }
 
-OSC_ERR DebayerBilinearBGR(uint8 *pDst, 
-			   uint8 *pSrc, 
-			   uint32 width, 
-			   uint32 height, 
-			   uint8 *pTmp, 
-			   enum EnBayerOrder enBayerOrder)
+/*********************************************************************//*!
+ * @brief Debayer a band of rows.
+ *
+ * @param pArg The band.
+ * @return Always NULL.
+ *
+ *//*********************************************************************/
+static void * debayerBand(void *pArg)
 {
+  const struct DEBAYER_BILINEAR_BAND *pBand = pArg;
+  const uint32 width = pBand->width;
   uint32 row;
-  uint8* pCurRow = pSrc;
-  uint8* pOneRowUp = &pSrc[-(ptrdiff_t)(width)];
-  uint8* pOneRowDown = &pSrc[width];
-  enum EnBayerOrder enRowBayerOrder = enBayerOrder;
-  
-  for(row = 0; row < height; row++)
+
+  for(row = pBand->firstRow; row < pBand->endRow; row++)
     {
-      // First, do all the calculations (filters) for the current row
-      // The first and the last row require special treatment.
-      if(row == 0)
-	{
-	  debayerBilinearPreprocRowFirstOrLast(pTmp,
-					       width,
-					       pOneRowDown,
-					       pCurRow);
-	} else if(row == (height - 1)) {
-	  debayerBilinearPreprocRowFirstOrLast(pTmp,
-					       width,
-					       pOneRowUp,
-					       pCurRow);	
-      } else {
-	  debayerBilinearPreprocRow(pTmp,
-				    width,
-				    pOneRowUp,
-				    pCurRow,
-				    pOneRowDown);
-      }
-
-      // Then, pick out the value we need to the format we want.
-      switch(enRowBayerOrder)
+      const uint8 *pCurRow = &pBand->pSrc[row*width];
+      // The first and the last row take the neighbor on the other side
+      // for both.
+      const uint8 *pOneRowUp = (row == 0) ? &pCurRow[width] : &pCurRow[-(ptrdiff_t)(width)];
+      const uint8 *pOneRowDown = (row == pBand->height - 1) ? pOneRowUp : &pCurRow[width];
+      bool bBorderRow = (row == 0) || (row == pBand->height - 1);
+
+      // Even rows have the bayer order of the image.
+      if((pBand->enBayerOrder == ROW_BGBG) == (row % 2 == 0))
 	{
-	case ROW_BGBG:
-	  bgbgToBgr(&pDst[row*width*3],
-		    pTmp,
-		    &pTmp[width],
-		    &pTmp[2*width],
-		    &pTmp[3*width],
+	  bgbgToBgr(&pBand->pDst[row*width*3],
+		    pOneRowUp,
 		    pCurRow,
+		    pOneRowDown,
+		    bBorderRow,
 		    width);
-	  enRowBayerOrder = ROW_GRGR;
-	  break;
-	case ROW_GRGR:
-	  grgrToBgr(&pDst[row*width*3],
-		    pTmp,
-		    &pTmp[width],
-		    &pTmp[2*width],
-		    &pTmp[3*width],
+	} else {
+	  grgrToBgr(&pBand->pDst[row*width*3],
+		    pOneRowUp,
 		    pCurRow,
+		    pOneRowDown,
+		    bBorderRow,
 		    width);
-	  enRowBayerOrder = ROW_BGBG;
-	  break;
-	default:
-	  OscLog(ERROR, "%s: Unsupported bayer order encountered! (%d)\n",
-		 __func__, enBayerOrder);
-	  return -EUNSUPPORTED;
 	}
-      pCurRow += width;
-      pOneRowUp += width;
-      pOneRowDown += width;
     }
+  return NULL;
+}
+
+OSC_ERR DebayerBilinearBGR(uint8 *pDst, 
+			   uint8 *pSrc, 
+			   uint32 width, 
+			   uint32 height, 
+			   uint8 *pTmp, 
+			   enum EnBayerOrder enBayerOrder)
+{
+  struct DEBAYER_BILINEAR_BAND aryBands[MAX_VIS_BANDS];
+  uint16 nBands, i;
+
+  if(enBayerOrder != ROW_BGBG && enBayerOrder != ROW_GRGR)
+    {
+      OscLog(ERROR, "%s: Unsupported bayer order encountered! (%d)\n",
+	     __func__, enBayerOrder);
+      return -EUNSUPPORTED;
+    }
+
+  // The temporary memory is only needed on the target.
+  nBands = VisGetBandCount(height, MIN_VIS_BAND_ROWS);
+  for(i = 0; i < nBands; i++)
+    {
+      aryBands[i].pDst = pDst;
+      aryBands[i].pSrc = pSrc;
+      aryBands[i].width = width;
+      aryBands[i].height = height;
+      aryBands[i].firstRow = height * i / nBands;
+      aryBands[i].endRow = height * (i + 1) / nBands;
+      aryBands[i].enBayerOrder = enBayerOrder;
+    }
+  VisRunBands(debayerBand, aryBands, sizeof(aryBands[0]), nBands);
 
   return SUCCESS;
 }
@@ -0,0 +1,69 @@
+/*	Oscar, a hardware abstraction framework for the LeanXcam and IndXcam.
+	Copyright (C) 2008 Supercomputing Systems AG
+	
+	This library is free software; you can redistribute it and/or modify it
+	under the terms of the GNU Lesser General Public License as published by
+	the Free Software Foundation; either version 2.1 of the License, or (at
+	your option) any later version.
+	
+	This library is distributed in the hope that it will be useful, but
+	WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser
+	General Public License for more details.
+	
+	You should have received a copy of the GNU Lesser General Public License
+	along with this library; if not, write to the Free Software Foundation,
+	Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+/*! @file
+ * @brief Splitting image operations into bands of rows run on several
+ * threads on the host.
+ */
+
+#include <pthread.h>
+#include <unistd.h>
+
+#include "vis.h"
+
+uint16 VisGetBandCount(const uint32 nRows, const uint32 minRows)
+{
+	long nProcessors = sysconf(_SC_NPROCESSORS_ONLN);
+	uint32 nBands = nRows / minRows;
+
+	if (nProcessors < (long)nBands)
+		nBands = (uint32)nProcessors;
+	if (nBands > MAX_VIS_BANDS)
+		nBands = MAX_VIS_BANDS;
+	if (nBands < 1)
+		nBands = 1;
+
+	return (uint16)nBands;
+}
+
+void VisRunBands(void * (*pfBand)(void *),
+		void *pBands,
+		const size_t bandSize,
+		const uint16 nBands)
+{
+	pthread_t aryThreads[MAX_VIS_BANDS];
+	bool aryStarted[MAX_VIS_BANDS];
+	uint8 *pBand = pBands;
+	uint16 i;
+
+	for (i = 1; i < nBands; i++)
+	{
+		aryStarted[i] = (pthread_create(&aryThreads[i], NULL, pfBand,
+				&pBand[i * bandSize]) == 0);
+	}
+
+	pfBand(pBands);
+
+	for (i = 1; i < nBands; i++)
+	{
+		if (aryStarted[i])
+			pthread_join(aryThreads[i], NULL);
+		else
+			pfBand(&pBand[i * bandSize]);
+	}
+}
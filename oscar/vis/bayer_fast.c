@@ -25,6 +25,43 @@
 
 #include "vis.h"
 
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#ifdef __SSE2__
+/*! @brief Store 4 pixels held in the low three bytes of the 32 bit
+ * values as 12 packed bytes. Also overwrites the 2 bytes after them. */
+static inline void StorePacked3x4(uint8 *pOut, __m128i pix)
+{
+	__m128i packed = _mm_or_si128(_mm_and_si128(pix, _mm_set_epi32(0, -1, 0, -1)),
+			_mm_slli_epi64(_mm_srli_epi64(pix, 32), 24));
+
+	_mm_storel_epi64((__m128i *)pOut, packed);
+	_mm_storel_epi64((__m128i *)&pOut[6], _mm_srli_si128(packed, 8));
+}
+#endif /* __SSE2__ */
+
+/*! @brief Number of pixels of a row OscVisFastDebayerYUV422 converts at
+ * once. */
+#define YUV_CHUNK 256
+
+/*********************************************************************//*!
+ * @brief Get the layout of the 2x2 blocks of a raw image, whose first
+ * row is blue and green. Only the green of the first row is used.
+ * 
+ * @param width Width of the raw image.
+ * @param pLayout The layout to fill out.
+ *//*********************************************************************/
+static void GetBlockLayout(const uint16 width, struct OSC_VIS_COLOR_LAYOUT *pLayout)
+{
+	pLayout->offsetB = 0;
+	pLayout->offsetG1 = 1;
+	pLayout->offsetG2 = 1;
+	pLayout->offsetR = width + 1;
+	pLayout->step = 2;
+}
+
 
 OSC_ERR OscVisFastDebayerBGR(const struct OSC_PICTURE *pRaw, struct OSC_PICTURE *pOut) 
 {
@@ -34,7 +71,23 @@ OSC_ERR OscVisFastDebayerBGR(const struct OSC_PICTURE *pRaw, struct OSC_PICTURE
 	char *out = (char *)pOut->data;
 
 	for (y=0; y<pRaw->height; y+=2) {
-		for (x=0; x<pRaw->width; x+=2) {
+		x = 0;
+#ifdef __SSE2__
+		/* The stores write past the last pixel, so at least one block
+		 * is left to the scalar loop. */
+		for (; x + 16 < pRaw->width; x += 16) {
+			__m128i row0 = _mm_loadu_si128((const __m128i *)&in[y*pRaw->width+x]);
+			__m128i R = _mm_srli_epi16(_mm_loadu_si128((const __m128i *)&in[(y+1)*pRaw->width+x]), 8);
+			/* Blue and green are already next to each other in the first row. */
+			__m128i bytes01 = row0;
+			__m128i byte2 = R;
+
+			StorePacked3x4((uint8 *)&out[outPos], _mm_unpacklo_epi16(bytes01, byte2));
+			StorePacked3x4((uint8 *)&out[outPos+12], _mm_unpackhi_epi16(bytes01, byte2));
+			outPos += 24;
+		}
+#endif /* __SSE2__ */
+		for (; x<pRaw->width; x+=2) {
 			/* Blue */
 			out[outPos++]=in[y*pRaw->width+x];			
 			/* Green */
@@ -57,7 +110,22 @@ OSC_ERR OscVisFastDebayerRGB(const struct OSC_PICTURE *pRaw, struct OSC_PICTURE
 	unsigned char *out = (unsigned char *)pOut->data;
 
 	for (y=0; y<pRaw->height; y+=2) {
-		for (x=0; x<pRaw->width; x+=2) {
+		x = 0;
+#ifdef __SSE2__
+		/* The stores write past the last pixel, so at least one block
+		 * is left to the scalar loop. */
+		for (; x + 16 < pRaw->width; x += 16) {
+			__m128i row0 = _mm_loadu_si128((const __m128i *)&in[y*pRaw->width+x]);
+			__m128i R = _mm_srli_epi16(_mm_loadu_si128((const __m128i *)&in[(y+1)*pRaw->width+x]), 8);
+			__m128i bytes01 = _mm_or_si128(_mm_and_si128(row0, _mm_set1_epi16((int16)0xff00)), R);
+			__m128i byte2 = _mm_and_si128(row0, _mm_set1_epi16(0xff));
+
+			StorePacked3x4((uint8 *)&out[outPos], _mm_unpacklo_epi16(bytes01, byte2));
+			StorePacked3x4((uint8 *)&out[outPos+12], _mm_unpackhi_epi16(bytes01, byte2));
+			outPos += 24;
+		}
+#endif /* __SSE2__ */
+		for (; x<pRaw->width; x+=2) {
 			/* Red */
 			out[outPos++]=in[(y+1)*pRaw->width+x+1];
 			/* Green */
@@ -116,7 +184,27 @@ OSC_ERR OscVisFastDebayerGrey(const struct OSC_PICTURE *pRaw, struct OSC_PICTURE
 	uint8 *out = (uint8 *)pOut->data;
 
 	for (y=0; y<pRaw->height; y+=2) {
-		for (x=0; x<pRaw->width; x+=2) {
+		x = 0;
+#ifdef __SSE2__
+		for (; x + 32 <= pRaw->width; x += 32) {
+			const __m128i lowByte = _mm_set1_epi16(0xff);
+			__m128i sum[2];
+			int i;
+
+			for (i = 0; i < 2; i++) {
+				__m128i row0 = _mm_loadu_si128((const __m128i *)&in[y*pRaw->width+x+16*i]);
+				__m128i row1 = _mm_loadu_si128((const __m128i *)&in[(y+1)*pRaw->width+x+16*i]);
+
+				sum[i] = _mm_add_epi16(
+						_mm_add_epi16(_mm_and_si128(row0, lowByte), _mm_srli_epi16(row0, 8)),
+						_mm_add_epi16(_mm_and_si128(row1, lowByte), _mm_srli_epi16(row1, 8)));
+			}
+			_mm_storeu_si128((__m128i *)&out[outPos],
+					_mm_packus_epi16(_mm_srli_epi16(sum[0], 2), _mm_srli_epi16(sum[1], 2)));
+			outPos += 16;
+		}
+#endif /* __SSE2__ */
+		for (; x<pRaw->width; x+=2) {
 			                /*     blue           +          2x green          +              red           */
 			out[outPos++] = (uint8)(( (uint16)in[y*pRaw->width+x] + 
 						  (uint16)in[y*pRaw->width+x+1] + 
@@ -131,28 +219,20 @@ OSC_ERR OscVisFastDebayerGrey(const struct OSC_PICTURE *pRaw, struct OSC_PICTURE
 }
 
 
+
+
 OSC_ERR OscVisFastDebayerLumY(const struct OSC_PICTURE *pRaw, struct OSC_PICTURE *pOut)
 {
-	uint16 x,y;
-	uint32 outPos = 0;
-	int16 pY;
-	int16 R, G, B;
-	unsigned char *in  = (unsigned char *)pRaw->data;
-	unsigned char *out = (unsigned char *)pOut->data;
+	struct OSC_VIS_COLOR_LAYOUT layout;
+	uint16 y;
+	uint8 *in  = (uint8 *)pRaw->data;
+	uint8 *out = (uint8 *)pOut->data;
 
-	for (y=0; y<pRaw->height; y+=2) {
-		for (x=0; x<pRaw->width; x+=2) {
-			R = in[(y+1)*pRaw->width+x+1];
-			G = in[y*pRaw->width+x+1];
-			B = in[y*pRaw->width+x];
-			/* Fixed-Point: Faktoren * 128 */
-			/* Y = 0.299*R+0.587*G+0.114*B) */
-
-			pY = ((38*R + 75*G + 15*B) >> 7);
-			
-			out[outPos++] = pY;
-		} /* for x */
-	} /* for y */
+	GetBlockLayout(pRaw->width, &layout);
+	for (y=0; y<pRaw->height/2; y++) {
+		OscVisColorToYUV(&in[2*y*pRaw->width], &layout, pRaw->width/2,
+				&out[y*(pRaw->width/2)], NULL, NULL);
+	}
 	pOut->width = pRaw->width/2;
 	pOut->height = pRaw->height/2; 
 	pOut->type = OSC_PICTURE_GREYSCALE;
@@ -162,27 +242,16 @@ OSC_ERR OscVisFastDebayerLumY(const struct OSC_PICTURE *pRaw, struct OSC_PICTURE
 
 OSC_ERR OscVisFastDebayerChromU(const struct OSC_PICTURE *pRaw, struct OSC_PICTURE *pOut) 
 {
-	uint16 x,y;
-	uint32 outPos = 0;
-	int16 pY, pU;
-	int16 R, G, B;
-	unsigned char *in  = (unsigned char *)pRaw->data;
-	unsigned char *out = (unsigned char *)pOut->data;
-
-	for (y=0; y<pRaw->height; y+=2) {
-		for (x = 0; x<pRaw->width; x+=2) {
-			R = in[(y+1)*pRaw->width+x+1];
-			G = in[y*pRaw->width+x+1];
-			B = in[y*pRaw->width+x];
-			/* Fixed-Point: Faktoren * 128 */
-			/* Y = 0.299*R+0.587*G+0.114*B) */
-
-			pY = ((38*R + 75*G + 15*B) >> 7);
-			pU = (((B - pY)*63)>>7)+128;
+	struct OSC_VIS_COLOR_LAYOUT layout;
+	uint16 y;
+	uint8 *in  = (uint8 *)pRaw->data;
+	uint8 *out = (uint8 *)pOut->data;
 
-			out[outPos++] = pU;
-		} /* for x */
-	} /* for y */
+	GetBlockLayout(pRaw->width, &layout);
+	for (y=0; y<pRaw->height/2; y++) {
+		OscVisColorToYUV(&in[2*y*pRaw->width], &layout, pRaw->width/2,
+				NULL, &out[y*(pRaw->width/2)], NULL);
+	}
 	pOut->width  = pRaw->width/2;
 	pOut->height = pRaw->height/2; 
 	pOut->type = OSC_PICTURE_CHROM_U;
@@ -192,27 +261,16 @@ OSC_ERR OscVisFastDebayerChromU(const struct OSC_PICTURE *pRaw, struct OSC_PICTU
 
 OSC_ERR OscVisFastDebayerChromV(const struct OSC_PICTURE *pRaw, struct OSC_PICTURE *pOut) 
 {
-	uint16 x,y;
-	uint32 outPos=0;
-	int16 pY, pV;
-	int16 R, G, B;
-	unsigned char *in  = (unsigned char *)pRaw->data;
-	unsigned char *out = (unsigned char *)pOut->data;
-
-	for (y=0; y<pRaw->height; y+=2) {
-		for (x=0; x<pRaw->width; x+=2) {
-			R = in[(y+1)*pRaw->width+x+1];
-			G = in[y*pRaw->width+x+1];
-			B = in[y*pRaw->width+x];
-			/* Fixed-Point: Faktoren * 128 */
-			/* Y = 0.299*R+0.587*G+0.114*B) */
-
-			pY = ((38*R + 75*G + 15*B) >> 7);
-			pV = (((R - pY)*112)>>7)+128;
+	struct OSC_VIS_COLOR_LAYOUT layout;
+	uint16 y;
+	uint8 *in  = (uint8 *)pRaw->data;
+	uint8 *out = (uint8 *)pOut->data;
 
-			out[outPos++] = pV;
-		} /* for x */
-	} /* for y */
+	GetBlockLayout(pRaw->width, &layout);
+	for (y=0; y<pRaw->height/2; y++) {
+		OscVisColorToYUV(&in[2*y*pRaw->width], &layout, pRaw->width/2,
+				NULL, NULL, &out[y*(pRaw->width/2)]);
+	}
 	pOut->width  = pRaw->width/2;
 	pOut->height = pRaw->height/2; 
 	pOut->type  = OSC_PICTURE_CHROM_V;
@@ -222,38 +280,50 @@ OSC_ERR OscVisFastDebayerChromV(const struct OSC_PICTURE *pRaw, struct OSC_PICTU
 
 OSC_ERR OscVisFastDebayerYUV422(const struct OSC_PICTURE *pRaw, struct OSC_PICTURE *pOut) 
 {
-	uint16 x,y;
+	struct OSC_VIS_COLOR_LAYOUT layout;
+	uint8 aryY[YUV_CHUNK + 1], aryU[YUV_CHUNK + 1], aryV[YUV_CHUNK + 1];
+	uint16 x, y, n, i;
 	uint32 outPos = 0;
-	int16 pY1, pY2, pU1, pV1;
-	int16 R1, G1, B1, R2, G2, B2;
-	unsigned char *in  = (unsigned char *)pRaw->data;
-	unsigned char *out = (unsigned char *)pOut->data;
+	uint8 *in  = (uint8 *)pRaw->data;
+	uint8 *out = (uint8 *)pOut->data;
 
+	GetBlockLayout(pRaw->width, &layout);
 	for (y=0; y < pRaw->height; y+=2) {
-		for (x=0; x < pRaw->width; x+=4) {
-			R1 = in[(y+1)*pRaw->width+x+1];
-			G1 = in[y*pRaw->width+x+1];
-			B1 = in[y*pRaw->width+x];
-			R2 = in[(y+1)*pRaw->width+x+3];
-			G2 = in[y*pRaw->width+x+3];
-			B2 = in[y*pRaw->width+x+2];
-			/* Fixed-Point: Faktoren * 128 */
-			/* Y = 0.299*R+0.587*G+0.114*B) */
-
-			pY1 = ((38*R1 + 75*G1 + 15*B1) >> 7);	
-			pU1 = (((B1 - pY1)*63)>>7)+128;
-			pV1 = (((R1 - pY1)*112)>>7)+128;
-
-			pY2 =  (38*R2 + 75*G2 + 15*B2) >> 7;	
-
-			out[outPos++]=pU1;
-			out[outPos++]=pY1;
-			out[outPos++]=pV1;
-			out[outPos++]=pY2;
-
+		/* U and V are those of the first pixel of a pair. */
+		for (x=0; x < pRaw->width/2; x+=n) {
+			n = MIN(YUV_CHUNK, pRaw->width/2 - x) & ~1;
+			if (n == 0)
+				break;
+			/* One more pixel than needed if there is one, so that the
+			 * kernel does not have to leave the end of the chunk to its
+			 * scalar loop. */
+			OscVisColorToYUV(&in[y*pRaw->width+2*x], &layout,
+					MIN(n + 1, pRaw->width/2 - x), aryY, aryU, aryV);
+
+			i = 0;
+#ifdef __SSE2__
+			for (; i + 8 <= n; i += 8) {
+				const __m128i zero = _mm_setzero_si128();
+				__m128i Y = _mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i *)&aryY[i]), zero);
+				__m128i U = _mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i *)&aryU[i]), zero);
+				__m128i V = _mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i *)&aryV[i]), zero);
+				__m128i UV = _mm_or_si128(_mm_and_si128(U, _mm_set1_epi32(0xffff)),
+						_mm_slli_epi32(V, 16));
+
+				_mm_storeu_si128((__m128i *)&out[outPos], _mm_or_si128(UV, _mm_slli_epi16(Y, 8)));
+				outPos += 16;
+			}
+#endif /* __SSE2__ */
+			for (; i < n; i+=2) {
+				out[outPos++]=aryU[i];
+				out[outPos++]=aryY[i];
+				out[outPos++]=aryV[i];
+				out[outPos++]=aryY[i+1];
+			}
 		} /* for x */
 	} /* for y */
-	pOut->width  = pRaw->width/2;
+	/* A macro pixel holds two pixels, a last single one is left out. */
+	pOut->width  = (pRaw->width/2) & ~1;
 	pOut->height = pRaw->height/2; 
 	pOut->type  = OSC_PICTURE_YUV_422;
 	return SUCCESS;
@@ -262,51 +332,16 @@ OSC_ERR OscVisFastDebayerYUV422(const struct OSC_PICTURE *pRaw, struct OSC_PICTU
 
 OSC_ERR OscVisFastDebayerHSL_H(const struct OSC_PICTURE *pRaw, struct OSC_PICTURE *pOut) 
 {
-	uint16 x,y;
-	uint32 outPos = 0;
-	uint8 max, min;
-	uint16 hue;
-	uint16 R, G, B;
-	unsigned char *in  = (unsigned char *)pRaw->data;
-	unsigned char *out = (unsigned char *)pOut->data;
-
-	for (y=0; y<pRaw->height; y+=2) {
-		for (x=0; x<pRaw->width; x+=2) {
-			R = in[(y+1)*pRaw->width+x+1];
-			G = in[y*pRaw->width+x+1];
-			B = in[y*pRaw->width+x];
-			
-			/* get max and min */
-			if( R > G ){
-				max = R;
-				min = G;
-			}else{
-				max = G;
-				min = R;
-			}
-			if( B > max ){
-				max = B;
-			}
-			if( B < min ){
-				min = B;
-			}
+	struct OSC_VIS_COLOR_LAYOUT layout;
+	uint16 y;
+	uint8 *in  = (uint8 *)pRaw->data;
+	uint8 *out = (uint8 *)pOut->data;
 
-			/* hue */
-			if(max == min){
-				hue = 0;
-			}else{
-				if(max == R){
-					hue = 10922 * (G - B) / (max - min) + 65536;
-				}else if(max == G){
-					hue = 10922 * (B - R) / (max - min) + 21845;
-				}else{
-					hue = 10922 * (R - G) / (max - min) + 43690;
-				}
-			}
-			out[outPos++] = (uint8)(hue >> 8);
-			
-		} /* for x */
-	} /* for y */
+	GetBlockLayout(pRaw->width, &layout);
+	for (y=0; y<pRaw->height/2; y++) {
+		OscVisColorToHSL(&in[2*y*pRaw->width], &layout, pRaw->width/2,
+				&out[y*(pRaw->width/2)], NULL, NULL);
+	}
 	pOut->width  = pRaw->width/2;
 	pOut->height = pRaw->height/2; 
 	pOut->type  = OSC_PICTURE_HUE;
@@ -316,49 +351,16 @@ OSC_ERR OscVisFastDebayerHSL_H(const struct OSC_PICTURE *pRaw, struct OSC_PICTUR
 
 OSC_ERR OscVisFastDebayerHSL_S(const struct OSC_PICTURE *pRaw, struct OSC_PICTURE *pOut) 
 {
-	uint16 x,y;
-	uint32 outPos = 0;
-	uint8 max, min;
-	uint16 sat, lum;
-	uint16 R, G, B;
-	unsigned char *in  = (unsigned char *)pRaw->data;
-	unsigned char *out = (unsigned char *)pOut->data;
-
-	for (y=0; y<pRaw->height; y+=2) {
-		for (x=0; x<pRaw->width; x+=2) {
-			R = in[(y+1)*pRaw->width+x+1];
-			G = in[y*pRaw->width+x+1];
-			B = in[y*pRaw->width+x];
-			
-			/* get max and min */
-			if( R > G ){
-				max = R;
-				min = G;
-			}else{
-				max = G;
-				min = R;
-			}
-			if( B > max ){
-				max = B;
-			}
-			if( B < min ){
-				min = B;
-			}
-			
-			/* luminance */
-			lum = (max + min) >> 1;
-
-			/* saturation */
-			if(lum < 128){
-				sat = ((max - min) << 8) / (lum << 1);
-			}else{
-				sat = ((max - min) << 8) / (512 - (lum << 1));
-			}
+	struct OSC_VIS_COLOR_LAYOUT layout;
+	uint16 y;
+	uint8 *in  = (uint8 *)pRaw->data;
+	uint8 *out = (uint8 *)pOut->data;
 
-			out[outPos++] = (uint8)sat;
-			
-		} /* for x */
-	} /* for y */
+	GetBlockLayout(pRaw->width, &layout);
+	for (y=0; y<pRaw->height/2; y++) {
+		OscVisColorToHSL(&in[2*y*pRaw->width], &layout, pRaw->width/2,
+				NULL, &out[y*(pRaw->width/2)], NULL);
+	}
 	pOut->width  = pRaw->width/2;
 	pOut->height = pRaw->height/2; 
 	pOut->type  = OSC_PICTURE_HUE;
@@ -368,42 +370,16 @@ OSC_ERR OscVisFastDebayerHSL_S(const struct OSC_PICTURE *pRaw, struct OSC_PICTUR
 
 OSC_ERR OscVisFastDebayerHSL_L(const struct OSC_PICTURE *pRaw, struct OSC_PICTURE *pOut) 
 {
-	uint16 x,y;
-	uint32 outPos = 0;
-	uint8 max, min;
-	uint16 lum;
-	uint16 R, G, B;
-	unsigned char *in  = (unsigned char *)pRaw->data;
-	unsigned char *out = (unsigned char *)pOut->data;
-
-	for (y=0; y<pRaw->height; y+=2) {
-		for (x=0; x<pRaw->width; x+=2) {
-			R = in[(y+1)*pRaw->width+x+1];
-			G = in[y*pRaw->width+x+1];
-			B = in[y*pRaw->width+x];
-			
-			/* get max and min */
-			if( R > G ){
-				max = R;
-				min = G;
-			}else{
-				max = G;
-				min = R;
-			}
-			if( B > max ){
-				max = B;
-			}
-			if( B < min ){
-				min = B;
-			}
-			
-			/* luminance */
-			lum = (max + min) >> 1;
+	struct OSC_VIS_COLOR_LAYOUT layout;
+	uint16 y;
+	uint8 *in  = (uint8 *)pRaw->data;
+	uint8 *out = (uint8 *)pOut->data;
 
-			out[outPos++] = (uint8)lum;
-			
-		} /* for x */
-	} /* for y */
+	GetBlockLayout(pRaw->width, &layout);
+	for (y=0; y<pRaw->height/2; y++) {
+		OscVisColorToHSL(&in[2*y*pRaw->width], &layout, pRaw->width/2,
+				NULL, NULL, &out[y*(pRaw->width/2)]);
+	}
 	pOut->width  = pRaw->width/2;
 	pOut->height = pRaw->height/2; 
 	pOut->type  = OSC_PICTURE_HUE;
@@ -26,6 +26,10 @@
 
 #include "vis.h"
 
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
 /*! @brief Rounding division by 2. */
 #define INT_DIVIDE_BY_2_ROUND(x) ((x + 1) / 2)
 /*! @brief Rounding division by 3. */
@@ -35,6 +39,12 @@
 /*! @brief Rounding division by 8. */
 #define INT_DIVIDE_BY_8_ROUND(x) ((x + 4) / 8)
 
+/*! @brief Reciprocal of 6 in Q.16, exact for the division of values
+ * below 32768. */
+#define DIVIDE_BY_6_RECIPROCAL 10923
+/*! @brief Division by 6 of a value below 32768. */
+#define DIVIDE_BY_6(x) ((uint8)(((uint32)(x) * DIVIDE_BY_6_RECIPROCAL) >> 16))
+
 /*! @brief Saturate an int value to an uint8. */
 #define SATURATE_TO_UINT8(x) (unlikely(x < 0) ? 0 : (unlikely(x > 255) ? 255 : x))
 
@@ -206,7 +216,7 @@ static void InterpGreen_FirstTwoRows(const uint8* pRaw,
 		pOutPix += BYTES_PER_PIX;
 		
 		/* Last pixel is not green. */
-		*pOutPix = INT_DIVIDE_BY_2_ROUND(pRaw[(ptrdiff_t)(-1)] + pRaw[width]);
+		*pOutPix = INT_DIVIDE_BY_2_ROUND(pRawPix[(ptrdiff_t)(-1)] + pRawPix[width]);
 		pRawPix++;
 	} else {
 		/* Last pixel is green. */
@@ -319,12 +329,14 @@ static void InterpGreen_LastTwoRows(const uint8* pRaw,
 
 		/* Last pixel is not green. */
 		*pOutPix =
-		  INT_DIVIDE_BY_3_ROUND(pRaw[(ptrdiff_t)(-1)] + pRaw[-(ptrdiff_t)(width)] + pRaw[width]);
+		  INT_DIVIDE_BY_3_ROUND(pRawPix[(ptrdiff_t)(-1)] + pRawPix[-(ptrdiff_t)(width)] + pRawPix[width]);
+		pRawPix++;
 	} else {
 		/* Last pixel is green. */
 		*pOutPix = *pRawPix;
 		pRawPix++;
 	}
+	pOutPix += BYTES_PER_PIX;
 	
 	/* --------------- Last row --------------------- */
 	/* Left-most pixel. */
@@ -544,165 +556,327 @@ inline static void InterpRedAndBlue_FirstOrLastRow(
 	}
 }
 
-OSC_ERR OscVisDebayer(const uint8* pRaw,
-		const uint16 width,
-		const uint16 height,
-		enum EnBayerOrder enBayerOrderFirstRow,
-		uint8 *const pOut)
+#ifdef __SSE2__
+/*! @brief Load 8 pixels as 16 bit values. */
+static inline __m128i Load8(const uint8 *p)
 {
-	bool        bTopLeftIsGreen, bTopRowIsRed, bFirstPixIsGreen, bRowIsRed;
-	uint8       *pOutPix, *pOutRow, *pOutPrefetch;
-	const uint8 *pRawPix, *pRawRow, *pRawPrefetch;
-	uint16      row, col;
-#ifdef BENCHMARK
-	uint32      startCyc;
-#endif
+	return _mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i *)p), _mm_setzero_si128());
+}
+
+/*! @brief Absolute value of 16 bit values. */
+static inline __m128i Abs16(__m128i x)
+{
+	return _mm_max_epi16(x, _mm_sub_epi16(_mm_setzero_si128(), x));
+}
+
+/*********************************************************************//*!
+ * @brief InterpGreen_CurRedOrBluePix for 8 pixels.
+ * 
+ * The results may be negative or above 255, they are saturated when
+ * packed to 8 bit. Shifting rounds negative values differently than the
+ * division but they are saturated to 0 either way.
+ *//*********************************************************************/
+static inline __m128i InterpGreen_CurRedOrBluePix8(const uint8* pRaw,
+		uint16 width)
+{
+	__m128i west, east, north, south, center2;
+	__m128i lapH, lapV, deltaH, deltaV, sumH, sumV;
+	__m128i outH, outV, outHV;
 	
-	/*---------------------- Input validation. -------------------- */
-	if((pRaw == NULL) || (pOut == NULL) || (width == 0) || (height == 0))
-	{
-		OscLog(ERROR, "%s(0x%x, %d, %d, %d 0x%x): Invalid arguments!",
-				__func__, pRaw, width, height, enBayerOrderFirstRow, pOut);
-		return -EINVALID_PARAMETER;
-	}
+	west = Load8(&pRaw[(ptrdiff_t)(-1)]);
+	east = Load8(&pRaw[1]);
+	north = Load8(&pRaw[-(ptrdiff_t)(width)]);
+	south = Load8(&pRaw[width]);
+	center2 = _mm_slli_epi16(Load8(pRaw), 1);
 	
-	if((!IS_EVEN(width)) || (width < 4) || (height < 4))
-	{
-		OscLog(ERROR, "%s: Invalid parameter! Width: %d Height: %d\n"
-				"Width must be even and >=4 and height must be >=4.\n",
-				__func__, width, height);
-		return -EINVALID_PARAMETER;
-	}
+	lapH = _mm_sub_epi16(_mm_sub_epi16(center2, Load8(&pRaw[(ptrdiff_t)(-2)])),
+			Load8(&pRaw[2]));
+	lapV = _mm_sub_epi16(_mm_sub_epi16(center2, Load8(&pRaw[(ptrdiff_t)(-2*width)])),
+			Load8(&pRaw[2*width]));
 	
-	bTopLeftIsGreen = (enBayerOrderFirstRow == ROW_GBGB) ||
-						(enBayerOrderFirstRow == ROW_GRGR);
-	bTopRowIsRed = (enBayerOrderFirstRow == ROW_RGRG) ||
-						(enBayerOrderFirstRow == ROW_GRGR);
+	deltaH = _mm_add_epi16(Abs16(_mm_sub_epi16(west, east)), Abs16(lapH));
+	deltaV = _mm_add_epi16(Abs16(_mm_sub_epi16(north, south)), Abs16(lapV));
 	
-	/* -------------- Interpolate all green pixels. -----------------*/
+	sumH = _mm_add_epi16(west, east);
+	sumV = _mm_add_epi16(north, south);
+	outH = _mm_srai_epi16(_mm_add_epi16(_mm_add_epi16(_mm_slli_epi16(sumH, 1), deltaH),
+			_mm_set1_epi16(2)), 2);
+	outV = _mm_srai_epi16(_mm_add_epi16(_mm_add_epi16(_mm_slli_epi16(sumV, 1), deltaV),
+			_mm_set1_epi16(2)), 2);
+	outHV = _mm_srai_epi16(_mm_add_epi16(_mm_add_epi16(
+			_mm_slli_epi16(_mm_add_epi16(sumH, sumV), 1),
+			_mm_add_epi16(deltaH, deltaV)), _mm_set1_epi16(4)), 3);
 	
-	BENCH_START(startCyc);
-	/* The first and last two rows must be treated specially. */
-	InterpGreen_FirstTwoRows(pRaw,
-		width,
-		bTopLeftIsGreen,
-		pOut);
-	BENCH_STOP("Green_FirstTwoRows", startCyc);
+	return VisSelect(_mm_cmplt_epi16(deltaH, deltaV), outH,
+			VisSelect(_mm_cmpgt_epi16(deltaH, deltaV), outV, outHV));
+}
+
+/*********************************************************************//*!
+ * @brief The color of the row for 8 pixels of an interior row.
+ * 
+ * This is the raw value for red or blue pixels and the horizontal
+ * interpolation of InterpRedAndBlue_CurGreenPix* for green ones.
+ * 
+ * @param pRaw The first raw pixel.
+ * @param pGreen Green of the row, at the first pixel.
+ * @param greenMask Set for the green pixels.
+ * @return The color.
+ *//*********************************************************************/
+static inline __m128i InterpRowColor8(const uint8* pRaw,
+		const uint8 *pGreen,
+		__m128i greenMask)
+{
+	__m128i center, horiz;
 	
-	pRawPix = &pRaw[2*width];
-	pRawPrefetch = &pRawPix[2*width];
-	pOutPix = &pOut[2*BYTES_PER_PIX*width];
-	pOutPrefetch = &pOutPix[2*width];
-	bFirstPixIsGreen = bTopLeftIsGreen;
+	center = Load8(pRaw);
+	horiz = _mm_add_epi16(_mm_add_epi16(Load8(&pRaw[(ptrdiff_t)(-1)]), Load8(&pRaw[1])), center);
+	horiz = _mm_sub_epi16(_mm_slli_epi16(horiz, 1),
+			_mm_add_epi16(Load8(&pGreen[(ptrdiff_t)(-1)]), Load8(&pGreen[1])));
+	horiz = _mm_srai_epi16(_mm_add_epi16(horiz, _mm_set1_epi16(2)), 2);
 	
-	BENCH_START(startCyc);
-	PREFETCH(pRawPrefetch);
-	PREFETCH(pOutPrefetch);
-	for(row = 2; row < height - 2; row++)
+	return VisSelect(greenMask, horiz, center);
+}
+
+/*********************************************************************//*!
+ * @brief The color other than that of the row for 8 pixels of an
+ * interior row.
+ * 
+ * This is the vertical interpolation of InterpRedAndBlue_CurGreenPix*
+ * for green pixels and the diagonal one of
+ * InterpRedOrBlue_CurBlueOrRedPix for red or blue ones.
+ * 
+ * @param pRaw The first raw pixel.
+ * @param width Width of the image.
+ * @param pGreenUp Green of the row above, at the first pixel.
+ * @param pGreen Green of the row, at the first pixel.
+ * @param pGreenDown Green of the row below, at the first pixel.
+ * @param greenMask Set for the green pixels.
+ * @return The color.
+ *//*********************************************************************/
+static inline __m128i InterpOtherColor8(const uint8* pRaw,
+		const uint16 width,
+		const uint8 *pGreenUp,
+		const uint8 *pGreen,
+		const uint8 *pGreenDown,
+		__m128i greenMask)
+{
+	__m128i vert, northwest, northeast, southwest, southeast, green2;
+	__m128i lapN, lapP, deltaN, deltaP, sumN, sumP, outN, outP, outNP;
+	
+	vert = _mm_add_epi16(_mm_add_epi16(Load8(&pRaw[-(ptrdiff_t)(width)]), Load8(&pRaw[width])),
+			Load8(pRaw));
+	vert = _mm_sub_epi16(_mm_slli_epi16(vert, 1),
+			_mm_add_epi16(Load8(pGreenUp), Load8(pGreenDown)));
+	vert = _mm_srai_epi16(_mm_add_epi16(vert, _mm_set1_epi16(2)), 2);
+	
+	northwest = Load8(&pRaw[(ptrdiff_t)(-width - 1)]);
+	northeast = Load8(&pRaw[(ptrdiff_t)(-width + 1)]);
+	southwest = Load8(&pRaw[(ptrdiff_t)(width - 1)]);
+	southeast = Load8(&pRaw[(ptrdiff_t)(width + 1)]);
+	green2 = _mm_slli_epi16(Load8(pGreen), 1);
+	lapN = _mm_sub_epi16(_mm_sub_epi16(green2, Load8(&pGreenUp[(ptrdiff_t)(-1)])),
+			Load8(&pGreenDown[1]));
+	lapP = _mm_sub_epi16(_mm_sub_epi16(green2, Load8(&pGreenUp[1])),
+			Load8(&pGreenDown[(ptrdiff_t)(-1)]));
+	deltaN = _mm_add_epi16(Abs16(_mm_sub_epi16(northwest, southeast)), Abs16(lapN));
+	deltaP = _mm_add_epi16(Abs16(_mm_sub_epi16(northeast, southwest)), Abs16(lapP));
+	sumN = _mm_add_epi16(_mm_add_epi16(northwest, southeast), lapN);
+	sumP = _mm_add_epi16(_mm_add_epi16(northeast, southwest), lapP);
+	outN = _mm_srai_epi16(_mm_add_epi16(sumN, _mm_set1_epi16(1)), 1);
+	outP = _mm_srai_epi16(_mm_add_epi16(sumP, _mm_set1_epi16(1)), 1);
+	outNP = _mm_srai_epi16(_mm_add_epi16(_mm_add_epi16(sumN, sumP), _mm_set1_epi16(2)), 2);
+	outNP = VisSelect(_mm_cmplt_epi16(deltaN, deltaP), outN,
+			VisSelect(_mm_cmpgt_epi16(deltaN, deltaP), outP, outNP));
+	
+	return VisSelect(greenMask, vert, outNP);
+}
+#endif /* __SSE2__ */
+
+void DebayerLinCorrGreenRows(const uint8* pRaw,
+		const uint16 width,
+		const uint16 firstRow,
+		const uint16 endRow,
+		const bool bTopLeftIsGreen,
+		uint8 *const pOut)
+{
+	const uint8 *pRawRow;
+	uint8       *pOutRow;
+	uint16      row, col;
+	bool        bFirstPixIsGreen;
+#ifdef __SSE2__
+	uint8       green[16];
+	uint16      i;
+#endif
+	
+	for(row = firstRow; row < endRow; row++)
 	{
+		pRawRow = &pRaw[(uint32)row*width];
+		pOutRow = &pOut[(uint32)row*width*BYTES_PER_PIX];
+		/* The color of the first pixel in a row alternates between green
+		 * and either blue or red. */
+		bFirstPixIsGreen = IS_EVEN(row) ? bTopLeftIsGreen : !bTopLeftIsGreen;
+		
 		/* Interpolate a single row. Copy the pixels that natively
 		 * represent green from the raw data and interpolate the
 		 * others. We must treat the first and the last two columns
 		 * specially. */
-		InterpGreen_FirstTwoCols(pRawPix,
+		InterpGreen_FirstTwoCols(pRawRow,
 				width,
 				bFirstPixIsGreen,
-				pOutPix);
-		pRawPix += 2;
-		pOutPix += 2*BYTES_PER_PIX;
+				pOutRow);
+		col = 2;
+		
+#ifdef __SSE2__
+		/* 16 pixels at a time, all interpolated and the green ones
+		 * replaced by the raw value. */
+		for(; col + 18 <= width; col += 16)
+		{
+			__m128i interp = _mm_packus_epi16(
+					InterpGreen_CurRedOrBluePix8(&pRawRow[col], width),
+					InterpGreen_CurRedOrBluePix8(&pRawRow[col + 8], width));
+			__m128i greenMask = _mm_set1_epi16(bFirstPixIsGreen ? 0x00ff : 0xff00);
+			
+			_mm_storeu_si128((__m128i *)green, VisSelect(greenMask,
+					_mm_loadu_si128((const __m128i *)&pRawRow[col]), interp));
+			for(i = 0; i < 16; i++)
+				pOutRow[(col + i)*BYTES_PER_PIX + GREEN_OFF] = green[i];
+		}
+#endif /* __SSE2__ */
 		
 		if(bFirstPixIsGreen)
 		{
-			for(col = 2; col < width - 2; col += 2)
+			for(; col < width - 2; col += 2)
 			{
-				pOutPix[GREEN_OFF] = *pRawPix;
-				pRawPix++;
-				
-				pOutPix[BYTES_PER_PIX + GREEN_OFF] =
-					InterpGreen_CurRedOrBluePix(pRawPix, width);
-				
-				pOutPix += 2*BYTES_PER_PIX;
-				pRawPix++;
+				pOutRow[col*BYTES_PER_PIX + GREEN_OFF] = pRawRow[col];
+				pOutRow[(col + 1)*BYTES_PER_PIX + GREEN_OFF] =
+					InterpGreen_CurRedOrBluePix(&pRawRow[col + 1], width);
 			}
 		} else {
 			/* First pixel is red or blue. */
-			for(col = 2; col < width - 2; col += 2)
+			for(; col < width - 2; col += 2)
 			{
-				pOutPix[GREEN_OFF] =
-					InterpGreen_CurRedOrBluePix(pRawPix, width);
-				pRawPix++;
-				
-				pOutPix[BYTES_PER_PIX + GREEN_OFF] = *pRawPix;
-				pRawPix++;
-				
-				pOutPix += 2*BYTES_PER_PIX;
+				pOutRow[col*BYTES_PER_PIX + GREEN_OFF] =
+					InterpGreen_CurRedOrBluePix(&pRawRow[col], width);
+				pOutRow[(col + 1)*BYTES_PER_PIX + GREEN_OFF] = pRawRow[col + 1];
 			}
 		}
 		
-		InterpGreen_LastTwoCols(pRawPix,
+		InterpGreen_LastTwoCols(&pRawRow[width - 2],
 				width,
 				bFirstPixIsGreen,
-				pOutPix);
-		pRawPix += 2;
-		pOutPix += 2*BYTES_PER_PIX;
-		
-		/* The color of the first pixel in a row alternates between green
-		 * and either blue or red. */
-		bFirstPixIsGreen = !bFirstPixIsGreen;
+				&pOutRow[(width - 2)*BYTES_PER_PIX]);
 	}
-	BENCH_STOP("Green_Center", startCyc);
-	
-	BENCH_START(startCyc);
-	bFirstPixIsGreen = IS_EVEN(height) ? bTopLeftIsGreen : !bTopLeftIsGreen;
-	InterpGreen_LastTwoRows(pRawPix,
-			width,
-			bFirstPixIsGreen,
-			pOutPix);
-	BENCH_STOP("Green_LastTwoRows", startCyc);
+}
+
+void DebayerLinCorrRedBlueRows(const uint8* pRaw,
+		const uint16 width,
+		const uint16 firstRow,
+		const uint16 endRow,
+		const bool bTopLeftIsGreen,
+		const bool bTopRowIsRed,
+		uint8 *const pOut)
+{
+	const uint8 *pRawRow;
+	uint8       *pOutRow;
+	uint16      row, col;
+	bool        bFirstPixIsGreen, bRowIsRed;
+#ifdef __SSE2__
+	/* The green of the row above, the row and the row below, copied out
+	 * of the output. */
+	uint8       *pGreenRows, *pGreen[3] = {NULL, NULL, NULL}, *pSwap;
+	uint8       rowColor[16], otherColor[16];
+	uint16      i;
 	
-	/* ------------- Interpolate red and blue pixels. ---------------*/
+	pGreenRows = malloc(3*width);
+	if(pGreenRows != NULL)
+	{
+		for(i = 0; i < 3; i++)
+			pGreen[i] = &pGreenRows[i*width];
+		
+		/* The row below is copied for every row. */
+		pOutRow = &pOut[(uint32)(firstRow - 1)*width*BYTES_PER_PIX];
+		for(col = 0; col < 2*width; col++)
+			pGreenRows[col] = pOutRow[col*BYTES_PER_PIX + GREEN_OFF];
+	}
+#endif /* __SSE2__ */
 	
-	BENCH_START(startCyc);
-	bFirstPixIsGreen = !bTopLeftIsGreen;
-	bRowIsRed = !bTopRowIsRed;
-	pRawPix = &pRaw[width];
-	pOutPix = &pOut[width*BYTES_PER_PIX];
-	pOutRow = pOutPix;
-	pRawRow = pRawPix;
-	for(row = 1; row < height - 1; row++)
+	for(row = firstRow; row < endRow; row++)
 	{
+		pRawRow = &pRaw[(uint32)row*width];
+		pOutRow = &pOut[(uint32)row*width*BYTES_PER_PIX];
+		/* The color of the first pixel in a row alternates between green
+		 * and either blue or red. */
+		bFirstPixIsGreen = IS_EVEN(row) ? bTopLeftIsGreen : !bTopLeftIsGreen;
+		bRowIsRed = IS_EVEN(row) ? bTopRowIsRed : !bTopRowIsRed;
+		
 		/* Interpolate a single row. Copy the pixels that natively
 		 * represent green from the raw data and interpolate the
 		 * others. We must treat the first and the last columns
 		 * specially. */
+		col = 1;
 		
-		/* For first column. */
-		pRawPix++;
-		pOutPix += BYTES_PER_PIX;
+#ifdef __SSE2__
+		if(pGreenRows != NULL)
+		{
+			/* The pixels at odd lanes are green if the first of the row
+			 * is. */
+			__m128i greenMask = _mm_set1_epi32(bFirstPixIsGreen ? 0xffff0000 : 0x0000ffff);
+			
+			for(col = 0; col < width; col++)
+				pGreen[2][col] = pOutRow[(width + col)*BYTES_PER_PIX + GREEN_OFF];
+			
+			for(col = 1; col + 17 <= width; col += 16)
+			{
+				_mm_storeu_si128((__m128i *)rowColor, _mm_packus_epi16(
+						InterpRowColor8(&pRawRow[col], &pGreen[1][col], greenMask),
+						InterpRowColor8(&pRawRow[col + 8], &pGreen[1][col + 8], greenMask)));
+				_mm_storeu_si128((__m128i *)otherColor, _mm_packus_epi16(
+						InterpOtherColor8(&pRawRow[col], width, &pGreen[0][col],
+								&pGreen[1][col], &pGreen[2][col], greenMask),
+						InterpOtherColor8(&pRawRow[col + 8], width, &pGreen[0][col + 8],
+								&pGreen[1][col + 8], &pGreen[2][col + 8], greenMask)));
+				
+				if(bRowIsRed)
+				{
+					for(i = 0; i < 16; i++)
+					{
+						pOutRow[(col + i)*BYTES_PER_PIX + RED_OFF] = rowColor[i];
+						pOutRow[(col + i)*BYTES_PER_PIX + BLUE_OFF] = otherColor[i];
+					}
+				} else {
+					for(i = 0; i < 16; i++)
+					{
+						pOutRow[(col + i)*BYTES_PER_PIX + BLUE_OFF] = rowColor[i];
+						pOutRow[(col + i)*BYTES_PER_PIX + RED_OFF] = otherColor[i];
+					}
+				}
+			}
+			
+			pSwap = pGreen[0];
+			pGreen[0] = pGreen[1];
+			pGreen[1] = pGreen[2];
+			pGreen[2] = pSwap;
+		}
+#endif /* __SSE2__ */
 		
 		if(!bFirstPixIsGreen)
 		{
 			/* First pixel is not green. */
 			if(bRowIsRed)
 			{
-				for(col = 1; col < width - 1; col += 2)
+				for(; col < width - 1; col += 2)
 				{
 					InterpRedAndBlue_CurGreenPixRedRow(
-								pRawPix,
+								&pRawRow[col],
 								width,
-								pOutPix);
+								&pOutRow[col*BYTES_PER_PIX]);
 					
-					pOutPix += BYTES_PER_PIX;
-					pRawPix++;
-					
-					pOutPix[RED_OFF] = *pRawPix;
-					pOutPix[BLUE_OFF] = InterpRedOrBlue_CurBlueOrRedPix(
-							pRawPix,
+					pOutRow[(col + 1)*BYTES_PER_PIX + RED_OFF] = pRawRow[col + 1];
+					pOutRow[(col + 1)*BYTES_PER_PIX + BLUE_OFF] =
+						InterpRedOrBlue_CurBlueOrRedPix(
+							&pRawRow[col + 1],
 							width,
-							pOutPix);
-								
-					pOutPix += BYTES_PER_PIX;
-					pRawPix++;
+							&pOutRow[(col + 1)*BYTES_PER_PIX]);
 				}
 				/* First and last column. Just copy from the neighboring
 				 * pixels. */
@@ -714,25 +888,19 @@ OSC_ERR OscVisDebayer(const uint8* pRaw,
 				pOutRow[(width - 1)*BYTES_PER_PIX + BLUE_OFF] =
 					pOutRow[(width - 2)*BYTES_PER_PIX + BLUE_OFF];
 			} else {
-								
-				for(col = 1; col < width - 1; col += 2)
+				for(; col < width - 1; col += 2)
 				{
 					InterpRedAndBlue_CurGreenPixBlueRow(
-							pRawPix,
+							&pRawRow[col],
 							width,
-							pOutPix);
-
-					pOutPix += BYTES_PER_PIX;
-					pRawPix++;
-
-					pOutPix[BLUE_OFF] = *pRawPix;
-					pOutPix[RED_OFF] = InterpRedOrBlue_CurBlueOrRedPix(
-							pRawPix,
+							&pOutRow[col*BYTES_PER_PIX]);
+					
+					pOutRow[(col + 1)*BYTES_PER_PIX + BLUE_OFF] = pRawRow[col + 1];
+					pOutRow[(col + 1)*BYTES_PER_PIX + RED_OFF] =
+						InterpRedOrBlue_CurBlueOrRedPix(
+							&pRawRow[col + 1],
 							width,
-							pOutPix);
-
-					pOutPix += BYTES_PER_PIX;
-					pRawPix++;
+							&pOutRow[(col + 1)*BYTES_PER_PIX]);
 				}
 				/* First and last column. Just copy from the neighboring
 				 * pixels. */
@@ -750,24 +918,19 @@ OSC_ERR OscVisDebayer(const uint8* pRaw,
 			/* First pixel is green. */
 			if(bRowIsRed)
 			{
-				for(col = 1; col < width - 1; col += 2)
+				for(; col < width - 1; col += 2)
 				{
-					pOutPix[RED_OFF] = *pRawPix;
-					pOutPix[BLUE_OFF] = InterpRedOrBlue_CurBlueOrRedPix(
-							pRawPix,
+					pOutRow[col*BYTES_PER_PIX + RED_OFF] = pRawRow[col];
+					pOutRow[col*BYTES_PER_PIX + BLUE_OFF] =
+						InterpRedOrBlue_CurBlueOrRedPix(
+							&pRawRow[col],
 							width,
-							pOutPix);
-
-					pOutPix += BYTES_PER_PIX;
-					pRawPix++;
-										
+							&pOutRow[col*BYTES_PER_PIX]);
+					
 					InterpRedAndBlue_CurGreenPixRedRow(
-							pRawPix,
+							&pRawRow[col + 1],
 							width,
-							pOutPix);
-
-					pOutPix += BYTES_PER_PIX;
-					pRawPix++;
+							&pOutRow[(col + 1)*BYTES_PER_PIX]);
 				}
 				/* First and last column. Just copy from the neighboring
 				 * pixels. */
@@ -775,30 +938,25 @@ OSC_ERR OscVisDebayer(const uint8* pRaw,
 				pOutRow[BLUE_OFF] = pOutRow[BYTES_PER_PIX + BLUE_OFF];
 
 				pOutRow[(width - 1)*BYTES_PER_PIX + RED_OFF] =
-					*pRawPix;
+					pRawRow[width - 1];
 				pOutRow[(width - 1)*BYTES_PER_PIX + BLUE_OFF] =
 					pOutRow[(width - 2)*BYTES_PER_PIX + BLUE_OFF];
 			}
 			else
 			{
-				for(col = 1; col < width - 1; col += 2)
+				for(; col < width - 1; col += 2)
 				{
-					pOutPix[BLUE_OFF] = *pRawPix;
-					pOutPix[RED_OFF] = InterpRedOrBlue_CurBlueOrRedPix(
-							pRawPix,
+					pOutRow[col*BYTES_PER_PIX + BLUE_OFF] = pRawRow[col];
+					pOutRow[col*BYTES_PER_PIX + RED_OFF] =
+						InterpRedOrBlue_CurBlueOrRedPix(
+							&pRawRow[col],
 							width,
-							pOutPix);
+							&pOutRow[col*BYTES_PER_PIX]);
 					
-					pRawPix++;
-					pOutPix += BYTES_PER_PIX;
-										
 					InterpRedAndBlue_CurGreenPixBlueRow(
-							pRawPix,
+							&pRawRow[col + 1],
 							width,
-							pOutPix);
-
-					pOutPix += BYTES_PER_PIX;
-					pRawPix++;
+							&pOutRow[(col + 1)*BYTES_PER_PIX]);
 				}
 				/* First and last column. Just copy from the neighboring
 				 * pixels. */
@@ -808,23 +966,76 @@ OSC_ERR OscVisDebayer(const uint8* pRaw,
 				pOutRow[(width - 1)*BYTES_PER_PIX + RED_OFF] =
 					pOutRow[(width - 2)*BYTES_PER_PIX + RED_OFF];
 				pOutRow[(width - 1)*BYTES_PER_PIX + BLUE_OFF] =
-					*pRawPix;
+					pRawRow[width - 1];
 			}
-
 		}
+	}
+	
+#ifdef __SSE2__
+	free(pGreenRows);
+#endif /* __SSE2__ */
+}
 
-		/* For last column */
-		pOutPix += BYTES_PER_PIX;
-		pRawPix++;
-		
-		/* The color of the first pixel in a row alternates between green
-		 * and either blue or red. */
-		bFirstPixIsGreen = !bFirstPixIsGreen;
-		bRowIsRed = !bRowIsRed;
-		pOutRow += BYTES_PER_PIX*width;
-		pRawRow += width;
+OSC_ERR OscVisDebayer(const uint8* pRaw,
+		const uint16 width,
+		const uint16 height,
+		enum EnBayerOrder enBayerOrderFirstRow,
+		uint8 *const pOut)
+{
+	bool        bTopLeftIsGreen, bTopRowIsRed, bFirstPixIsGreen;
+#ifdef BENCHMARK
+	uint32      startCyc;
+#endif
+	
+	/*---------------------- Input validation. -------------------- */
+	if((pRaw == NULL) || (pOut == NULL) || (width == 0) || (height == 0))
+	{
+		OscLog(ERROR, "%s(0x%x, %d, %d, %d 0x%x): Invalid arguments!",
+				__func__, pRaw, width, height, enBayerOrderFirstRow, pOut);
+		return -EINVALID_PARAMETER;
 	}
-	BENCH_STOP("RedBlue_Center", startCyc);
+	
+	if((!IS_EVEN(width)) || (width < 4) || (height < 4))
+	{
+		OscLog(ERROR, "%s: Invalid parameter! Width: %d Height: %d\n"
+				"Width must be even and >=4 and height must be >=4.\n",
+				__func__, width, height);
+		return -EINVALID_PARAMETER;
+	}
+	
+	bTopLeftIsGreen = (enBayerOrderFirstRow == ROW_GBGB) ||
+						(enBayerOrderFirstRow == ROW_GRGR);
+	bTopRowIsRed = (enBayerOrderFirstRow == ROW_RGRG) ||
+						(enBayerOrderFirstRow == ROW_GRGR);
+	
+	/* -------------- Interpolate all green pixels. -----------------*/
+	
+	BENCH_START(startCyc);
+	/* The first and last two rows must be treated specially. */
+	InterpGreen_FirstTwoRows(pRaw,
+		width,
+		bTopLeftIsGreen,
+		pOut);
+	BENCH_STOP("Green_FirstTwoRows", startCyc);
+	
+	BENCH_START(startCyc);
+	bFirstPixIsGreen = IS_EVEN(height) ? bTopLeftIsGreen : !bTopLeftIsGreen;
+	InterpGreen_LastTwoRows(&pRaw[(uint32)(height - 2)*width],
+			width,
+			bFirstPixIsGreen,
+			&pOut[(uint32)(height - 2)*width*BYTES_PER_PIX]);
+	BENCH_STOP("Green_LastTwoRows", startCyc);
+	
+	/* ---------- Interpolate the interior, green first. ------------*/
+	
+	BENCH_START(startCyc);
+	DebayerLinCorrInterior(pRaw,
+			width,
+			height,
+			bTopLeftIsGreen,
+			bTopRowIsRed,
+			pOut);
+	BENCH_STOP("Interior", startCyc);
 	
 	/* Fill in the first and the last row as well as the corners.
 	 * For this, use the color information of the neighboring pixels.
@@ -853,10 +1064,78 @@ OSC_ERR OscVisDebayer(const uint8* pRaw,
 	return SUCCESS;
 }
 
+/*********************************************************************//*!
+ * @brief Calculate one row of OscVisDebayerGreyscaleHalfSize.
+ * 
+ * Every output pixel is (2 * red + green1 + green2 + 2 * blue) / 6 of a
+ * 2x2 cell. The division is done as a multiplication with the reciprocal,
+ * which gives the same result for sums below 32768.
+ * 
+ * @param pRow0 The first raw row of the cells.
+ * @param pRow1 The second raw row of the cells.
+ * @param outWidth Number of output pixels.
+ * @param bTopLeftIsGreen Whether the first pixel of pRow0 is green.
+ * @param pOut The output row.
+ *//*********************************************************************/
+void DebayerGreyscaleHalfSizeRow(uint8 const *pRow0, uint8 const *pRow1, uint16 const outWidth, bool const bTopLeftIsGreen, uint8 *pOut)
+{
+	uint16 ix = 0;
+#ifdef __SSE2__
+	__m128i const lowBytes = _mm_set1_epi16(0x00ff);
+	__m128i const recip6 = _mm_set1_epi16(DIVIDE_BY_6_RECIPROCAL);
+	
+	for(; ix + 16 <= outWidth; ix += 16)
+	{
+		__m128i grey[2];
+		uint16 half;
+		
+		for(half = 0; half < 2; half++)
+		{
+			__m128i raw0 = _mm_loadu_si128((__m128i const *)&pRow0[(ix + half * 8) * 2]);
+			__m128i raw1 = _mm_loadu_si128((__m128i const *)&pRow1[(ix + half * 8) * 2]);
+			/* Deinterleave the pixels of the cells into 16 bit lanes. */
+			__m128i even0 = _mm_and_si128(raw0, lowBytes);
+			__m128i odd0 = _mm_srli_epi16(raw0, 8);
+			__m128i even1 = _mm_and_si128(raw1, lowBytes);
+			__m128i odd1 = _mm_srli_epi16(raw1, 8);
+			__m128i sum = _mm_add_epi16(_mm_add_epi16(even0, odd0), _mm_add_epi16(even1, odd1));
+			/* Red and blue count twice. */
+			if (bTopLeftIsGreen)
+				sum = _mm_add_epi16(sum, _mm_add_epi16(odd0, even1));
+			else
+				sum = _mm_add_epi16(sum, _mm_add_epi16(even0, odd1));
+			grey[half] = _mm_mulhi_epu16(sum, recip6);
+		}
+		_mm_storeu_si128((__m128i *)&pOut[ix], _mm_packus_epi16(grey[0], grey[1]));
+	}
+#endif /* __SSE2__ */
+	
+	if (bTopLeftIsGreen)
+		for(; ix < outWidth; ix += 1)
+		{
+			uint16 ixRaw = ix * 2;
+			uint16 grey;
+			
+			grey = (uint16)pRow0[ixRaw] + (uint16)pRow0[ixRaw + 1] * 2 +
+					(uint16)pRow1[ixRaw] * 2 + (uint16)pRow1[ixRaw + 1];
+			pOut[ix] = DIVIDE_BY_6(grey);
+		}
+	else
+		for(; ix < outWidth; ix += 1)
+		{
+			uint16 ixRaw = ix * 2;
+			uint16 grey;
+			
+			grey = (uint16)pRow0[ixRaw] * 2 + (uint16)pRow0[ixRaw + 1] +
+					(uint16)pRow1[ixRaw] + (uint16)pRow1[ixRaw + 1] * 2;
+			pOut[ix] = DIVIDE_BY_6(grey);
+		}
+}
+
 OSC_ERR OscVisDebayerGreyscaleHalfSize(uint8 const * const pRaw, uint16 const width, uint16 const height, enum EnBayerOrder const enBayerOrderFirstRow, uint8 * const pOut)
 {
 	bool bTopLeftIsGreen;
-	uint16 ix, iy, outWidth = width / 2, outHeight = height / 2;
+	uint16 iy, outWidth = width / 2, outHeight = height / 2;
 	
 	/*---------------------- Input validation. -------------------- */
 	if((pRaw == NULL) || (pOut == NULL))
@@ -876,44 +1155,14 @@ OSC_ERR OscVisDebayerGreyscaleHalfSize(uint8 const * const pRaw, uint16 const wi
 	
 	bTopLeftIsGreen = (enBayerOrderFirstRow == ROW_GBGB) || (enBayerOrderFirstRow == ROW_GRGR);
 
-	if (bTopLeftIsGreen)
-		for(iy = 0; iy < outHeight; iy += 1)
-		{
-			uint16 iyRaw = iy * 2;
-			for(ix = 0; ix < outWidth; ix += 1)
-			{
-				uint8 cellRed, cellGreen1, cellGreen2, cellBlue;
-				uint16 ixRaw = ix * 2;
-				uint16 grey;
-				
-				cellGreen1 = pRaw[iyRaw * width + ixRaw];
-				cellRed = pRaw[iyRaw * width + ixRaw + 1];
-				cellBlue = pRaw[(iyRaw + 1) * width + ixRaw];
-				cellGreen2 = pRaw[(iyRaw + 1) * width + ixRaw + 1];
-				
-				grey = (uint16)cellRed * 2 + (uint16)cellGreen1 + (uint16)cellGreen2 + (uint16)cellBlue * 2;
-				pOut[iy * outWidth + ix] = grey / 6;
-			}
-		}
-	else
-		for(iy = 0; iy < outHeight; iy += 1)
-		{
-			uint16 iyRaw = iy * 2;
-			for(ix = 0; ix < outWidth; ix += 1)
-			{
-				uint8 cellRed, cellGreen1, cellGreen2, cellBlue;
-				uint16 ixRaw = ix * 2;
-				uint16 grey;;
-				
-				cellRed = pRaw[iyRaw * width + ixRaw];
-				cellGreen1 = pRaw[iyRaw * width + ixRaw + 1];
-				cellGreen2 = pRaw[(iyRaw + 1) * width + ixRaw];
-				cellBlue = pRaw[(iyRaw + 1) * width + ixRaw + 1];
-				
-				grey = (uint16)cellRed * 2 + (uint16)cellGreen1 + (uint16)cellGreen2 + (uint16)cellBlue * 2;
-				pOut[iy * outWidth + ix] = grey / 6;
-			}
-		}
+	for(iy = 0; iy < outHeight; iy += 1)
+	{
+		DebayerGreyscaleHalfSizeRow(&pRaw[iy * 2 * width],
+				&pRaw[(iy * 2 + 1) * width],
+				outWidth,
+				bTopLeftIsGreen,
+				&pOut[iy * outWidth]);
+	}
 	
 	return SUCCESS;
 }
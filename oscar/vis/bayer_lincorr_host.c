@@ -0,0 +1,123 @@
+/*	Oscar, a hardware abstraction framework for the LeanXcam and IndXcam.
+	Copyright (C) 2008 Supercomputing Systems AG
+	
+	This library is free software; you can redistribute it and/or modify it
+	under the terms of the GNU Lesser General Public License as published by
+	the Free Software Foundation; either version 2.1 of the License, or (at
+	your option) any later version.
+	
+	This library is distributed in the hope that it will be useful, but
+	WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser
+	General Public License for more details.
+	
+	You should have received a copy of the GNU Lesser General Public License
+	along with this library; if not, write to the Free Software Foundation,
+	Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+/*! @file
+ * @brief Interior of the linear correction debayering on the host.
+ * 
+ * The rows are split into one band per processor. All bands are
+ * interpolated for green before any is done for red and blue, as those
+ * read the green of the neighboring rows.
+ */
+
+#include "vis.h"
+
+/*! @brief One band of rows and the image it belongs to. */
+struct DEBAYER_BAND {
+	const uint8 *pRaw;
+	uint16 width;
+	uint16 firstRow;
+	uint16 endRow;
+	bool bTopLeftIsGreen;
+	bool bTopRowIsRed;
+	uint8 *pOut;
+};
+
+/*********************************************************************//*!
+ * @brief Thread function interpolating the green of a band.
+ * 
+ * @param pArg The band.
+ * @return Always NULL.
+ *//*********************************************************************/
+static void * GreenBand(void *pArg)
+{
+	struct DEBAYER_BAND *pBand = pArg;
+
+	DebayerLinCorrGreenRows(pBand->pRaw, pBand->width, pBand->firstRow,
+			pBand->endRow, pBand->bTopLeftIsGreen, pBand->pOut);
+	return NULL;
+}
+
+/*********************************************************************//*!
+ * @brief Thread function interpolating the red and blue of a band.
+ * 
+ * @param pArg The band.
+ * @return Always NULL.
+ *//*********************************************************************/
+static void * RedBlueBand(void *pArg)
+{
+	struct DEBAYER_BAND *pBand = pArg;
+
+	DebayerLinCorrRedBlueRows(pBand->pRaw, pBand->width, pBand->firstRow,
+			pBand->endRow, pBand->bTopLeftIsGreen, pBand->bTopRowIsRed,
+			pBand->pOut);
+	return NULL;
+}
+
+/*********************************************************************//*!
+ * @brief Split rows into bands of about equal size.
+ * 
+ * @param aryBands The bands, with the image already filled in.
+ * @param nBands The number of bands.
+ * @param firstRow The first row.
+ * @param endRow The row after the last one.
+ *//*********************************************************************/
+static void SplitRows(struct DEBAYER_BAND *aryBands, uint16 nBands,
+		uint16 firstRow, uint16 endRow)
+{
+	uint16 i;
+
+	for (i = 0; i < nBands; i++)
+	{
+		aryBands[i].firstRow = (uint16)(firstRow + (uint32)(endRow - firstRow) * i / nBands);
+		aryBands[i].endRow = (uint16)(firstRow + (uint32)(endRow - firstRow) * (i + 1) / nBands);
+	}
+}
+
+void DebayerLinCorrInterior(const uint8* pRaw,
+		const uint16 width,
+		const uint16 height,
+		const bool bTopLeftIsGreen,
+		const bool bTopRowIsRed,
+		uint8 *const pOut)
+{
+	struct DEBAYER_BAND aryBands[MAX_VIS_BANDS];
+	uint16 nBands = VisGetBandCount(height, MIN_VIS_BAND_ROWS), i;
+
+	if (nBands <= 1)
+	{
+		DebayerLinCorrGreenRows(pRaw, width, 2, height - 2, bTopLeftIsGreen, pOut);
+		DebayerLinCorrRedBlueRows(pRaw, width, 1, height - 1, bTopLeftIsGreen,
+				bTopRowIsRed, pOut);
+		return;
+	}
+
+	for (i = 0; i < nBands; i++)
+	{
+		aryBands[i].pRaw = pRaw;
+		aryBands[i].width = width;
+		aryBands[i].bTopLeftIsGreen = bTopLeftIsGreen;
+		aryBands[i].bTopRowIsRed = bTopRowIsRed;
+		aryBands[i].pOut = pOut;
+	}
+
+	SplitRows(aryBands, nBands, 2, height - 2);
+	VisRunBands(GreenBand, aryBands, sizeof(aryBands[0]), nBands);
+
+	SplitRows(aryBands, nBands, 1, height - 1);
+	VisRunBands(RedBlueBand, aryBands, sizeof(aryBands[0]), nBands);
+}
@@ -0,0 +1,35 @@
+/*	Oscar, a hardware abstraction framework for the LeanXcam and IndXcam.
+	Copyright (C) 2008 Supercomputing Systems AG
+	
+	This library is free software; you can redistribute it and/or modify it
+	under the terms of the GNU Lesser General Public License as published by
+	the Free Software Foundation; either version 2.1 of the License, or (at
+	your option) any later version.
+	
+	This library is distributed in the hope that it will be useful, but
+	WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser
+	General Public License for more details.
+	
+	You should have received a copy of the GNU Lesser General Public License
+	along with this library; if not, write to the Free Software Foundation,
+	Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+/*! @file
+ * @brief Interior of the linear correction debayering on the target.
+ */
+
+#include "vis.h"
+
+void DebayerLinCorrInterior(const uint8* pRaw,
+		const uint16 width,
+		const uint16 height,
+		const bool bTopLeftIsGreen,
+		const bool bTopRowIsRed,
+		uint8 *const pOut)
+{
+	DebayerLinCorrGreenRows(pRaw, width, 2, height - 2, bTopLeftIsGreen, pOut);
+	DebayerLinCorrRedBlueRows(pRaw, width, 1, height - 1, bTopLeftIsGreen,
+			bTopRowIsRed, pOut);
+}
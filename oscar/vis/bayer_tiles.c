@@ -0,0 +1,178 @@
+/*	Oscar, a hardware abstraction framework for the LeanXcam and IndXcam.
+	Copyright (C) 2008 Supercomputing Systems AG
+	
+	This library is free software; you can redistribute it and/or modify it
+	under the terms of the GNU Lesser General Public License as published by
+	the Free Software Foundation; either version 2.1 of the License, or (at
+	your option) any later version.
+	
+	This library is distributed in the hope that it will be useful, but
+	WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser
+	General Public License for more details.
+	
+	You should have received a copy of the GNU Lesser General Public License
+	along with this library; if not, write to the Free Software Foundation,
+	Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+/*! @file
+ * @brief Debayering of rectangles of an image into a tile atlas.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "vis.h"
+
+/*! @brief Number of raw pixels debayered around each side of a
+ * rectangle. OscVisDebayer reads 3 pixels around an interior pixel, the
+ * fourth keeps the window at even coordinates and thus the bayer order
+ * of the image. */
+#define TILE_CONTEXT 4
+
+/*********************************************************************//*!
+ * @brief Get the window of the raw image debayered for a rectangle.
+ *
+ * @param pRect The rectangle, clipped to the image and not empty.
+ * @param width Width of the image.
+ * @param height Height of the image.
+ * @param pWindow The window containing the rectangle and its context.
+ *//*********************************************************************/
+static void GetTileWindow(const struct OSC_VIS_RECT *pRect,
+		const uint16 width,
+		const uint16 height,
+		struct OSC_VIS_RECT *pWindow)
+{
+	uint32 right = MIN((uint32)pRect->left + pRect->width + TILE_CONTEXT, width);
+	uint32 bottom = MIN((uint32)pRect->top + pRect->height + TILE_CONTEXT, height);
+
+	pWindow->left = pRect->left > TILE_CONTEXT ? (pRect->left - TILE_CONTEXT) & ~1 : 0;
+	pWindow->top = pRect->top > TILE_CONTEXT ? (pRect->top - TILE_CONTEXT) & ~1 : 0;
+	/* The width of the image is even, so this stays inside. */
+	pWindow->width = ((right + 1) & ~1) - pWindow->left;
+	pWindow->height = bottom - pWindow->top;
+}
+
+OSC_ERR OscVisDebayerTiles(const uint8 *pRaw,
+		const uint16 width,
+		const uint16 height,
+		const enum EnBayerOrder enBayerOrderFirstRow,
+		const struct OSC_VIS_RECT *pRects,
+		const uint16 nRects,
+		const enum EnOscPictureType enType,
+		uint8 *pAtlas,
+		const uint32 atlasSize,
+		struct OSC_VIS_TILE *pTiles)
+{
+	struct OSC_VIS_RECT window;
+	uint32 bytesPerPix, offset = 0, maxWindowSize = 0;
+	uint8 *pWinRaw = NULL, *pWinOut;
+	uint16 i, row;
+	OSC_ERR err = SUCCESS;
+
+	/*---------------------- Input validation. -------------------- */
+	if((pRaw == NULL) || (pRects == NULL && nRects != 0) ||
+			(pTiles == NULL && nRects != 0) ||
+			(enType != OSC_PICTURE_BGR_24 && enType != OSC_PICTURE_GREYSCALE))
+	{
+		OscLog(ERROR, "%s(0x%x, %d, %d, %d, 0x%x, %d, %d, 0x%x, %d, 0x%x): Invalid arguments!\n",
+				__func__, pRaw, width, height, enBayerOrderFirstRow, pRects,
+				nRects, enType, pAtlas, atlasSize, pTiles);
+		return -EINVALID_PARAMETER;
+	}
+
+	if((width % 2 != 0) || (width < 4) || (height < 4))
+	{
+		OscLog(ERROR, "%s: Invalid parameter! Width: %d Height: %d\n"
+				"Width must be even and >=4 and height must be >=4.\n",
+				__func__, width, height);
+		return -EINVALID_PARAMETER;
+	}
+
+	bytesPerPix = (enType == OSC_PICTURE_BGR_24) ? 3 : 1;
+
+	/* Clip the rectangles and lay out the atlas. */
+	for (i = 0; i < nRects; i++)
+	{
+		struct OSC_VIS_TILE *pTile = &pTiles[i];
+
+		pTile->rect = pRects[i];
+		if (pTile->rect.left >= width || pTile->rect.top >= height)
+		{
+			pTile->rect.width = 0;
+			pTile->rect.height = 0;
+		} else {
+			pTile->rect.width = MIN(pTile->rect.width, width - pTile->rect.left);
+			pTile->rect.height = MIN(pTile->rect.height, height - pTile->rect.top);
+		}
+		pTile->offset = offset;
+
+		offset += (uint32)pTile->rect.width * pTile->rect.height * bytesPerPix;
+		if (pTile->rect.width != 0 && pTile->rect.height != 0)
+		{
+			GetTileWindow(&pTile->rect, width, height, &window);
+			maxWindowSize = MAX(maxWindowSize, (uint32)window.width * window.height);
+		}
+	}
+
+	if (offset > atlasSize || (offset != 0 && pAtlas == NULL))
+	{
+		OscLog(ERROR, "%s: The tiles need %d bytes but the atlas has %d!\n",
+				__func__, offset, pAtlas == NULL ? 0 : atlasSize);
+		return -EBUFFER_TOO_SMALL;
+	}
+
+	if (maxWindowSize == 0)
+		return SUCCESS;
+
+	/* One buffer for the raw and the debayered window. */
+	pWinRaw = malloc(maxWindowSize * (1 + 3));
+	if (pWinRaw == NULL)
+	{
+		OscLog(ERROR, "%s: Unable to allocate %d bytes!\n",
+				__func__, maxWindowSize * (1 + 3));
+		return -EOUT_OF_MEMORY;
+	}
+	pWinOut = &pWinRaw[maxWindowSize];
+
+	for (i = 0; i < nRects; i++)
+	{
+		const struct OSC_VIS_TILE *pTile = &pTiles[i];
+		const uint8 *pIn;
+		uint8 *pDst = &pAtlas[pTile->offset];
+
+		if (pTile->rect.width == 0 || pTile->rect.height == 0)
+			continue;
+
+		GetTileWindow(&pTile->rect, width, height, &window);
+		for (row = 0; row < window.height; row++)
+		{
+			memcpy(&pWinRaw[(uint32)row * window.width],
+					&pRaw[(uint32)(window.top + row) * width + window.left],
+					window.width);
+		}
+
+		/* The window starts at even coordinates, so it has the same bayer
+		 * order as the image. */
+		err = OscVisDebayer(pWinRaw, window.width, window.height,
+				enBayerOrderFirstRow, pWinOut);
+		if (err != SUCCESS)
+			break;
+
+		for (row = 0; row < pTile->rect.height; row++)
+		{
+			pIn = &pWinOut[((uint32)(pTile->rect.top - window.top + row) * window.width
+					+ pTile->rect.left - window.left) * 3];
+			if (enType == OSC_PICTURE_BGR_24)
+				memcpy(pDst, pIn, pTile->rect.width * 3);
+			else
+				OscVisColorToYUV(pIn, &OSC_VIS_BGR_LAYOUT, pTile->rect.width, pDst, NULL, NULL);
+			pDst += pTile->rect.width * bytesPerPix;
+		}
+	}
+
+	free(pWinRaw);
+	return err;
+}
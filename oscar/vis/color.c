@@ -0,0 +1,458 @@
+/*	Oscar, a hardware abstraction framework for the LeanXcam and IndXcam.
+	Copyright (C) 2008 Supercomputing Systems AG
+	
+	This library is free software; you can redistribute it and/or modify it
+	under the terms of the GNU Lesser General Public License as published by
+	the Free Software Foundation; either version 2.1 of the License, or (at
+	your option) any later version.
+	
+	This library is distributed in the hope that it will be useful, but
+	WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser
+	General Public License for more details.
+	
+	You should have received a copy of the GNU Lesser General Public License
+	along with this library; if not, write to the Free Software Foundation,
+	Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+/*! @file
+ * @brief Color conversion kernels.
+ * 
+ * The vision functions, the JPEG encoder and the application all convert
+ * colors with these, so each color space is defined in one place. Two
+ * are derived from RGB: the luminance and color differences of the
+ * vision functions, with the weights of OscVisBGR2Grey, and the YCbCr of
+ * JFIF written by the JPEG encoder.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "vis.h"
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+/*! @brief Luminance of the vision functions, (0.299 * R + 0.587 * G +
+ * 0.114 * B) with weights scaled by 128. */
+#define LUMINANCE(R, G, B) ((38 * (R) + 75 * (G) + 15 * (B)) >> 7)
+/*! @brief Color differences to the luminance of the vision functions,
+ * (0.492 * (B - Y)) and (0.877 * (R - Y)) with factors scaled by 128. */
+#define CHROMINANCE_U(B, Y) ((((B) - (Y)) * 63 >> 7) + 128)
+#define CHROMINANCE_V(R, Y) ((((R) - (Y)) * 112 >> 7) + 128)
+
+/*! @brief Luma and chroma of JFIF with weights scaled by 256. The chroma
+ * is left scaled, so that it can be summed up for subsampling. */
+#define JFIF_Y(R, G, B) ((77 * (R) + 150 * (G) + 29 * (B)) >> 8)
+#define JFIF_CB(R, G, B) (-43 * (R) - 85 * (G) + 128 * (B))
+#define JFIF_CR(R, G, B) (128 * (R) - 107 * (G) - 21 * (B))
+
+const struct OSC_VIS_COLOR_LAYOUT OSC_VIS_BGR_LAYOUT = { 0, 1, 1, 2, 3 };
+
+/*! @brief Reciprocals of the hue denominator max - min, rounded up, so
+ * that (a * aryHueReciprocal[d]) >> 16 == 10922 * a / d for 0 <= a <= d.
+ * The entry for 0 makes hue 0 for grey pixels. */
+static const uint32 aryHueReciprocal[256] = {
+	0, 715784192, 357892096, 238594731, 178946048, 143156839, 119297366, 102254885,
+	89473024, 79531577, 71578420, 65071291, 59648683, 55060323, 51127443, 47718947,
+	44736512, 42104953, 39765789, 37672853, 35789210, 34084962, 32535646, 31121052,
+	29824342, 28631368, 27530162, 26510526, 25563722, 24682214, 23859474, 23089813,
+	22368256, 21690431, 21052477, 20450977, 19882895, 19345519, 18836427, 18353441,
+	17894605, 17458152, 17042481, 16646144, 16267823, 15906316, 15560526, 15229451,
+	14912171, 14607841, 14315684, 14034985, 13765081, 13505363, 13255263, 13014259,
+	12781861, 12557618, 12341107, 12131936, 11929737, 11734168, 11544907, 11361654,
+	11184128, 11012065, 10845216, 10683347, 10526239, 10373684, 10225489, 10081468,
+	9941448, 9805263, 9672760, 9543790, 9418214, 9295899, 9176721, 9060560,
+	8947303, 8836842, 8729076, 8623906, 8521241, 8420991, 8323072, 8227405,
+	8133912, 8042520, 7953158, 7865761, 7780263, 7696605, 7614726, 7534571,
+	7456086, 7379219, 7303921, 7230144, 7157842, 7086973, 7017493, 6949362,
+	6882541, 6816993, 6752682, 6689572, 6627632, 6566828, 6507130, 6448507,
+	6390931, 6334374, 6278809, 6224211, 6170554, 6117814, 6065968, 6014994,
+	5964869, 5915572, 5867084, 5819384, 5772454, 5726274, 5680827, 5636096,
+	5592064, 5548715, 5506033, 5464002, 5422608, 5381837, 5341674, 5302106,
+	5263120, 5224703, 5186842, 5149527, 5112745, 5076484, 5040734, 5005484,
+	4970724, 4936443, 4902632, 4869281, 4836380, 4803921, 4771895, 4740293,
+	4709107, 4678329, 4647950, 4617963, 4588361, 4559135, 4530280, 4501788,
+	4473652, 4445865, 4418421, 4391315, 4364538, 4338087, 4311953, 4286133,
+	4260621, 4235410, 4210496, 4185873, 4161536, 4137481, 4113703, 4090196,
+	4066956, 4043979, 4021260, 3998795, 3976579, 3954609, 3932881, 3911390,
+	3890132, 3869104, 3848303, 3827723, 3807363, 3787218, 3767286, 3747562,
+	3728043, 3708727, 3689610, 3670689, 3651961, 3633423, 3615072, 3596906,
+	3578921, 3561116, 3543487, 3526031, 3508747, 3491631, 3474681, 3457895,
+	3441271, 3424805, 3408497, 3392343, 3376341, 3360490, 3344786, 3329229,
+	3313816, 3298545, 3283414, 3268421, 3253565, 3238843, 3224254, 3209795,
+	3195466, 3181264, 3167187, 3153235, 3139405, 3125696, 3112106, 3098633,
+	3085277, 3072036, 3058907, 3045891, 3032984, 3020187, 3007497, 2994913,
+	2982435, 2970059, 2957786, 2945614, 2933542, 2921569, 2909692, 2897912,
+	2886227, 2874636, 2863137, 2851730, 2840414, 2829187, 2818048, 2806997
+};
+
+/*! @brief Reciprocals of half the saturation denominator, rounded up, so
+ * that (a * arySatReciprocal[d]) >> 16 == (a << 8) / (d << 1) for all
+ * a < 256. The entry for 0 makes the saturation of black pixels 0. */
+static const uint32 arySatReciprocal[129] = {
+	0, 8388608, 4194304, 2796203, 2097152, 1677722, 1398102, 1198373,
+	1048576, 932068, 838861, 762601, 699051, 645278, 599187, 559241,
+	524288, 493448, 466034, 441506, 419431, 399458, 381301, 364723,
+	349526, 335545, 322639, 310690, 299594, 289263, 279621, 270601,
+	262144, 254201, 246724, 239675, 233017, 226720, 220753, 215093,
+	209716, 204601, 199729, 195084, 190651, 186414, 182362, 178482,
+	174763, 171197, 167773, 164483, 161320, 158276, 155345, 152521,
+	149797, 147169, 144632, 142180, 139811, 137519, 135301, 133153,
+	131072, 129056, 127101, 125204, 123362, 121575, 119838, 118150,
+	116509, 114913, 113360, 111849, 110377, 108943, 107547, 106185,
+	104858, 103564, 102301, 101068, 99865, 98690, 97542, 96421,
+	95326, 94255, 93207, 92183, 91181, 90201, 89241, 88302,
+	87382, 86481, 85599, 84734, 83887, 83056, 82242, 81443,
+	80660, 79892, 79138, 78399, 77673, 76960, 76261, 75574,
+	74899, 74236, 73585, 72945, 72316, 71698, 71090, 70493,
+	69906, 69328, 68760, 68201, 67651, 67109, 66577, 66053,
+	65536
+};
+
+/*! @brief Compute 10922 * diff / delta for |diff| <= delta, truncating
+ * towards zero like the integer division. */
+static inline int32 HueQuotient(int32 diff, uint8 delta)
+{
+	int32 q = (int32)(((uint32)abs(diff) * aryHueReciprocal[delta]) >> 16);
+
+	return diff < 0 ? -q : q;
+}
+
+
+/*********************************************************************//*!
+ * @brief Get the color of a pixel.
+ * 
+ * @param pPix The first byte of the pixel.
+ * @param pLayout The layout of the pixel.
+ * @param pR Red is returned over this pointer.
+ * @param pG Green is returned over this pointer.
+ * @param pB Blue is returned over this pointer.
+ *//*********************************************************************/
+static inline void GetColor(const uint8 *pPix,
+		const struct OSC_VIS_COLOR_LAYOUT *pLayout,
+		int16 *pR,
+		int16 *pG,
+		int16 *pB)
+{
+	*pR = pPix[pLayout->offsetR];
+	*pG = (pPix[pLayout->offsetG1] + pPix[pLayout->offsetG2] + 1) >> 1;
+	*pB = pPix[pLayout->offsetB];
+}
+
+#ifdef __SSE2__
+/*! @brief Load the colors of 8 pixels with a step of 2 bytes as 16 bit
+ * values. Reads 1 byte after the last color of the last pixel. */
+static inline void LoadColor8(const uint8 *pPix,
+		const struct OSC_VIS_COLOR_LAYOUT *pLayout,
+		__m128i *pR, __m128i *pG, __m128i *pB)
+{
+	const __m128i lowByte = _mm_set1_epi16(0xff);
+
+	*pR = _mm_and_si128(_mm_loadu_si128((const __m128i *)&pPix[pLayout->offsetR]), lowByte);
+	*pG = _mm_and_si128(_mm_loadu_si128((const __m128i *)&pPix[pLayout->offsetG1]), lowByte);
+	if (pLayout->offsetG2 != pLayout->offsetG1)
+		*pG = _mm_avg_epu16(*pG, _mm_and_si128(
+				_mm_loadu_si128((const __m128i *)&pPix[pLayout->offsetG2]), lowByte));
+	*pB = _mm_and_si128(_mm_loadu_si128((const __m128i *)&pPix[pLayout->offsetB]), lowByte);
+}
+
+/*! @brief Store the low bytes of two times 8 16 bit values. */
+static inline void StoreLowBytes16(uint8 *pOut, __m128i a, __m128i b)
+{
+	const __m128i lowByte = _mm_set1_epi16(0xff);
+
+	_mm_storeu_si128((__m128i *)pOut,
+			_mm_packus_epi16(_mm_and_si128(a, lowByte), _mm_and_si128(b, lowByte)));
+}
+
+/*! @brief Weighted sum (wR * R + wG * G + wB * B) of 8 pixels, modulo
+ * 65536. */
+static inline __m128i WeightedSum8(__m128i R, __m128i G, __m128i B,
+		int16 wR, int16 wG, int16 wB)
+{
+	return _mm_add_epi16(_mm_add_epi16(
+			_mm_mullo_epi16(R, _mm_set1_epi16(wR)),
+			_mm_mullo_epi16(G, _mm_set1_epi16(wG))),
+			_mm_mullo_epi16(B, _mm_set1_epi16(wB)));
+}
+
+/*! @brief Color difference ((C - Y) * factor >> 7) + 128 of 8 pixels, of
+ * which only the low byte is used. */
+static inline __m128i Chrom8(__m128i C, __m128i Y, int16 factor)
+{
+	return _mm_add_epi16(_mm_srai_epi16(_mm_mullo_epi16(_mm_sub_epi16(C, Y),
+			_mm_set1_epi16(factor)), 7), _mm_set1_epi16(128));
+}
+
+/*! @brief Compute (a * pTable[d]) >> 16 of 8 values, which must be below
+ * 65536. */
+static inline __m128i MultiplyReciprocal8(__m128i a, __m128i d, const uint32 *pTable)
+{
+	uint16 aryD[8];
+	uint32 aryRcp[8];
+	__m128i hi, lo;
+	int i;
+
+	_mm_storeu_si128((__m128i *)aryD, d);
+	for (i = 0; i < 8; i++)
+		aryRcp[i] = pTable[aryD[i]];
+	hi = _mm_set_epi16(aryRcp[7] >> 16, aryRcp[6] >> 16, aryRcp[5] >> 16,
+			aryRcp[4] >> 16, aryRcp[3] >> 16, aryRcp[2] >> 16,
+			aryRcp[1] >> 16, aryRcp[0] >> 16);
+	lo = _mm_set_epi16(aryRcp[7], aryRcp[6], aryRcp[5], aryRcp[4],
+			aryRcp[3], aryRcp[2], aryRcp[1], aryRcp[0]);
+	/* The result fits into 16 bit, so the high part only needs the
+	 * low 16 bits of its product. */
+	return _mm_add_epi16(_mm_mullo_epi16(a, hi), _mm_mulhi_epu16(a, lo));
+}
+
+/*! @brief The upper 8 bits of the 16 bit hue of 8 pixels. */
+static inline __m128i Hue8(__m128i R, __m128i G, __m128i B,
+		__m128i max, __m128i min)
+{
+	__m128i maxIsR = _mm_cmpeq_epi16(max, R);
+	__m128i maxIsG = _mm_andnot_si128(maxIsR, _mm_cmpeq_epi16(max, G));
+	__m128i diff, offset, neg, hue;
+
+	diff = VisSelect(maxIsR, _mm_sub_epi16(G, B),
+			VisSelect(maxIsG, _mm_sub_epi16(B, R), _mm_sub_epi16(R, G)));
+	offset = VisSelect(maxIsR, _mm_setzero_si128(),
+			VisSelect(maxIsG, _mm_set1_epi16(21845), _mm_set1_epi16((int16)43690)));
+
+	/* The division truncates towards zero. */
+	neg = _mm_srai_epi16(diff, 15);
+	hue = MultiplyReciprocal8(_mm_sub_epi16(_mm_xor_si128(diff, neg), neg),
+			_mm_sub_epi16(max, min), aryHueReciprocal);
+	hue = _mm_sub_epi16(_mm_xor_si128(hue, neg), neg);
+
+	return _mm_srli_epi16(_mm_add_epi16(hue, offset), 8);
+}
+
+/*! @brief The saturation of 8 pixels, of which only the low byte is
+ * used. */
+static inline __m128i Sat8(__m128i max, __m128i min)
+{
+	__m128i lum = _mm_srli_epi16(_mm_add_epi16(max, min), 1);
+	__m128i d = VisSelect(_mm_cmplt_epi16(lum, _mm_set1_epi16(128)), lum,
+			_mm_sub_epi16(_mm_set1_epi16(256), lum));
+
+	return MultiplyReciprocal8(_mm_sub_epi16(max, min), d, arySatReciprocal);
+}
+#endif /* __SSE2__ */
+
+OSC_ERR OscVisGetBayerColorLayout(const uint16 width,
+		const enum EnBayerOrder enBayerOrderFirstRow,
+		struct OSC_VIS_COLOR_LAYOUT *pLayout)
+{
+	if (pLayout == NULL)
+	{
+		OscLog(ERROR, "%s(%d, %d, 0x%x): Invalid arguments!\n",
+				__func__, width, enBayerOrderFirstRow, pLayout);
+		return -EINVALID_PARAMETER;
+	}
+
+	switch (enBayerOrderFirstRow)
+	{
+	case ROW_BGBG:
+		pLayout->offsetB = 0;
+		pLayout->offsetG1 = 1;
+		pLayout->offsetG2 = width;
+		pLayout->offsetR = width + 1;
+		break;
+	case ROW_RGRG:
+		pLayout->offsetR = 0;
+		pLayout->offsetG1 = 1;
+		pLayout->offsetG2 = width;
+		pLayout->offsetB = width + 1;
+		break;
+	case ROW_GBGB:
+		pLayout->offsetG1 = 0;
+		pLayout->offsetB = 1;
+		pLayout->offsetR = width;
+		pLayout->offsetG2 = width + 1;
+		break;
+	case ROW_GRGR:
+		pLayout->offsetG1 = 0;
+		pLayout->offsetR = 1;
+		pLayout->offsetB = width;
+		pLayout->offsetG2 = width + 1;
+		break;
+	default:
+		OscLog(ERROR, "%s: Invalid bayer order %d!\n", __func__, enBayerOrderFirstRow);
+		return -EINVALID_PARAMETER;
+	}
+	pLayout->step = 2;
+
+	return SUCCESS;
+}
+
+void OscVisColorToYUV(const uint8 *pIn,
+		const struct OSC_VIS_COLOR_LAYOUT *pLayout,
+		const uint32 nPixels,
+		uint8 *pY,
+		uint8 *pU,
+		uint8 *pV)
+{
+	/* A copy the stores cannot alias. */
+	const struct OSC_VIS_COLOR_LAYOUT layout = *pLayout;
+	uint32 x = 0;
+	int16 R, G, B, Y;
+
+#ifdef __SSE2__
+	/* The loads read past the last pixel, so at least one is left to the
+	 * scalar loop. */
+	if (layout.step == 2)
+		for (; x + 16 < nPixels; x += 16)
+		{
+			__m128i R0, G0, B0, Y0, R1, G1, B1, Y1;
+
+			LoadColor8(&pIn[2 * x], &layout, &R0, &G0, &B0);
+			LoadColor8(&pIn[2 * x + 16], &layout, &R1, &G1, &B1);
+			Y0 = _mm_srli_epi16(WeightedSum8(R0, G0, B0, 38, 75, 15), 7);
+			Y1 = _mm_srli_epi16(WeightedSum8(R1, G1, B1, 38, 75, 15), 7);
+			if (pY != NULL)
+				StoreLowBytes16(&pY[x], Y0, Y1);
+			if (pU != NULL)
+				StoreLowBytes16(&pU[x], Chrom8(B0, Y0, 63), Chrom8(B1, Y1, 63));
+			if (pV != NULL)
+				StoreLowBytes16(&pV[x], Chrom8(R0, Y0, 112), Chrom8(R1, Y1, 112));
+		}
+#endif /* __SSE2__ */
+
+	/* Only the luminance, as for greyscale images. */
+	if (pY != NULL && pU == NULL && pV == NULL)
+	{
+		for (; x < nPixels; x++)
+		{
+			GetColor(&pIn[x * layout.step], &layout, &R, &G, &B);
+			pY[x] = (uint8)LUMINANCE(R, G, B);
+		}
+		return;
+	}
+
+	for (; x < nPixels; x++)
+	{
+		GetColor(&pIn[x * layout.step], &layout, &R, &G, &B);
+		Y = LUMINANCE(R, G, B);
+		if (pY != NULL)
+			pY[x] = (uint8)Y;
+		if (pU != NULL)
+			pU[x] = (uint8)CHROMINANCE_U(B, Y);
+		if (pV != NULL)
+			pV[x] = (uint8)CHROMINANCE_V(R, Y);
+	}
+}
+
+void OscVisColorToYCbCr(const uint8 *pIn,
+		const struct OSC_VIS_COLOR_LAYOUT *pLayout,
+		const uint32 nPixels,
+		uint8 *pY,
+		int16 *pCb,
+		int16 *pCr)
+{
+	/* A copy the stores cannot alias. */
+	const struct OSC_VIS_COLOR_LAYOUT layout = *pLayout;
+	uint32 x = 0;
+	int16 R, G, B;
+
+#ifdef __SSE2__
+	/* The loads read past the last pixel, so at least one is left to the
+	 * scalar loop. The weighted sums all fit into 16 bit. */
+	if (layout.step == 2)
+		for (; x + 8 < nPixels; x += 8)
+		{
+			__m128i R8, G8, B8;
+
+			LoadColor8(&pIn[2 * x], &layout, &R8, &G8, &B8);
+			if (pY != NULL)
+				_mm_storel_epi64((__m128i *)&pY[x], _mm_packus_epi16(
+						_mm_srli_epi16(WeightedSum8(R8, G8, B8, 77, 150, 29), 8),
+						_mm_setzero_si128()));
+			if (pCb != NULL)
+				_mm_storeu_si128((__m128i *)&pCb[x], WeightedSum8(R8, G8, B8, -43, -85, 128));
+			if (pCr != NULL)
+				_mm_storeu_si128((__m128i *)&pCr[x], WeightedSum8(R8, G8, B8, 128, -107, -21));
+		}
+#endif /* __SSE2__ */
+
+	for (; x < nPixels; x++)
+	{
+		GetColor(&pIn[x * layout.step], &layout, &R, &G, &B);
+		if (pY != NULL)
+			pY[x] = (uint8)JFIF_Y(R, G, B);
+		if (pCb != NULL)
+			pCb[x] = (int16)JFIF_CB(R, G, B);
+		if (pCr != NULL)
+			pCr[x] = (int16)JFIF_CR(R, G, B);
+	}
+}
+
+void OscVisColorToHSL(const uint8 *pIn,
+		const struct OSC_VIS_COLOR_LAYOUT *pLayout,
+		const uint32 nPixels,
+		uint8 *pH,
+		uint8 *pS,
+		uint8 *pL)
+{
+	/* A copy the stores cannot alias. */
+	const struct OSC_VIS_COLOR_LAYOUT layout = *pLayout;
+	uint32 x = 0;
+	int16 R, G, B, max, min, lum;
+	uint16 hue;
+
+#ifdef __SSE2__
+	/* The loads read past the last pixel, so at least one is left to the
+	 * scalar loop. */
+	if (layout.step == 2)
+		for (; x + 16 < nPixels; x += 16)
+		{
+			__m128i R0, G0, B0, max0, min0, R1, G1, B1, max1, min1;
+
+			LoadColor8(&pIn[2 * x], &layout, &R0, &G0, &B0);
+			LoadColor8(&pIn[2 * x + 16], &layout, &R1, &G1, &B1);
+			max0 = _mm_max_epi16(_mm_max_epi16(R0, G0), B0);
+			min0 = _mm_min_epi16(_mm_min_epi16(R0, G0), B0);
+			max1 = _mm_max_epi16(_mm_max_epi16(R1, G1), B1);
+			min1 = _mm_min_epi16(_mm_min_epi16(R1, G1), B1);
+			if (pH != NULL)
+				StoreLowBytes16(&pH[x], Hue8(R0, G0, B0, max0, min0),
+						Hue8(R1, G1, B1, max1, min1));
+			if (pS != NULL)
+				StoreLowBytes16(&pS[x], Sat8(max0, min0), Sat8(max1, min1));
+			if (pL != NULL)
+				StoreLowBytes16(&pL[x], _mm_srli_epi16(_mm_add_epi16(max0, min0), 1),
+						_mm_srli_epi16(_mm_add_epi16(max1, min1), 1));
+		}
+#endif /* __SSE2__ */
+
+	for (; x < nPixels; x++)
+	{
+		GetColor(&pIn[x * layout.step], &layout, &R, &G, &B);
+		max = MAX(MAX(R, G), B);
+		min = MIN(MIN(R, G), B);
+		lum = (max + min) >> 1;
+
+		if (pH != NULL)
+		{
+			if (max == min)
+				hue = 0;
+			else if (max == R)
+				hue = HueQuotient(G - B, max - min) + 65536;
+			else if (max == G)
+				hue = HueQuotient(B - R, max - min) + 21845;
+			else
+				hue = HueQuotient(R - G, max - min) + 43690;
+			pH[x] = (uint8)(hue >> 8);
+		}
+		/* The saturation is ((max - min) << 8) / (lum << 1) below a
+		 * luminance of 128 and ((max - min) << 8) / (512 - (lum << 1))
+		 * above. */
+		if (pS != NULL)
+			pS[x] = (uint8)(((max - min) * arySatReciprocal[lum < 128 ? lum : 256 - lum]) >> 16);
+		if (pL != NULL)
+			pL[x] = (uint8)lum;
+	}
+}
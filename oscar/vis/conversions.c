@@ -27,50 +27,20 @@
 
 #include "vis.h"
 
-
+/*! @brief Number of pixels converted at once by the functions going
+ * through a buffer. An even number. */
+#define CONVERSION_CHUNK 256
 
 OSC_ERR OscVisBGR2Grey(struct OSC_PICTURE *picIn, struct OSC_PICTURE *picOut)
 {
-
-	uint32 outPos = 0;
-	uint32 nPixels;
-	uint32 pix, cacheLine, nCacheLines, nPixPerCacheLine;
-	uint8 *pGrayImgOut = (uint8*)picOut->data;
 	const uint16 width = picIn->width;
 	const uint16 height = picIn->height;
-	uint8 *pImgIn = (uint8*)picIn->data;
-	uint8 *pIn_prefetch = pImgIn;
-	uint8 *pIn = pImgIn;
-	uint8 pointerOffset;
-	
-	nPixels = width*height;
-	
-	/* load cache (32 byte -> ~10 RGB pixels) */
-	PREFETCH(pIn_prefetch);
-	/* set pointer + 10 pixels (RGB) -> +30bytes*/
-	pointerOffset = (CACHE_LINE_LEN/(3*sizeof(uint8))) * 3;
-	pIn_prefetch += pointerOffset;
-	
-	/* number of necessary cache lines to process entire RGB image (10 RGB pixels per CL) */
-	nCacheLines = (nPixels*3*sizeof(uint8))/pointerOffset;
-	/* number of pixels per cacheline (10 RGB pixels) */
-    nPixPerCacheLine = CACHE_LINE_LEN/(3*sizeof(uint8));
 
-    for(cacheLine = 0; cacheLine < nCacheLines; cacheLine++)
-    {
-    	/* load next 10 RGB pixels */
-    	PREFETCH(pIn_prefetch);
-    	pIn_prefetch += pointerOffset;
-    	for(pix = 0; pix < nPixPerCacheLine; pix++)
-        {
-        	pGrayImgOut[outPos++] = (15*pIn[0] + 75*pIn[1] + 38*pIn[2]) >> 7;
-        	pIn += 3;
-        }
-        	
-    }
-    picOut->width = width;
-    picOut->height = height;
-    picOut->type = OSC_PICTURE_GREYSCALE;
+	OscVisColorToYUV((uint8*)picIn->data, &OSC_VIS_BGR_LAYOUT, (uint32)width*height,
+			(uint8*)picOut->data, NULL, NULL);
+	picOut->width = width;
+	picOut->height = height;
+	picOut->type = OSC_PICTURE_GREYSCALE;
 	return SUCCESS;
 }
 
@@ -138,13 +108,8 @@ OSC_ERR OscVisBGR2BW(struct OSC_PICTURE *picIn, struct OSC_PICTURE *picOut, uint
 	const uint16 height = picIn->height;
 	
 	uint8 foregroundValue, backgroundValue;
-	uint32 outPos = 0;
-	uint32 nPixels;
-	uint32 pix, cacheLine, nCacheLines, nPixPerCacheLine;
-	uint8 *pIn_prefetch = pImgIn;
-	uint8 *pIn = pImgIn;
-	uint8 pointerOffset;
-	uint8 tempGrayVal;
+	uint8 aryGrey[CONVERSION_CHUNK];
+	uint32 nPixels, pos, pix, n;
 	
 	nPixels = width*height;
 	
@@ -158,36 +123,109 @@ OSC_ERR OscVisBGR2BW(struct OSC_PICTURE *picIn, struct OSC_PICTURE *picOut, uint
 		foregroundValue = 1;
 		backgroundValue = 0;
 	}
-	/* load cache (32 byte -> ~10 RGB pixels) */
-	PREFETCH(pIn_prefetch);
-	/* set pointer + 10 pixels (RGB) -> +30bytes*/
-	pointerOffset = (CACHE_LINE_LEN/(3*sizeof(uint8))) * 3;
-	pIn_prefetch += pointerOffset;
-	
-	/* number of necessary cache lines to process entire RGB image (10 RGB pixels per CL) */
-	nCacheLines = (nPixels*3*sizeof(uint8))/pointerOffset;
-	/* number of pixels per cacheline (10 RGB pixels) */
-    nPixPerCacheLine = CACHE_LINE_LEN/(3*sizeof(uint8));
 
-    for(cacheLine = 0; cacheLine < nCacheLines; cacheLine++)
-    {
-    	/* load next 10 RGB pixels */
-    	PREFETCH(pIn_prefetch);
-    	pIn_prefetch += pointerOffset;
-    	for(pix = 0; pix < nPixPerCacheLine; pix++)
-        {
-        	tempGrayVal = (15*pIn[0] + 75*pIn[1] + 38*pIn[2]) >> 7;
-        	if (tempGrayVal > threshold)
-				pBWImgOut[outPos++] = foregroundValue;
+	for(pos = 0; pos < nPixels; pos += n)
+	{
+		n = MIN(CONVERSION_CHUNK, nPixels - pos);
+		OscVisColorToYUV(&pImgIn[pos*3], &OSC_VIS_BGR_LAYOUT, n, aryGrey, NULL, NULL);
+		for(pix = 0; pix < n; pix++)
+		{
+			if (aryGrey[pix] > threshold)
+				pBWImgOut[pos + pix] = foregroundValue;
 			else
-				pBWImgOut[outPos++] = backgroundValue; 		
-        	pIn += 3;
-        }
-        	
-    }
-    picOut->height = height;
-    picOut->width = width;
-    picOut->type = OSC_PICTURE_BINARY;
+				pBWImgOut[pos + pix] = backgroundValue;
+		}
+	}
+	picOut->height = height;
+	picOut->width = width;
+	picOut->type = OSC_PICTURE_BINARY;
+	return SUCCESS;
+}
+
+OSC_ERR OscVisBGR2YCbCr(const struct OSC_PICTURE *picIn, struct OSC_PICTURE *picOut)
+{
+	uint8 aryY[2][CONVERSION_CHUNK];
+	int16 aryCb[2][CONVERSION_CHUNK], aryCr[2][CONVERSION_CHUNK];
+	const uint8 *pIn;
+	uint8 *pOut;
+	uint16 width, height, x, y, n, i, nRows;
+
+	/*---------------------- Input validation. -------------------- */
+	if((picIn == NULL) || (picOut == NULL) || (picIn->data == NULL) ||
+			(picOut->data == NULL) || (picIn->type != OSC_PICTURE_BGR_24))
+	{
+		OscLog(ERROR, "%s(0x%x, 0x%x): Invalid arguments!\n",
+				__func__, picIn, picOut);
+		return -EINVALID_PARAMETER;
+	}
+
+	width = picIn->width;
+	height = picIn->height;
+	if((picOut->type != OSC_PICTURE_YUV_444 && picOut->type != OSC_PICTURE_YUV_422 &&
+			picOut->type != OSC_PICTURE_YUV_420) ||
+			(picOut->type != OSC_PICTURE_YUV_444 && width % 2 != 0) ||
+			(picOut->type == OSC_PICTURE_YUV_420 && height % 2 != 0))
+	{
+		OscLog(ERROR, "%s: Invalid parameter! Type: %d Width: %d Height: %d\n",
+				__func__, picOut->type, width, height);
+		return -EINVALID_PARAMETER;
+	}
+
+	pIn = (const uint8*)picIn->data;
+	pOut = (uint8*)picOut->data;
+	nRows = (picOut->type == OSC_PICTURE_YUV_420) ? 2 : 1;
+
+	/* The chroma is summed up over the pixels sharing it and divided in
+	 * one go, like the JPEG encoder does. */
+	for(y = 0; y < height; y += nRows)
+	{
+		for(x = 0; x < width; x += n)
+		{
+			n = MIN(CONVERSION_CHUNK, width - x);
+			for(i = 0; i < nRows; i++)
+			{
+				OscVisColorToYCbCr(&pIn[((uint32)(y + i)*width + x)*3], &OSC_VIS_BGR_LAYOUT,
+						n, aryY[i], aryCb[i], aryCr[i]);
+			}
+
+			if(picOut->type == OSC_PICTURE_YUV_444)
+			{
+				for(i = 0; i < n; i++)
+				{
+					*pOut++ = aryY[0][i];
+					*pOut++ = (uint8)((aryCb[0][i] >> 8) + 128);
+					*pOut++ = (uint8)((aryCr[0][i] >> 8) + 128);
+				}
+			}
+			else if(picOut->type == OSC_PICTURE_YUV_422)
+			{
+				for(i = 0; i < n; i += 2)
+				{
+					*pOut++ = (uint8)(((aryCb[0][i] + aryCb[0][i + 1]) >> 9) + 128);
+					*pOut++ = aryY[0][i];
+					*pOut++ = (uint8)(((aryCr[0][i] + aryCr[0][i + 1]) >> 9) + 128);
+					*pOut++ = aryY[0][i + 1];
+				}
+			}
+			else
+			{
+				for(i = 0; i < n; i += 2)
+				{
+					*pOut++ = aryY[0][i];
+					*pOut++ = aryY[0][i + 1];
+					*pOut++ = aryY[1][i];
+					*pOut++ = aryY[1][i + 1];
+					*pOut++ = (uint8)(((aryCb[0][i] + aryCb[0][i + 1] +
+							aryCb[1][i] + aryCb[1][i + 1]) >> 10) + 128);
+					*pOut++ = (uint8)(((aryCr[0][i] + aryCr[0][i + 1] +
+							aryCr[1][i] + aryCr[1][i + 1]) >> 10) + 128);
+				}
+			}
+		}
+	}
+
+	picOut->width = width;
+	picOut->height = height;
 	return SUCCESS;
 }
 
@@ -23,9 +23,14 @@
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 
 #include "vis.h"
 
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif /* __SSE2__ */
+
 
 /* Realization of a 3x3 Gauss filter kernel */
 int8 aGauss3x3[9] = { 1,  2,  1,
@@ -57,56 +62,317 @@ struct OSC_VIS_FILTER_KERNEL MEDIAN5X5 = {5, 5, 25, aMedian5x5};
 
 
 
-/* A generic 2D filter for grayscale images */
-OSC_ERR OscVisFilter2D(struct OSC_PICTURE *picIn, struct OSC_PICTURE *picOut, uint8 *pTemp, struct OSC_VIS_FILTER_KERNEL *pKernel)
+/*! @brief Number of output pixels of a row filtered at once by the
+ * separable filter. */
+#define FILTER_CHUNK 256
+
+/*! @brief The largest kernel width or height. */
+#define MAX_KERNEL_SIZE 255
+
+/*! @brief A kernel split into a row and a column vector, so that every
+ * element of the kernel is the product of its row and column factor. */
+struct SEPARABLE_KERNEL {
+	uint16 aryRow[MAX_KERNEL_SIZE];	/*!< @brief Factors along a row. */
+	uint16 aryCol[MAX_KERNEL_SIZE];	/*!< @brief Factors along a column. */
+	int16 shift;					/*!< @brief log2 of the weight or -1. */
+};
+
+/*! @brief Greatest common divisor of two non-negative numbers. */
+static uint16 Gcd(uint16 a, uint16 b)
 {
-	const uint8 *pIn = (uint8*)picIn->data;
-	uint8 *pOut = (uint8*)picOut->data;
-	const uint16 width = picIn->width;
-	const uint16 height = picIn->height;
-	
-	uint16 x,y,kx,ky;
-	uint16 yOffset, xOffset;
+	while (b != 0)
+	{
+		uint16 t = a % b;
+		a = b;
+		b = t;
+	}
+	return a;
+}
+
+/*********************************************************************//*!
+ * @brief Split a kernel into a row and a column vector.
+ * 
+ * Only kernels without negative elements are split and only if the sum
+ * of a filtered pixel fits 16 bits, so that the separable filter
+ * calculates exactly the same as the generic one.
+ * 
+ * @param pKernel The kernel.
+ * @param pSep The split kernel is returned here.
+ * @return TRUE if the kernel could be split.
+ *//*********************************************************************/
+static bool GetSeparableKernel(const struct OSC_VIS_FILTER_KERNEL *pKernel,
+		struct SEPARABLE_KERNEL *pSep)
+{
+	const uint16 kw = pKernel->kernelWidth, kh = pKernel->kernelHeight;
+	const int8 *pK = pKernel->kernelArray;
+	uint16 x, y, refX = 0, refY = 0, gcd = 0;
+	uint32 sumRow = 0, sumCol = 0;
+	int32 ref = 0;
+
+	pSep->shift = -1;
+	for (x = 0; x < 16; x++)
+	{
+		if (pKernel->kernelWeight == 1 << x)
+			pSep->shift = x;
+	}
+
+	for (y = 0; y < kh; y++)
+	{
+		for (x = 0; x < kw; x++)
+		{
+			if (pK[y * kw + x] < 0)
+				return FALSE;
+			if (ref == 0 && pK[y * kw + x] > 0)
+			{
+				refX = x;
+				refY = y;
+				ref = pK[y * kw + x];
+			}
+		}
+	}
+	if (ref == 0)
+		return FALSE;
+
+	/* Every row must be a multiple of the reference row. */
+	for (y = 0; y < kh; y++)
+	{
+		for (x = 0; x < kw; x++)
+		{
+			if (pK[y * kw + x] * ref != pK[y * kw + refX] * pK[refY * kw + x])
+				return FALSE;
+		}
+	}
+
+	/* Take the reference row divided by its common divisor as row vector,
+	 * the column through the reference element gets the rest. */
+	for (x = 0; x < kw; x++)
+		gcd = Gcd(gcd, pK[refY * kw + x]);
+	for (x = 0; x < kw; x++)
+	{
+		pSep->aryRow[x] = pK[refY * kw + x] / gcd;
+		sumRow += pSep->aryRow[x];
+	}
+	for (y = 0; y < kh; y++)
+	{
+		pSep->aryCol[y] = pK[y * kw + refX] * gcd / ref;
+		sumCol += pSep->aryCol[y];
+	}
+
+	return sumRow * sumCol * 255 <= 0xffff;
+}
+
+/*********************************************************************//*!
+ * @brief Filter the inner pixels of a row with a separable kernel.
+ * 
+ * The column vector is applied first over a chunk of the row and then the
+ * row vector to these column sums.
+ * 
+ * @param aryRows The input rows covered by the kernel.
+ * @param width Width of the rows.
+ * @param pKernel The original kernel for its size and weight.
+ * @param pSep The split kernel.
+ * @param left Number of pixels left of the kernel center.
+ * @param pOut The output row.
+ *//*********************************************************************/
+static void FilterRowSeparable(const uint8 *const *aryRows,
+		const uint16 width,
+		const struct OSC_VIS_FILTER_KERNEL *pKernel,
+		const struct SEPARABLE_KERNEL *pSep,
+		const uint16 left,
+		uint8 *pOut)
+{
+	const uint16 kw = pKernel->kernelWidth, kh = pKernel->kernelHeight;
+	const uint16 end = width - (kw - 1 - left);
+	uint16 aryColSums[FILTER_CHUNK + MAX_KERNEL_SIZE - 1];
+	uint16 arySums[FILTER_CHUNK];
+	uint16 x0, n, i, k;
+
+	for (x0 = left; x0 < end; x0 += n)
+	{
+		const uint16 nCols = (n = MIN(FILTER_CHUNK, end - x0)) + kw - 1;
+		const uint16 first = x0 - left;
+
+		i = 0;
+#ifdef __SSE2__
+		for (; i + 8 <= nCols; i += 8)
+		{
+			__m128i sum = _mm_setzero_si128();
+
+			for (k = 0; k < kh; k++)
+			{
+				__m128i in = _mm_unpacklo_epi8(_mm_loadl_epi64(
+						(const __m128i *)&aryRows[k][first + i]), _mm_setzero_si128());
+				sum = _mm_add_epi16(sum, _mm_mullo_epi16(in, _mm_set1_epi16(pSep->aryCol[k])));
+			}
+			_mm_storeu_si128((__m128i *)&aryColSums[i], sum);
+		}
+#endif /* __SSE2__ */
+		for (; i < nCols; i++)
+		{
+			uint16 sum = 0;
+
+			for (k = 0; k < kh; k++)
+				sum += aryRows[k][first + i] * pSep->aryCol[k];
+			aryColSums[i] = sum;
+		}
+
+		i = 0;
+#ifdef __SSE2__
+		for (; i + 8 <= n; i += 8)
+		{
+			__m128i sum = _mm_setzero_si128();
+
+			for (k = 0; k < kw; k++)
+			{
+				sum = _mm_add_epi16(sum, _mm_mullo_epi16(
+						_mm_loadu_si128((const __m128i *)&aryColSums[i + k]),
+						_mm_set1_epi16(pSep->aryRow[k])));
+			}
+			_mm_storeu_si128((__m128i *)&arySums[i], sum);
+		}
+#endif /* __SSE2__ */
+		for (; i < n; i++)
+		{
+			uint16 sum = 0;
+
+			for (k = 0; k < kw; k++)
+				sum += aryColSums[i + k] * pSep->aryRow[k];
+			arySums[i] = sum;
+		}
+
+		if (pSep->shift >= 0)
+		{
+			i = 0;
+#ifdef __SSE2__
+			for (; i + 16 <= n; i += 16)
+			{
+				const __m128i lowByte = _mm_set1_epi16(0xff);
+				__m128i a = _mm_srl_epi16(_mm_loadu_si128((const __m128i *)&arySums[i]),
+						_mm_cvtsi32_si128(pSep->shift));
+				__m128i b = _mm_srl_epi16(_mm_loadu_si128((const __m128i *)&arySums[i + 8]),
+						_mm_cvtsi32_si128(pSep->shift));
+
+				_mm_storeu_si128((__m128i *)&pOut[x0 + i], _mm_packus_epi16(
+						_mm_and_si128(a, lowByte), _mm_and_si128(b, lowByte)));
+			}
+#endif /* __SSE2__ */
+			for (; i < n; i++)
+				pOut[x0 + i] = (uint8)(arySums[i] >> pSep->shift);
+		} else {
+			for (i = 0; i < n; i++)
+				pOut[x0 + i] = (uint8)(arySums[i] / pKernel->kernelWeight);
+		}
+	}
+}
+
+/*********************************************************************//*!
+ * @brief Filter the inner pixels of a row with any kernel.
+ * 
+ * @param aryRows The input rows covered by the kernel.
+ * @param width Width of the rows.
+ * @param pKernel The kernel.
+ * @param left Number of pixels left of the kernel center.
+ * @param pOut The output row.
+ *//*********************************************************************/
+static void FilterRowGeneric(const uint8 *const *aryRows,
+		const uint16 width,
+		const struct OSC_VIS_FILTER_KERNEL *pKernel,
+		const uint16 left,
+		uint8 *pOut)
+{
+	const uint16 kw = pKernel->kernelWidth, kh = pKernel->kernelHeight;
+	uint16 x, kx, ky;
 	uint32 tempVal;
-	
-	/* move the initial start pixel according to the size of the kernel (boundary condition). */			
-	if (pKernel->kernelHeight > 0)
-		yOffset = (pKernel->kernelHeight-1) >> 1;
-	else yOffset = 0;
-		
-	if (pKernel->kernelWidth > 0)
-		xOffset = (pKernel->kernelWidth-1) >> 1;
-	else xOffset = 0;
-	
-	/* copy the input image to the temporary buffer */
-	memcpy_inline(pTemp, pIn, ((sizeof(uint8)*width*height) >> 2));
-	/* safe area computation */
-	for(y = yOffset; y < (height - yOffset); y++)
+
+	for (x = left; x < width - (kw - 1 - left); x++)
 	{
-		for(x = xOffset; x < (width - xOffset); x++)
-		{		
-			tempVal = 0;
-			for(ky = 0; ky < pKernel->kernelHeight; ky++)
+		tempVal = 0;
+		for (ky = 0; ky < kh; ky++)
+		{
+			for (kx = 0; kx < kw; kx++)
 			{
-				for(kx = 0; kx < pKernel->kernelWidth; kx++)
-				{
-					tempVal = tempVal + (pTemp[(y-yOffset+ky) * width + (x-xOffset+kx)] * pKernel->kernelArray[ky * pKernel->kernelWidth + kx]);
-				}
+				tempVal = tempVal + (aryRows[ky][x - left + kx] * pKernel->kernelArray[ky * kw + kx]);
 			}
-			pOut[y * width + x] = tempVal/pKernel->kernelWeight;	
 		}
-	}	
-	/* finalize picture */
-	picOut->width = width;
-	picOut->height = height;
-	picOut->type = OSC_PICTURE_GREYSCALE;
-	return SUCCESS;	
+		pOut[x] = tempVal / pKernel->kernelWeight;
+	}
 }
 
+/* A generic 2D filter for grayscale images */
+OSC_ERR OscVisFilter2D(struct OSC_PICTURE *picIn, struct OSC_PICTURE *picOut, uint8 *pTemp, struct OSC_VIS_FILTER_KERNEL *pKernel)
+{
+	const uint8 *aryRows[MAX_KERNEL_SIZE];
+	struct SEPARABLE_KERNEL sep;
+	const uint8 *pIn;
+	uint8 *pOut;
+	uint16 width, height, kh, top, left, y, ky;
+	bool bSeparable, bInPlace;
+
+	/*---------------------- Input validation. -------------------- */
+	if ((picIn == NULL) || (picOut == NULL) || (pKernel == NULL) ||
+			(pKernel->kernelArray == NULL) || (pKernel->kernelWidth == 0) ||
+			(pKernel->kernelHeight == 0) || (pKernel->kernelWeight == 0))
+	{
+		OscLog(ERROR, "%s(0x%x, 0x%x, 0x%x, 0x%x): Invalid arguments!\n",
+				__func__, picIn, picOut, pTemp, pKernel);
+		return -EINVALID_PARAMETER;
+	}
 
+	pIn = (uint8*)picIn->data;
+	pOut = (uint8*)picOut->data;
+	width = picIn->width;
+	height = picIn->height;
+	kh = pKernel->kernelHeight;
+	bInPlace = (pIn == pOut);
+
+	if (bInPlace && pTemp == NULL)
+	{
+		OscLog(ERROR, "%s: Filtering in place needs a temporary buffer!\n", __func__);
+		return -EINVALID_PARAMETER;
+	}
+
+	/* move the initial start pixel according to the size of the kernel (boundary condition). */
+	top = (kh - 1) >> 1;
+	left = (pKernel->kernelWidth - 1) >> 1;
+
+	if (width >= pKernel->kernelWidth && height >= kh)
+	{
+		bSeparable = GetSeparableKernel(pKernel, &sep);
 
+		/* Filtering in place keeps the input rows still needed in a ring
+		 * buffer, as their pixels are overwritten by then. */
+		if (bInPlace)
+		{
+			for (ky = 0; ky < kh - 1; ky++)
+				memcpy(&pTemp[(uint32)ky * width], &pIn[(uint32)ky * width], width);
+		}
 
+		for (y = top; y < height - (kh - 1 - top); y++)
+		{
+			const uint16 lastRow = y - top + kh - 1;
 
+			for (ky = 0; ky < kh; ky++)
+			{
+				const uint16 row = y - top + ky;
 
+				if (bInPlace)
+					aryRows[ky] = &pTemp[(uint32)(row % kh) * width];
+				else
+					aryRows[ky] = &pIn[(uint32)row * width];
+			}
+			if (bInPlace)
+				memcpy(&pTemp[(uint32)(lastRow % kh) * width], &pIn[(uint32)lastRow * width], width);
 
+			if (bSeparable)
+				FilterRowSeparable(aryRows, width, pKernel, &sep, left, &pOut[(uint32)y * width]);
+			else
+				FilterRowGeneric(aryRows, width, pKernel, left, &pOut[(uint32)y * width]);
+		}
+	}
 
+	/* finalize picture */
+	picOut->width = width;
+	picOut->height = height;
+	picOut->type = OSC_PICTURE_GREYSCALE;
+	return SUCCESS;	
+}
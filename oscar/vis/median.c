@@ -0,0 +1,424 @@
+/*	Oscar, a hardware abstraction framework for the LeanXcam and IndXcam.
+	Copyright (C) 2008 Supercomputing Systems AG
+	
+	This library is free software; you can redistribute it and/or modify it
+	under the terms of the GNU Lesser General Public License as published by
+	the Free Software Foundation; either version 2.1 of the License, or (at
+	your option) any later version.
+	
+	This library is distributed in the hope that it will be useful, but
+	WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser
+	General Public License for more details.
+	
+	You should have received a copy of the GNU Lesser General Public License
+	along with this library; if not, write to the Free Software Foundation,
+	Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+/*! @file
+ * @brief Median filter for greyscale images.
+ *
+ * The 3x3 and 5x5 medians are selected by sorting networks, which work
+ * on 16 pixels at a time with SSE2 on the host. Larger windows use the
+ * constant time algorithm of Perreault and Hebert: a histogram is kept
+ * for every column and moved down by one row per output row, the
+ * histogram of the window is moved right by adding and removing a column
+ * histogram per pixel. Both histograms are split into 16 coarse bins
+ * of the upper 4 bits and 16 fine bins per coarse bin, so that only one
+ * coarse bin needs its fine bins per pixel.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "vis.h"
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif /* __SSE2__ */
+
+/*! @brief Compare-exchange steps selecting the median of 9 values into
+ * element 4 (Paeth). */
+#define MEDIAN9_NETWORK(X) \
+	X(1, 2) X(4, 5) X(7, 8) X(0, 1) X(3, 4) X(6, 7) X(1, 2) X(4, 5) \
+	X(7, 8) X(0, 3) X(5, 8) X(4, 7) X(3, 6) X(1, 4) X(2, 5) X(4, 7) \
+	X(4, 2) X(6, 4) X(4, 2)
+
+/*! @brief Compare-exchange steps selecting the median of 25 values into
+ * element 12. These are the steps of Batcher's odd-even merge sort of 32
+ * values which the median depends on, with the 7 values beyond the input
+ * taken as larger than all others. */
+#define MEDIAN25_NETWORK(X) \
+	X(0, 1) X(2, 3) X(4, 5) X(6, 7) X(8, 9) X(10, 11) X(12, 13) X(14, 15) \
+	X(16, 17) X(18, 19) X(20, 21) X(22, 23) X(0, 2) X(1, 3) X(4, 6) X(5, 7) \
+	X(8, 10) X(9, 11) X(12, 14) X(13, 15) X(16, 18) X(17, 19) X(20, 22) X(21, 23) \
+	X(1, 2) X(5, 6) X(9, 10) X(13, 14) X(17, 18) X(21, 22) X(0, 4) X(1, 5) \
+	X(2, 6) X(3, 7) X(8, 12) X(9, 13) X(10, 14) X(11, 15) X(16, 20) X(17, 21) \
+	X(18, 22) X(19, 23) X(2, 4) X(3, 5) X(10, 12) X(11, 13) X(18, 20) X(19, 21) \
+	X(1, 2) X(3, 4) X(5, 6) X(9, 10) X(11, 12) X(13, 14) X(17, 18) X(19, 20) \
+	X(21, 22) X(0, 8) X(1, 9) X(2, 10) X(3, 11) X(4, 12) X(5, 13) X(6, 14) \
+	X(7, 15) X(16, 24) X(4, 8) X(5, 9) X(6, 10) X(7, 11) X(20, 24) X(2, 4) \
+	X(3, 5) X(6, 8) X(7, 9) X(10, 12) X(11, 13) X(18, 20) X(19, 21) X(22, 24) \
+	X(1, 2) X(3, 4) X(5, 6) X(7, 8) X(9, 10) X(11, 12) X(13, 14) X(17, 18) \
+	X(19, 20) X(21, 22) X(23, 24) X(0, 16) X(1, 17) X(2, 18) X(3, 19) X(4, 20) \
+	X(5, 21) X(6, 22) X(7, 23) X(8, 24) X(8, 16) X(9, 17) X(10, 18) X(11, 19) \
+	X(12, 20) X(13, 21) X(6, 10) X(7, 11) X(12, 16) X(13, 17) X(10, 12) X(11, 13) \
+	X(11, 12)
+
+/*! @brief Put the smaller of two pixels into the first one. */
+#define SORT_PIX(a, b) { const uint8 t = MIN(p[a], p[b]); p[b] = MAX(p[a], p[b]); p[a] = t; }
+
+#ifdef __SSE2__
+/*! @brief Put the smaller of two times 16 pixels into the first one. */
+#define SORT_SSE2(a, b) { const __m128i t = _mm_min_epu8(v[a], v[b]); v[b] = _mm_max_epu8(v[a], v[b]); v[a] = t; }
+#endif /* __SSE2__ */
+
+/*********************************************************************//*!
+ * @brief Filter the inner pixels of a row with a 3x3 median.
+ *
+ * @param aryRows The input rows above, at and below the output row.
+ * @param width Width of the rows.
+ * @param pOut The output row.
+ *//*********************************************************************/
+static void MedianRow3x3(const uint8 *const *aryRows,
+		const uint16 width,
+		uint8 *pOut)
+{
+	uint16 x = 1, i;
+
+#ifdef __SSE2__
+	for (; x + 16 <= width - 1; x += 16)
+	{
+		__m128i v[9];
+
+		for (i = 0; i < 9; i++)
+			v[i] = _mm_loadu_si128((const __m128i *)&aryRows[i / 3][x - 1 + i % 3]);
+		MEDIAN9_NETWORK(SORT_SSE2)
+		_mm_storeu_si128((__m128i *)&pOut[x], v[4]);
+	}
+#endif /* __SSE2__ */
+
+	for (; x < width - 1; x++)
+	{
+		uint8 p[9];
+
+		for (i = 0; i < 9; i++)
+			p[i] = aryRows[i / 3][x - 1 + i % 3];
+		MEDIAN9_NETWORK(SORT_PIX)
+		pOut[x] = p[4];
+	}
+}
+
+/*********************************************************************//*!
+ * @brief Filter the inner pixels of a row with a 5x5 median.
+ *
+ * @param aryRows The two input rows above, the one at and the two below
+ * the output row.
+ * @param width Width of the rows.
+ * @param pOut The output row.
+ *//*********************************************************************/
+static void MedianRow5x5(const uint8 *const *aryRows,
+		const uint16 width,
+		uint8 *pOut)
+{
+	uint16 x = 2, i;
+
+#ifdef __SSE2__
+	for (; x + 16 <= width - 2; x += 16)
+	{
+		__m128i v[25];
+
+		for (i = 0; i < 25; i++)
+			v[i] = _mm_loadu_si128((const __m128i *)&aryRows[i / 5][x - 2 + i % 5]);
+		MEDIAN25_NETWORK(SORT_SSE2)
+		_mm_storeu_si128((__m128i *)&pOut[x], v[12]);
+	}
+#endif /* __SSE2__ */
+
+	for (; x < width - 2; x++)
+	{
+		uint8 p[25];
+
+		for (i = 0; i < 25; i++)
+			p[i] = aryRows[i / 5][x - 2 + i % 5];
+		MEDIAN25_NETWORK(SORT_PIX)
+		pOut[x] = p[12];
+	}
+}
+
+/*! @brief Add 16 histogram bins to others. */
+static inline void AddBins16(uint16 *pDst, const uint16 *pSrc)
+{
+#ifdef __SSE2__
+	_mm_storeu_si128((__m128i *)pDst, _mm_add_epi16(
+			_mm_loadu_si128((const __m128i *)pDst), _mm_loadu_si128((const __m128i *)pSrc)));
+	_mm_storeu_si128((__m128i *)&pDst[8], _mm_add_epi16(
+			_mm_loadu_si128((const __m128i *)&pDst[8]), _mm_loadu_si128((const __m128i *)&pSrc[8])));
+#else /* __SSE2__ */
+	uint16 i;
+
+	for (i = 0; i < 16; i++)
+		pDst[i] += pSrc[i];
+#endif /* __SSE2__ */
+}
+
+/*! @brief Subtract 16 histogram bins from others. */
+static inline void SubBins16(uint16 *pDst, const uint16 *pSrc)
+{
+#ifdef __SSE2__
+	_mm_storeu_si128((__m128i *)pDst, _mm_sub_epi16(
+			_mm_loadu_si128((const __m128i *)pDst), _mm_loadu_si128((const __m128i *)pSrc)));
+	_mm_storeu_si128((__m128i *)&pDst[8], _mm_sub_epi16(
+			_mm_loadu_si128((const __m128i *)&pDst[8]), _mm_loadu_si128((const __m128i *)&pSrc[8])));
+#else /* __SSE2__ */
+	uint16 i;
+
+	for (i = 0; i < 16; i++)
+		pDst[i] -= pSrc[i];
+#endif /* __SSE2__ */
+}
+
+/*********************************************************************//*!
+ * @brief Find the bin of 16 that holds the value of a given rank.
+ * 
+ * @param pBins The bins.
+ * @param rank The number of values smaller than the searched one.
+ * @param pBelow Input: the number of values below the first bin. Output:
+ * the number of values below the found bin.
+ * @return The index of the bin.
+ *//*********************************************************************/
+static inline uint16 FindBin16(const uint16 *pBins,
+		const uint32 rank,
+		uint32 *pBelow)
+{
+#ifdef __SSE2__
+	/* The cumulative counts are compared as unsigned by flipping the sign
+	 * bits, the first one above the rank is the bin. This avoids a
+	 * mispredicted branch on each search. */
+	const __m128i signBit = _mm_set1_epi16((int16)0x8000);
+	const __m128i limit = _mm_xor_si128(_mm_set1_epi16((int16)(rank - *pBelow)), signBit);
+	uint16 aryCum[16];
+	__m128i lo = _mm_loadu_si128((const __m128i *)pBins);
+	__m128i hi = _mm_loadu_si128((const __m128i *)&pBins[8]);
+	uint16 bin;
+
+	lo = _mm_add_epi16(lo, _mm_slli_si128(lo, 2));
+	hi = _mm_add_epi16(hi, _mm_slli_si128(hi, 2));
+	lo = _mm_add_epi16(lo, _mm_slli_si128(lo, 4));
+	hi = _mm_add_epi16(hi, _mm_slli_si128(hi, 4));
+	lo = _mm_add_epi16(lo, _mm_slli_si128(lo, 8));
+	hi = _mm_add_epi16(hi, _mm_slli_si128(hi, 8));
+	hi = _mm_add_epi16(hi, _mm_shuffle_epi32(_mm_shufflehi_epi16(lo, 0xff), 0xff));
+	_mm_storeu_si128((__m128i *)aryCum, lo);
+	_mm_storeu_si128((__m128i *)&aryCum[8], hi);
+
+	bin = (uint16)__builtin_ctz(_mm_movemask_epi8(_mm_packs_epi16(
+			_mm_cmpgt_epi16(_mm_xor_si128(lo, signBit), limit),
+			_mm_cmpgt_epi16(_mm_xor_si128(hi, signBit), limit))));
+	if (bin != 0)
+		*pBelow += aryCum[bin - 1];
+	return bin;
+#else /* __SSE2__ */
+	uint16 bin;
+
+	for (bin = 0; *pBelow + pBins[bin] <= rank; bin++)
+		*pBelow += pBins[bin];
+	return bin;
+#endif /* __SSE2__ */
+}
+
+/*********************************************************************//*!
+ * @brief Filter the inner pixels of rows with a median of any size
+ * using histograms.
+ *
+ * @param pIn The input image.
+ * @param width Width of the image.
+ * @param radius Pixels from the center to the border of the window.
+ * @param firstRow The first row to filter, at least radius.
+ * @param endRow The row after the last one to filter, at most height -
+ * radius.
+ * @param pOut The output image.
+ * @return SUCCESS or an appropriate error code otherwise.
+ *//*********************************************************************/
+static OSC_ERR MedianRowsHistogram(const uint8 *pIn,
+		const uint16 width,
+		const uint8 radius,
+		const uint16 firstRow,
+		const uint16 endRow,
+		uint8 *pOut)
+{
+	const uint16 size = 2 * radius + 1;
+	const uint32 half = (uint32)size * size / 2;
+	const uint32 histSize = (uint32)width * (256 + 16) * sizeof(uint16);
+	uint16 *pColFine, *pColCoarse;
+	uint16 aryCoarse[16], aryFine[16 * 16];
+	int32 aryFineX[16];
+	uint32 sum;
+	uint16 x, y, c, i;
+	int32 j;
+
+	/* The fine histograms of all columns, followed by their coarse ones. */
+	pColFine = malloc(histSize);
+	if (pColFine == NULL)
+	{
+		OscLog(ERROR, "%s: Unable to allocate %d bytes!\n", __func__, histSize);
+		return -EOUT_OF_MEMORY;
+	}
+	pColCoarse = &pColFine[(uint32)width * 256];
+	memset(pColFine, 0, histSize);
+
+	/* The column histograms start with the rows above the first that are
+	 * in the window, every output row then adds one at the bottom. */
+	for (y = firstRow - radius; y < firstRow + radius; y++)
+	{
+		const uint8 *pRow = &pIn[(uint32)y * width];
+
+		for (x = 0; x < width; x++)
+		{
+			pColFine[(uint32)x * 256 + pRow[x]]++;
+			pColCoarse[(uint32)x * 16 + (pRow[x] >> 4)]++;
+		}
+	}
+
+	for (y = firstRow; y < endRow; y++)
+	{
+		const uint8 *pAdd = &pIn[(uint32)(y + radius) * width];
+		uint8 *pOutRow = &pOut[(uint32)y * width];
+
+		if (y != firstRow)
+		{
+			const uint8 *pRemove = &pIn[(uint32)(y - radius - 1) * width];
+
+			for (x = 0; x < width; x++)
+			{
+				pColFine[(uint32)x * 256 + pRemove[x]]--;
+				pColCoarse[(uint32)x * 16 + (pRemove[x] >> 4)]--;
+			}
+		}
+		for (x = 0; x < width; x++)
+		{
+			pColFine[(uint32)x * 256 + pAdd[x]]++;
+			pColCoarse[(uint32)x * 16 + (pAdd[x] >> 4)]++;
+		}
+
+		/* The fine bins of the window are only brought up to date when
+		 * their coarse bin holds the median. Stale ones are recalculated
+		 * if that is cheaper than catching up column by column, which
+		 * takes two operations per column. */
+		memset(aryCoarse, 0, sizeof(aryCoarse));
+		for (c = 0; c < 16; c++)
+			aryFineX[c] = -(int32)size;
+		for (x = 0; x < size - 1; x++)
+			AddBins16(aryCoarse, &pColCoarse[(uint32)x * 16]);
+
+		for (x = radius; x < width - radius; x++)
+		{
+			uint16 *pFine;
+
+			AddBins16(aryCoarse, &pColCoarse[(uint32)(x + radius) * 16]);
+
+			sum = 0;
+			c = FindBin16(aryCoarse, half, &sum);
+
+			pFine = &aryFine[c * 16];
+			if (2 * (x - aryFineX[c]) >= size)
+			{
+				memset(pFine, 0, 16 * sizeof(uint16));
+				for (j = x - radius; j <= x + radius; j++)
+					AddBins16(pFine, &pColFine[(uint32)j * 256 + c * 16]);
+			} else {
+				for (j = aryFineX[c] + 1; j <= x; j++)
+				{
+					SubBins16(pFine, &pColFine[(uint32)(j - radius - 1) * 256 + c * 16]);
+					AddBins16(pFine, &pColFine[(uint32)(j + radius) * 256 + c * 16]);
+				}
+			}
+			aryFineX[c] = x;
+
+			i = FindBin16(pFine, half, &sum);
+			pOutRow[x] = (uint8)(c * 16 + i);
+
+			SubBins16(aryCoarse, &pColCoarse[(uint32)(x - radius) * 16]);
+		}
+	}
+
+	free(pColFine);
+	return SUCCESS;
+}
+
+OSC_ERR MedianRows(const uint8 *pIn,
+		const uint16 width,
+		const uint8 radius,
+		const uint16 firstRow,
+		const uint16 endRow,
+		uint8 *pOut)
+{
+	const uint8 *aryRows[5];
+	uint16 y, k;
+
+	if (radius > 2)
+		return MedianRowsHistogram(pIn, width, radius, firstRow, endRow, pOut);
+
+	for (y = firstRow; y < endRow; y++)
+	{
+		for (k = 0; k < 2 * radius + 1; k++)
+			aryRows[k] = &pIn[(uint32)(y - radius + k) * width];
+
+		if (radius == 1)
+			MedianRow3x3(aryRows, width, &pOut[(uint32)y * width]);
+		else
+			MedianRow5x5(aryRows, width, &pOut[(uint32)y * width]);
+	}
+	return SUCCESS;
+}
+
+OSC_ERR OscVisMedianFilter(struct OSC_PICTURE *picIn,
+		struct OSC_PICTURE *picOut,
+		const uint8 radius)
+{
+	const uint8 *pIn;
+	uint8 *pOut;
+	uint16 width, height, y;
+	OSC_ERR err = SUCCESS;
+
+	/*---------------------- Input validation. -------------------- */
+	if ((picIn == NULL) || (picOut == NULL) || (picIn->data == NULL) ||
+			(picOut->data == NULL) || (picIn->data == picOut->data) ||
+			(radius == 0) || (radius > OSC_VIS_MAX_MEDIAN_RADIUS))
+	{
+		OscLog(ERROR, "%s(0x%x, 0x%x, %d): Invalid arguments!\n",
+				__func__, picIn, picOut, radius);
+		return -EINVALID_PARAMETER;
+	}
+
+	pIn = (uint8*)picIn->data;
+	pOut = (uint8*)picOut->data;
+	width = picIn->width;
+	height = picIn->height;
+
+	if (width < 2 * radius + 1 || height < 2 * radius + 1)
+	{
+		/* Only border, which is copied. */
+		memcpy(pOut, pIn, (uint32)width * height);
+	} else {
+		memcpy(pOut, pIn, (uint32)radius * width);
+		memcpy(&pOut[(uint32)(height - radius) * width],
+				&pIn[(uint32)(height - radius) * width], (uint32)radius * width);
+		for (y = radius; y < height - radius; y++)
+		{
+			memcpy(&pOut[(uint32)y * width], &pIn[(uint32)y * width], radius);
+			memcpy(&pOut[(uint32)(y + 1) * width - radius],
+					&pIn[(uint32)(y + 1) * width - radius], radius);
+		}
+
+		err = MedianInterior(pIn, width, height, radius, pOut);
+	}
+
+	/* finalize picture */
+	picOut->width = width;
+	picOut->height = height;
+	picOut->type = OSC_PICTURE_GREYSCALE;
+	return err;
+}
@@ -0,0 +1,84 @@
+/*	Oscar, a hardware abstraction framework for the LeanXcam and IndXcam.
+	Copyright (C) 2008 Supercomputing Systems AG
+	
+	This library is free software; you can redistribute it and/or modify it
+	under the terms of the GNU Lesser General Public License as published by
+	the Free Software Foundation; either version 2.1 of the License, or (at
+	your option) any later version.
+	
+	This library is distributed in the hope that it will be useful, but
+	WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser
+	General Public License for more details.
+	
+	You should have received a copy of the GNU Lesser General Public License
+	along with this library; if not, write to the Free Software Foundation,
+	Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+/*! @file
+ * @brief Interior of the median filter on the host.
+ *
+ * The rows are split into one band per processor.
+ */
+
+#include "vis.h"
+
+/*! @brief One band of rows and the image it belongs to. */
+struct MEDIAN_BAND {
+	const uint8 *pIn;
+	uint16 width;
+	uint8 radius;
+	uint16 firstRow;
+	uint16 endRow;
+	uint8 *pOut;
+	OSC_ERR err;
+};
+
+/*********************************************************************//*!
+ * @brief Thread function filtering a band.
+ *
+ * @param pArg The band.
+ * @return Always NULL.
+ *//*********************************************************************/
+static void * MedianBand(void *pArg)
+{
+	struct MEDIAN_BAND *pBand = pArg;
+
+	pBand->err = MedianRows(pBand->pIn, pBand->width, pBand->radius,
+			pBand->firstRow, pBand->endRow, pBand->pOut);
+	return NULL;
+}
+
+OSC_ERR MedianInterior(const uint8 *pIn,
+		const uint16 width,
+		const uint16 height,
+		const uint8 radius,
+		uint8 *pOut)
+{
+	struct MEDIAN_BAND aryBands[MAX_VIS_BANDS];
+	const uint16 nRows = height - 2 * radius;
+	uint16 nBands = VisGetBandCount(nRows, MIN_VIS_BAND_ROWS), i;
+
+	if (nBands <= 1)
+		return MedianRows(pIn, width, radius, radius, height - radius, pOut);
+
+	for (i = 0; i < nBands; i++)
+	{
+		aryBands[i].pIn = pIn;
+		aryBands[i].width = width;
+		aryBands[i].radius = radius;
+		aryBands[i].firstRow = (uint16)(radius + (uint32)nRows * i / nBands);
+		aryBands[i].endRow = (uint16)(radius + (uint32)nRows * (i + 1) / nBands);
+		aryBands[i].pOut = pOut;
+	}
+
+	VisRunBands(MedianBand, aryBands, sizeof(aryBands[0]), nBands);
+
+	for (i = 0; i < nBands; i++)
+	{
+		if (aryBands[i].err != SUCCESS)
+			return aryBands[i].err;
+	}
+	return SUCCESS;
+}
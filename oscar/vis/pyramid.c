@@ -0,0 +1,256 @@
+/*	Oscar, a hardware abstraction framework for the LeanXcam and IndXcam.
+	Copyright (C) 2008 Supercomputing Systems AG
+	
+	This library is free software; you can redistribute it and/or modify it
+	under the terms of the GNU Lesser General Public License as published by
+	the Free Software Foundation; either version 2.1 of the License, or (at
+	your option) any later version.
+	
+	This library is distributed in the hope that it will be useful, but
+	WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser
+	General Public License for more details.
+	
+	You should have received a copy of the GNU Lesser General Public License
+	along with this library; if not, write to the Free Software Foundation,
+	Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+/*! @file
+ * @brief Greyscale image pyramid built from a raw image.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "vis.h"
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif /* __SSE2__ */
+
+/*! @brief The smallest width and height of a raw image, giving a level 2
+ * of 2x2 pixels. */
+#define MIN_PYRAMID_SIZE 16
+
+/*********************************************************************//*!
+ * @brief Calculate one row of a pyramid level from two rows of the
+ * level above.
+ *
+ * Every output pixel is the rounded mean of a 2x2 block.
+ *
+ * @param pRow0 The first row of the blocks.
+ * @param pRow1 The second row of the blocks.
+ * @param outWidth Number of output pixels.
+ * @param pOut The output row.
+ *//*********************************************************************/
+static void ShrinkRow(const uint8 *pRow0,
+		const uint8 *pRow1,
+		const uint16 outWidth,
+		uint8 *pOut)
+{
+	uint16 ix = 0;
+#ifdef __SSE2__
+	const __m128i lowBytes = _mm_set1_epi16(0x00ff);
+	const __m128i two = _mm_set1_epi16(2);
+
+	for (; ix + 16 <= outWidth; ix += 16)
+	{
+		__m128i mean[2];
+		uint16 half;
+
+		for (half = 0; half < 2; half++)
+		{
+			__m128i in0 = _mm_loadu_si128((const __m128i *)&pRow0[(ix + half * 8) * 2]);
+			__m128i in1 = _mm_loadu_si128((const __m128i *)&pRow1[(ix + half * 8) * 2]);
+			/* Add the left and right pixels of the blocks in 16 bit lanes. */
+			__m128i sum = _mm_add_epi16(
+					_mm_add_epi16(_mm_and_si128(in0, lowBytes), _mm_srli_epi16(in0, 8)),
+					_mm_add_epi16(_mm_and_si128(in1, lowBytes), _mm_srli_epi16(in1, 8)));
+
+			mean[half] = _mm_srli_epi16(_mm_add_epi16(sum, two), 2);
+		}
+		_mm_storeu_si128((__m128i *)&pOut[ix], _mm_packus_epi16(mean[0], mean[1]));
+	}
+#endif /* __SSE2__ */
+
+	for (; ix < outWidth; ix++)
+	{
+		pOut[ix] = (uint8)(((uint16)pRow0[2 * ix] + pRow0[2 * ix + 1] +
+				pRow1[2 * ix] + pRow1[2 * ix + 1] + 2) >> 2);
+	}
+}
+
+OSC_ERR OscVisCreatePyramid(struct OSC_VIS_PYRAMID *pPyramid,
+		const uint16 width,
+		const uint16 height)
+{
+	uint32 offset = 0;
+	uint16 levelWidth = width, levelHeight = height, i;
+
+	/*---------------------- Input validation. -------------------- */
+	if (pPyramid == NULL)
+	{
+		OscLog(ERROR, "%s(0x%x, %d, %d): Invalid arguments!\n",
+				__func__, pPyramid, width, height);
+		return -EINVALID_PARAMETER;
+	}
+
+	if ((width % 2 != 0) || (height % 2 != 0) ||
+			(width < MIN_PYRAMID_SIZE) || (height < MIN_PYRAMID_SIZE))
+	{
+		OscLog(ERROR, "%s: Invalid parameter! Width: %d Height: %d\n"
+				"Width and height must be even and >=%d.\n",
+				__func__, width, height, MIN_PYRAMID_SIZE);
+		return -EINVALID_PARAMETER;
+	}
+
+	memset(pPyramid, 0, sizeof(struct OSC_VIS_PYRAMID));
+	pPyramid->width = width;
+	pPyramid->height = height;
+
+	for (i = 0; i < OSC_VIS_PYRAMID_LEVELS; i++)
+	{
+		levelWidth /= 2;
+		levelHeight /= 2;
+		pPyramid->levels[i].width = levelWidth;
+		pPyramid->levels[i].height = levelHeight;
+		pPyramid->levels[i].type = OSC_PICTURE_GREYSCALE;
+		offset += (uint32)levelWidth * levelHeight;
+	}
+
+	pPyramid->pBuffer = malloc(offset);
+	if (pPyramid->pBuffer == NULL)
+	{
+		OscLog(ERROR, "%s: Unable to allocate %d bytes!\n", __func__, offset);
+		return -EOUT_OF_MEMORY;
+	}
+	pPyramid->bufferSize = offset;
+
+	offset = 0;
+	for (i = 0; i < OSC_VIS_PYRAMID_LEVELS; i++)
+	{
+		pPyramid->levels[i].data = &pPyramid->pBuffer[offset];
+		offset += (uint32)pPyramid->levels[i].width * pPyramid->levels[i].height;
+	}
+
+	return SUCCESS;
+}
+
+OSC_ERR OscVisDestroyPyramid(struct OSC_VIS_PYRAMID *pPyramid)
+{
+	if (pPyramid == NULL)
+	{
+		OscLog(ERROR, "%s(0x%x): Invalid arguments!\n", __func__, pPyramid);
+		return -EINVALID_PARAMETER;
+	}
+
+	free(pPyramid->pBuffer);
+	memset(pPyramid, 0, sizeof(struct OSC_VIS_PYRAMID));
+	return SUCCESS;
+}
+
+OSC_ERR OscVisBuildPyramid(struct OSC_VIS_PYRAMID *pPyramid,
+		const uint8 *pRaw,
+		const enum EnBayerOrder enBayerOrderFirstRow)
+{
+	const struct OSC_PICTURE *pHalf, *pQuarter, *pEighth;
+	uint8 *pHalfData, *pQuarterData, *pEighthData;
+	bool bTopLeftIsGreen;
+	uint16 iy, iyQuarter, iyEighth;
+
+	/*---------------------- Input validation. -------------------- */
+	if ((pPyramid == NULL) || (pPyramid->pBuffer == NULL) || (pRaw == NULL))
+	{
+		OscLog(ERROR, "%s(0x%x, 0x%x, %d): Invalid arguments!\n",
+				__func__, pPyramid, pRaw, enBayerOrderFirstRow);
+		return -EINVALID_PARAMETER;
+	}
+
+	pHalf = &pPyramid->levels[0];
+	pQuarter = &pPyramid->levels[1];
+	pEighth = &pPyramid->levels[2];
+	pHalfData = pHalf->data;
+	pQuarterData = pQuarter->data;
+	pEighthData = pEighth->data;
+
+	bTopLeftIsGreen = (enBayerOrderFirstRow == ROW_GBGB) || (enBayerOrderFirstRow == ROW_GRGR);
+
+	/* Each row of a smaller level follows right after the second of its
+	 * two rows in the level above. Odd rows and columns left over at the
+	 * end of a level are not used by the next. */
+	for (iy = 0; iy < pHalf->height; iy++)
+	{
+		DebayerGreyscaleHalfSizeRow(&pRaw[(uint32)iy * 2 * pPyramid->width],
+				&pRaw[((uint32)iy * 2 + 1) * pPyramid->width],
+				pHalf->width,
+				bTopLeftIsGreen,
+				&pHalfData[(uint32)iy * pHalf->width]);
+
+		iyQuarter = iy / 2;
+		if (iy % 2 == 0)
+			continue;
+
+		ShrinkRow(&pHalfData[(uint32)(iy - 1) * pHalf->width],
+				&pHalfData[(uint32)iy * pHalf->width],
+				pQuarter->width,
+				&pQuarterData[(uint32)iyQuarter * pQuarter->width]);
+
+		iyEighth = iyQuarter / 2;
+		if (iyQuarter % 2 == 0)
+			continue;
+
+		ShrinkRow(&pQuarterData[(uint32)(iyQuarter - 1) * pQuarter->width],
+				&pQuarterData[(uint32)iyQuarter * pQuarter->width],
+				pEighth->width,
+				&pEighthData[(uint32)iyEighth * pEighth->width]);
+	}
+
+	return SUCCESS;
+}
+
+OSC_ERR OscVisBuildPyramidLevel(const struct OSC_PICTURE *picIn,
+		struct OSC_PICTURE *picOut)
+{
+	const uint8 *pIn;
+	uint8 *pOut;
+	uint16 outWidth, outHeight, iy;
+
+	/*---------------------- Input validation. -------------------- */
+	if ((picIn == NULL) || (picOut == NULL) || (picIn->data == NULL) ||
+			(picOut->data == NULL) || (picIn->data == picOut->data) ||
+			(picIn->type != OSC_PICTURE_GREYSCALE))
+	{
+		OscLog(ERROR, "%s(0x%x, 0x%x): Invalid arguments!\n",
+				__func__, picIn, picOut);
+		return -EINVALID_PARAMETER;
+	}
+
+	if ((picIn->width < 2) || (picIn->height < 2))
+	{
+		OscLog(ERROR, "%s: Invalid parameter! Width: %d Height: %d\n"
+				"Width and height must be >=2.\n",
+				__func__, picIn->width, picIn->height);
+		return -EINVALID_PARAMETER;
+	}
+
+	pIn = (const uint8*)picIn->data;
+	pOut = (uint8*)picOut->data;
+	outWidth = picIn->width / 2;
+	outHeight = picIn->height / 2;
+
+	for (iy = 0; iy < outHeight; iy++)
+	{
+		ShrinkRow(&pIn[(uint32)iy * 2 * picIn->width],
+				&pIn[((uint32)iy * 2 + 1) * picIn->width],
+				outWidth,
+				&pOut[(uint32)iy * outWidth]);
+	}
+
+	/* finalize picture */
+	picOut->width = outWidth;
+	picOut->height = outHeight;
+	picOut->type = OSC_PICTURE_GREYSCALE;
+	return SUCCESS;
+}
@@ -25,6 +25,10 @@
 
 #include "oscar.h"
 
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif /* __SSE2__ */
+
 /*======================= Private methods ==============================*/
 /*********************************************************************//*!
  * @brief Assembler method to debayer a raw image to grey by averaging 
@@ -42,4 +46,171 @@ extern void debayer_grey(unsigned char *pDst,
                          unsigned int width,
                          unsigned int height);
 
+/*********************************************************************//*!
+ * @brief Interpolate the green color of rows of OscVisDebayer.
+ * 
+ * Only rows with two rows above and below them may be passed.
+ * 
+ * @param pRaw The raw image.
+ * @param width Width of the image.
+ * @param firstRow The first row to interpolate.
+ * @param endRow The row after the last one to interpolate.
+ * @param bTopLeftIsGreen Whether the top left pixel of the image is
+ * green.
+ * @param pOut The output image.
+ *//*********************************************************************/
+void DebayerLinCorrGreenRows(const uint8* pRaw,
+		const uint16 width,
+		const uint16 firstRow,
+		const uint16 endRow,
+		const bool bTopLeftIsGreen,
+		uint8 *const pOut);
+
+/*********************************************************************//*!
+ * @brief Interpolate the red and blue colors of rows of OscVisDebayer.
+ * 
+ * The green color of the rows and of the row above and below each must
+ * be done.
+ * 
+ * @param pRaw The raw image.
+ * @param width Width of the image.
+ * @param firstRow The first row to interpolate, at least 1.
+ * @param endRow The row after the last one to interpolate, at most
+ * height - 1.
+ * @param bTopLeftIsGreen Whether the top left pixel of the image is
+ * green.
+ * @param bTopRowIsRed Whether the top row of the image contains red
+ * pixels.
+ * @param pOut The output image.
+ *//*********************************************************************/
+void DebayerLinCorrRedBlueRows(const uint8* pRaw,
+		const uint16 width,
+		const uint16 firstRow,
+		const uint16 endRow,
+		const bool bTopLeftIsGreen,
+		const bool bTopRowIsRed,
+		uint8 *const pOut);
+
+/*********************************************************************//*!
+ * @brief Interpolate all but the first and last two rows for the green
+ * color and all but the first and last row for red and blue.
+ * 
+ * On the host the image is split into bands of rows that are done on
+ * several threads.
+ * 
+ * @param pRaw The raw image.
+ * @param width Width of the image.
+ * @param height Height of the image.
+ * @param bTopLeftIsGreen Whether the top left pixel of the image is
+ * green.
+ * @param bTopRowIsRed Whether the top row of the image contains red
+ * pixels.
+ * @param pOut The output image.
+ *//*********************************************************************/
+void DebayerLinCorrInterior(const uint8* pRaw,
+		const uint16 width,
+		const uint16 height,
+		const bool bTopLeftIsGreen,
+		const bool bTopRowIsRed,
+		uint8 *const pOut);
+
+/*********************************************************************//*!
+ * @brief Calculate one row of OscVisDebayerGreyscaleHalfSize.
+ * 
+ * @param pRow0 The first raw row of the cells.
+ * @param pRow1 The second raw row of the cells.
+ * @param outWidth Number of output pixels.
+ * @param bTopLeftIsGreen Whether the first pixel of pRow0 is green.
+ * @param pOut The output row.
+ *//*********************************************************************/
+void DebayerGreyscaleHalfSizeRow(uint8 const *pRow0,
+		uint8 const *pRow1,
+		uint16 const outWidth,
+		bool const bTopLeftIsGreen,
+		uint8 *pOut);
+
+/*********************************************************************//*!
+ * @brief Filter the inner pixels of rows of OscVisMedianFilter.
+ * 
+ * @param pIn The input image.
+ * @param width Width of the image.
+ * @param radius Pixels from the center to the border of the window.
+ * @param firstRow The first row to filter, at least radius.
+ * @param endRow The row after the last one to filter, at most height -
+ * radius.
+ * @param pOut The output image.
+ * @return SUCCESS or an appropriate error code otherwise.
+ *//*********************************************************************/
+OSC_ERR MedianRows(const uint8 *pIn,
+		const uint16 width,
+		const uint8 radius,
+		const uint16 firstRow,
+		const uint16 endRow,
+		uint8 *pOut);
+
+/*********************************************************************//*!
+ * @brief Filter all pixels of an image with a median that are at least
+ * radius pixels away from the border.
+ * 
+ * On the host the image is split into bands of rows that are done on
+ * several threads.
+ * 
+ * @param pIn The input image.
+ * @param width Width of the image, at least 2 * radius + 1.
+ * @param height Height of the image, at least 2 * radius + 1.
+ * @param radius Pixels from the center to the border of the window.
+ * @param pOut The output image.
+ * @return SUCCESS or an appropriate error code otherwise.
+ *//*********************************************************************/
+OSC_ERR MedianInterior(const uint8 *pIn,
+		const uint16 width,
+		const uint16 height,
+		const uint8 radius,
+		uint8 *pOut);
+
+#ifdef __SSE2__
+/*! @brief Take a where the mask is set and b elsewhere. */
+static inline __m128i VisSelect(__m128i mask, __m128i a, __m128i b)
+{
+	return _mm_or_si128(_mm_and_si128(mask, a), _mm_andnot_si128(mask, b));
+}
+#endif /* __SSE2__ */
+
+#ifdef OSC_HOST
+/*! @brief The maximum number of bands an image is split into. */
+#define MAX_VIS_BANDS 8
+/*! @brief The minimum number of rows in a band, smaller images are done
+ * on fewer threads. */
+#define MIN_VIS_BAND_ROWS 64
+
+/*********************************************************************//*!
+ * @brief Get the number of bands to split the rows of an image into.
+ * 
+ * There is at most one band per processor and each band has at least
+ * minRows rows.
+ * 
+ * @param nRows The number of rows to split.
+ * @param minRows The minimum number of rows per band.
+ * @return The number of bands, between 1 and MAX_VIS_BANDS.
+ *//*********************************************************************/
+uint16 VisGetBandCount(const uint32 nRows, const uint32 minRows);
+
+/*********************************************************************//*!
+ * @brief Run a function on all bands, the first one on the calling
+ * thread and the others on threads of their own.
+ * 
+ * A band whose thread cannot be started is done by the caller. Returns
+ * when all bands are done.
+ * 
+ * @param pfBand The thread function, called with a pointer to a band.
+ * @param pBands Array of the band structures.
+ * @param bandSize The size of a band structure.
+ * @param nBands The number of bands, at most MAX_VIS_BANDS.
+ *//*********************************************************************/
+void VisRunBands(void * (*pfBand)(void *),
+		void *pBands,
+		const size_t bandSize,
+		const uint16 nBands);
+#endif /* OSC_HOST */
+
 #endif /*VIS_PRIV_H_*/
@@ -14,11 +14,16 @@
 
 OSC_ERR OscVisDrawBoundingBoxBW(struct OSC_PICTURE *picIn, struct OSC_VIS_REGIONS *regions, uint8 Color);
 
-void ProcessFrame(uint8 *pInputImg)
+void ProcessFrame(uint8 *pRawImg)
 {
 	int c, r;
 	int nc = OSC_CAM_MAX_IMAGE_WIDTH/2;
 	int siz = sizeof(data.u8TempImage[GRAYSCALE]);
+	/* The grey image is only needed while it is being shown. */
+	bool bStoreGrey = (data.ipc.state.nImageType == GRAYSCALE);
+	/* The current row of the grey image, if it is not stored. */
+	uint8 GreyRow[OSC_CAM_MAX_IMAGE_WIDTH/2];
+	uint8 *pGrey;
 
 	int Shift = 7;
 	short Beta = 2;//the meaning is that in floating point the value of Beta is = 6/(1 << Shift) = 6/128 = 0.0469
@@ -31,7 +36,9 @@ void ProcessFrame(uint8 *pInputImg)
 	{
 		/* this is the first time we call this function */
 		/* first time we call this; index 1 always has the background image */
-		memcpy(data.u8TempImage[BACKGROUND], data.u8TempImage[GRAYSCALE], sizeof(data.u8TempImage[GRAYSCALE]));
+		OscVisDebayerGreyscaleHalfSize(pRawImg, OSC_CAM_MAX_IMAGE_WIDTH, OSC_CAM_MAX_IMAGE_HEIGHT, ROW_BGBG, data.u8TempImage[BACKGROUND]);
+		if(bStoreGrey)
+			memcpy(data.u8TempImage[GRAYSCALE], data.u8TempImage[BACKGROUND], sizeof(data.u8TempImage[GRAYSCALE]));
 		/* set foreground counter to zero */
 		memset(data.u8TempImage[FGRCOUNTER], 0, sizeof(data.u8TempImage[FGRCOUNTER]));
 	}
@@ -40,10 +47,17 @@ void ProcessFrame(uint8 *pInputImg)
 		/* this is the default case */
 		for(r = 0; r < siz; r+= nc)/* we strongly rely on the fact that them images have the same size */
 		{
+			/* debayer the row while the raw rows and the row of the
+			 * background model are both in the cache */
+			pGrey = bStoreGrey ? &data.u8TempImage[GRAYSCALE][r] : GreyRow;
+			OscVisDebayerGreyscaleHalfSize(&pRawImg[r/nc*2*OSC_CAM_MAX_IMAGE_WIDTH], OSC_CAM_MAX_IMAGE_WIDTH, 2, ROW_BGBG, pGrey);
+
 			for(c = 0; c < nc; c++)
 			{
+				short Grey = pGrey[c];
+
 				/* first determine the foreground estimate */
-				data.u8TempImage[THRESHOLD][r+c] = abs((short) data.u8TempImage[GRAYSCALE][r+c]-(short) data.u8TempImage[BACKGROUND][r+c]) < data.ipc.state.nThreshold ? 0 : 0xff;
+				data.u8TempImage[THRESHOLD][r+c] = abs(Grey-(short) data.u8TempImage[BACKGROUND][r+c]) < data.ipc.state.nThreshold ? 0 : 0xff;
 
 				/* now depending on the foreground estimate ... */
 				if(data.u8TempImage[THRESHOLD][r+c]) {
@@ -53,14 +67,14 @@ void ProcessFrame(uint8 *pInputImg)
 					} else {
 						/* if counter reaches max -> set current image to background */
 						data.u8TempImage[FGRCOUNTER][r+c] = 0;
-						data.u8TempImage[BACKGROUND][r+c] = data.u8TempImage[GRAYSCALE][r+c];
+						data.u8TempImage[BACKGROUND][r+c] = (uint8) Grey;
 					}
 				} else {/* ...or in case background is detected -> decrease foreground counter and update background as usual */					
 					if(0 < data.u8TempImage[FGRCOUNTER][r+c]) {
 						data.u8TempImage[FGRCOUNTER][r+c]--;
 					}
 					/* now update the background image; the value of background should be corrected by the following difference (* 1/128) */
-					short Diff = Beta*((short) data.u8TempImage[GRAYSCALE][r+c] - (short) data.u8TempImage[BACKGROUND][r+c]);
+					short Diff = Beta*(Grey - (short) data.u8TempImage[BACKGROUND][r+c]);
 
 					if(abs(Diff) >= 128) //we will have a correction - apply it (this also avoids the "bug" that -1 >> 1 = -1)
 						data.u8TempImage[BACKGROUND][r+c] = (uint8) ((short) data.u8TempImage[BACKGROUND][r+c] + (Diff >> Shift));//first cast to (short) because Diff can be negative then cast to uint8
@@ -128,8 +142,11 @@ void ProcessFrame(uint8 *pInputImg)
 
 		//OscLog(INFO, "number of objects %d\n", ImgRegions.noOfObjects);
 		//plot bounding boxes both in gray and dilation image
-		Pic2.data = data.u8TempImage[GRAYSCALE];
-		OscVisDrawBoundingBoxBW( &Pic2, &ImgRegions, 255);
+		if(bStoreGrey)
+		{
+			Pic2.data = data.u8TempImage[GRAYSCALE];
+			OscVisDrawBoundingBoxBW( &Pic2, &ImgRegions, 255);
+		}
 		OscVisDrawBoundingBoxBW( &Pic1, &ImgRegions, 128);
 	}
 }
@@ -25,6 +25,14 @@
 /*! @brief The file name of the test image on the host. */
 #define TEST_IMAGE_FN "test.bmp"
 
+/*! @brief Upper limit (ms) for a client waiting on a state change. The other
+ * clients are served while a WAIT_APP_STATE request is held back. */
+#define MAX_STATE_WAIT_TIMEOUT 2000
+
+/*! @brief Number of pyramid levels kept for decimated image requests,
+ * i.e. 1/2, 1/4 and 1/8 of the half resolution image. */
+#define NR_PYRAMID_LEVELS 3
+
 /*------------------- Main data object and members ------------------*/
 
 /*! @brief The different states of a pending IPC request. */
@@ -35,6 +43,21 @@ enum EnIpcRequestState
 	REQ_STATE_NACK_PENDING
 };
 
+/*! @brief A client's long poll for a change of the application state. */
+struct STATE_WAIT
+{
+	/*! @brief The held back WAIT_APP_STATE request, valid if bPending. */
+	struct OSC_IPC_REQUEST req;
+	/*! @brief Whether req is held back. */
+	bool bPending;
+	/*! @brief The state version the request compares against. */
+	struct APP_STATE_VERSION version;
+	/*! @brief Whether version was set since the last WAIT_APP_STATE request. */
+	bool bVersionSet;
+	/*! @brief Cycle count when the request was received. */
+	long long start;
+};
+
 /*! @brief Holds all the data needed for IPC with the user interface.*/
 struct IPC_DATA
 {
@@ -45,6 +68,11 @@ struct IPC_DATA
 	struct OSC_IPC_REQUEST req;
 	/*! @brief The state of above IPC request. */
 	enum EnIpcRequestState enReqState;
+	/*! @brief The state waits, indexed by the client connection. */
+	struct STATE_WAIT aryStateWaits[OSC_IPC_MAX_CONNECTIONS];
+	/*! @brief The image area and decimation returned by GET_IMG_RECT, indexed
+	 * by the client connection. */
+	struct IMG_REQUEST aryImgRequests[OSC_IPC_MAX_CONNECTIONS];
 	
 	/*! @brief All the information requested by the web interface is gathered
 	 * here. */
@@ -91,6 +119,16 @@ struct TEMPLATE
 	uint8* pCurRawImg;
 	/*! @brief All data necessary for IPC. */
 	struct IPC_DATA ipc;
+	/*! @brief Downscaled copies of one of the temporary images, one level
+	 * after the other, each half the size of the previous. Built on demand
+	 * by image requests. */
+	uint8 u8Pyramid[OSC_CAM_MAX_IMAGE_WIDTH/4*OSC_CAM_MAX_IMAGE_HEIGHT/4*4/3];
+	/*! @brief The temporary image the pyramid was built from. */
+	int nPyramidImg;
+	/*! @brief Step counter of the frame the pyramid was built from. */
+	unsigned int nPyramidStep;
+	/*! @brief The number of valid pyramid levels. */
+	int nPyramidLevels;
 
 };
 
@@ -144,15 +182,37 @@ OSC_ERR AckIpcRequests();
  *//*********************************************************************/
 void IpcSendImage(fract16 *f16Image, uint32 nPixels);
 
+/*********************************************************************//*!
+ * @brief Check whether an image request lies within the live image and
+ * uses a supported decimation factor.
+ * 
+ * @param pImgReq The image request to check.
+ * @return TRUE if the request can be served.
+ *//*********************************************************************/
+bool IsValidImgRequest(const struct IMG_REQUEST *pImgReq);
+
+/*********************************************************************//*!
+ * @brief Write the area of a temporary image selected by the image
+ * request of the client to the result pointer of the current request.
+ * 
+ * The caller has checked that the area fits into the request.
+ * 
+ * Decimated requests are served from a pyramid of the image, which is
+ * built at most once per frame and image.
+ * 
+ * @param nImg Index of the temporary image to send.
+ *//*********************************************************************/
+void IpcSendImageRect(int nImg);
+
 /*********************************************************************//*!
  * @brief Process a newly captured frame.
  * 
- * In the case of this template, this consists just of debayering the
- * image and writing the result to the result image buffer. This should
- * be the starting point where you add your code.
+ * The raw image is debayered to half size one row at a time and each
+ * row is fed to the background model right away. The grey image is only
+ * stored while the user interface shows it.
  * 
  * @param pRawImg The raw image to process.
  *//*********************************************************************/
-void ProcessFrame();
+void ProcessFrame(uint8 *pRawImg);
 
 #endif /*TEMPLATE_H_*/
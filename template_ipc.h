@@ -18,7 +18,13 @@ enum EnIpcParamIds
 	GET_NEW_IMG,
 	SET_IMAGE_TYPE,
 	SET_EXPOSURE_TIME,
-	SET_THRESHOLD
+	SET_THRESHOLD,
+	SET_IMAGE_FORMAT,
+	SET_JPEG_QUALITY,
+	SET_STATE_VERSION,
+	WAIT_APP_STATE,
+	SET_IMG_REQUEST,
+	GET_IMG_RECT
 };
 
 /*! @brief The path of the unix domain socket used for IPC between the application and its user interface. */
@@ -37,6 +43,26 @@ struct IMG_RECT
 	uint16 yPos;
 };
 
+/*! @brief The largest decimation factor supported by image requests. */
+#define MAX_IMG_DECIMATION 8
+
+/*! @brief Selects the part of the live image returned by GET_IMG_RECT. Set
+ * with SET_IMG_REQUEST. The rectangle is given in pixels of the half
+ * resolution live image, counted from its first pixel in memory. */
+struct IMG_REQUEST
+{
+	/*! @brief The area of the live image to return. */
+	struct IMG_RECT rect;
+	/*! @brief Downscaling factor (1, 2, 4 or 8). Each output pixel is the
+	 * average of decimation x decimation input pixels. */
+	uint16 decimation;
+};
+
+/*! @brief The size in bytes of the image returned for an IMG_REQUEST. */
+#define IMG_REQUEST_WIDTH(pReq) ((pReq)->rect.width / (pReq)->decimation)
+#define IMG_REQUEST_HEIGHT(pReq) ((pReq)->rect.height / (pReq)->decimation)
+#define IMG_REQUEST_SIZE(pReq) (IMG_REQUEST_WIDTH(pReq) * IMG_REQUEST_HEIGHT(pReq))
+
 /*! @brief The different modes the application can be in. */
 enum EnAppMode
 {
@@ -44,6 +70,13 @@ enum EnAppMode
 	APP_CAPTURE_ON
 };
 
+/*! @brief The file formats the live image can be served in. */
+enum EnImageFormat
+{
+	IMG_FORMAT_BMP,
+	IMG_FORMAT_JPEG
+};
+
 /*! @brief Object describing all the state information the web interface needs to know about the application. */
 struct APPLICATION_STATE
 {
@@ -61,6 +94,28 @@ struct APPLICATION_STATE
 	int nThreshold;
 	/*! @brief  the step counter */
 	unsigned int nStepCounter;
+	/*! @brief The file format the live image is served in. */
+	enum EnImageFormat enImageFormat;
+	/*! @brief JPEG quality in percent (1 to 100) used for the live image. */
+	int nJpegQuality;
+};
+
+/*! @brief The part of the application state a client has last seen. Set with
+ * SET_STATE_VERSION before a WAIT_APP_STATE request, which is only answered
+ * once one of these fields changed or the timeout expired. */
+struct APP_STATE_VERSION
+{
+	/*! @brief The step counter last seen by the client. */
+	unsigned int nStepCounter;
+	/*! @brief The threshold last seen by the client. */
+	int nThreshold;
+	/*! @brief The exposure time last seen by the client. */
+	int nExposureTime;
+	/*! @brief The image type index last seen by the client. */
+	unsigned int nImageType;
+	/*! @brief Time in milliseconds to wait for a change at most. Limited to
+	 * MAX_STATE_WAIT_TIMEOUT by the application. */
+	uint32 timeout;
 };
 
 #endif /*TEMPLATE_IPC_H_*/